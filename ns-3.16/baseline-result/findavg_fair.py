@@ -1,6 +1,7 @@
 import os
 import sys
 import numpy
+import records
 
 
 regular = dict()
@@ -8,7 +9,7 @@ rc3 = dict()
 
 
 def findavgregular(input_file):
-  lines = input_file.readlines()
+  lines = records.readlines(input_file)
   for line in lines:
       words  = line.split()
       if((float(words[1]) + float(words[2]) <= 10) and (float(words[2]) >= 2)):
@@ -18,7 +19,7 @@ def findavgregular(input_file):
 
 
 def findavgrc3(input_file):
-  lines = input_file.readlines()
+  lines = records.readlines(input_file)
   for line in lines:
       words  = line.split()
       if((float(words[1]) + float(words[2]) <= 5) and (float(words[2]) >= 2)):
@@ -32,8 +33,8 @@ if __name__ == "__main__":
     sys.exit(1)
 
   try:
-    input_file1 = open(sys.argv[1])
-    input_file2 = open(sys.argv[2])
+    input_file1 = open(sys.argv[1], 'rb')
+    input_file2 = open(sys.argv[2], 'rb')
   except:
     print "Error opening", sys.argv[1]
     sys.exit(1)
@@ -0,0 +1,82 @@
+"""Reader of the logs written by ns3::RecordSink.
+
+A log is either the original tab separated text or, when the simulation
+ran with --binaryLogs=1, a binary record file:
+
+  'RECS', version (1 byte), byte order ('<' or '>'),
+  16 bit format length, format, then the packed records.
+
+Each character of the format is one field, with the struct module codes
+d (double), Q, I, H (unsigned) and i (int32); s is a string stored as a
+16 bit length followed by its bytes.
+
+  python records.py recv.bin > recv.txt
+
+converts a binary log back to the text the simulation would have written.
+"""
+
+import struct
+import sys
+
+MAGIC = b'RECS'
+
+
+def _format_field(value):
+  if isinstance(value, float):
+    # the default precision of std::ostream
+    return '%g' % value
+  if isinstance(value, bytes) and not isinstance(value, str):
+    return value.decode('latin-1')
+  return str(value)
+
+
+def _read_binary(data):
+  version = ord(data[4:5])
+  if version != 1:
+    raise ValueError("unsupported record version %d" % version)
+  order = data[5:6].decode('ascii')
+  (length,) = struct.unpack(order + 'H', data[6:8])
+  fmt = data[8:8 + length].decode('ascii')
+  offset = 8 + length
+  # runs of fixed size fields are unpacked at once
+  chunks = []
+  for field in fmt:
+    if field == 's':
+      chunks.append(None)
+    elif chunks and chunks[-1] is not None:
+      chunks[-1] += field
+    else:
+      chunks.append(field)
+  chunks = [c if c is None else struct.Struct(order + c) for c in chunks]
+  string_length = struct.Struct(order + 'H')
+  while offset < len(data):
+    record = []
+    for chunk in chunks:
+      if chunk is None:
+        (n,) = string_length.unpack_from(data, offset)
+        offset += string_length.size
+        record.append(data[offset:offset + n])
+        offset += n
+      else:
+        record.extend(chunk.unpack_from(data, offset))
+        offset += chunk.size
+    yield record
+
+
+def readlines(input_file):
+  """Return the records of an open log as lines of text."""
+  data = input_file.read()
+  if isinstance(data, str) and not isinstance(data, bytes):
+    data = data.encode('latin-1')
+  if data[:4] != MAGIC:
+    return data.decode('latin-1').splitlines(True)
+  return ['\t'.join(_format_field(v) for v in record) + '\n'
+          for record in _read_binary(data)]
+
+
+if __name__ == "__main__":
+  if len(sys.argv) < 2:
+    print("Usage: %s <log file>" % sys.argv[0])
+    sys.exit(1)
+  with open(sys.argv[1], 'rb') as f:
+    sys.stdout.writelines(readlines(f))
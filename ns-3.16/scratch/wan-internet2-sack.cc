@@ -17,6 +17,10 @@
 */
 
 #include <iostream>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <algorithm>
 #include "ns3/header.h"
 #include "ns3/ptr.h"
 #include "ns3/log.h"
@@ -28,16 +32,18 @@
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/flow-monitor-helper.h"
 #include "ns3/priority-queue.h"
+#include "ns3/record-sink.h"
+#include "ns3/fct-collector.h"
 #include "ns3/point-to-point-layout-module.h"
 #include "ns3/seq-ts-header.h"
 #include "ns3/my-priority-tag.h"
+#include "ns3/topology-partitioner.h"
 
 
 #define MAXPACKETS 100
 #define MAXBYTES 1024
 #define BYTES 1024000
 #define PKTCOUNT 1
-#define LOGINTERVAL 1
 
 using namespace ns3;
 using namespace std;
@@ -47,21 +53,14 @@ NS_LOG_COMPONENT_DEFINE ("TCPTopology");
         
         
 
-ofstream ofs1("recv.txt", ios::app); 
+RecordStream *recvStream;
 
-struct FlowsCompleted
+// recv.txt keeps the size, completion time, start and id of each flow
+static void RecordFlowCompleted(const FctCollector::FlowRecord &flow)
 {
-  uint32_t size;
-  double latency;
-  double starttime;
-  uint32_t flowid;
-};
-
-FlowsCompleted *flowsCompleted;
-uint32_t flowsCompletedCnt;
-double logTime;
+  recvStream->Add (flow.size).Add (flow.lastByte.GetSeconds () - flow.start.GetSeconds ()).Add (flow.start.GetSeconds ()).Add (flow.flowId).End ();
+}
 
-Ptr<Socket> *sock1;
 int NODES, LINKS;
 
 class Sender : public Application
@@ -170,6 +169,8 @@ public:
     void Setup(Address address, uint32_t packetSize, double starttime, uint32_t flowid, uint8_t priority);
     Ptr<Socket> GetListeningSocket (void) const;
     std::list<Ptr<Socket> > GetAcceptedSockets (void) const;
+    void SetCompleteCallback (Callback<void, uint32_t> complete);
+    void SetCollector (Ptr<FctCollector> collector);
     
 protected:
     virtual void DoDispose (void);
@@ -196,6 +197,8 @@ private:
     double m_starttime;
     uint32_t        m_flowid;
     uint8_t         m_priority;
+    Callback<void, uint32_t> m_completeCallback;
+    Ptr<FctCollector> m_collector;
     TracedCallback<Ptr<const Packet>, const Address &> m_rxTrace;
     
 };
@@ -240,11 +243,27 @@ TcpReceiver::GetAcceptedSockets (void) const
     return m_socketList;
 }
 
+// Called with the flow id once all the bytes of the flow are received
+void
+TcpReceiver::SetCompleteCallback (Callback<void, uint32_t> complete)
+{
+    m_completeCallback = complete;
+}
+
+// Told of the first and last bytes of the flow
+void
+TcpReceiver::SetCollector (Ptr<FctCollector> collector)
+{
+    m_collector = collector;
+}
+
 void TcpReceiver::DoDispose (void)
 {
     NS_LOG_FUNCTION (this);
     m_socket = 0;
     m_socketList.clear ();
+    m_completeCallback = MakeNullCallback<void, uint32_t> ();
+    m_collector = 0;
     
     // chain up
     Application::DoDispose ();
@@ -313,6 +332,8 @@ void TcpReceiver::HandleRead (Ptr<Socket> socket)
         { //EOF
             break;
         }
+        if (m_totalRx == 0 && m_collector)
+            m_collector->FirstByte (m_flowid);
         m_totalRx += packet->GetSize ();
         //packet->PeekHeader(h);
         /*buf = (char*)malloc(packet->GetSize());
@@ -344,19 +365,11 @@ void TcpReceiver::HandleRead (Ptr<Socket> socket)
         {
             //std::cout<<"\nReceived all data ("<<m_totalRx<<") at:"<<Simulator::Now().GetSeconds()<<" from "<<InetSocketAddress::ConvertFrom(from).GetIpv4 ()<<"\n";
             //ofs1<<m_totalBytes<<"\t"<<Simulator::Now().GetSeconds()-m_starttime<<"\t"<<m_starttime<<"\n";
-            flowsCompleted[flowsCompletedCnt].size = m_totalBytes;
-            flowsCompleted[flowsCompletedCnt].latency = Simulator::Now().GetSeconds()-m_starttime;
-            flowsCompleted[flowsCompletedCnt].starttime = m_starttime;
-            flowsCompleted[flowsCompletedCnt].flowid = m_flowid;
-            flowsCompletedCnt++;
-    
-            if(Simulator::Now().GetSeconds() > logTime + LOGINTERVAL)
-            {
-              logTime = logTime + LOGINTERVAL;
-              for(uint32_t i=0; i<flowsCompletedCnt; i++)
-                  ofs1<<flowsCompleted[i].size<<"\t"<<flowsCompleted[i].latency<<"\t"<<flowsCompleted[i].starttime<<"\t"<<flowsCompleted[i].flowid<<"\n";
-              flowsCompletedCnt = 0;
-            } 
+            if(m_collector)
+              m_collector->FlowCompleted(m_flowid);
+
+            if(!m_completeCallback.IsNull())
+              m_completeCallback(m_flowid);
         }
         
         /*if(m_totalRx > m_totalBytes)
@@ -387,26 +400,225 @@ void TcpReceiver::HandleAccept (Ptr<Socket> s, const Address& from)
 }
 
 
-uint32_t *linkutil;
-static void LinkUtilLog(std::string context, Ptr<Packet const> p)
+// Reads the workload one arrival at a time and creates the sender and
+// receiver of a flow at its start time. With teardown enabled, both ends
+// are closed and released once the receiver has the whole flow, so the
+// number of live sockets and listening endpoints follows the number of
+// concurrent flows rather than the size of the workload.
+class WorkloadDriver
+{
+public:
+    WorkloadDriver(FILE *workload, double endtime, bool teardown);
+    void SetHosts(NodeContainer nodes, std::vector<Ipv4Address> hostAddresses, uint32_t initcwnd);
+    void SetCollector(Ptr<FctCollector> collector);
+    void Start();
+    uint32_t GetPeakFlows() const;
+    uint32_t GetStartedFlows() const;
+    
+private:
+    struct ActiveFlow
+    {
+        Ptr<Sender> sender;
+        Ptr<Socket> socket;
+        Ptr<TcpReceiver> receiver;
+    };
+    
+    void ReadNext();
+    void StartFlow();
+    void FlowCompleted(uint32_t flowid);
+    void Teardown(uint32_t flowid);
+    
+    FILE *m_workload;
+    double m_endtime;
+    bool m_teardown;
+    NodeContainer m_nodes;
+    std::vector<Ipv4Address> m_hostAddresses;
+    std::vector<uint16_t> m_ports;
+    uint32_t m_initcwnd;
+    Ptr<FctCollector> m_collector;
+    
+    // the arrival read ahead, started at m_starttime
+    double m_starttime;
+    uint32_t m_size, m_sender, m_dest, m_flowid;
+    uint32_t m_nextFlowid;
+    
+    std::map<uint32_t, ActiveFlow> m_active;
+    uint32_t m_peakFlows;
+    uint32_t m_startedFlows;
+};
+
+WorkloadDriver::WorkloadDriver(FILE *workload, double endtime, bool teardown)
+: m_workload(workload),
+m_endtime(endtime),
+m_teardown(teardown),
+m_initcwnd(1),
+m_nextFlowid(0),
+m_peakFlows(0),
+m_startedFlows(0)
+{
+    uint32_t num;
+    if(fscanf(m_workload, "%d", &num) != 1)
+      cout<<"Error";
+}
+
+void
+WorkloadDriver::SetHosts(NodeContainer nodes, std::vector<Ipv4Address> hostAddresses, uint32_t initcwnd)
+{
+    m_nodes = nodes;
+    m_hostAddresses = hostAddresses;
+    m_ports.assign(nodes.GetN(), 1);
+    m_initcwnd = initcwnd;
+}
+
+// Told of the start, retransmissions and completion of every flow
+void
+WorkloadDriver::SetCollector(Ptr<FctCollector> collector)
+{
+    m_collector = collector;
+}
+
+void
+WorkloadDriver::Start()
+{
+    ReadNext();
+}
+
+uint32_t
+WorkloadDriver::GetPeakFlows() const
+{
+    return m_peakFlows;
+}
+
+uint32_t
+WorkloadDriver::GetStartedFlows() const
+{
+    return m_startedFlows;
+}
+
+// Arrivals are expected in timestamp order; one that is already late starts
+// right away. Flows starting after the end time are skipped.
+void
+WorkloadDriver::ReadNext()
+{
+    while(fscanf(m_workload, "%lf %d %d %d", &m_starttime, &m_size, &m_sender, &m_dest) == 4)
+    {
+        m_flowid = m_nextFlowid++;
+        if(m_starttime < m_endtime)
+        {
+            Time delay = Seconds(m_starttime) - Simulator::Now();
+            if(delay.IsStrictlyNegative())
+              delay = Seconds(0);
+            Simulator::Schedule(delay, &WorkloadDriver::StartFlow, this);
+            return;
+        }
+    }
+}
+
+void
+WorkloadDriver::StartFlow()
+{
+    Ptr<Node> sender = m_nodes.Get(m_sender);
+    Ptr<Node> dest = m_nodes.Get(m_dest);
+    Address sinkAddress(InetSocketAddress(m_hostAddresses[m_dest], m_ports[m_dest]++));
+    // the applications are not added to the nodes, they only live as long as the flow
+    Time stop = Seconds(m_endtime) - Simulator::Now();
+    
+    ActiveFlow &flow = m_active[m_flowid];
+    flow.receiver = CreateObject<TcpReceiver>();
+    flow.receiver->Setup(sinkAddress, m_size, m_starttime, m_flowid, 0);
+    flow.receiver->SetNode(dest);
+    flow.receiver->SetStartTime(Seconds(0.));
+    flow.receiver->SetStopTime(stop);
+    if(m_collector)
+      flow.receiver->SetCollector(m_collector);
+    if(m_teardown)
+      flow.receiver->SetCompleteCallback(MakeCallback(&WorkloadDriver::FlowCompleted, this));
+    
+    flow.socket = Socket::CreateSocket(sender, TcpSocketFactory::GetTypeId());
+    flow.socket -> SetAttribute("FlowId", UintegerValue (m_flowid));
+    flow.socket -> SetAttribute("FlowSize", UintegerValue (m_size));
+    flow.socket -> SetAttribute("Priority", UintegerValue (0));
+    flow.socket -> SetAttribute("InitialCwnd", UintegerValue (m_initcwnd));
+    flow.socket -> SetAttribute("DeviceQueue", PointerValue(sender->GetDevice(0)->GetObject<PointToPointNetDevice>()->GetQueue()));
+    //flow.socket -> TraceConnect("CongestionWindow", "Cwind", MakeCallback(&CwndChange));
+    if(m_collector)
+    {
+        // rounded, not truncated like Seconds(), so that recv.txt has the start of the workload
+        m_collector->FlowStarted(m_flowid, m_size, NanoSeconds((int64_t)(m_starttime * 1e9 + 0.5)));
+        flow.socket -> TraceConnectWithoutContext("Retransmission", MakeCallback(&FctCollector::Retransmit, m_collector));
+        flow.socket -> TraceConnectWithoutContext("Timeout", MakeCallback(&FctCollector::Timeout, m_collector));
+    }
+    flow.sender = CreateObject<Sender>();
+    flow.sender->Setup(flow.socket, sinkAddress, m_size);
+    flow.sender->SetNode(sender);
+    flow.sender->SetStartTime(Seconds(0.));
+    flow.sender->SetStopTime(stop);
+    
+    // the receiver listens before the sender connects
+    Simulator::ScheduleWithContext(dest->GetId(), Seconds(0), &Object::Start, flow.receiver);
+    Simulator::ScheduleWithContext(sender->GetId(), Seconds(0), &Object::Start, flow.sender);
+    
+    m_startedFlows++;
+    m_peakFlows = std::max(m_peakFlows, (uint32_t)m_active.size());
+    ReadNext();
+}
+
+void
+WorkloadDriver::FlowCompleted(uint32_t flowid)
 {
-      if(p!=NULL)
-      {
-          int link = atoi(context.c_str());
-          linkutil[link] += p->GetSize();
-          //linkutilfs<<context<<"\t"<<p->GetSize()<<"\t"<<Simulator::Now().GetSeconds()<<"\n";
-      }
+    // called from the receive callback of the socket, close it afterwards
+    Simulator::ScheduleNow(&WorkloadDriver::Teardown, this, flowid);
 }
 
+void
+WorkloadDriver::Teardown(uint32_t flowid)
+{
+    std::map<uint32_t, ActiveFlow>::iterator it = m_active.find(flowid);
+    if(it == m_active.end())
+      return;
+    ActiveFlow &flow = it->second;
+    
+    // the receiver closes first, the sender closes as soon as it sees the FIN
+    flow.socket->ShutdownSend();
+    std::list<Ptr<Socket> > accepted = flow.receiver->GetAcceptedSockets();
+    for(std::list<Ptr<Socket> >::iterator s = accepted.begin(); s != accepted.end(); s++)
+    {
+        (*s)->SetRecvCallback(MakeNullCallback<void, Ptr<Socket> > ());
+        (*s)->SetCloseCallbacks(MakeNullCallback<void, Ptr<Socket> > (),
+                                MakeNullCallback<void, Ptr<Socket> > ());
+        (*s)->Close();
+    }
+    Ptr<Socket> listening = flow.receiver->GetListeningSocket();
+    if(listening)
+    {
+        listening->SetRecvCallback(MakeNullCallback<void, Ptr<Socket> > ());
+        listening->SetAcceptCallback(MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                                     MakeNullCallback<void, Ptr<Socket>, const Address &> ());
+        listening->SetCloseCallbacks(MakeNullCallback<void, Ptr<Socket> > (),
+                                     MakeNullCallback<void, Ptr<Socket> > ());
+        listening->Close();
+    }
+    flow.receiver->Dispose();
+    flow.sender->Dispose();
+    m_active.erase(it);
+}
+
+
+//the two devices of each link, sampled from the byte counters of their
+//MacTx trace point instead of a callback per transmitted packet
+std::vector<Ptr<PointToPointNetDevice> > linkDevices;
+uint64_t *linkutil;  // bytes sent on each link at the last sample
+
 
-ofstream linkutilfs("linkutil.txt", ios::app);
+RecordStream *linkutilStream;
 EventId linkutilevent;
 void RecordLinkUtil()
 {
   for(int i=0; i<LINKS; i++)
   {
-      linkutilfs<<Simulator::Now().GetSeconds()<<"\t"<<i<<"\t"<<linkutil[i]<<"\n";
-      linkutil[i] = 0;
+      uint64_t bytes = linkDevices[2*i]->GetCounters ().macTxBytes + linkDevices[2*i+1]->GetCounters ().macTxBytes;
+      linkutilStream->Add (Simulator::Now ().GetSeconds ()).Add ((int32_t)i).Add ((uint32_t)(bytes - linkutil[i])).End ();
+      linkutil[i] = bytes;
   }
   linkutilevent = Simulator::Schedule(Seconds(0.1), RecordLinkUtil);
 }
@@ -414,16 +626,31 @@ void RecordLinkUtil()
 
 
 
-ofstream dropsofs("drops.txt", ios::app);
-static void PacketDropped(std::string context, Ptr<Packet const> p)
+RecordStream *dropsStream;
+static void PacketDropped(uint32_t queueId, Ptr<Packet const> p, uint8_t priority, uint32_t flowId)
 {
-      if(p!=NULL)
-      {
-          MyPriorityTag tag;
-          p->PeekPacketTag(tag);
-          NS_ASSERT(tag.GetTypeId().GetName() == "ns3::MyPriorityTag");
-          dropsofs<<Simulator::Now().GetSeconds()<<"\t"<<context<<"\t"<<tag.GetId()<<"\t"<<(uint16_t)tag.GetPriority()<<"\n";
-      }
+      dropsStream->Add (Simulator::Now ().GetSeconds ()).Add (queueId).Add (flowId).Add ((uint16_t)priority).End ();
+}
+
+//one record per queue and priority class, written at the end of the run
+std::vector<Ptr<PriorityQueue> > priorityQueues;
+void RecordClassStats(RecordStream *stream)
+{
+  for(uint32_t i=0; i<priorityQueues.size(); i++)
+  {
+    for(uint8_t c=0; c<NUM_PRIORITY_QUEUES; c++)
+    {
+      const PriorityQueue::ClassStats &stats = priorityQueues[i]->GetClassStats(c);
+      double meanSojourn = stats.dequeuedPackets > 0 ? stats.sojournSum.GetSeconds() / stats.dequeuedPackets : 0;
+      stream->Add (priorityQueues[i]->GetSampleId ()).Add ((uint16_t)c)
+        .Add (stats.enqueuedPackets).Add (stats.enqueuedBytes)
+        .Add (stats.dequeuedPackets).Add (stats.dequeuedBytes)
+        .Add (stats.droppedPackets).Add (stats.droppedBytes)
+        .Add (stats.pushedOutPackets).Add (stats.pushedOutBytes)
+        .Add (stats.flushedPackets).Add (stats.flushedBytes)
+        .Add (meanSojourn).Add (stats.maxSojourn.GetSeconds ()).End ();
+    }
+  }
 }
 
 /*ofstream cwndofs("cwnd.txt", ios::app);
@@ -438,6 +665,147 @@ CwndChange (std::string context, uint32_t oldCwnd, uint32_t newCwnd)
 
 
 
+//records the operations on the event list for utils/bench-scheduler:
+//one 64 bit word each, the timestamp of an insertion, EVENT_TRACE_NEXT
+//for the removal of the next event, or EVENT_TRACE_REMOVE with the
+//number of the insertion of a removed event
+#define EVENT_TRACE_NEXT (1ULL << 63)
+#define EVENT_TRACE_REMOVE (1ULL << 62)
+class EventTraceScheduler : public MapScheduler
+{
+public:
+  static TypeId GetTypeId(void);
+  EventTraceScheduler();
+  virtual ~EventTraceScheduler();
+
+  virtual void Insert(const Event &ev);
+  virtual Event RemoveNext(void);
+  virtual void Remove(const Event &ev);
+
+private:
+  void Write(uint64_t word);
+  void SetFileName(std::string fileName);
+  std::string GetFileName(void) const;
+
+  std::string m_fileName;
+  FILE *m_file;
+  bool m_first;
+  uint32_t m_firstUid;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(EventTraceScheduler);
+
+TypeId
+EventTraceScheduler::GetTypeId(void)
+{
+  static TypeId tid = TypeId("ns3::EventTraceScheduler")
+    .SetParent<MapScheduler>()
+    .AddConstructor<EventTraceScheduler>()
+    .AddAttribute("FileName", "The file the event list operations are written to",
+                  StringValue("events.bin"),
+                  MakeStringAccessor(&EventTraceScheduler::SetFileName, &EventTraceScheduler::GetFileName),
+                  MakeStringChecker())
+  ;
+  return tid;
+}
+
+EventTraceScheduler::EventTraceScheduler()
+  : m_file(0),
+    m_first(true),
+    m_firstUid(0)
+{
+}
+
+EventTraceScheduler::~EventTraceScheduler()
+{
+  if(m_file)
+    fclose(m_file);
+}
+
+void
+EventTraceScheduler::SetFileName(std::string fileName)
+{
+  if(m_file)
+    fclose(m_file);
+  m_fileName = fileName;
+  m_file = fopen(fileName.c_str(), "wb");
+  if(m_file == 0)
+    NS_FATAL_ERROR("Can not open " << fileName);
+}
+
+std::string
+EventTraceScheduler::GetFileName(void) const
+{
+  return m_fileName;
+}
+
+void
+EventTraceScheduler::Write(uint64_t word)
+{
+  if(fwrite(&word, sizeof(word), 1, m_file) != 1)
+    NS_FATAL_ERROR("Can not write to " << m_fileName);
+}
+
+void
+EventTraceScheduler::Insert(const Event &ev)
+{
+  //the simulator numbers the events in the order of their insertion
+  if(m_first)
+  {
+    m_firstUid = ev.key.m_uid;
+    m_first = false;
+  }
+  Write(ev.key.m_ts);
+  MapScheduler::Insert(ev);
+}
+
+Scheduler::Event
+EventTraceScheduler::RemoveNext(void)
+{
+  Write(EVENT_TRACE_NEXT);
+  return MapScheduler::RemoveNext();
+}
+
+void
+EventTraceScheduler::Remove(const Event &ev)
+{
+  Write(EVENT_TRACE_REMOVE | (ev.key.m_uid - m_firstUid));
+  MapScheduler::Remove(ev);
+}
+
+//splits the topology for a parallel run, the flows of the workload
+//giving the load of the nodes they cross: about three events per data
+//packet at every hop, half of that for the acks coming back
+void PartitionTopology(uint32_t partitions, int links, int *n1s, int *n2s, int *linkDelays,
+                       const char *workload, double endtime, std::string path)
+{
+  TopologyPartitioner partitioner;
+  for(int i=0; i<links; i++)
+    partitioner.AddLink(n1s[i], n2s[i], MilliSeconds(linkDelays[i]));
+
+  FILE *fp = fopen(workload, "r");
+  uint32_t num;
+  double starttime;
+  int size, sender, dest;
+  if(fp == NULL || fscanf(fp, "%d", &num) != 1)
+    NS_FATAL_ERROR("Can not read the workload " << workload);
+  while(fscanf(fp, "%lf %d %d %d", &starttime, &size, &sender, &dest) == 4)
+  {
+    if(starttime >= endtime)
+      continue;
+    double packets = (size + 1459) / 1460;
+    partitioner.AddFlow(sender, dest, packets * 3 / endtime);
+    partitioner.AddFlow(dest, sender, packets * 1.5 / endtime);
+  }
+  fclose(fp);
+
+  partitioner.Partition(partitions);
+  partitioner.Print(cout);
+  std::ofstream os(path.c_str());
+  for(uint32_t i=0; i<partitioner.GetNNodes(); i++)
+    os << i << " " << partitioner.GetPartition(i) << "\n";
+}
+
 int main (int argc, char *argv[])
 {
 
@@ -450,12 +818,21 @@ int main (int argc, char *argv[])
   bool multipriorities = 0;
   bool logCleanUp = 0;
   bool flushOut = 0;
+  bool pacedLowPriority = 0;
+  bool teardown = 1;
+  bool binaryLogs = 0;
+  std::string queueSampling = "Periodic";
+  std::string packetChecking = "Headers";
+  std::string outputDir = "";
   double backgrounddrop = 0;
   uint32_t prioritySlots = 4;
+  uint32_t partitions = 0;
+  std::string scheduler = "";
+  std::string eventTrace = "";
+  bool flowMonitor = 0;
 
 
 
-  Packet::EnableChecking();
   //LogComponentEnable ("Ipv4GlobalRouting", LOG_LEVEL_INFO);
   //LogComponentEnable ("Ipv4StaticRouting", LOG_LEVEL_INFO);
   //LogComponentEnable ("TcpSocketBase", LOG_LEVEL_ALL);
@@ -478,8 +855,53 @@ int main (int argc, char *argv[])
   cmd.AddValue("logCleanUp", "logCleanUp", logCleanUp);
   cmd.AddValue("backgrounddrop", "backgrounddrop", backgrounddrop);
   cmd.AddValue("flushOut", "flushOut", flushOut);
+  cmd.AddValue("teardown", "Close and release the sockets of a flow once it is received", teardown);
+  cmd.AddValue("pacedLowPriority", "Build low priority packets when the device queue sends them", pacedLowPriority);
+  cmd.AddValue("binaryLogs", "Write the logs as binary records, see baseline-result/records.py", binaryLogs);
+  cmd.AddValue("queueSampling", "Queue length sampling: Periodic, OnChange, Histogram or Disabled", queueSampling);
+  cmd.AddValue("packetChecking", "Packet sanity checks: Metadata (full packet metadata), Headers (header stack only) or None", packetChecking);
+  cmd.AddValue("outputDir", "Directory the logs are written to, created if needed (default: the working directory)", outputDir);
+  cmd.AddValue("partitions", "Split the topology into this many partitions for a parallel run, written to partitions.txt (default: 0, no split)", partitions);
+  cmd.AddValue("scheduler", "TypeId of the event scheduler (default: ns3::MapScheduler)", scheduler);
+  cmd.AddValue("eventTrace", "Record the operations on the event list to this file, for utils/bench-scheduler", eventTrace);
+  cmd.AddValue("flowMonitor", "Monitor the packets of every flow at every node, written to flowmon.xml", flowMonitor);
   cmd.Parse(argc, argv); 
 
+  if(!eventTrace.empty())
+  {
+    ObjectFactory factory("ns3::EventTraceScheduler");
+    factory.Set("FileName", StringValue(eventTrace));
+    Simulator::SetScheduler(factory);
+  }
+  else if(!scheduler.empty())
+    Simulator::SetScheduler(ObjectFactory(scheduler));
+
+  //the packet metadata records every header of every packet: keep it for debugging
+  if(packetChecking == "Metadata")
+    Packet::EnableChecking();
+  else if(packetChecking == "Headers")
+    Packet::EnableHeaderChecking();
+  else if(packetChecking != "None")
+    NS_FATAL_ERROR("Unknown packetChecking " << packetChecking);
+
+  //every log goes to outputDir, so that several runs can share a working directory
+  std::string out = "";
+  if(!outputDir.empty())
+  {
+    SystemPath::MakeDirectories(outputDir);
+    out = outputDir + "/";
+  }
+  RecordSink::SetBinary(binaryLogs);
+  recvStream = RecordSink::GetStream (out + "recv.txt", "IddI");
+  linkutilStream = RecordSink::GetStream (out + "linkutil.txt", "diI");
+  dropsStream = RecordSink::GetStream (out + "drops.txt", "dIIH");
+  Config::SetDefault ("ns3::TcpRC3Sack::RtoFile", StringValue(out + "rto.txt"));
+  Config::SetDefault ("ns3::TcpRC3Sack::AcksFile", StringValue(out + "acks.txt"));
+  Config::SetDefault ("ns3::TcpRC3Sack::CleanUpFile", StringValue(out + "cleanup.txt"));
+  Config::SetDefault ("ns3::PriorityQueue::QueueLengthFile", StringValue(out + "queuelength.txt"));
+  Config::SetDefault ("ns3::QueueSampler::SubQueueFile", StringValue(out + "subqueuelength.txt"));
+  Config::SetDefault ("ns3::QueueSampler::HistogramFile", StringValue(out + "queuehistogram.txt"));
+
 
   Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (2048000000));
   Config::SetDefault ("ns3::TcpSocket::RcvBufSize", UintegerValue (2048000000));
@@ -488,13 +910,19 @@ int main (int argc, char *argv[])
   Config::SetDefault ("ns3::TcpL4Protocol::SocketType", StringValue ("ns3::TcpRC3Sack"));
   Config::SetDefault ("ns3::TcpSocket::DelAckCount", UintegerValue (1));
   Config::SetDefault ("ns3::RttEstimator::InitialEstimation", TimeValue (Seconds (1)));
+  //closed flows only linger in TIME_WAIT for 2*MSL, keep their endpoints out of the demux
+  Config::SetDefault ("ns3::TcpSocketBase::MaxSegLifetime", DoubleValue (0.1));
+  // Sender only sends size-only packets
+  Config::SetDefault ("ns3::TcpSocketBase::VirtualPayload", BooleanValue(true));
   Config::SetDefault ("ns3::TcpRC3Sack::LimitedWindow", BooleanValue(false));
   Config::SetDefault ("ns3::TcpRC3Sack::LogRTO", BooleanValue(true));
   Config::SetDefault ("ns3::TcpRC3Sack::LogCleanUp", BooleanValue(logCleanUp));
   Config::SetDefault ("ns3::TcpRC3Sack::UseP2", BooleanValue(useP2));
   Config::SetDefault ("ns3::TcpRC3Sack::FlushOut", BooleanValue(flushOut));
+  Config::SetDefault ("ns3::TcpRC3Sack::PacedLowPriority", BooleanValue(pacedLowPriority));
   Config::SetDefault ("ns3::TcpRC3Sack::MultiPriorities", BooleanValue(multipriorities));
   Config::SetDefault ("ns3::TcpRC3Sack::PrioritySlots", UintegerValue(prioritySlots));
+  Config::SetDefault ("ns3::QueueSampler::Mode", StringValue(queueSampling));
 
   FILE *fp = fopen(topofile, "r");
   FILE *fp2 = fopen(endhostfile,"r");
@@ -521,6 +949,7 @@ int main (int argc, char *argv[])
 
   int linkDelays[LINKS];
   int linkBandwidths[LINKS];
+  int linkEnds[2][LINKS];
 
   int n1, n2;
   for(int i=0; i<LINKS; i++)
@@ -529,12 +958,17 @@ int main (int argc, char *argv[])
     err=fscanf(fp, "%d", &n2);
     err=fscanf(fp, "%d", &linkBandwidths[i]);
     err=fscanf(fp, "%d", &linkDelays[i]);
+    linkEnds[0][i] = n1;
+    linkEnds[1][i] = n2;
     
     p2p[i].Add(nodes.Get(n1)); 
     p2p[i].Add(nodes.Get(n2)); 
   }
 
   cout<<"Read the links with delay-bandwidth\n";
+
+  if(partitions > 0)
+    PartitionTopology(partitions, LINKS, linkEnds[0], linkEnds[1], linkDelays, workload, endtime, out + "partitions.txt");
   //end hosts
  
 
@@ -546,7 +980,7 @@ int main (int argc, char *argv[])
   
   PointToPointHelper pointToPoint[LINKS];
   NetDeviceContainer devices[LINKS];
-  linkutil = new uint32_t[LINKS];
+  linkutil = new uint64_t[LINKS];
   for(int i=0; i < LINKS; i++)
   {
     //setting link characteristics
@@ -561,28 +995,29 @@ int main (int argc, char *argv[])
 
     //for logging link utilization
     linkutil[i] = 0;
-    sprintf(str, "%d", i);
-    devices[i].Get(0)->GetObject<PointToPointNetDevice> () -> TraceConnect("MacTx", str, MakeCallback(&LinkUtilLog));
-    sprintf(str, "%d", i);
-    devices[i].Get(1)->GetObject<PointToPointNetDevice> () -> TraceConnect("MacTx", str, MakeCallback(&LinkUtilLog));
+    linkDevices.push_back(devices[i].Get(0)->GetObject<PointToPointNetDevice> ());
+    linkDevices.push_back(devices[i].Get(1)->GetObject<PointToPointNetDevice> ());
   }
 
 
   cout<<"Assigned delay and bandiwdth\n";
 
   uint32_t queueid = 0;
+  std::vector<Ptr<const AttributeValue> > queueids;
   for(int i=0; i<NODES; i++)
   {
     for(int j=0; j<(int)nodes.Get(i)->GetNDevices(); j++)
     {
-      sprintf(str, "/NodeList/%d/DeviceList/%d/TxQueue/Id", i, j);
-      Config::Set (str, UintegerValue (queueid++));
-      sprintf(str, "%d", queueid-1);
-      nodes.Get(i)->GetDevice(j)->GetObject<PointToPointNetDevice>()->GetQueue()->TraceConnect("Drop", str, MakeCallback(&PacketDropped));
+      queueids.push_back(Create<UintegerValue> (queueid++));
+      nodes.Get(i)->GetDevice(j)->GetObject<PointToPointNetDevice>()->GetQueue()->TraceConnectWithoutContext("ClassDrop", MakeBoundCallback(&PacketDropped, queueid-1));
+      nodes.Get(i)->GetDevice(j)->GetObject<PointToPointNetDevice>()->GetQueue()->TraceConnectWithoutContext("ClassPushOut", MakeBoundCallback(&PacketDropped, queueid-1));
+      priorityQueues.push_back(nodes.Get(i)->GetDevice(j)->GetObject<PointToPointNetDevice>()->GetQueue()->GetObject<PriorityQueue>());
       nodes.Get(i)->GetDevice(j)->GetObject<PointToPointNetDevice>()->GetQueue()->SetAttribute("MaxBytes", UintegerValue(bufsize));
       nodes.Get(i)->GetDevice(j)->GetObject<PointToPointNetDevice>()->GetQueue()->SetAttribute("BackgroundDrop", DoubleValue(backgrounddrop));
     }
   }
+  //one walk of the node list for all the queues, in the order of the loop above
+  Config::SetMany ("/NodeList/*/DeviceList/*/TxQueue/Id", queueids);
 
   InternetStackHelper stack;
   stack.Install(nodes);
@@ -609,6 +1044,8 @@ int main (int argc, char *argv[])
 
   int host_interfaces[NODES];
   int host_interfaceIdx[NODES];
+  for(int i=0; i<NODES; i++)
+    host_interfaces[i] = -1;
   int numhosts;
   int host, link, idx;
   err=fscanf(fp2, "%d", &numhosts);
@@ -631,74 +1068,34 @@ int main (int argc, char *argv[])
 
   cout<<"\n\n\nAll routes included...I am all set :)\n\n\n";
 
-  FILE *fp3 = fopen(workload,"r");
-
-  uint32_t num;
-  err=fscanf(fp3, "%d", &num);
-  
-
-
-  Ptr<Sender> *sendapp1 = new Ptr<Sender>[num];
-  Ptr<TcpReceiver> *recvapp1 = new Ptr<TcpReceiver>[num];
-  sock1 = new Ptr<Socket>[num];
-
-  flowsCompleted = new FlowsCompleted[num];
-  flowsCompletedCnt = 0;
-  logTime = 0;
-
-
-  uint16_t ports[NODES];
+  //hosts are addressed by the interface of their access link
+  std::vector<Ipv4Address> hostAddresses(NODES);
   for(int i=0; i<NODES; i++)
-    ports[i] = 1;
-
-  RecordLinkUtil();
-
-  for(uint32_t i = 0; i<num; i++)
-  {
-
-    double starttime;
-    uint32_t size, sender, dest;
+    if(host_interfaces[i] >= 0)
+      hostAddresses[i] = interfaces[host_interfaces[i]].GetAddress(host_interfaceIdx[i]);
 
+  FILE *fp3 = fopen(workload,"r");
+  WorkloadDriver driver(fp3, endtime, teardown);
+  driver.SetHosts(nodes, hostAddresses, initcwnd_base);
+  // the summary window is set with --ns3::FctCollector::SummaryStart/SummaryStop
+  Ptr<FctCollector> collector = CreateObject<FctCollector>();
+  collector->SetAttribute("FlowFile", StringValue(out + "fct.txt"));
+  collector->TraceConnectWithoutContext("FlowCompleted", MakeCallback(&RecordFlowCompleted));
+  driver.SetCollector(collector);
 
-    err=fscanf(fp3, "%lf %d %d %d", &starttime, &size, &sender, &dest); 
-
-    if(starttime < endtime)
-    {
-        Address sinkAddress(InetSocketAddress(interfaces[host_interfaces[dest]].GetAddress(host_interfaceIdx[dest]), ports[dest]++));
-  
-
-        sendapp1[i] = CreateObject<Sender>();
-        sock1[i] = Socket::CreateSocket(nodes.Get(sender), TcpSocketFactory::GetTypeId());
-        sock1[i] -> SetAttribute("FlowId", UintegerValue (i));
-        sock1[i] -> SetAttribute("FlowSize", UintegerValue (size));
-        sock1[i] -> SetAttribute("Priority", UintegerValue (0));
-        sock1[i] -> SetAttribute("InitialCwnd", UintegerValue (initcwnd_base));
-        sock1[i] -> SetAttribute("DeviceQueue", PointerValue(nodes.Get(sender)->GetDevice(0)->GetObject<PointToPointNetDevice>()->GetQueue()));
-        //sock1[i] -> TraceConnect("CongestionWindow", "Cwind", MakeCallback(&CwndChange));
-        sendapp1[i]->Setup(sock1[i], sinkAddress, size);
-        nodes.Get(sender)->AddApplication(sendapp1[i]);
-        sendapp1[i]->SetStartTime(Seconds(starttime));
-        sendapp1[i]->SetStopTime(Seconds(endtime));
-
-
-        recvapp1[i] = CreateObject<TcpReceiver>();
-        recvapp1[i]->Setup(sinkAddress, size, starttime, i, 0);
-        nodes.Get(dest)->AddApplication(recvapp1[i]);
-        recvapp1[i]->SetStartTime(Seconds(0.));
-        recvapp1[i]->SetStopTime(Seconds(endtime));
-    }
-
+  RecordLinkUtil();
 
-  }
+  driver.Start();
 
 
    if(err==-1)
     cout<<"Error";
 
   // Flow Monitor
-  /*Ptr<FlowMonitor> flowmon;
+  Ptr<FlowMonitor> flowmon;
   FlowMonitorHelper flowmonHelper;
-  flowmon = flowmonHelper.InstallAll ();*/
+  if(flowMonitor)
+    flowmon = flowmonHelper.InstallAll ();
   
 
 
@@ -707,11 +1104,18 @@ int main (int argc, char *argv[])
   //pointToPoint.EnablePcapAll("tcptopo");
   Simulator::Stop(Seconds(endtime));
   Simulator::Run ();
-  //flowmon->SerializeToXmlFile ("tcptopo.flowmon", false, false);
+  if(flowmon)
+    flowmon->SerializeToXmlFile (out + "flowmon.xml", false, false);
+  cout<<"Started "<<driver.GetStartedFlows()<<" flows, at most "<<driver.GetPeakFlows()<<" at once\n";
+  collector->WriteSummary (RecordSink::GetStream (out + "fct-summary.txt", "IdddddQ"));
+  collector->Dispose ();
+  RecordClassStats (RecordSink::GetStream (out + "classstats.txt", "IHQQQQQQQQQQdd"));
+  priorityQueues.clear();
+  linkDevices.clear();
+
+  //flushes the logs
   Simulator::Destroy ();
+  fclose(fp3);
 
-  for(uint32_t i=0; i<flowsCompletedCnt; i++)
-    ofs1<<flowsCompleted[i].size<<"\t"<<flowsCompleted[i].latency<<"\t"<<flowsCompleted[i].starttime<<"\t"<<flowsCompleted[i].flowid<<"\n";
-  
   return 0;
 }
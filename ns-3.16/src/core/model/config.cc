@@ -244,6 +244,7 @@ private:
   void Canonicalize (void);
   void DoResolve (std::string path, Ptr<Object> root);
   void DoArrayResolve (std::string path, const ObjectPtrContainerValue &vector);
+  bool GetArrayIndex (std::string path, uint32_t *index) const;
   void DoResolveOne (Ptr<Object> object);
   std::string GetResolvedPath (void) const;
   virtual void DoOne (Ptr<Object> object, std::string path) = 0;
@@ -440,10 +441,30 @@ Resolver::DoResolve (std::string path, Ptr<Object> root)
             {
               NS_LOG_DEBUG ("GetAttribute(vector)="<<info.name<<" on path="<<GetResolvedPath () << pathLeft);
               foundMatch = true;
-              ObjectPtrContainerValue vector;
-              root->GetAttribute (info.name, vector);
               m_workStack.push_back (info.name);
-              DoArrayResolve (pathLeft, vector);
+              const ObjectPtrContainerAccessor *accessor = 
+                dynamic_cast<const ObjectPtrContainerAccessor *> (PeekPointer (info.accessor));
+              uint32_t index;
+              if (accessor != 0 && GetArrayIndex (pathLeft, &index))
+                {
+                  // a single element: fetch it without copying the whole
+                  // container, which keeps /NodeList/i/DeviceList/j paths
+                  // independent of the number of nodes.
+                  Ptr<Object> object = accessor->GetAt (PeekPointer (root), index);
+                  if (object != 0)
+                    {
+                      std::string::size_type next = pathLeft.find ("/", 1);
+                      m_workStack.push_back (pathLeft.substr (1, next-1));
+                      DoResolve (pathLeft.substr (next, pathLeft.size ()-next), object);
+                      m_workStack.pop_back ();
+                    }
+                }
+              else
+                {
+                  ObjectPtrContainerValue vector;
+                  root->GetAttribute (info.name, vector);
+                  DoArrayResolve (pathLeft, vector);
+                }
               m_workStack.pop_back ();
             }
           // this could be anything else and we don't know what to do with it.
@@ -486,11 +507,43 @@ Resolver::DoArrayResolve (std::string path, const ObjectPtrContainerValue &conta
     }
 }
 
+bool
+Resolver::GetArrayIndex (std::string path, uint32_t *index) const
+{
+  NS_LOG_FUNCTION (this << path << index);
+  std::string::size_type next = path.find ("/", 1);
+  if (next == std::string::npos || next == 1 || next > 11)
+    {
+      return false;
+    }
+  // only the canonical form, so that the resolved path is the same as
+  // the one DoArrayResolve builds
+  if (path[1] == '0' && next != 2)
+    {
+      return false;
+    }
+  uint64_t value = 0;
+  for (std::string::size_type i = 1; i < next; i++)
+    {
+      if (path[i] < '0' || path[i] > '9')
+        {
+          return false;
+        }
+      value = value * 10 + (path[i] - '0');
+    }
+  if (value > 0xffffffff)
+    {
+      return false;
+    }
+  *index = value;
+  return true;
+}
 
 class ConfigImpl 
 {
 public:
   void Set (std::string path, const AttributeValue &value);
+  void SetMany (std::string path, const std::vector<Ptr<const AttributeValue> > &values);
   void ConnectWithoutContext (std::string path, const CallbackBase &cb);
   void Connect (std::string path, const CallbackBase &cb);
   void DisconnectWithoutContext (std::string path, const CallbackBase &cb);
@@ -532,6 +585,24 @@ ConfigImpl::Set (std::string path, const AttributeValue &value)
   container.Set (leaf, value);
 }
 void 
+ConfigImpl::SetMany (std::string path, const std::vector<Ptr<const AttributeValue> > &values)
+{
+  NS_LOG_FUNCTION (this << path << &values);
+
+  std::string root, leaf;
+  ParsePath (path, &root, &leaf);
+  Config::MatchContainer container = LookupMatches (root);
+  if (container.GetN () != values.size ())
+    {
+      NS_FATAL_ERROR ("Path " << path << " matches " << container.GetN () << " objects"
+                      " but " << values.size () << " values were given");
+    }
+  for (uint32_t i = 0; i < container.GetN (); i++)
+    {
+      container.Get (i)->SetAttribute (leaf, *values[i]);
+    }
+}
+void 
 ConfigImpl::ConnectWithoutContext (std::string path, const CallbackBase &cb)
 {
   NS_LOG_FUNCTION (this << path << &cb);
@@ -664,6 +735,11 @@ void Set (std::string path, const AttributeValue &value)
   NS_LOG_FUNCTION (path << &value);
   Singleton<ConfigImpl>::Get ()->Set (path, value);
 }
+void SetMany (std::string path, const std::vector<Ptr<const AttributeValue> > &values)
+{
+  NS_LOG_FUNCTION (path << &values);
+  Singleton<ConfigImpl>::Get ()->SetMany (path, values);
+}
 void SetDefault (std::string name, const AttributeValue &value)
 {
   NS_LOG_FUNCTION (name << &value);
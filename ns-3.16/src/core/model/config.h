@@ -51,6 +51,17 @@ void Reset (void);
  * value.
  */
 void Set (std::string path, const AttributeValue &value);
+/**
+ * \param path a path to match attributes.
+ * \param values the values to set, one per matching attribute.
+ *
+ * This function will resolve the input path once and then set the
+ * attribute of the i-th matching object, in the order of LookupMatches,
+ * to the i-th value.  Setting a different value on each of many objects
+ * this way costs one walk of the object tree instead of one per object.
+ * It will crash if the number of values is not the number of matches.
+ */
+void SetMany (std::string path, const std::vector<Ptr<const AttributeValue> > &values);
 /**
  * \param name the full name of the attribute
  * \param value the value to set.
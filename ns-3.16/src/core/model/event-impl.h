@@ -22,6 +22,7 @@
 
 #include <stdint.h>
 #include "simple-ref-count.h"
+#include "pool-allocator.h"
 
 namespace ns3 {
 
@@ -58,6 +59,14 @@ public:
    */
   bool IsCancelled (void);
 
+  /**
+   * Events are created and destroyed by the million, so they come from
+   * the PoolAllocator. The destructor is virtual, so the size given to
+   * operator delete is the one of the concrete event.
+   */
+  static void *operator new (size_t size);
+  static void operator delete (void *p, size_t size);
+
 protected:
   virtual void Notify (void) = 0;
 
@@ -67,4 +76,20 @@ private:
 
 } // namespace ns3
 
+namespace ns3 {
+
+inline void *
+EventImpl::operator new (size_t size)
+{
+  return PoolAllocator::Allocate (size);
+}
+
+inline void
+EventImpl::operator delete (void *p, size_t size)
+{
+  PoolAllocator::Deallocate (p, size);
+}
+
+} // namespace ns3
+
 #endif /* EVENT_IMPL_H */
@@ -79,6 +79,22 @@ MakeObjectMapAccessor (U T::*memberVector)
       // quiet compiler.
       return 0;
     }
+    virtual Ptr<Object> DoGetAt (const ObjectBase *object, uint32_t index) const {
+      const T *obj = dynamic_cast<const T *> (object);
+      if (obj == 0)
+        {
+          return 0;
+        }
+      typename U::const_iterator end = (obj->*m_memberVector).end ();
+      for (typename U::const_iterator j = (obj->*m_memberVector).begin (); j != end; j++)
+        {
+          if ((*j).first == index)
+            {
+              return (*j).second;
+            }
+        }
+      return 0;
+    }
     U T::*m_memberVector;
   } *spec = new MemberStdContainer ();
   spec->m_memberVector = memberVector;
@@ -139,9 +139,19 @@ public:
   virtual bool Get (const ObjectBase * object, AttributeValue &value) const;
   virtual bool HasGetter (void) const;
   virtual bool HasSetter (void) const;
+  /**
+   * \param object the object which holds the container
+   * \param index the index of the requested object
+   * \returns the object stored at index, or zero if there is none.
+   *
+   * Unlike Get, this does not copy the whole container.
+   */
+  Ptr<Object> GetAt (const ObjectBase *object, uint32_t index) const;
 private:
   virtual bool DoGetN (const ObjectBase *object, uint32_t *n) const = 0;
   virtual Ptr<Object> DoGet (const ObjectBase *object, uint32_t i, uint32_t *index) const = 0;
+  // the default implementation looks for index among all the elements
+  virtual Ptr<Object> DoGetAt (const ObjectBase *object, uint32_t index) const;
 };
 
 template <typename T, typename U, typename INDEX>
@@ -165,6 +175,15 @@ MakeObjectPtrContainerAccessor (Ptr<U> (T::*get)(INDEX) const,
       *index = i;
       return (obj->*m_get)(i);
     }
+    virtual Ptr<Object> DoGetAt (const ObjectBase *object, uint32_t index) const {
+      uint32_t n;
+      if (!DoGetN (object, &n) || index >= n)
+        {
+          return 0;
+        }
+      const T *obj = static_cast<const T *> (object);
+      return (obj->*m_get)(index);
+    }
     Ptr<U> (T::*m_get)(INDEX) const;
     INDEX (T::*m_getN)(void) const;
   } *spec = new MemberGetters ();
@@ -0,0 +1,73 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "pool-allocator.h"
+#include "global-value.h"
+#include "boolean.h"
+#include "log.h"
+
+NS_LOG_COMPONENT_DEFINE ("PoolAllocator");
+
+namespace ns3 {
+
+static GlobalValue g_poolAllocation = GlobalValue ("PoolAllocation",
+                                                   "Take events, packets and packet tags from "
+                                                   "size-class free lists instead of the system allocator",
+                                                   BooleanValue (false),
+                                                   MakeBooleanChecker ());
+
+enum PoolAllocator::State PoolAllocator::g_state = PoolAllocator::UNKNOWN;
+struct PoolAllocator::Block *PoolAllocator::g_free[PoolAllocator::N_CLASSES];
+
+// the size of the chunks the blocks are carved from
+static const uint32_t CHUNK_SIZE = 64 * 1024;
+
+bool
+PoolAllocator::IsEnabled (void)
+{
+  if (g_state == UNKNOWN)
+    {
+      Initialize ();
+    }
+  return g_state == ENABLED;
+}
+
+void
+PoolAllocator::Initialize (void)
+{
+  BooleanValue enabled;
+  g_poolAllocation.GetValue (enabled);
+  g_state = enabled.Get () ? ENABLED : DISABLED;
+  NS_LOG_LOGIC ("pool allocation " << (enabled.Get () ? "enabled" : "disabled"));
+}
+
+void *
+PoolAllocator::Refill (uint32_t sizeClass)
+{
+  uint32_t blockSize = (sizeClass + 1) << CLASS_SHIFT;
+  uint32_t n = CHUNK_SIZE / blockSize;
+  NS_LOG_LOGIC ("new chunk of " << n << " blocks of " << blockSize << " bytes");
+  uint8_t *chunk = static_cast<uint8_t *> (::operator new (n * blockSize));
+  // the first block is returned, the others are put on the free list
+  for (uint32_t i = n - 1; i > 0; i--)
+    {
+      struct Block *block = reinterpret_cast<struct Block *> (chunk + i * blockSize);
+      block->next = g_free[sizeClass];
+      g_free[sizeClass] = block;
+    }
+  return chunk;
+}
+
+} // namespace ns3
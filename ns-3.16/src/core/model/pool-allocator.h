@@ -0,0 +1,138 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef POOL_ALLOCATOR_H
+#define POOL_ALLOCATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+
+namespace ns3 {
+
+/**
+ * \ingroup core
+ *
+ * \brief Size-class free lists for the small objects allocated and
+ * released for every event and every packet.
+ *
+ * When the "PoolAllocation" global value is true, the blocks of up to
+ * MAX_SIZE bytes are carved from 64 KiB chunks and kept on one free list
+ * per 16 byte size class once released, so that a simulation in steady
+ * state does not call the system allocator for its events, packets,
+ * packet buffers and packet tags. The chunks are never returned to the
+ * system: the memory held is the peak number of live objects of each
+ * size class.
+ *
+ * Otherwise every call goes to ::operator new and ::operator delete.
+ * The choice is made once, at the first allocation, so the global value
+ * must be set before anything is scheduled, e.g. with --PoolAllocation=1
+ * on the command line or NS_GLOBAL_VALUE="PoolAllocation=1".
+ *
+ * The free lists are not protected by any lock: keep the pool off with
+ * simulator implementations which create events from several threads.
+ */
+class PoolAllocator
+{
+public:
+  /**
+   * \param size the number of bytes to allocate
+   * \returns a block of at least size bytes
+   */
+  static inline void *Allocate (uint32_t size);
+  /**
+   * \param p a block returned by Allocate
+   * \param size the size given to Allocate
+   */
+  static inline void Deallocate (void *p, uint32_t size);
+  /**
+   * \returns true if the blocks are taken from the pool
+   */
+  static bool IsEnabled (void);
+
+  /**
+   * The largest block served from the pool.
+   */
+  static const uint32_t MAX_SIZE = 512;
+
+private:
+  enum State
+  {
+    UNKNOWN = 0,
+    ENABLED,
+    DISABLED
+  };
+  struct Block
+  {
+    struct Block *next;
+  };
+  static const uint32_t CLASS_SHIFT = 4;
+  static const uint32_t N_CLASSES = MAX_SIZE >> CLASS_SHIFT;
+
+  static void Initialize (void);
+  static void *Refill (uint32_t sizeClass);
+
+  // zero initialized before any constructor runs, so UNKNOWN
+  static enum State g_state;
+  static struct Block *g_free[N_CLASSES];
+};
+
+} // namespace ns3
+
+namespace ns3 {
+
+void *
+PoolAllocator::Allocate (uint32_t size)
+{
+  if (g_state == ENABLED && size <= MAX_SIZE && size != 0)
+    {
+      uint32_t sizeClass = (size - 1) >> CLASS_SHIFT;
+      struct Block *block = g_free[sizeClass];
+      if (block != 0)
+        {
+          g_free[sizeClass] = block->next;
+          return block;
+        }
+      return Refill (sizeClass);
+    }
+  if (g_state == UNKNOWN)
+    {
+      Initialize ();
+      return Allocate (size);
+    }
+  return ::operator new (size);
+}
+
+void
+PoolAllocator::Deallocate (void *p, uint32_t size)
+{
+  if (p == 0)
+    {
+      return;
+    }
+  if (g_state == ENABLED && size <= MAX_SIZE && size != 0)
+    {
+      uint32_t sizeClass = (size - 1) >> CLASS_SHIFT;
+      struct Block *block = static_cast<struct Block *> (p);
+      block->next = g_free[sizeClass];
+      g_free[sizeClass] = block;
+      return;
+    }
+  ::operator delete (p);
+}
+
+} // namespace ns3
+
+#endif /* POOL_ALLOCATOR_H */
@@ -0,0 +1,252 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "quad-heap-scheduler.h"
+#include "event-impl.h"
+#include "assert.h"
+#include "log.h"
+
+NS_LOG_COMPONENT_DEFINE ("QuadHeapScheduler");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (QuadHeapScheduler);
+
+TypeId
+QuadHeapScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::QuadHeapScheduler")
+    .SetParent<Scheduler> ()
+    .AddConstructor<QuadHeapScheduler> ()
+  ;
+  return tid;
+}
+
+QuadHeapScheduler::QuadHeapScheduler ()
+  : m_nowHead (0),
+    m_now (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+QuadHeapScheduler::~QuadHeapScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+bool
+QuadHeapScheduler::IsLess (const Entry &a, const Entry &b)
+{
+  return a.ts < b.ts || (a.ts == b.ts && a.uid < b.uid);
+}
+
+void
+QuadHeapScheduler::SiftUp (uint32_t index, const Entry &entry)
+{
+  while (index > 0)
+    {
+      uint32_t parent = (index - 1) / 4;
+      if (!IsLess (entry, m_heap[parent]))
+        {
+          break;
+        }
+      m_heap[index] = m_heap[parent];
+      index = parent;
+    }
+  m_heap[index] = entry;
+}
+
+void
+QuadHeapScheduler::SiftDown (uint32_t index, const Entry &entry)
+{
+  uint32_t size = m_heap.size ();
+  while (true)
+    {
+      uint32_t first = index * 4 + 1;
+      if (first >= size)
+        {
+          break;
+        }
+      uint32_t last = first + 4 < size ? first + 4 : size;
+      uint32_t smallest = first;
+      for (uint32_t child = first + 1; child < last; child++)
+        {
+          if (IsLess (m_heap[child], m_heap[smallest]))
+            {
+              smallest = child;
+            }
+        }
+      if (!IsLess (m_heap[smallest], entry))
+        {
+          break;
+        }
+      m_heap[index] = m_heap[smallest];
+      index = smallest;
+    }
+  m_heap[index] = entry;
+}
+
+Scheduler::Event
+QuadHeapScheduler::Release (const Entry &entry)
+{
+  Event ev;
+  ev.impl = m_slots[entry.slot].impl;
+  ev.key.m_ts = entry.ts;
+  ev.key.m_uid = entry.uid;
+  ev.key.m_context = m_slots[entry.slot].context;
+  m_freeSlots.push_back (entry.slot);
+  return ev;
+}
+
+bool
+QuadHeapScheduler::IsNowNext (void) const
+{
+  if (m_nowHead == m_nowQueue.size ())
+    {
+      return false;
+    }
+  if (m_heap.empty ())
+    {
+      return true;
+    }
+  const EventKey &now = m_nowQueue[m_nowHead].key;
+  return now.m_ts < m_heap[0].ts || (now.m_ts == m_heap[0].ts && now.m_uid < m_heap[0].uid);
+}
+
+void
+QuadHeapScheduler::Insert (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  if (ev.key.m_ts == m_now
+      && (m_nowHead == m_nowQueue.size () || m_nowQueue.back ().key < ev.key))
+    {
+      if (m_nowHead == m_nowQueue.size ())
+        {
+          m_nowQueue.clear ();
+          m_nowHead = 0;
+        }
+      m_nowQueue.push_back (ev);
+      return;
+    }
+  Entry entry;
+  entry.ts = ev.key.m_ts;
+  entry.uid = ev.key.m_uid;
+  if (m_freeSlots.empty ())
+    {
+      entry.slot = m_slots.size ();
+      m_slots.push_back (Slot ());
+    }
+  else
+    {
+      entry.slot = m_freeSlots.back ();
+      m_freeSlots.pop_back ();
+    }
+  m_slots[entry.slot].impl = ev.impl;
+  m_slots[entry.slot].context = ev.key.m_context;
+  m_heap.push_back (entry);
+  SiftUp (m_heap.size () - 1, entry);
+}
+
+bool
+QuadHeapScheduler::IsEmpty (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_heap.empty () && m_nowHead == m_nowQueue.size ();
+}
+
+Scheduler::Event
+QuadHeapScheduler::PeekNext (void) const
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!IsEmpty ());
+  if (IsNowNext ())
+    {
+      return m_nowQueue[m_nowHead];
+    }
+  const Entry &entry = m_heap[0];
+  Event ev;
+  ev.impl = m_slots[entry.slot].impl;
+  ev.key.m_ts = entry.ts;
+  ev.key.m_uid = entry.uid;
+  ev.key.m_context = m_slots[entry.slot].context;
+  return ev;
+}
+
+Scheduler::Event
+QuadHeapScheduler::RemoveNext (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!IsEmpty ());
+  Event next;
+  if (IsNowNext ())
+    {
+      next = m_nowQueue[m_nowHead];
+      m_nowHead++;
+    }
+  else
+    {
+      next = Release (m_heap[0]);
+      Entry last = m_heap.back ();
+      m_heap.pop_back ();
+      if (!m_heap.empty ())
+        {
+          SiftDown (0, last);
+        }
+    }
+  m_now = next.key.m_ts;
+  return next;
+}
+
+void
+QuadHeapScheduler::Remove (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  for (uint32_t i = m_nowHead; i < m_nowQueue.size (); i++)
+    {
+      if (m_nowQueue[i].key.m_uid == ev.key.m_uid)
+        {
+          NS_ASSERT (m_nowQueue[i].impl == ev.impl);
+          m_nowQueue.erase (m_nowQueue.begin () + i);
+          return;
+        }
+    }
+  for (uint32_t i = 0; i < m_heap.size (); i++)
+    {
+      if (m_heap[i].uid == ev.key.m_uid)
+        {
+          NS_ASSERT (m_slots[m_heap[i].slot].impl == ev.impl);
+          Release (m_heap[i]);
+          Entry last = m_heap.back ();
+          m_heap.pop_back ();
+          if (i < m_heap.size ())
+            {
+              // the last entry may belong above or below the hole
+              if (i > 0 && IsLess (last, m_heap[(i - 1) / 4]))
+                {
+                  SiftUp (i, last);
+                }
+              else
+                {
+                  SiftDown (i, last);
+                }
+            }
+          return;
+        }
+    }
+  NS_ASSERT (false);
+}
+
+} // namespace ns3
@@ -0,0 +1,90 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef QUAD_HEAP_SCHEDULER_H
+#define QUAD_HEAP_SCHEDULER_H
+
+#include "scheduler.h"
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup scheduler
+ * \brief a 4-ary heap event scheduler with a queue for the current time
+ *
+ * The heap is an implicit tree of four children per node over a
+ * contiguous array: half as deep as a binary heap, with no pointer to
+ * chase. Its entries hold the key of an event and the index of the slot
+ * of its EventImpl, 16 bytes, so that the four children of a node fit
+ * in a cache line, and holes are moved down and up instead of swapping
+ * entries.
+ *
+ * The events scheduled for the timestamp of the last removed event,
+ * Simulator::ScheduleNow and the like, come after every pending event
+ * with that timestamp since their uid is larger: they are appended to a
+ * FIFO queue in constant time and never enter the heap.
+ *
+ * Remove is linear in the number of pending events, as in HeapScheduler;
+ * the simulator only uses it for Simulator::Remove.
+ */
+class QuadHeapScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  QuadHeapScheduler ();
+  virtual ~QuadHeapScheduler ();
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+private:
+  struct Entry
+  {
+    uint64_t ts;
+    uint32_t uid;
+    uint32_t slot;
+  };
+  struct Slot
+  {
+    EventImpl *impl;
+    uint32_t context;
+  };
+
+  static inline bool IsLess (const Entry &a, const Entry &b);
+  void SiftUp (uint32_t index, const Entry &entry);
+  void SiftDown (uint32_t index, const Entry &entry);
+  Event Release (const Entry &entry);
+  bool IsNowNext (void) const;
+
+  // the root is at index 0, the children of i at 4i + 1 to 4i + 4
+  std::vector<Entry> m_heap;
+  std::vector<Slot> m_slots;
+  std::vector<uint32_t> m_freeSlots;
+  // the events at m_now, ordered by uid, from m_nowHead on
+  std::vector<Event> m_nowQueue;
+  uint32_t m_nowHead;
+  uint64_t m_now;
+};
+
+} // namespace ns3
+
+#endif /* QUAD_HEAP_SCHEDULER_H */
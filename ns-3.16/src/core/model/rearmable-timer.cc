@@ -0,0 +1,143 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "rearmable-timer.h"
+#include "simulator.h"
+#include "make-event.h"
+#include "log.h"
+
+NS_LOG_COMPONENT_DEFINE ("RearmableTimer");
+
+namespace ns3 {
+
+RearmableTimer::RearmableTimer ()
+  : m_impl (0),
+    m_end (0),
+    m_running (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+RearmableTimer::~RearmableTimer ()
+{
+  NS_LOG_FUNCTION (this);
+  for (std::vector<Slot>::iterator i = m_slots.begin (); i != m_slots.end (); i++)
+    {
+      if (i->pending)
+        {
+          i->event->Cancel ();
+        }
+    }
+  delete m_impl;
+}
+
+bool
+RearmableTimer::IsCovered (void) const
+{
+  for (std::vector<Slot>::const_iterator i = m_slots.begin (); i != m_slots.end (); i++)
+    {
+      if (i->pending && i->ts <= m_end)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+RearmableTimer::Schedule (Time delay)
+{
+  NS_LOG_FUNCTION (this << delay);
+  NS_ASSERT (m_impl != 0);
+  m_end = (Simulator::Now () + delay).GetTimeStep ();
+  m_running = true;
+  if (IsCovered ())
+    {
+      // the pending event moves on to m_end when it comes
+      return;
+    }
+  uint32_t slot = 0;
+  while (slot < m_slots.size () && m_slots[slot].pending)
+    {
+      slot++;
+    }
+  if (slot == m_slots.size ())
+    {
+      Slot created;
+      created.event = Ptr<EventImpl> (MakeEvent (&RearmableTimer::Expire, this, slot), false);
+      created.ts = 0;
+      created.pending = false;
+      m_slots.push_back (created);
+    }
+  m_slots[slot].ts = m_end;
+  m_slots[slot].pending = true;
+  Simulator::Schedule (delay, m_slots[slot].event);
+}
+
+void
+RearmableTimer::Cancel (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_running = false;
+}
+
+bool
+RearmableTimer::IsRunning (void) const
+{
+  return m_running;
+}
+
+bool
+RearmableTimer::IsExpired (void) const
+{
+  return !m_running;
+}
+
+Time
+RearmableTimer::GetDelayLeft (void) const
+{
+  if (!m_running)
+    {
+      return Seconds (0);
+    }
+  return TimeStep (m_end) - Simulator::Now ();
+}
+
+void
+RearmableTimer::Expire (uint32_t slot)
+{
+  NS_LOG_FUNCTION (this << slot);
+  m_slots[slot].pending = false;
+  if (!m_running)
+    {
+      return;
+    }
+  uint64_t now = Simulator::Now ().GetTimeStep ();
+  if (m_end == now)
+    {
+      m_running = false;
+      m_impl->Invoke ();
+      return;
+    }
+  NS_ASSERT (m_end > now);
+  if (!IsCovered ())
+    {
+      m_slots[slot].ts = m_end;
+      m_slots[slot].pending = true;
+      Simulator::Schedule (TimeStep (m_end - now), m_slots[slot].event);
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,273 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef REARMABLE_TIMER_H
+#define REARMABLE_TIMER_H
+
+#include "nstime.h"
+#include "event-impl.h"
+#include "ptr.h"
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+class TimerImpl;
+
+/**
+ * \ingroup core
+ * \brief a timer which is cancelled and re-armed without scheduling
+ *        a new event each time
+ *
+ * A timer restarted on every packet, such as the retransmission timer
+ * of TCP, cancels its event and schedules a new one each time with an
+ * EventId: every restart allocates an EventImpl and leaves a cancelled
+ * event in the event list until its time comes. A RearmableTimer only
+ * records its new expiration time when an event of its own is already
+ * scheduled at or before it, and moves on to that time when this event
+ * comes: the event list holds one event per timer whatever the number of
+ * restarts. Another event is only scheduled when the timer is armed
+ * earlier than all of its pending events, and the EventImpls are reused.
+ *
+ * As with an EventId, the function runs at the expiration time, but
+ * possibly after the other events of the same timestamp scheduled
+ * before the timer was last armed.
+ *
+ * The destructor cancels the pending events. A timer armed when
+ * Simulator::Destroy is called must not be armed again.
+ */
+class RearmableTimer
+{
+public:
+  RearmableTimer ();
+  ~RearmableTimer ();
+
+  /**
+   * \param delay the delay after which the function runs
+   *
+   * Arms the timer, or moves its expiration time to delay from now if
+   * it is already armed.
+   */
+  void Schedule (Time delay);
+  /**
+   * Disarms the timer, if it is armed.
+   */
+  void Cancel (void);
+  /**
+   * \returns true if the timer is armed, false otherwise.
+   */
+  bool IsRunning (void) const;
+  /**
+   * \returns true if the timer is not armed, false otherwise.
+   */
+  bool IsExpired (void) const;
+  /**
+   * \returns the time left before the timer expires, or zero if it
+   *          is not armed.
+   */
+  Time GetDelayLeft (void) const;
+
+  /**
+   * \param fn the function
+   *
+   * Store this function in this RearmableTimer for later use by RearmableTimer::Schedule.
+   */
+  template <typename FN>
+  void SetFunction (FN fn);
+
+  /**
+   * \param memPtr the member function pointer
+   * \param objPtr the pointer to object
+   *
+   * Store this function and object in this RearmableTimer for later use by RearmableTimer::Schedule.
+   */
+  template <typename MEM_PTR, typename OBJ_PTR>
+  void SetFunction (MEM_PTR memPtr, OBJ_PTR objPtr);
+
+
+  /**
+   * \param a1 the first argument
+   *
+   * Store this argument in this RearmableTimer for later use by RearmableTimer::Schedule.
+   */
+  template <typename T1>
+  void SetArguments (T1 a1);
+  /**
+   * \param a1 the first argument
+   * \param a2 the second argument
+   *
+   * Store these arguments in this RearmableTimer for later use by RearmableTimer::Schedule.
+   */
+  template <typename T1, typename T2>
+  void SetArguments (T1 a1, T2 a2);
+  /**
+   * \param a1 the first argument
+   * \param a2 the second argument
+   * \param a3 the third argument
+   *
+   * Store these arguments in this RearmableTimer for later use by RearmableTimer::Schedule.
+   */
+  template <typename T1, typename T2, typename T3>
+  void SetArguments (T1 a1, T2 a2, T3 a3);
+  /**
+   * \param a1 the first argument
+   * \param a2 the second argument
+   * \param a3 the third argument
+   * \param a4 the fourth argument
+   *
+   * Store these arguments in this RearmableTimer for later use by RearmableTimer::Schedule.
+   */
+  template <typename T1, typename T2, typename T3, typename T4>
+  void SetArguments (T1 a1, T2 a2, T3 a3, T4 a4);
+  /**
+   * \param a1 the first argument
+   * \param a2 the second argument
+   * \param a3 the third argument
+   * \param a4 the fourth argument
+   * \param a5 the fifth argument
+   *
+   * Store these arguments in this RearmableTimer for later use by RearmableTimer::Schedule.
+   */
+  template <typename T1, typename T2, typename T3, typename T4, typename T5>
+  void SetArguments (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5);
+  /**
+   * \param a1 the first argument
+   * \param a2 the second argument
+   * \param a3 the third argument
+   * \param a4 the fourth argument
+   * \param a5 the fifth argument
+   * \param a6 the sixth argument
+   *
+   * Store these arguments in this RearmableTimer for later use by RearmableTimer::Schedule.
+   */
+  template <typename T1, typename T2, typename T3, typename T4, typename T5, typename T6>
+  void SetArguments (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6);
+
+private:
+  struct Slot
+  {
+    Ptr<EventImpl> event;
+    uint64_t ts;
+    bool pending;
+  };
+
+  RearmableTimer (const RearmableTimer &o);
+  RearmableTimer &operator = (const RearmableTimer &o);
+  bool IsCovered (void) const;
+  void Expire (uint32_t slot);
+
+  TimerImpl *m_impl;
+  // the events of the timer, at most one pending at or before m_end
+  std::vector<Slot> m_slots;
+  uint64_t m_end;
+  bool m_running;
+};
+
+} // namespace ns3
+
+#include "timer-impl.h"
+
+namespace ns3 {
+
+
+template <typename FN>
+void 
+RearmableTimer::SetFunction (FN fn)
+{
+  delete m_impl;
+  m_impl = MakeTimerImpl (fn);
+}
+template <typename MEM_PTR, typename OBJ_PTR>
+void 
+RearmableTimer::SetFunction (MEM_PTR memPtr, OBJ_PTR objPtr)
+{
+  delete m_impl;
+  m_impl = MakeTimerImpl (memPtr, objPtr);
+}
+
+template <typename T1>
+void 
+RearmableTimer::SetArguments (T1 a1)
+{
+  if (m_impl == 0)
+    {
+      NS_FATAL_ERROR ("You cannot set the arguments of a RearmableTimer before setting its function.");
+      return;
+    }
+  m_impl->SetArgs (a1);
+}
+template <typename T1, typename T2>
+void 
+RearmableTimer::SetArguments (T1 a1, T2 a2)
+{
+  if (m_impl == 0)
+    {
+      NS_FATAL_ERROR ("You cannot set the arguments of a RearmableTimer before setting its function.");
+      return;
+    }
+  m_impl->SetArgs (a1, a2);
+}
+
+template <typename T1, typename T2, typename T3>
+void 
+RearmableTimer::SetArguments (T1 a1, T2 a2, T3 a3)
+{
+  if (m_impl == 0)
+    {
+      NS_FATAL_ERROR ("You cannot set the arguments of a RearmableTimer before setting its function.");
+      return;
+    }
+  m_impl->SetArgs (a1, a2, a3);
+}
+
+template <typename T1, typename T2, typename T3, typename T4>
+void 
+RearmableTimer::SetArguments (T1 a1, T2 a2, T3 a3, T4 a4)
+{
+  if (m_impl == 0)
+    {
+      NS_FATAL_ERROR ("You cannot set the arguments of a RearmableTimer before setting its function.");
+      return;
+    }
+  m_impl->SetArgs (a1, a2, a3, a4);
+}
+
+template <typename T1, typename T2, typename T3, typename T4, typename T5>
+void 
+RearmableTimer::SetArguments (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5)
+{
+  if (m_impl == 0)
+    {
+      NS_FATAL_ERROR ("You cannot set the arguments of a RearmableTimer before setting its function.");
+      return;
+    }
+  m_impl->SetArgs (a1, a2, a3, a4, a5);
+}
+
+template <typename T1, typename T2, typename T3, typename T4, typename T5, typename T6>
+void 
+RearmableTimer::SetArguments (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6)
+{
+  if (m_impl == 0)
+    {
+      NS_FATAL_ERROR ("You cannot set the arguments of a RearmableTimer before setting its function.");
+      return;
+    }
+  m_impl->SetArgs (a1, a2, a3, a4, a5, a6);
+}
+
+} // namespace ns3
+
+#endif /* REARMABLE_TIMER_H */
@@ -459,6 +459,107 @@ ObjectVectorConfigTestCase::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ (iv.Get (), -16, "Object Attribute \"A\" not set as expected");
 }
 
+// ===========================================================================
+// Test for the paths which index into vectors of objects and for SetMany.
+// ===========================================================================
+class ObjectVectorIndexConfigTestCase : public TestCase
+{
+public:
+  ObjectVectorIndexConfigTestCase ();
+  virtual ~ObjectVectorIndexConfigTestCase () {}
+
+private:
+  virtual void DoRun (void);
+};
+
+ObjectVectorIndexConfigTestCase::ObjectVectorIndexConfigTestCase ()
+  : TestCase ("Check the configuration of vectors of Object by index and with SetMany")
+{
+}
+
+void
+ObjectVectorIndexConfigTestCase::DoRun (void)
+{
+  IntegerValue iv;
+
+  //
+  // Create a root namespace object with five objects in its NodesA vector,
+  // the i-th of which has i + 1 objects in its NodesB vector.
+  //
+  Ptr<ConfigTestObject> root = CreateObject<ConfigTestObject> ();
+  Config::RegisterRootNamespaceObject (root);
+  std::vector<std::vector<Ptr<ConfigTestObject> > > nodes (5);
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    {
+      Ptr<ConfigTestObject> a = CreateObject<ConfigTestObject> ();
+      root->AddNodeA (a);
+      for (uint32_t j = 0; j <= i; j++)
+        {
+          nodes[i].push_back (CreateObject<ConfigTestObject> ());
+          a->AddNodeB (nodes[i][j]);
+        }
+    }
+
+  //
+  // An index path only changes the object at that index.
+  //
+  Config::Set ("/NodesA/3/NodesB/2/A", IntegerValue (-20));
+  nodes[3][2]->GetAttribute ("A", iv);
+  NS_TEST_ASSERT_MSG_EQ (iv.Get (), -20, "Object Attribute \"A\" not set as expected");
+  nodes[3][1]->GetAttribute ("A", iv);
+  NS_TEST_ASSERT_MSG_EQ (iv.Get (), 10, "Object Attribute \"A\" unexpectedly set");
+  nodes[2][2]->GetAttribute ("A", iv);
+  NS_TEST_ASSERT_MSG_EQ (iv.Get (), 10, "Object Attribute \"A\" unexpectedly set");
+
+  //
+  // An index past the end matches nothing, and the non canonical forms of
+  // an index match the same object as the canonical one.
+  //
+  Config::MatchContainer matches = Config::LookupMatches ("/NodesA/1/NodesB/2");
+  NS_TEST_ASSERT_MSG_EQ (matches.GetN (), 0, "Index past the end unexpectedly matched");
+  matches = Config::LookupMatches ("/NodesA/4/NodesB/3");
+  NS_TEST_ASSERT_MSG_EQ (matches.GetN (), 1, "Index path did not match one object");
+  NS_TEST_ASSERT_MSG_EQ (matches.Get (0), nodes[4][3], "Index path matched another object");
+  NS_TEST_ASSERT_MSG_EQ (matches.GetMatchedPath (0), "/NodesA/4/NodesB/3/", "Unexpected matched path");
+  matches = Config::LookupMatches ("/NodesA/04/NodesB/3");
+  NS_TEST_ASSERT_MSG_EQ (matches.GetN (), 1, "Non canonical index path did not match one object");
+  NS_TEST_ASSERT_MSG_EQ (matches.Get (0), nodes[4][3], "Non canonical index path matched another object");
+
+  //
+  // SetMany sets the values in the order of LookupMatches.
+  //
+  std::vector<Ptr<const AttributeValue> > values;
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    {
+      for (uint32_t j = 0; j < nodes[i].size (); j++)
+        {
+          values.push_back (Create<IntegerValue> (values.size ()));
+        }
+    }
+  Config::SetMany ("/NodesA/*/NodesB/*/B", values);
+  bool ok = true;
+  int64_t expected = 0;
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    {
+      for (uint32_t j = 0; j < nodes[i].size (); j++)
+        {
+          nodes[i][j]->GetAttribute ("B", iv);
+          ok = ok && iv.Get () == expected++;
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (ok, true, "Object Attribute \"B\" not set as expected");
+
+  values.resize (3);
+  Config::SetMany ("/NodesA/2/NodesB/*/A", values);
+  for (uint32_t j = 0; j < 3; j++)
+    {
+      nodes[2][j]->GetAttribute ("A", iv);
+      NS_TEST_ASSERT_MSG_EQ (iv.Get (), j, "Object Attribute \"A\" not set as expected");
+    }
+
+  Config::UnregisterRootNamespaceObject (root);
+}
+
 // ===========================================================================
 // Test for the ability to trace configure with vectors of objects.
 // ===========================================================================
@@ -621,6 +722,7 @@ ConfigTestSuite::ConfigTestSuite ()
   AddTestCase (new RootNamespaceConfigTestCase);
   AddTestCase (new UnderRootNamespaceConfigTestCase);
   AddTestCase (new ObjectVectorConfigTestCase);
+  AddTestCase (new ObjectVectorIndexConfigTestCase);
 }
 
 static ConfigTestSuite configTestSuite;
@@ -0,0 +1,135 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "ns3/rearmable-timer.h"
+#include "ns3/simulator.h"
+#include "ns3/test.h"
+
+#include <vector>
+
+using namespace ns3;
+
+class RearmableTimerTestCase : public TestCase
+{
+public:
+  RearmableTimerTestCase ();
+  virtual void DoRun (void);
+  void Expire (int argument);
+  void Rearm (RearmableTimer *timer, Time delay);
+  void Check (RearmableTimer *timer, bool running, Time left);
+
+  std::vector<Time> m_expired;
+  std::vector<int> m_arguments;
+  bool m_checksOk;
+};
+
+RearmableTimerTestCase::RearmableTimerTestCase ()
+  : TestCase ("Check that a RearmableTimer expires at the time it was last armed for")
+{
+}
+
+void
+RearmableTimerTestCase::Expire (int argument)
+{
+  m_expired.push_back (Simulator::Now ());
+  m_arguments.push_back (argument);
+}
+
+void
+RearmableTimerTestCase::Rearm (RearmableTimer *timer, Time delay)
+{
+  timer->Cancel ();
+  timer->Schedule (delay);
+}
+
+void
+RearmableTimerTestCase::Check (RearmableTimer *timer, bool running, Time left)
+{
+  m_checksOk = m_checksOk && timer->IsRunning () == running && timer->IsExpired () == !running
+    && timer->GetDelayLeft () == left;
+}
+
+void
+RearmableTimerTestCase::DoRun (void)
+{
+  m_checksOk = true;
+
+  // later, then earlier than the pending event
+  {
+    RearmableTimer timer;
+    timer.SetFunction (&RearmableTimerTestCase::Expire, this);
+    timer.SetArguments (1);
+    timer.Schedule (MicroSeconds (10));
+    Simulator::Schedule (MicroSeconds (5), &RearmableTimerTestCase::Rearm, this, &timer, MicroSeconds (20));
+    Simulator::Schedule (MicroSeconds (6), &RearmableTimerTestCase::Check, this, &timer, true, MicroSeconds (19));
+    Simulator::Schedule (MicroSeconds (20), &RearmableTimer::Schedule, &timer, MicroSeconds (2));
+    Simulator::Schedule (MicroSeconds (23), &RearmableTimerTestCase::Check, this, &timer, false, Seconds (0));
+    Simulator::Run ();
+  }
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_expired.size (), 1, "the timer expired more than once");
+  NS_TEST_ASSERT_MSG_EQ (m_expired[0], MicroSeconds (22), "the timer expired at another time");
+  NS_TEST_ASSERT_MSG_EQ (m_arguments[0], 1, "wrong argument");
+  NS_TEST_ASSERT_MSG_EQ (m_checksOk, true, "wrong state or delay left");
+
+  // cancelled, re-armed after the cancellation, re-armed 1000 times
+  m_expired.clear ();
+  {
+    RearmableTimer timer;
+    timer.SetFunction (&RearmableTimerTestCase::Expire, this);
+    timer.SetArguments (2);
+    timer.Schedule (MicroSeconds (10));
+    Simulator::Schedule (MicroSeconds (5), &RearmableTimer::Cancel, &timer);
+    Simulator::Schedule (MicroSeconds (7), &RearmableTimer::Schedule, &timer, MicroSeconds (10));
+    for (uint32_t i = 0; i < 1000; i++)
+      {
+        Simulator::Schedule (MicroSeconds (100 + i), &RearmableTimerTestCase::Rearm, this, &timer, MicroSeconds (50));
+      }
+    Simulator::Run ();
+  }
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_expired.size (), 2, "wrong number of expirations");
+  NS_TEST_ASSERT_MSG_EQ (m_expired[0], MicroSeconds (17), "the timer did not expire after it was re-armed");
+  NS_TEST_ASSERT_MSG_EQ (m_expired[1], MicroSeconds (1149), "the timer did not expire after its last re-arm");
+
+  // re-armed by its own function, and destroyed while armed
+  m_expired.clear ();
+  {
+    RearmableTimer *timer = new RearmableTimer ();
+    timer->SetFunction (&RearmableTimerTestCase::Rearm, this);
+    timer->SetArguments (timer, MicroSeconds (3));
+    timer->Schedule (MicroSeconds (3));
+    Simulator::Schedule (MicroSeconds (10), &RearmableTimerTestCase::Check, this, timer, true, MicroSeconds (2));
+    Simulator::Schedule (MicroSeconds (11), &RearmableTimerTestCase::Expire, this, 3);
+    Simulator::Schedule (MicroSeconds (11), &RearmableTimerTestCase::Check, this, timer, true, MicroSeconds (1));
+    Simulator::Stop (MicroSeconds (11));
+    Simulator::Run ();
+    delete timer;
+    Simulator::Run ();
+  }
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_expired.size (), 1, "the events of a destroyed timer ran");
+  NS_TEST_ASSERT_MSG_EQ (m_checksOk, true, "wrong state or delay left");
+}
+
+static class RearmableTimerTestSuite : public TestSuite
+{
+public:
+  RearmableTimerTestSuite ()
+    : TestSuite ("rearmable-timer", UNIT)
+  {
+    AddTestCase (new RearmableTimerTestCase ());
+  }
+} g_rearmableTimerTestSuite;
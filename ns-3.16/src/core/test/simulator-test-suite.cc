@@ -23,6 +23,7 @@
 #include "ns3/heap-scheduler.h"
 #include "ns3/map-scheduler.h"
 #include "ns3/calendar-scheduler.h"
+#include "ns3/quad-heap-scheduler.h"
 
 using namespace ns3;
 
@@ -459,6 +460,84 @@ SimulatorTemplateTestCase::DoRun (void)
   Simulator::Destroy ();
 }
 
+/**
+ * Drives a scheduler and a MapScheduler through the same mix of
+ * insertions, some at the current timestamp, removals of the next event
+ * and removals of arbitrary events, and checks that they agree.
+ */
+class SchedulerOrderTestCase : public TestCase
+{
+public:
+  SchedulerOrderTestCase (ObjectFactory schedulerFactory);
+  virtual void DoRun (void);
+  ObjectFactory m_schedulerFactory;
+};
+
+SchedulerOrderTestCase::SchedulerOrderTestCase (ObjectFactory schedulerFactory)
+  : TestCase ("Check the order of many events with " +
+              schedulerFactory.GetTypeId ().GetName ()),
+    m_schedulerFactory (schedulerFactory)
+{
+}
+
+void
+SchedulerOrderTestCase::DoRun (void)
+{
+  Ptr<Scheduler> scheduler = m_schedulerFactory.Create<Scheduler> ();
+  Ptr<Scheduler> reference = CreateObject<MapScheduler> ();
+  std::vector<Scheduler::Event> events;
+  std::vector<bool> done;
+  uint64_t now = 0;
+  uint32_t uid = 0;
+  uint32_t seed = 1;
+  for (uint32_t i = 0; i < 20000; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      uint32_t r = (seed >> 8) % 100;
+      if (r < 55 || reference->IsEmpty ())
+        {
+          Scheduler::Event ev;
+          ev.impl = 0;
+          // a third at the current time, the others up to 1000 later
+          ev.key.m_ts = now + (r % 3 == 0 ? 0 : (seed >> 4) % 1000);
+          ev.key.m_uid = uid++;
+          ev.key.m_context = 0;
+          scheduler->Insert (ev);
+          reference->Insert (ev);
+          events.push_back (ev);
+          done.push_back (false);
+        }
+      else if (r < 95)
+        {
+          Scheduler::Event expected = reference->RemoveNext ();
+          NS_TEST_ASSERT_MSG_EQ (scheduler->PeekNext ().key.m_uid, expected.key.m_uid, "wrong next event");
+          Scheduler::Event next = scheduler->RemoveNext ();
+          NS_TEST_ASSERT_MSG_EQ (next.key.m_uid, expected.key.m_uid, "wrong next event");
+          NS_TEST_ASSERT_MSG_EQ (next.key.m_ts, expected.key.m_ts, "wrong timestamp");
+          now = next.key.m_ts;
+          done[next.key.m_uid] = true;
+        }
+      else
+        {
+          Scheduler::Event ev = events[(seed >> 4) % events.size ()];
+          if (!done[ev.key.m_uid])
+            {
+              scheduler->Remove (ev);
+              reference->Remove (ev);
+              done[ev.key.m_uid] = true;
+            }
+        }
+      NS_TEST_ASSERT_MSG_EQ (scheduler->IsEmpty (), reference->IsEmpty (), "wrong emptiness");
+    }
+  while (!reference->IsEmpty ())
+    {
+      uint32_t expected = reference->RemoveNext ().key.m_uid;
+      uint32_t next = scheduler->RemoveNext ().key.m_uid;
+      NS_TEST_ASSERT_MSG_EQ (next, expected, "wrong next event");
+    }
+  NS_TEST_ASSERT_MSG_EQ (scheduler->IsEmpty (), true, "events left");
+}
+
 class SimulatorTestSuite : public TestSuite
 {
 public:
@@ -475,5 +554,10 @@ public:
     AddTestCase (new SimulatorEventsTestCase (factory));
     factory.SetTypeId (CalendarScheduler::GetTypeId ());
     AddTestCase (new SimulatorEventsTestCase (factory));
+    factory.SetTypeId (QuadHeapScheduler::GetTypeId ());
+    AddTestCase (new SimulatorEventsTestCase (factory));
+    AddTestCase (new SchedulerOrderTestCase (factory));
+    factory.SetTypeId (HeapScheduler::GetTypeId ());
+    AddTestCase (new SchedulerOrderTestCase (factory));
   }
 } g_simulatorTestSuite;
@@ -0,0 +1,210 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation;
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef FLOW_HASH_TABLE_H
+#define FLOW_HASH_TABLE_H
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/// Hashes the flow and packet identifiers used as keys by the flow
+/// monitor.
+struct FlowHash
+{
+  static uint32_t Mix (uint32_t h)
+  {
+    // the finalizer of MurmurHash3
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+  }
+  uint32_t operator () (uint32_t key) const
+  {
+    return Mix (key);
+  }
+  uint32_t operator () (const std::pair<uint32_t, uint32_t> &key) const
+  {
+    return Mix (key.first * 0x9e3779b9 ^ key.second);
+  }
+};
+
+/// \brief A hash table with open addressing, for the lookups the flow
+/// monitor does for each packet at each hop.
+///
+/// The entries are kept in a single array of slots, probed linearly,
+/// which is grown to keep it at most half full.  Erasing shifts the
+/// following entries back, so lookups never step over deleted slots.
+///
+/// Pointers to the values are invalidated by the next Insert, and by
+/// Erase.
+template <typename Key, typename Value, typename Hash = FlowHash>
+class FlowHashTable
+{
+public:
+  FlowHashTable ()
+    : m_size (0)
+  {
+  }
+
+  /// \returns the value of the key, or 0 if the key is not in the table
+  Value *Find (const Key &key)
+  {
+    if (m_size == 0)
+      {
+        return 0;
+      }
+    uint32_t mask = m_slots.size () - 1;
+    for (uint32_t i = m_hash (key) & mask; m_slots[i].used; i = (i + 1) & mask)
+      {
+        if (m_slots[i].key == key)
+          {
+            return &m_slots[i].value;
+          }
+      }
+    return 0;
+  }
+
+  const Value *Find (const Key &key) const
+  {
+    return const_cast<FlowHashTable *> (this)->Find (key);
+  }
+
+  /// \brief Insert a key with a default constructed value, unless the
+  /// key is already in the table.
+  /// \returns the value of the key and whether it was inserted
+  std::pair<Value *, bool> Insert (const Key &key)
+  {
+    if (2 * (m_size + 1) > m_slots.size ())
+      {
+        Grow ();
+      }
+    uint32_t mask = m_slots.size () - 1;
+    uint32_t i = m_hash (key) & mask;
+    for (; m_slots[i].used; i = (i + 1) & mask)
+      {
+        if (m_slots[i].key == key)
+          {
+            return std::make_pair (&m_slots[i].value, false);
+          }
+      }
+    m_slots[i].used = true;
+    m_slots[i].key = key;
+    m_slots[i].value = Value ();
+    m_size++;
+    return std::make_pair (&m_slots[i].value, true);
+  }
+
+  /// \returns true if the key was in the table
+  bool Erase (const Key &key)
+  {
+    if (m_size == 0)
+      {
+        return false;
+      }
+    uint32_t mask = m_slots.size () - 1;
+    uint32_t i = m_hash (key) & mask;
+    for (; m_slots[i].used; i = (i + 1) & mask)
+      {
+        if (m_slots[i].key == key)
+          {
+            break;
+          }
+      }
+    if (!m_slots[i].used)
+      {
+        return false;
+      }
+    // move back the entries which probed past the freed slot
+    uint32_t j = i;
+    while (true)
+      {
+        j = (j + 1) & mask;
+        if (!m_slots[j].used)
+          {
+            break;
+          }
+        uint32_t home = m_hash (m_slots[j].key) & mask;
+        // the entry stays if its home is cyclically in (i, j]
+        bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays)
+          {
+            m_slots[i] = m_slots[j];
+            i = j;
+          }
+      }
+    m_slots[i].used = false;
+    m_slots[i].value = Value ();
+    m_size--;
+    return true;
+  }
+
+  uint32_t GetSize (void) const
+  {
+    return m_size;
+  }
+
+  void Clear (void)
+  {
+    m_slots.clear ();
+    m_size = 0;
+  }
+
+private:
+  struct Slot
+  {
+    Slot ()
+      : used (false)
+    {
+    }
+    Key key;
+    Value value;
+    bool used;
+  };
+
+  void Grow (void)
+  {
+    std::vector<Slot> old;
+    old.swap (m_slots);
+    m_slots.resize (old.empty () ? 16 : 2 * old.size ());
+    uint32_t mask = m_slots.size () - 1;
+    for (typename std::vector<Slot>::const_iterator s = old.begin (); s != old.end (); s++)
+      {
+        if (s->used)
+          {
+            uint32_t i = m_hash (s->key) & mask;
+            while (m_slots[i].used)
+              {
+                i = (i + 1) & mask;
+              }
+            m_slots[i] = *s;
+          }
+      }
+  }
+
+  std::vector<Slot> m_slots;
+  uint32_t m_size;
+  Hash m_hash;
+};
+
+} // namespace ns3
+
+#endif /* FLOW_HASH_TABLE_H */
@@ -35,6 +35,8 @@ NS_LOG_COMPONENT_DEFINE ("FlowMonitor");
 
 NS_OBJECT_ENSURE_REGISTERED (FlowMonitor);
 
+const uint32_t FlowMonitor::NO_PACKET;
+
 
 TypeId 
 FlowMonitor::GetTypeId (void)
@@ -82,7 +84,10 @@ FlowMonitor::GetInstanceTypeId (void) const
 }
 
 FlowMonitor::FlowMonitor ()
-  : m_enabled (false)
+  : m_freeTracked (NO_PACKET),
+    m_oldestTracked (NO_PACKET),
+    m_newestTracked (NO_PACKET),
+    m_enabled (false)
 {
   // m_histogramBinWidth=DEFAULT_BIN_WIDTH;
 }
@@ -91,11 +96,11 @@ FlowMonitor::FlowMonitor ()
 inline FlowMonitor::FlowStats&
 FlowMonitor::GetStatsForFlow (FlowId flowId)
 {
-  std::map<FlowId, FlowStats>::iterator iter;
-  iter = m_flowStats.find (flowId);
-  if (iter == m_flowStats.end ())
+  std::pair<FlowStats **, bool> index = m_flowStatsIndex.Insert (flowId);
+  if (index.second)
     {
       FlowMonitor::FlowStats &ref = m_flowStats[flowId];
+      *index.first = &ref;
       ref.delaySum = Seconds (0);
       ref.jitterSum = Seconds (0);
       ref.lastDelay = Seconds (0);
@@ -113,10 +118,66 @@ FlowMonitor::GetStatsForFlow (FlowId flowId)
     }
   else
     {
-      return iter->second;
+      return **index.first;
     }
 }
 
+inline uint32_t
+FlowMonitor::FindTrackedPacket (FlowId flowId, FlowPacketId packetId)
+{
+  const uint32_t *index = m_trackedIndex.Find (std::make_pair (flowId, packetId));
+  return index == 0 ? NO_PACKET : *index;
+}
+
+void
+FlowMonitor::LinkNewestTrackedPacket (uint32_t index)
+{
+  TrackedPacket &tracked = m_trackedPackets[index];
+  tracked.older = m_newestTracked;
+  tracked.newer = NO_PACKET;
+  if (m_newestTracked != NO_PACKET)
+    {
+      m_trackedPackets[m_newestTracked].newer = index;
+    }
+  else
+    {
+      m_oldestTracked = index;
+    }
+  m_newestTracked = index;
+}
+
+void
+FlowMonitor::UnlinkTrackedPacket (uint32_t index)
+{
+  TrackedPacket &tracked = m_trackedPackets[index];
+  if (tracked.older != NO_PACKET)
+    {
+      m_trackedPackets[tracked.older].newer = tracked.newer;
+    }
+  else
+    {
+      m_oldestTracked = tracked.newer;
+    }
+  if (tracked.newer != NO_PACKET)
+    {
+      m_trackedPackets[tracked.newer].older = tracked.older;
+    }
+  else
+    {
+      m_newestTracked = tracked.older;
+    }
+}
+
+void
+FlowMonitor::ReleaseTrackedPacket (uint32_t index)
+{
+  TrackedPacket &tracked = m_trackedPackets[index];
+  UnlinkTrackedPacket (index);
+  m_trackedIndex.Erase (std::make_pair (tracked.flowId, tracked.packetId));
+  tracked.older = m_freeTracked;
+  m_freeTracked = index;
+}
+
 
 void
 FlowMonitor::ReportFirstTx (Ptr<FlowProbe> probe, uint32_t flowId, uint32_t packetId, uint32_t packetSize)
@@ -126,7 +187,28 @@ FlowMonitor::ReportFirstTx (Ptr<FlowProbe> probe, uint32_t flowId, uint32_t pack
       return;
     }
   Time now = Simulator::Now ();
-  TrackedPacket &tracked = m_trackedPackets[std::make_pair (flowId, packetId)];
+  std::pair<uint32_t *, bool> index = m_trackedIndex.Insert (std::make_pair (flowId, packetId));
+  if (index.second)
+    {
+      if (m_freeTracked != NO_PACKET)
+        {
+          *index.first = m_freeTracked;
+          m_freeTracked = m_trackedPackets[m_freeTracked].older;
+        }
+      else
+        {
+          *index.first = m_trackedPackets.size ();
+          m_trackedPackets.push_back (TrackedPacket ());
+        }
+    }
+  else
+    {
+      UnlinkTrackedPacket (*index.first);
+    }
+  LinkNewestTrackedPacket (*index.first);
+  TrackedPacket &tracked = m_trackedPackets[*index.first];
+  tracked.flowId = flowId;
+  tracked.packetId = packetId;
   tracked.firstSeenTime = now;
   tracked.lastSeenTime = tracked.firstSeenTime;
   tracked.timesForwarded = 0;
@@ -153,19 +235,21 @@ FlowMonitor::ReportForwarding (Ptr<FlowProbe> probe, uint32_t flowId, uint32_t p
     {
       return;
     }
-  std::pair<FlowId, FlowPacketId> key (flowId, packetId);
-  TrackedPacketMap::iterator tracked = m_trackedPackets.find (key);
-  if (tracked == m_trackedPackets.end ())
+  uint32_t index = FindTrackedPacket (flowId, packetId);
+  if (index == NO_PACKET)
     {
       NS_LOG_WARN ("Received packet forward report (flowId=" << flowId << ", packetId=" << packetId
                                                              << ") but not known to be transmitted.");
       return;
     }
 
-  tracked->second.timesForwarded++;
-  tracked->second.lastSeenTime = Simulator::Now ();
+  TrackedPacket &tracked = m_trackedPackets[index];
+  tracked.timesForwarded++;
+  tracked.lastSeenTime = Simulator::Now ();
+  UnlinkTrackedPacket (index);
+  LinkNewestTrackedPacket (index);
 
-  Time delay = (Simulator::Now () - tracked->second.firstSeenTime);
+  Time delay = (Simulator::Now () - tracked.firstSeenTime);
   probe->AddPacketStats (flowId, packetSize, delay);
 }
 
@@ -177,16 +261,17 @@ FlowMonitor::ReportLastRx (Ptr<FlowProbe> probe, uint32_t flowId, uint32_t packe
     {
       return;
     }
-  TrackedPacketMap::iterator tracked = m_trackedPackets.find (std::make_pair (flowId, packetId));
-  if (tracked == m_trackedPackets.end ())
+  uint32_t index = FindTrackedPacket (flowId, packetId);
+  if (index == NO_PACKET)
     {
       NS_LOG_WARN ("Received packet last-tx report (flowId=" << flowId << ", packetId=" << packetId
                                                              << ") but not known to be transmitted.");
       return;
     }
+  const TrackedPacket &tracked = m_trackedPackets[index];
 
   Time now = Simulator::Now ();
-  Time delay = (now - tracked->second.firstSeenTime);
+  Time delay = (now - tracked.firstSeenTime);
   probe->AddPacketStats (flowId, packetSize, delay);
 
   FlowStats &stats = GetStatsForFlow (flowId);
@@ -225,12 +310,12 @@ FlowMonitor::ReportLastRx (Ptr<FlowProbe> probe, uint32_t flowId, uint32_t packe
         }
     }
   stats.timeLastRxPacket = now;
-  stats.timesForwarded += tracked->second.timesForwarded;
+  stats.timesForwarded += tracked.timesForwarded;
 
   NS_LOG_DEBUG ("ReportLastTx: removing tracked packet (flowId="
                 << flowId << ", packetId=" << packetId << ").");
 
-  m_trackedPackets.erase (tracked); // we don't need to track this packet anymore
+  ReleaseTrackedPacket (index); // we don't need to track this packet anymore
 }
 
 void
@@ -255,14 +340,14 @@ FlowMonitor::ReportDrop (Ptr<FlowProbe> probe, uint32_t flowId, uint32_t packetI
   stats.bytesDropped[reasonCode] += packetSize;
   NS_LOG_DEBUG ("++stats.packetsDropped[" << reasonCode<< "]; // becomes: " << stats.packetsDropped[reasonCode]);
 
-  TrackedPacketMap::iterator tracked = m_trackedPackets.find (std::make_pair (flowId, packetId));
-  if (tracked != m_trackedPackets.end ())
+  uint32_t index = FindTrackedPacket (flowId, packetId);
+  if (index != NO_PACKET)
     {
       // we don't need to track this packet anymore
       // FIXME: this will not necessarily be true with broadcast/multicast
       NS_LOG_DEBUG ("ReportDrop: removing tracked packet (flowId="
                     << flowId << ", packetId=" << packetId << ").");
-      m_trackedPackets.erase (tracked);
+      ReleaseTrackedPacket (index);
     }
 }
 
@@ -278,24 +363,17 @@ FlowMonitor::CheckForLostPackets (Time maxDelay)
 {
   Time now = Simulator::Now ();
 
-  for (TrackedPacketMap::iterator iter = m_trackedPackets.begin ();
-       iter != m_trackedPackets.end (); )
+  // only the packets not seen for maxDelay are visited, from the oldest
+  while (m_oldestTracked != NO_PACKET
+         && now - m_trackedPackets[m_oldestTracked].lastSeenTime >= maxDelay)
     {
-      if (now - iter->second.lastSeenTime >= maxDelay)
-        {
-          // packet is considered lost, add it to the loss statistics
-          std::map<FlowId, FlowStats>::iterator
-            flow = m_flowStats.find (iter->first.first);
-          NS_ASSERT (flow != m_flowStats.end ());
-          flow->second.lostPackets++;
-
-          // we won't track it anymore
-          m_trackedPackets.erase (iter++);
-        }
-      else
-        {
-          iter++;
-        }
+      // packet is considered lost, add it to the loss statistics
+      FlowStats **flow = m_flowStatsIndex.Find (m_trackedPackets[m_oldestTracked].flowId);
+      NS_ASSERT (flow != 0);
+      (*flow)->lostPackets++;
+
+      // we won't track it anymore
+      ReleaseTrackedPacket (m_oldestTracked);
     }
 }
 
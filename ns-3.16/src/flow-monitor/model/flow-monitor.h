@@ -29,6 +29,7 @@
 #include "ns3/flow-probe.h"
 #include "ns3/flow-classifier.h"
 #include "ns3/histogram.h"
+#include "ns3/flow-hash-table.h"
 #include "ns3/nstime.h"
 #include "ns3/event-id.h"
 
@@ -213,14 +214,29 @@ private:
     Time firstSeenTime; // absolute time when the packet was first seen by a probe
     Time lastSeenTime; // absolute time when the packet was last seen by a probe
     uint32_t timesForwarded; // number of times the packet was reportedly forwarded
+    FlowId flowId;
+    FlowPacketId packetId;
+    uint32_t older; // the previous packet in the last seen order, or the next free slot
+    uint32_t newer; // the next packet in the last seen order
   };
 
+  static const uint32_t NO_PACKET = 0xffffffff;
+
   // FlowId --> FlowStats
   std::map<FlowId, FlowStats> m_flowStats;
-
-  // (FlowId,PacketId) --> TrackedPacket
-  typedef std::map< std::pair<FlowId, FlowPacketId>, TrackedPacket> TrackedPacketMap;
-  TrackedPacketMap m_trackedPackets;
+  // FlowId --> the FlowStats in m_flowStats
+  FlowHashTable<FlowId, FlowStats *> m_flowStatsIndex;
+
+  // (FlowId,PacketId) --> index of the TrackedPacket in m_trackedPackets
+  typedef FlowHashTable<std::pair<FlowId, FlowPacketId>, uint32_t> TrackedPacketIndex;
+  TrackedPacketIndex m_trackedIndex;
+  // the tracked packets, and the free slots left by the packets no longer tracked
+  std::vector<TrackedPacket> m_trackedPackets;
+  uint32_t m_freeTracked;
+  // the tracked packets are linked in the order they were last seen, so the
+  // lost ones are at the oldest end
+  uint32_t m_oldestTracked;
+  uint32_t m_newestTracked;
   Time m_maxPerHopDelay;
   std::vector< Ptr<FlowProbe> > m_flowProbes;
 
@@ -237,6 +253,10 @@ private:
   Time m_flowInterruptionsMinTime;
 
   FlowStats& GetStatsForFlow (FlowId flowId);
+  uint32_t FindTrackedPacket (FlowId flowId, FlowPacketId packetId);
+  void LinkNewestTrackedPacket (uint32_t index);
+  void UnlinkTrackedPacket (uint32_t index);
+  void ReleaseTrackedPacket (uint32_t index);
   void PeriodicCheckForLostPackets ();
 };
 
@@ -35,10 +35,21 @@ FlowProbe::FlowProbe (Ptr<FlowMonitor> flowMonitor)
   m_flowMonitor->AddProbe (this);
 }
 
+FlowProbe::FlowStats &
+FlowProbe::GetFlowStats (FlowId flowId)
+{
+  std::pair<FlowStats **, bool> index = m_statsIndex.Insert (flowId);
+  if (index.second)
+    {
+      *index.first = &m_stats[flowId];
+    }
+  return **index.first;
+}
+
 void
 FlowProbe::AddPacketStats (FlowId flowId, uint32_t packetSize, Time delayFromFirstProbe)
 {
-  FlowStats &flow = m_stats[flowId];
+  FlowStats &flow = GetFlowStats (flowId);
   flow.delayFromFirstProbeSum += delayFromFirstProbe;
   flow.bytes += packetSize;
   ++flow.packets;
@@ -47,7 +58,7 @@ FlowProbe::AddPacketStats (FlowId flowId, uint32_t packetSize, Time delayFromFir
 void
 FlowProbe::AddPacketDropStats (FlowId flowId, uint32_t packetSize, uint32_t reasonCode)
 {
-  FlowStats &flow = m_stats[flowId];
+  FlowStats &flow = GetFlowStats (flowId);
 
   if (flow.packetsDropped.size () < reasonCode + 1)
     {
@@ -27,6 +27,7 @@
 #include "ns3/simple-ref-count.h"
 #include "ns3/flow-classifier.h"
 #include "ns3/nstime.h"
+#include "ns3/flow-hash-table.h"
 
 namespace ns3 {
 
@@ -82,6 +83,11 @@ protected:
   Ptr<FlowMonitor> m_flowMonitor;
   Stats m_stats;
 
+private:
+  FlowStats &GetFlowStats (FlowId flowId);
+
+  // FlowId --> the FlowStats in m_stats
+  FlowHashTable<FlowId, FlowStats *> m_statsIndex;
 };
 
 
@@ -23,6 +23,7 @@
 #include "ipv4-flow-classifier.h"
 #include "ns3/udp-header.h"
 #include "ns3/tcp-header.h"
+#include <algorithm>
 
 namespace ns3 {
 
@@ -95,6 +96,15 @@ bool operator == (const Ipv4FlowClassifier::FiveTuple &t1,
 
 
 
+uint32_t
+Ipv4FlowClassifier::FiveTupleHash::operator () (const Ipv4FlowClassifier::FiveTuple &tuple) const
+{
+  uint32_t h = FlowHash::Mix (tuple.sourceAddress.Get ());
+  h = FlowHash::Mix (h ^ tuple.destinationAddress.Get ());
+  return FlowHash::Mix (h ^ (tuple.sourcePort << 16 | tuple.destinationPort) ^ tuple.protocol << 8);
+}
+
+
 Ipv4FlowClassifier::Ipv4FlowClassifier ()
 {
 }
@@ -139,16 +149,17 @@ Ipv4FlowClassifier::Classify (const Ipv4Header &ipHeader, Ptr<const Packet> ipPa
     }
 
   // try to insert the tuple, but check if it already exists
-  std::pair<std::map<FiveTuple, FlowId>::iterator, bool> insert
-    = m_flowMap.insert (std::pair<FiveTuple, FlowId> (tuple, 0));
+  std::pair<FlowId *, bool> insert = m_flowMap.Insert (tuple);
 
   // if the insertion succeeded, we need to assign this tuple a new flow identifier
   if (insert.second)
     {
-      insert.first->second = GetNewFlowId ();
+      *insert.first = GetNewFlowId ();
+      NS_ASSERT (*insert.first == m_flows.size () + 1);
+      m_flows.push_back (tuple);
     }
 
-  *out_flowId = insert.first->second;
+  *out_flowId = *insert.first;
   *out_packetId = ipHeader.GetIdentification ();
 
   return true;
@@ -158,13 +169,9 @@ Ipv4FlowClassifier::Classify (const Ipv4Header &ipHeader, Ptr<const Packet> ipPa
 Ipv4FlowClassifier::FiveTuple
 Ipv4FlowClassifier::FindFlow (FlowId flowId) const
 {
-  for (std::map<FiveTuple, FlowId>::const_iterator
-       iter = m_flowMap.begin (); iter != m_flowMap.end (); iter++)
+  if (flowId >= 1 && flowId <= m_flows.size ())
     {
-      if (iter->second == flowId)
-        {
-          return iter->first;
-        }
+      return m_flows[flowId - 1];
     }
   NS_FATAL_ERROR ("Could not find the flow with ID " << flowId);
   FiveTuple retval = { Ipv4Address::GetZero (), Ipv4Address::GetZero (), 0, 0, 0 };
@@ -178,9 +185,18 @@ Ipv4FlowClassifier::SerializeToXmlStream (std::ostream &os, int indent) const
 
   INDENT (indent); os << "<Ipv4FlowClassifier>\n";
 
+  // in the order of the tuples
+  std::vector<std::pair<FiveTuple, FlowId> > flows;
+  flows.reserve (m_flows.size ());
+  for (uint32_t i = 0; i < m_flows.size (); i++)
+    {
+      flows.push_back (std::make_pair (m_flows[i], i + 1));
+    }
+  std::sort (flows.begin (), flows.end ());
+
   indent += 2;
-  for (std::map<FiveTuple, FlowId>::const_iterator
-       iter = m_flowMap.begin (); iter != m_flowMap.end (); iter++)
+  for (std::vector<std::pair<FiveTuple, FlowId> >::const_iterator
+       iter = flows.begin (); iter != flows.end (); iter++)
     {
       INDENT (indent);
       os << "<Flow flowId=\"" << iter->second << "\""
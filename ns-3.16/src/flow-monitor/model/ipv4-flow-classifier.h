@@ -22,10 +22,11 @@
 #define IPV4_FLOW_CLASSIFIER_H
 
 #include <stdint.h>
-#include <map>
+#include <vector>
 
 #include "ns3/ipv4-header.h"
 #include "ns3/flow-classifier.h"
+#include "ns3/flow-hash-table.h"
 
 namespace ns3 {
 
@@ -48,6 +49,11 @@ public:
     uint16_t destinationPort;
   };
 
+  struct FiveTupleHash
+  {
+    uint32_t operator () (const FiveTuple &tuple) const;
+  };
+
   Ipv4FlowClassifier ();
 
   /// \brief try to classify the packet into flow-id and packet-id
@@ -63,7 +69,9 @@ public:
 
 private:
 
-  std::map<FiveTuple, FlowId> m_flowMap;
+  FlowHashTable<FiveTuple, FlowId, FiveTupleHash> m_flowMap;
+  // the tuple of each flow, by flow id - 1
+  std::vector<FiveTuple> m_flows;
 
 };
 
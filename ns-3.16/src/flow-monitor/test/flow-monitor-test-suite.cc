@@ -0,0 +1,256 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation;
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <algorithm>
+#include <cstdlib> // for rand()
+#include <map>
+#include <vector>
+
+#include "ns3/flow-hash-table.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/flow-probe.h"
+#include "ns3/simulator.h"
+#include "ns3/test.h"
+
+namespace ns3 {
+
+class FlowHashTableTestCase : public TestCase
+{
+public:
+  FlowHashTableTestCase ();
+  virtual void DoRun (void);
+};
+
+FlowHashTableTestCase::FlowHashTableTestCase ()
+  : TestCase ("Check the FlowHashTable against a std::map")
+{
+}
+
+void
+FlowHashTableTestCase::DoRun (void)
+{
+  typedef std::pair<uint32_t, uint32_t> Key;
+  FlowHashTable<Key, uint32_t> table;
+  std::map<Key, uint32_t> expected;
+  bool ok = true;
+  // few distinct keys, so that they are inserted and erased many times
+  for (uint32_t i = 0; i < 200000; i++)
+    {
+      Key key (std::rand () % 50, std::rand () % 100);
+      switch (std::rand () % 3)
+        {
+        case 0:
+          {
+            std::pair<uint32_t *, bool> insert = table.Insert (key);
+            ok = ok && insert.second == (expected.find (key) == expected.end ());
+            if (insert.second)
+              {
+                *insert.first = i;
+                expected[key] = i;
+              }
+          }
+          break;
+        case 1:
+          ok = ok && table.Erase (key) == (expected.erase (key) == 1);
+          break;
+        default:
+          {
+            uint32_t *value = table.Find (key);
+            std::map<Key, uint32_t>::const_iterator it = expected.find (key);
+            ok = ok && (value == 0) == (it == expected.end ());
+            ok = ok && (value == 0 || *value == it->second);
+          }
+          break;
+        }
+      ok = ok && table.GetSize () == expected.size ();
+    }
+  NS_TEST_ASSERT_MSG_EQ (ok, true, "the table and the map disagree");
+}
+
+class TestFlowProbe : public FlowProbe
+{
+public:
+  TestFlowProbe (Ptr<FlowMonitor> monitor)
+    : FlowProbe (monitor)
+  {
+  }
+};
+
+/**
+ * Reports random packet events to a FlowMonitor and checks its statistics
+ * against a model of the original implementation, which scanned every
+ * tracked packet to find the lost ones.
+ */
+class FlowMonitorLostPacketsTestCase : public TestCase
+{
+public:
+  FlowMonitorLostPacketsTestCase ();
+  virtual void DoRun (void);
+
+private:
+  struct Tracked
+  {
+    Time lastSeen;
+    uint32_t timesForwarded;
+  };
+  struct Expected
+  {
+    Expected ()
+      : rxPackets (0),
+        lostPackets (0),
+        timesForwarded (0)
+    {
+    }
+    uint32_t rxPackets;
+    uint32_t lostPackets;
+    uint32_t timesForwarded;
+  };
+  typedef std::pair<FlowId, FlowPacketId> Key;
+
+  void Step (uint32_t steps);
+  void CheckForLostPackets (Time maxDelay);
+
+  Ptr<FlowMonitor> m_monitor;
+  Ptr<FlowProbe> m_probe;
+  std::map<Key, Tracked> m_tracked;
+  std::map<FlowId, Expected> m_expected;
+  std::vector<FlowPacketId> m_nextPacketId;
+};
+
+FlowMonitorLostPacketsTestCase::FlowMonitorLostPacketsTestCase ()
+  : TestCase ("Check the tracked packets and lost packets of the FlowMonitor")
+{
+}
+
+void
+FlowMonitorLostPacketsTestCase::CheckForLostPackets (Time maxDelay)
+{
+  for (std::map<Key, Tracked>::iterator it = m_tracked.begin (); it != m_tracked.end (); )
+    {
+      if (Simulator::Now () - it->second.lastSeen >= maxDelay)
+        {
+          m_expected[it->first.first].lostPackets++;
+          m_tracked.erase (it++);
+        }
+      else
+        {
+          it++;
+        }
+    }
+  m_monitor->CheckForLostPackets (maxDelay);
+}
+
+void
+FlowMonitorLostPacketsTestCase::Step (uint32_t steps)
+{
+  for (uint32_t i = 0; i < 20; i++)
+    {
+      FlowId flowId = 1 + std::rand () % m_nextPacketId.size ();
+      // mostly the recent packets of the flow, some of them lost
+      FlowPacketId next = m_nextPacketId[flowId - 1];
+      FlowPacketId packetId = next - std::min<uint32_t> (next, std::rand () % 8);
+      Key key (flowId, packetId);
+      bool tracked = m_tracked.find (key) != m_tracked.end ();
+      switch (std::rand () % 6)
+        {
+        case 0:
+        case 1:
+          key.second = m_nextPacketId[flowId - 1]++;
+          m_tracked[key].lastSeen = Simulator::Now ();
+          m_tracked[key].timesForwarded = 0;
+          m_monitor->ReportFirstTx (m_probe, flowId, key.second, 100);
+          break;
+        case 2:
+        case 3:
+          if (tracked)
+            {
+              m_tracked[key].lastSeen = Simulator::Now ();
+              m_tracked[key].timesForwarded++;
+            }
+          m_monitor->ReportForwarding (m_probe, flowId, packetId, 100);
+          break;
+        case 4:
+          if (tracked)
+            {
+              m_expected[flowId].rxPackets++;
+              m_expected[flowId].timesForwarded += m_tracked[key].timesForwarded;
+              m_tracked.erase (key);
+            }
+          m_monitor->ReportLastRx (m_probe, flowId, packetId, 100);
+          break;
+        default:
+          m_expected[flowId].lostPackets++;
+          m_tracked.erase (key);
+          m_monitor->ReportDrop (m_probe, flowId, packetId, 100, 0);
+          break;
+        }
+    }
+  if (steps % 50 == 0)
+    {
+      CheckForLostPackets (MilliSeconds (std::rand () % 300));
+    }
+  if (steps > 0)
+    {
+      Simulator::Schedule (MilliSeconds (1 + std::rand () % 5), &FlowMonitorLostPacketsTestCase::Step, this, steps - 1);
+    }
+}
+
+void
+FlowMonitorLostPacketsTestCase::DoRun (void)
+{
+  m_monitor = CreateObject<FlowMonitor> ();
+  m_monitor->SetAttribute ("MaxPerHopDelay", TimeValue (MilliSeconds (200)));
+  m_probe = Create<TestFlowProbe> (m_monitor);
+  m_nextPacketId.assign (30, 0);
+  // the periodic check of the monitor runs every second
+  for (uint32_t s = 1; s < 20; s++)
+    {
+      Simulator::Schedule (Seconds (s), &FlowMonitorLostPacketsTestCase::CheckForLostPackets, this, MilliSeconds (200));
+    }
+  Simulator::Schedule (MilliSeconds (1), &FlowMonitorLostPacketsTestCase::Step, this, 5000);
+  // the steps take at most 15s
+  Simulator::Stop (Seconds (20));
+  Simulator::Run ();
+  CheckForLostPackets (Seconds (0));
+
+  std::map<FlowId, FlowMonitor::FlowStats> stats = m_monitor->GetFlowStats ();
+  NS_TEST_ASSERT_MSG_EQ (stats.size (), m_nextPacketId.size (), "every flow sent packets");
+  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator it = stats.begin (); it != stats.end (); it++)
+    {
+      const Expected &expected = m_expected[it->first];
+      NS_TEST_EXPECT_MSG_EQ (it->second.txPackets, m_nextPacketId[it->first - 1], "flow " << it->first);
+      NS_TEST_EXPECT_MSG_EQ (it->second.rxPackets, expected.rxPackets, "flow " << it->first);
+      NS_TEST_EXPECT_MSG_EQ (it->second.lostPackets, expected.lostPackets, "flow " << it->first);
+      NS_TEST_EXPECT_MSG_EQ (it->second.timesForwarded, expected.timesForwarded, "flow " << it->first);
+    }
+
+  m_probe = 0;
+  m_monitor = 0;
+  Simulator::Destroy ();
+}
+
+static class FlowMonitorTestSuite : public TestSuite
+{
+public:
+  FlowMonitorTestSuite ()
+    : TestSuite ("flow-monitor", UNIT)
+  {
+    AddTestCase (new FlowHashTableTestCase ());
+    AddTestCase (new FlowMonitorLostPacketsTestCase ());
+  }
+} g_flowMonitorTestSuite;
+
+} // namespace ns3
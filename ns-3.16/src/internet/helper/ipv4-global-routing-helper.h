@@ -83,6 +83,17 @@ public:
    *
    */
   static void RecomputeRoutingTables (void);
+  /**
+   * \brief Bring the routes installed by PopulateRoutingTables() up to date
+   * after links went down or up.
+   *
+   * The result is the same as RecomputeRoutingTables(), but when links
+   * only went down, the shortest paths are computed again only for the
+   * nodes that were using them.
+   *
+   * \see GlobalRouteManager::UpdateRoutes
+   */
+  static void UpdateRoutingTables (void);
 private:
   /**
    * \internal
@@ -16,7 +16,6 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
-#include <algorithm>
 #include <iostream>
 #include "ns3/log.h"
 #include "ns3/assert.h"
@@ -59,7 +58,8 @@ operator<< (std::ostream& os, const CandidateQueue& q)
 }
 
 CandidateQueue::CandidateQueue()
-  : m_candidates ()
+  : m_candidates (),
+    m_order (0)
 {
   NS_LOG_FUNCTION_NOARGS ();
 }
@@ -87,11 +87,10 @@ CandidateQueue::Push (SPFVertex *vNew)
 {
   NS_LOG_FUNCTION (this << vNew);
 
-  CandidateList_t::iterator i = std::upper_bound (
-      m_candidates.begin (), m_candidates.end (), vNew,
-      &CandidateQueue::CompareSPFVertex
-      );
-  m_candidates.insert (i, vNew);
+  vNew->m_candidateOrder = m_order++;
+  vNew->m_candidateIndex = m_candidates.size ();
+  m_candidates.push_back (vNew);
+  SiftUp (vNew->m_candidateIndex);
 }
 
 SPFVertex *
@@ -104,7 +103,13 @@ CandidateQueue::Pop (void)
     }
 
   SPFVertex *v = m_candidates.front ();
-  m_candidates.pop_front ();
+  m_candidates.front () = m_candidates.back ();
+  m_candidates.front ()->m_candidateIndex = 0;
+  m_candidates.pop_back ();
+  if (!m_candidates.empty ())
+    {
+      SiftDown (0);
+    }
   return v;
 }
 
@@ -157,11 +162,85 @@ CandidateQueue::Reorder (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
-  m_candidates.sort (&CandidateQueue::CompareSPFVertex);
+  for (uint32_t i = m_candidates.size () / 2; i-- > 0; )
+    {
+      SiftDown (i);
+    }
   NS_LOG_LOGIC ("After reordering the CandidateQueue");
   NS_LOG_LOGIC (*this);
 }
 
+void
+CandidateQueue::Update (SPFVertex *v)
+{
+  NS_LOG_FUNCTION (this << v);
+  NS_ASSERT (v->m_candidateIndex < m_candidates.size () && m_candidates[v->m_candidateIndex] == v);
+
+  v->m_candidateOrder = m_order++;
+  SiftUp (v->m_candidateIndex);
+}
+
+void
+CandidateQueue::SiftUp (uint32_t index)
+{
+  SPFVertex *v = m_candidates[index];
+  while (index > 0)
+    {
+      uint32_t parent = (index - 1) / 2;
+      if (!IsBefore (v, m_candidates[parent]))
+        {
+          break;
+        }
+      m_candidates[index] = m_candidates[parent];
+      m_candidates[index]->m_candidateIndex = index;
+      index = parent;
+    }
+  m_candidates[index] = v;
+  v->m_candidateIndex = index;
+}
+
+void
+CandidateQueue::SiftDown (uint32_t index)
+{
+  SPFVertex *v = m_candidates[index];
+  uint32_t size = m_candidates.size ();
+  while (true)
+    {
+      uint32_t child = 2 * index + 1;
+      if (child >= size)
+        {
+          break;
+        }
+      if (child + 1 < size && IsBefore (m_candidates[child + 1], m_candidates[child]))
+        {
+          child++;
+        }
+      if (!IsBefore (m_candidates[child], v))
+        {
+          break;
+        }
+      m_candidates[index] = m_candidates[child];
+      m_candidates[index]->m_candidateIndex = index;
+      index = child;
+    }
+  m_candidates[index] = v;
+  v->m_candidateIndex = index;
+}
+
+bool
+CandidateQueue::IsBefore (const SPFVertex* v1, const SPFVertex* v2)
+{
+  if (CompareSPFVertex (v1, v2))
+    {
+      return true;
+    }
+  if (CompareSPFVertex (v2, v1))
+    {
+      return false;
+    }
+  return v1->m_candidateOrder < v2->m_candidateOrder;
+}
+
 /*
  * In this implementation, SPFVertex follows the ordering where
  * a vertex is ranked first if its GetDistanceFromRoot () is smaller;
@@ -22,7 +22,7 @@
 #define CANDIDATE_QUEUE_H
 
 #include <stdint.h>
-#include <list>
+#include <vector>
 #include "ns3/ipv4-address.h"
 
 namespace ns3 {
@@ -45,6 +45,12 @@ class SPFVertex;
  * for a Find () operation, the dynamic nature of the data and the derived
  * requirement for a Reorder () operation led us to implement this simple 
  * enhanced priority queue.
+ *
+ * The queue is a binary heap over a vector; each vertex keeps its position
+ * in the heap so that Update () moves it up in logarithmic time when its
+ * distance decreases.  Vertices at the same distance and of the same type
+ * are popped in the order they were pushed or last updated, as they were in
+ * the sorted list this heap replaces.
  */
 class CandidateQueue
 {
@@ -162,6 +168,19 @@ public:
  */
   void Reorder (void);
 
+/**
+ * @brief Move a vertex of the queue whose distance from the root decreased
+ * to its new place.
+ * @internal
+ *
+ * The vertex goes after the vertices already in the queue at the same
+ * distance and of the same type, as if it had been popped and pushed again.
+ *
+ * @see SPFVertex
+ * @param v The Shortest Path First Vertex, which must be in the queue.
+ */
+  void Update (SPFVertex *v);
+
 private:
 /**
  * Candidate Queue copy construction is disallowed (not implemented) to 
@@ -189,8 +208,19 @@ private:
  */
   static bool CompareSPFVertex (const SPFVertex* v1, const SPFVertex* v2);
 
-  typedef std::list<SPFVertex*> CandidateList_t;
+/**
+ * \brief return true if v1 is popped before v2: CompareSPFVertex, then the
+ * order in which they were pushed or updated
+ */
+  static bool IsBefore (const SPFVertex* v1, const SPFVertex* v2);
+  void SiftUp (uint32_t index);
+  void SiftDown (uint32_t index);
+
+  typedef std::vector<SPFVertex*> CandidateList_t;
+  // the heap: the top at index 0, the children of i at 2i + 1 and 2i + 2
   CandidateList_t m_candidates;
+  // the order of the next vertex pushed or updated
+  uint32_t m_order;
 
   friend std::ostream& operator<< (std::ostream& os, const CandidateQueue& q);
 };
@@ -35,6 +35,13 @@
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/ipv4-list-routing.h"
 #include "ns3/mpi-interface.h"
+#include "ns3/global-value.h"
+#include "ns3/uinteger.h"
+#include "ns3/core-config.h"
+#ifdef HAVE_PTHREAD_H
+#include "ns3/system-thread.h"
+#include <unistd.h>
+#endif
 #include "global-router-interface.h"
 #include "global-route-manager-impl.h"
 #include "candidate-queue.h"
@@ -44,6 +51,13 @@ NS_LOG_COMPONENT_DEFINE ("GlobalRouteManager");
 
 namespace ns3 {
 
+static GlobalValue g_globalRoutingThreads = GlobalValue ("GlobalRoutingThreads",
+                                                         "The number of threads the SPF calculations "
+                                                         "of the global routing run in, 0 for one per "
+                                                         "online processor",
+                                                         UintegerValue (0),
+                                                         MakeUintegerChecker<uint32_t> ());
+
 std::ostream& 
 operator<< (std::ostream& os, const SPFVertex::NodeExit_t& exit)
 {
@@ -87,7 +101,9 @@ SPFVertex::SPFVertex () :
   m_nextHop ("0.0.0.0"),
   m_parents (),
   m_children (),
-  m_vertexProcessed (false)
+  m_vertexProcessed (false),
+  m_candidateIndex (0),
+  m_candidateOrder (0)
 {
   NS_LOG_FUNCTION_NOARGS ();
 }
@@ -100,7 +116,9 @@ SPFVertex::SPFVertex (GlobalRoutingLSA* lsa) :
   m_nextHop ("0.0.0.0"),
   m_parents (),
   m_children (),
-  m_vertexProcessed (false)
+  m_vertexProcessed (false),
+  m_candidateIndex (0),
+  m_candidateOrder (0)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
@@ -413,6 +431,10 @@ SPFVertex::ClearVertexProcessed (void)
 GlobalRouteManagerLSDB::GlobalRouteManagerLSDB ()
   :
     m_database (),
+    m_linkData (),
+    m_lsas (),
+    m_offsets (),
+    m_nLinkRecords (0),
     m_extdatabase ()
 {
   NS_LOG_FUNCTION_NOARGS ();
@@ -421,11 +443,10 @@ GlobalRouteManagerLSDB::GlobalRouteManagerLSDB ()
 GlobalRouteManagerLSDB::~GlobalRouteManagerLSDB ()
 {
   NS_LOG_FUNCTION_NOARGS ();
-  LSDBMap_t::iterator i;
-  for (i= m_database.begin (); i!= m_database.end (); i++)
+  for (uint32_t i = 0; i < m_lsas.size (); i++)
     {
       NS_LOG_LOGIC ("free LSA");
-      GlobalRoutingLSA* temp = i->second;
+      GlobalRoutingLSA* temp = m_lsas[i];
       delete temp;
     }
   for (uint32_t j = 0; j < m_extdatabase.size (); j++)
@@ -436,16 +457,17 @@ GlobalRouteManagerLSDB::~GlobalRouteManagerLSDB ()
     }
   NS_LOG_LOGIC ("clear map");
   m_database.clear ();
+  m_linkData.clear ();
+  m_lsas.clear ();
 }
 
 void
 GlobalRouteManagerLSDB::Initialize ()
 {
   NS_LOG_FUNCTION_NOARGS ();
-  LSDBMap_t::iterator i;
-  for (i= m_database.begin (); i!= m_database.end (); i++)
+  for (uint32_t i = 0; i < m_lsas.size (); i++)
     {
-      GlobalRoutingLSA* temp = i->second;
+      GlobalRoutingLSA* temp = m_lsas[i];
       temp->SetStatus (GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED);
     }
 }
@@ -457,10 +479,36 @@ GlobalRouteManagerLSDB::Insert (Ipv4Address addr, GlobalRoutingLSA* lsa)
   if (lsa->GetLSType () == GlobalRoutingLSA::ASExternalLSAs) 
     {
       m_extdatabase.push_back (lsa);
+      return;
     } 
-  else
+  uint32_t index = m_lsas.size ();
+  if (!m_database.insert (LSDBPair_t (addr, index)).second)
+    {
+      return;
+    }
+  m_lsas.push_back (lsa);
+  m_offsets.push_back (m_nLinkRecords);
+  m_nLinkRecords += lsa->GetNLinkRecords ();
+//
+// Of the LSAs with a transit network record for the same link data, keep
+// the one with the lowest link state ID.
+//
+  for (uint32_t j = 0; j < lsa->GetNLinkRecords (); j++)
     {
-      m_database.insert (LSDBPair_t (addr, lsa));
+      GlobalRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
+      if (lr->GetLinkType () != GlobalRoutingLinkRecord::TransitNetwork)
+        {
+          continue;
+        }
+      LSDBMap_t::iterator i = m_linkData.find (lr->GetLinkData ());
+      if (i == m_linkData.end ())
+        {
+          m_linkData.insert (LSDBPair_t (lr->GetLinkData (), index));
+        }
+      else if (addr < m_lsas[i->second]->GetLinkStateId ())
+        {
+          i->second = index;
+        }
     }
 }
 
@@ -480,43 +528,54 @@ GlobalRoutingLSA*
 GlobalRouteManagerLSDB::GetLSA (Ipv4Address addr) const
 {
   NS_LOG_FUNCTION (addr);
-//
-// Look up an LSA by its address.
-//
-  LSDBMap_t::const_iterator i;
-  for (i= m_database.begin (); i!= m_database.end (); i++)
-    {
-      if (i->first == addr)
-        {
-          return i->second;
-        }
-    }
-  return 0;
+  uint32_t index = GetLSAIndex (addr);
+  return index == SPF_INFINITY ? 0 : m_lsas[index];
 }
 
 GlobalRoutingLSA*
 GlobalRouteManagerLSDB::GetLSAByLinkData (Ipv4Address addr) const
 {
   NS_LOG_FUNCTION (addr);
-//
-// Look up an LSA by its address.
-//
-  LSDBMap_t::const_iterator i;
-  for (i= m_database.begin (); i!= m_database.end (); i++)
-    {
-      GlobalRoutingLSA* temp = i->second;
-// Iterate among temp's Link Records
-      for (uint32_t j = 0; j < temp->GetNLinkRecords (); j++)
-        {
-          GlobalRoutingLinkRecord *lr = temp->GetLinkRecord (j);
-          if ( lr->GetLinkType () == GlobalRoutingLinkRecord::TransitNetwork &&
-               lr->GetLinkData () == addr)
-            {
-              return temp;
-            }
-        }
-    }
-  return 0;
+  uint32_t index = GetLSAIndexByLinkData (addr);
+  return index == SPF_INFINITY ? 0 : m_lsas[index];
+}
+
+uint32_t
+GlobalRouteManagerLSDB::GetNLSAs (void) const
+{
+  return m_lsas.size ();
+}
+
+GlobalRoutingLSA*
+GlobalRouteManagerLSDB::GetLSAByIndex (uint32_t index) const
+{
+  return m_lsas[index];
+}
+
+uint32_t
+GlobalRouteManagerLSDB::GetLSAIndex (Ipv4Address addr) const
+{
+  LSDBMap_t::const_iterator i = m_database.find (addr);
+  return i == m_database.end () ? SPF_INFINITY : i->second;
+}
+
+uint32_t
+GlobalRouteManagerLSDB::GetLSAIndexByLinkData (Ipv4Address addr) const
+{
+  LSDBMap_t::const_iterator i = m_linkData.find (addr);
+  return i == m_linkData.end () ? SPF_INFINITY : i->second;
+}
+
+uint32_t
+GlobalRouteManagerLSDB::GetLinkRecordOffset (uint32_t index) const
+{
+  return m_offsets[index];
+}
+
+uint32_t
+GlobalRouteManagerLSDB::GetNLinkRecords (void) const
+{
+  return m_nLinkRecords;
 }
 
 // ---------------------------------------------------------------------------
@@ -527,16 +586,28 @@ GlobalRouteManagerLSDB::GetLSAByLinkData (Ipv4Address addr) const
 
 GlobalRouteManagerImpl::GlobalRouteManagerImpl () 
   :
-    m_spfroot (0)
+    m_spfroot (0),
+    m_manager (0),
+    m_root (0)
 {
   NS_LOG_FUNCTION_NOARGS ();
   m_lsdb = new GlobalRouteManagerLSDB ();
 }
 
+GlobalRouteManagerImpl::GlobalRouteManagerImpl (GlobalRouteManagerImpl *manager)
+  :
+    m_spfroot (0),
+    m_lsdb (manager->m_lsdb),
+    m_manager (manager),
+    m_root (0)
+{
+  NS_LOG_FUNCTION (manager);
+}
+
 GlobalRouteManagerImpl::~GlobalRouteManagerImpl ()
 {
   NS_LOG_FUNCTION_NOARGS ();
-  if (m_lsdb)
+  if (m_lsdb && m_manager == 0)
     {
       delete m_lsdb;
     }
@@ -553,6 +624,20 @@ GlobalRouteManagerImpl::DebugUseLsdb (GlobalRouteManagerLSDB* lsdb)
   m_lsdb = lsdb;
 }
 
+void
+GlobalRouteManagerImpl::DeleteRoutes (Ptr<Ipv4GlobalRouting> gr)
+{
+  uint32_t j = 0;
+  uint32_t nRoutes = gr->GetNRoutes ();
+  // Each time we delete route 0, the route index shifts downward
+  // We can delete all routes if we delete the route numbered 0
+  // nRoutes times
+  for (j = 0; j < nRoutes; j++)
+    {
+      gr->RemoveRoute (0);
+    }
+}
+
 void
 GlobalRouteManagerImpl::DeleteGlobalRoutes ()
 {
@@ -567,19 +652,10 @@ GlobalRouteManagerImpl::DeleteGlobalRoutes ()
           continue;
         }
       Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-      uint32_t j = 0;
-      uint32_t nRoutes = gr->GetNRoutes ();
       NS_LOG_LOGIC ("Deleting " << gr->GetNRoutes ()<< " routes from node " << node->GetId ());
-      // Each time we delete route 0, the route index shifts downward
-      // We can delete all routes if we delete the route numbered 0
-      // nRoutes times
-      for (j = 0; j < nRoutes; j++)
-        {
-          NS_LOG_LOGIC ("Deleting global route " << j << " from node " << node->GetId ());
-          gr->RemoveRoute (0);
-        }
-      NS_LOG_LOGIC ("Deleted " << j << " global routes from node "<< node->GetId ());
+      DeleteRoutes (gr);
     }
+  m_states.clear ();
   if (m_lsdb)
     {
       NS_LOG_LOGIC ("Deleting LSDB, creating new one");
@@ -588,6 +664,13 @@ GlobalRouteManagerImpl::DeleteGlobalRoutes ()
     }
 }
 
+void
+GlobalRouteManagerImpl::BuildGlobalRoutingDatabase () 
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  BuildGlobalRoutingDatabase (m_lsdb);
+}
+
 //
 // In order to build the routing database, we need to walk the list of nodes
 // in the system and look for those that support the GlobalRouter interface.
@@ -598,9 +681,9 @@ GlobalRouteManagerImpl::DeleteGlobalRoutes ()
 // ultimately be computed.
 //
 void
-GlobalRouteManagerImpl::BuildGlobalRoutingDatabase () 
+GlobalRouteManagerImpl::BuildGlobalRoutingDatabase (GlobalRouteManagerLSDB *lsdb) 
 {
-  NS_LOG_FUNCTION_NOARGS ();
+  NS_LOG_FUNCTION (lsdb);
 //
 // Walk the list of nodes looking for the GlobalRouter Interface.  Nodes with
 // global router interfaces are, not too surprisingly, our routers.
@@ -642,9 +725,72 @@ GlobalRouteManagerImpl::BuildGlobalRoutingDatabase ()
 //
 // Write the newly discovered link state advertisement to the database.
 //
-          m_lsdb->Insert (lsa->GetLinkStateId (), lsa); 
+          lsdb->Insert (lsa->GetLinkStateId (), lsa); 
+        }
+    }
+}
+
+//
+// The SPF calculations must not look up the nodes themselves: that would
+// change the reference counts of the objects from several threads.  They
+// find the Ipv4 and routing protocol of the root in this map instead.
+//
+void
+GlobalRouteManagerImpl::BuildRouterMap (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  m_routers.clear ();
+  NodeList::Iterator listEnd = NodeList::End ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<Node> node = *i;
+      Ptr<GlobalRouter> rtr = node->GetObject<GlobalRouter> ();
+      if (rtr == 0)
+        {
+          continue;
+        }
+      Router router;
+      router.ipv4 = node->GetObject<Ipv4> ();
+      router.routing = rtr->GetRoutingProtocol ();
+      m_routers[rtr->GetRouterId ()] = router;
+    }
+}
+
+//
+// Return the router IDs of the nodes that get routes, in the order of the
+// node list.
+//
+std::vector<Ipv4Address>
+GlobalRouteManagerImpl::GetRoots (void) const
+{
+  std::vector<Ipv4Address> roots;
+  NodeList::Iterator listEnd = NodeList::End ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<Node> node = *i;
+//
+// Look for the GlobalRouter interface that indicates that the node is
+// participating in routing.
+//
+      Ptr<GlobalRouter> rtr = 
+        node->GetObject<GlobalRouter> ();
+
+      // Ignore nodes that are not assigned to our systemId (distributed sim)
+      if (node->GetSystemId () != MpiInterface::GetSystemId ()) 
+        {
+          continue;
+        }
+
+//
+// if the node has a global router interface, then run the global routing
+// algorithms.
+//
+      if (rtr && rtr->GetNumLSAs () )
+        {
+          roots.push_back (rtr->GetRouterId ());
         }
     }
+  return roots;
 }
 
 //
@@ -684,37 +830,381 @@ void
 GlobalRouteManagerImpl::InitializeRoutes ()
 {
   NS_LOG_FUNCTION_NOARGS ();
+  NS_LOG_INFO ("About to start SPF calculation");
+  BuildRouterMap ();
+  ComputeRoutes (GetRoots ());
+  m_routers.clear ();
+  NS_LOG_INFO ("Finished SPF calculation");
+}
+
+uint32_t
+GlobalRouteManagerImpl::GetNThreads (void)
+{
+#ifdef HAVE_PTHREAD_H
+  UintegerValue threads;
+  g_globalRoutingThreads.GetValue (threads);
+  if (threads.Get () != 0)
+    {
+      return threads.Get ();
+    }
+  long n = sysconf (_SC_NPROCESSORS_ONLN);
+  return n > 0 ? n : 1;
+#else
+  return 1;
+#endif
+}
+
+void
+GlobalRouteManagerImpl::RunJob (Job *job)
+{
+  GlobalRouteManagerImpl *worker = job->worker;
+  for (uint32_t i = job->first; i < job->end; i += job->step)
+    {
+      worker->SPFCalculate ((*job->roots)[i]);
+      (*job->routes)[i].swap (worker->m_routes);
+      (*job->states)[i].stub = worker->m_state.stub;
+      (*job->states)[i].neighbor = worker->m_state.neighbor;
+      (*job->states)[i].tight.swap (worker->m_state.tight);
+    }
+}
+
 //
-// Walk the list of nodes in the system.
+// Run the SPF calculations of the roots, spread over the threads, and
+// install the routes they found in the order of the roots.  The roots are
+// taken by batches so that only the routes of a batch wait to be
+// installed.
 //
-  NS_LOG_INFO ("About to start SPF calculation");
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+void
+GlobalRouteManagerImpl::ComputeRoutes (const std::vector<Ipv4Address> &roots)
+{
+  NS_LOG_FUNCTION (roots.size ());
+  uint32_t nThreads = std::max<uint32_t> (1, std::min<uint32_t> (GetNThreads (), roots.size ()));
+  uint32_t batch = 16 * nThreads;
+  std::vector<std::vector<Route> > routes (roots.size ());
+  std::vector<RootState> states (roots.size ());
+  std::vector<Job> jobs (nThreads);
+  for (uint32_t k = 0; k < nThreads; k++)
     {
-      Ptr<Node> node = *i;
+      jobs[k].worker = k == 0 ? this : new GlobalRouteManagerImpl (this);
+      jobs[k].roots = &roots;
+      jobs[k].step = nThreads;
+      jobs[k].routes = &routes;
+      jobs[k].states = &states;
+    }
+  for (uint32_t base = 0; base < roots.size (); base += batch)
+    {
+      uint32_t end = std::min<uint32_t> (base + batch, roots.size ());
+      for (uint32_t k = 0; k < nThreads; k++)
+        {
+          jobs[k].first = base + k;
+          jobs[k].end = end;
+        }
+#ifdef HAVE_PTHREAD_H
+      std::vector<Ptr<SystemThread> > threads;
+      for (uint32_t k = 1; k < nThreads; k++)
+        {
+          threads.push_back (Create<SystemThread> (MakeBoundCallback (&GlobalRouteManagerImpl::RunJob, &jobs[k])));
+          threads.back ()->Start ();
+        }
+      RunJob (&jobs[0]);
+      for (uint32_t k = 0; k < threads.size (); k++)
+        {
+          threads[k]->Join ();
+        }
+#else
+      RunJob (&jobs[0]);
+#endif
+      for (uint32_t i = base; i < end; i++)
+        {
+          std::map<Ipv4Address, Router>::const_iterator router = m_routers.find (roots[i]);
+          if (router != m_routers.end ())
+            {
+              InstallRoutes (router->second.routing, routes[i]);
+            }
+          std::vector<Route> ().swap (routes[i]);
+          RootState &state = m_states[roots[i]];
+          state.stub = states[i].stub;
+          state.neighbor = states[i].neighbor;
+          state.tight.swap (states[i].tight);
+        }
+    }
+  for (uint32_t k = 1; k < nThreads; k++)
+    {
+      delete jobs[k].worker;
+    }
+}
+
+void
+GlobalRouteManagerImpl::InstallRoutes (Ptr<Ipv4GlobalRouting> gr, const std::vector<Route> &routes)
+{
+  for (std::vector<Route>::const_iterator i = routes.begin (); i != routes.end (); i++)
+    {
+      switch (i->type)
+        {
+        case Route::HOST:
+          gr->AddHostRouteTo (i->dest, i->nextHop, i->outIf);
+          break;
+        case Route::NETWORK:
+          gr->AddNetworkRouteTo (i->dest, i->mask, i->nextHop, i->outIf);
+          break;
+        case Route::EXTERNAL:
+          gr->AddASExternalRouteTo (i->dest, i->mask, i->nextHop, i->outIf);
+          break;
+        }
+    }
+}
+
+void
+GlobalRouteManagerImpl::AddRoute (Route::Type type, Ipv4Address dest, Ipv4Mask mask,
+                                  Ipv4Address nextHop, uint32_t outIf)
+{
+  Route route;
+  route.type = type;
+  route.dest = dest;
+  route.mask = mask;
+  route.nextHop = nextHop;
+  route.outIf = outIf;
+  m_routes.push_back (route);
+}
+
 //
-// Look for the GlobalRouter interface that indicates that the node is
-// participating in routing.
+// Record, for each point-to-point link record, whether it is on a shortest
+// path from the root: if no such record goes down, the shortest path tree
+// of the root stays the same.
 //
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
+void
+GlobalRouteManagerImpl::RecordTightLinks (void)
+{
+  m_state.tight.assign (m_lsdb->GetNLinkRecords (), false);
+  for (uint32_t i = 0; i < m_lsdb->GetNLSAs (); i++)
+    {
+      if (m_distances[i] == SPF_INFINITY)
+        {
+          continue;
+        }
+      GlobalRoutingLSA *lsa = m_lsdb->GetLSAByIndex (i);
+      uint32_t offset = m_lsdb->GetLinkRecordOffset (i);
+      for (uint32_t j = 0; j < lsa->GetNLinkRecords (); j++)
+        {
+          GlobalRoutingLinkRecord *l = lsa->GetLinkRecord (j);
+          if (l->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
+            {
+              continue;
+            }
+          uint32_t w = m_lsdb->GetLSAIndex (l->GetLinkId ());
+          if (w != SPF_INFINITY && m_distances[w] != SPF_INFINITY
+              && m_distances[i] + l->GetMetric () == m_distances[w])
+            {
+              m_state.tight[offset + j] = true;
+            }
+        }
+    }
+}
 
-      // Ignore nodes that are not assigned to our systemId (distributed sim)
-      if (node->GetSystemId () != MpiInterface::GetSystemId ()) 
+//
+// Compare the new database with the one the routes were computed from.
+// When the only changes are point-to-point and stub records removed from
+// router LSAs, which is what links going down do, the roots whose shortest
+// path tree used none of the removed point-to-point records keep their
+// routes, minus those to the removed interfaces and stub networks; only the
+// other roots are computed again.  Anything else computes all the routes
+// again.
+//
+void
+GlobalRouteManagerImpl::UpdateRoutes ()
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  if (m_states.empty ())
+    {
+      DeleteGlobalRoutes ();
+      BuildGlobalRoutingDatabase ();
+      InitializeRoutes ();
+      return;
+    }
+  GlobalRouteManagerLSDB *lsdb = new GlobalRouteManagerLSDB ();
+  BuildGlobalRoutingDatabase (lsdb);
+
+  bool full = lsdb->GetNLSAs () != m_lsdb->GetNLSAs ()
+    || lsdb->GetNumExtLSAs () != m_lsdb->GetNumExtLSAs ();
+  for (uint32_t i = 0; !full && i < lsdb->GetNumExtLSAs (); i++)
+    {
+      GlobalRoutingLSA *a = m_lsdb->GetExtLSA (i);
+      GlobalRoutingLSA *b = lsdb->GetExtLSA (i);
+      full = a->GetLinkStateId () != b->GetLinkStateId ()
+        || a->GetNetworkLSANetworkMask () != b->GetNetworkLSANetworkMask ()
+        || a->GetAdvertisingRouter () != b->GetAdvertisingRouter ();
+    }
+  // by LSA index, the indexes of the removed records in the old LSA
+  std::vector<std::vector<uint32_t> > removed (lsdb->GetNLSAs ());
+  // by record offset in the new database, the offset in the old one
+  std::vector<uint32_t> oldRecords (lsdb->GetNLinkRecords ());
+  bool changed = false;
+  for (uint32_t i = 0; !full && i < lsdb->GetNLSAs (); i++)
+    {
+      GlobalRoutingLSA *a = m_lsdb->GetLSAByIndex (i);
+      GlobalRoutingLSA *b = lsdb->GetLSAByIndex (i);
+      if (a->GetLinkStateId () != b->GetLinkStateId ()
+          || a->GetLSType () != GlobalRoutingLSA::RouterLSA
+          || b->GetLSType () != GlobalRoutingLSA::RouterLSA)
+        {
+          full = true;
+          break;
+        }
+      std::vector<bool> matched (a->GetNLinkRecords (), false);
+      for (uint32_t j = 0; !full && j < b->GetNLinkRecords (); j++)
+        {
+          GlobalRoutingLinkRecord *lb = b->GetLinkRecord (j);
+          uint32_t k = 0;
+          for (; k < a->GetNLinkRecords (); k++)
+            {
+              GlobalRoutingLinkRecord *la = a->GetLinkRecord (k);
+              if (!matched[k] && la->GetLinkType () == lb->GetLinkType ()
+                  && la->GetLinkId () == lb->GetLinkId ()
+                  && la->GetLinkData () == lb->GetLinkData ()
+                  && la->GetMetric () == lb->GetMetric ())
+                {
+                  break;
+                }
+            }
+          // an added record may make any path shorter
+          full = k == a->GetNLinkRecords ();
+          if (!full)
+            {
+              matched[k] = true;
+              oldRecords[lsdb->GetLinkRecordOffset (i) + j] = m_lsdb->GetLinkRecordOffset (i) + k;
+            }
+        }
+      for (uint32_t k = 0; !full && k < a->GetNLinkRecords (); k++)
+        {
+          if (!matched[k])
+            {
+              full = a->GetLinkRecord (k)->GetLinkType () == GlobalRoutingLinkRecord::TransitNetwork;
+              removed[i].push_back (k);
+              changed = true;
+            }
+        }
+    }
+  if (full)
+    {
+      NS_LOG_LOGIC ("Computing all the routes again");
+      delete lsdb;
+      DeleteGlobalRoutes ();
+      BuildGlobalRoutingDatabase ();
+      InitializeRoutes ();
+      return;
+    }
+  if (!changed)
+    {
+      delete lsdb;
+      return;
+    }
+
+  BuildRouterMap ();
+  std::vector<Ipv4Address> roots;
+  for (std::map<Ipv4Address, RootState>::iterator i = m_states.begin (); i != m_states.end (); i++)
+    {
+      Ipv4Address root = i->first;
+      RootState &state = i->second;
+      std::map<Ipv4Address, Router>::const_iterator router = m_routers.find (root);
+      if (router == m_routers.end ())
         {
           continue;
         }
+      bool affected = false;
+      if (state.stub)
+        {
+          affected = !removed[m_lsdb->GetLSAIndex (root)].empty ()
+            || !removed[m_lsdb->GetLSAIndex (state.neighbor)].empty ();
+        }
+      for (uint32_t u = 0; !state.stub && !affected && u < removed.size (); u++)
+        {
+          GlobalRoutingLSA *lsa = m_lsdb->GetLSAByIndex (u);
+          for (uint32_t j = 0; !affected && j < removed[u].size (); j++)
+            {
+              GlobalRoutingLinkRecord *l = lsa->GetLinkRecord (removed[u][j]);
+              affected = l->GetLinkType () == GlobalRoutingLinkRecord::PointToPoint
+                && (lsa->GetLinkStateId () == root || l->GetLinkId () == root
+                    || state.tight[m_lsdb->GetLinkRecordOffset (u) + removed[u][j]]);
+            }
+        }
+      if (affected || (!state.stub && !PatchRoutes (root, router->second.routing, lsdb, removed)))
+        {
+          DeleteRoutes (router->second.routing);
+          roots.push_back (root);
+          continue;
+        }
+      if (!state.stub)
+        {
+          std::vector<bool> tight (lsdb->GetNLinkRecords ());
+          for (uint32_t j = 0; j < tight.size (); j++)
+            {
+              tight[j] = state.tight[oldRecords[j]];
+            }
+          state.tight.swap (tight);
+        }
+    }
+  NS_LOG_LOGIC ("Computing the routes of " << roots.size () << " of " << m_states.size () << " roots again");
+  delete m_lsdb;
+  m_lsdb = lsdb;
+  ComputeRoutes (roots);
+  m_routers.clear ();
+}
 
 //
-// if the node has a global router interface, then run the global routing
-// algorithms.
+// Remove, from the routes of a root whose shortest path tree did not
+// change, the host routes to the removed point-to-point interfaces and the
+// network routes to the removed stub networks.  The routes to the stub
+// networks of a router use the same exits as the host routes to its
+// interfaces: find them there.  Return false if that is not possible.
 //
-      if (rtr && rtr->GetNumLSAs () )
+bool
+GlobalRouteManagerImpl::PatchRoutes (Ipv4Address root, Ptr<Ipv4GlobalRouting> gr,
+                                     GlobalRouteManagerLSDB *lsdb,
+                                     const std::vector<std::vector<uint32_t> > &removed)
+{
+  NS_LOG_FUNCTION (root);
+  for (uint32_t u = 0; u < removed.size (); u++)
+    {
+      GlobalRoutingLSA *lsa = m_lsdb->GetLSAByIndex (u);
+      if (removed[u].empty () || lsa->GetLinkStateId () == root)
         {
-          SPFCalculate (rtr->GetRouterId ());
+          continue;
+        }
+      std::vector<Ipv4RoutingTableEntry> exits;
+      bool haveExits = false;
+      for (uint32_t j = 0; j < removed[u].size (); j++)
+        {
+          GlobalRoutingLinkRecord *l = lsa->GetLinkRecord (removed[u][j]);
+          if (l->GetLinkType () == GlobalRoutingLinkRecord::PointToPoint)
+            {
+              gr->RemoveHostRoutesTo (l->GetLinkData ());
+              continue;
+            }
+          if (!haveExits)
+            {
+              GlobalRoutingLSA *remaining = lsdb->GetLSAByIndex (u);
+              uint32_t k = 0;
+              while (k < remaining->GetNLinkRecords ()
+                     && remaining->GetLinkRecord (k)->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
+                {
+                  k++;
+                }
+              if (k == remaining->GetNLinkRecords ())
+                {
+                  return false;
+                }
+              exits = gr->GetHostRoutesTo (remaining->GetLinkRecord (k)->GetLinkData ());
+              haveExits = true;
+            }
+          Ipv4Mask mask (l->GetLinkData ().Get ());
+          Ipv4Address network = l->GetLinkId ().CombineMask (mask);
+          for (uint32_t e = 0; e < exits.size (); e++)
+            {
+              gr->RemoveNetworkRouteTo (network, mask, exits[e].GetGateway (), exits[e].GetInterface ());
+            }
         }
     }
-  NS_LOG_INFO ("Finished SPF calculation");
+  return true;
 }
 
 //
@@ -737,6 +1227,7 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 
   SPFVertex* w = 0;
   GlobalRoutingLSA* w_lsa = 0;
+  uint32_t w_index = 0;
   GlobalRoutingLinkRecord *l = 0;
   uint32_t distance = 0;
   uint32_t numRecordsInVertex = 0;
@@ -783,16 +1274,18 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 // Lookup the link state advertisement of the new link -- we call it <w> in
 // the link state database.
 //
-              w_lsa = m_lsdb->GetLSA (l->GetLinkId ());
-              NS_ASSERT (w_lsa);
+              w_index = m_lsdb->GetLSAIndex (l->GetLinkId ());
+              NS_ASSERT (w_index != SPF_INFINITY);
+              w_lsa = m_lsdb->GetLSAByIndex (w_index);
               NS_LOG_LOGIC ("Found a P2P record from " << 
                             v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
             }
           else if (l->GetLinkType () == 
                    GlobalRoutingLinkRecord::TransitNetwork)
             {
-              w_lsa = m_lsdb->GetLSA (l->GetLinkId ());
-              NS_ASSERT (w_lsa);
+              w_index = m_lsdb->GetLSAIndex (l->GetLinkId ());
+              NS_ASSERT (w_index != SPF_INFINITY);
+              w_lsa = m_lsdb->GetLSAByIndex (w_index);
               NS_LOG_LOGIC ("Found a Transit record from " << 
                             v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
             }
@@ -804,12 +1297,13 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 // Get w_lsa:  In case of V is Network-LSA
       if (v->GetVertexType () == SPFVertex::VertexNetwork) 
         {
-          w_lsa = m_lsdb->GetLSAByLinkData 
+          w_index = m_lsdb->GetLSAIndexByLinkData 
               (v->GetLSA ()->GetAttachedRouter (i));
-          if (!w_lsa)
+          if (w_index == SPF_INFINITY)
             {
               continue;
             }
+          w_lsa = m_lsdb->GetLSAByIndex (w_index);
           NS_LOG_LOGIC ("Found a Network LSA from " << 
                         v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
         }
@@ -822,7 +1316,7 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 // If the link is to a router that is already in the shortest path first tree
 // then we have it covered -- ignore it.
 //
-      if (w_lsa->GetStatus () == GlobalRoutingLSA::LSA_SPF_IN_SPFTREE) 
+      if (m_status[w_index] == GlobalRoutingLSA::LSA_SPF_IN_SPFTREE) 
         {
           NS_LOG_LOGIC ("Skipping ->  LSA "<< 
                         w_lsa->GetLinkStateId () << " already in SPF tree");
@@ -846,7 +1340,7 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
       NS_LOG_LOGIC ("Considering w_lsa " << w_lsa->GetLinkStateId ());
 
 // Is there already vertex w in candidate list?
-      if (w_lsa->GetStatus () == GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED)
+      if (m_status[w_index] == GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED)
         {
 // Calculate nexthop to w
 // We need to figure out how to actually get to the new router represented
@@ -858,7 +1352,8 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
           w = new SPFVertex (w_lsa);
           if (SPFNexthopCalculation (v, w, l, distance))
             {
-              w_lsa->SetStatus (GlobalRoutingLSA::LSA_SPF_CANDIDATE);
+              m_status[w_index] = GlobalRoutingLSA::LSA_SPF_CANDIDATE;
+              m_candidates[w_index] = w;
 //
 // Push this new vertex onto the priority queue (ordered by distance from the
 // root node).
@@ -873,7 +1368,7 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
             NS_ASSERT_MSG (0, "SPFNexthopCalculation never " 
                            << "return false, but it does now!");
         }
-      else if (w_lsa->GetStatus () == GlobalRoutingLSA::LSA_SPF_CANDIDATE)
+      else if (m_status[w_index] == GlobalRoutingLSA::LSA_SPF_CANDIDATE)
         {
 //
 // We have already considered the link represented by <w>.  What wse have to
@@ -889,7 +1384,7 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 * if we've found a shorter path.
 */
           SPFVertex* cw;
-          cw = candidate.Find (w_lsa->GetLinkStateId ());
+          cw = m_candidates[w_index];
           if (cw->GetDistanceFromRoot () < distance)
             {
 //
@@ -943,9 +1438,9 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
                 {
 //
 // If we've changed the cost to get to the vertex represented by <w>, we 
-// must reorder the priority queue keyed to that cost.
+// must move it up the priority queue keyed to that cost.
 //
-                  candidate.Reorder ();
+                  candidate.Update (cw);
                 }
             } // new lower cost path found
         } // end W is already on the candidate list
@@ -1232,7 +1727,14 @@ void
 GlobalRouteManagerImpl::DebugSPFCalculate (Ipv4Address root)
 {
   NS_LOG_FUNCTION (root);
+  BuildRouterMap ();
   SPFCalculate (root);
+  if (m_root != 0)
+    {
+      InstallRoutes (m_root->routing, m_routes);
+    }
+  m_root = 0;
+  m_routers.clear ();
 }
 
 //
@@ -1269,6 +1771,7 @@ GlobalRouteManagerImpl::CheckForStubNode (Ipv4Address root)
       // routing should not be called for this node, but we can just raise
       // a warning here and return true.
       NS_LOG_WARN ("all nodes should have at least one transit link:" << root );
+      m_state.stub = true;
       return true;
     }
   if (transits == 1)
@@ -1305,12 +1808,10 @@ GlobalRouteManagerImpl::CheckForStubNode (Ipv4Address root)
               if (lr->GetLinkId () == myRouterId)
                 {
                   // Next hop is stored in the LinkID field of lr
-                  Ptr<GlobalRouter> router = rlsa->GetNode ()->GetObject<GlobalRouter> ();
-                  NS_ASSERT (router);
-                  Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-                  NS_ASSERT (gr);
-                  gr->AddNetworkRouteTo (Ipv4Address ("0.0.0.0"), Ipv4Mask ("0.0.0.0"), lr->GetLinkData (), 
-                                         FindOutgoingInterfaceId (transitLink->GetLinkData ()));
+                  AddRoute (Route::NETWORK, Ipv4Address ("0.0.0.0"), Ipv4Mask ("0.0.0.0"), lr->GetLinkData (),
+                            FindOutgoingInterfaceId (transitLink->GetLinkData ()));
+                  m_state.stub = true;
+                  m_state.neighbor = transitLink->GetLinkId ();
                   NS_LOG_LOGIC ("Inserting default route for node " << myRouterId << " to next hop " << 
                                 lr->GetLinkData () << " via interface " << 
                                 FindOutgoingInterfaceId (transitLink->GetLinkData ()));
@@ -1330,9 +1831,20 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 
   SPFVertex *v;
 //
-// Initialize the Link State Database.
-//
-  m_lsdb->Initialize ();
+// Find the router we compute the routes of, and initialize the state of the
+// calculation.  The LSDB is shared with the calculations of other roots and
+// is not written to.
+//
+  const std::map<Ipv4Address, Router> &routers = m_manager ? m_manager->m_routers : m_routers;
+  std::map<Ipv4Address, Router>::const_iterator router = routers.find (root);
+  m_root = router == routers.end () ? 0 : &router->second;
+  m_routes.clear ();
+  m_state.stub = false;
+  m_state.neighbor = root;
+  m_state.tight.clear ();
+  m_status.assign (m_lsdb->GetNLSAs (), GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED);
+  m_candidates.assign (m_lsdb->GetNLSAs (), 0);
+  m_distances.assign (m_lsdb->GetNLSAs (), SPF_INFINITY);
 //
 // The candidate queue is a priority queue of SPFVertex objects, with the top
 // of the queue being the closest vertex in terms of distance from the root
@@ -1345,14 +1857,17 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 // calculation.  Each router (and corresponding network) is a vertex in the
 // shortest path first (SPF) tree.
 //
-  v = new SPFVertex (m_lsdb->GetLSA (root));
+  uint32_t index = m_lsdb->GetLSAIndex (root);
+  NS_ASSERT (index != SPF_INFINITY);
+  v = new SPFVertex (m_lsdb->GetLSAByIndex (index));
 // 
 // This vertex is the root of the SPF tree and it is distance 0 from the root.
 // We also mark this vertex as being in the SPF tree.
 //
   m_spfroot= v;
   v->SetDistanceFromRoot (0);
-  v->GetLSA ()->SetStatus (GlobalRoutingLSA::LSA_SPF_IN_SPFTREE);
+  m_status[index] = GlobalRoutingLSA::LSA_SPF_IN_SPFTREE;
+  m_distances[index] = 0;
   NS_LOG_LOGIC ("Starting SPFCalculate for node " << root);
 
 //
@@ -1362,10 +1877,11 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 // reached.  Instead, short-circuit this computation and just install
 // a default route in the CheckForStubNode() method.
 //
-  if (NodeList::GetNNodes () > 0 && CheckForStubNode (root))
+  if (m_root != 0 && CheckForStubNode (root))
     {
       NS_LOG_LOGIC ("SPFCalculate truncated for stub node " << root);
       delete m_spfroot;
+      m_spfroot = 0;
       return;
     }
 
@@ -1410,10 +1926,12 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
       v = candidate.Pop ();
       NS_LOG_LOGIC ("Popped vertex " << v->GetVertexId ());
 //
-// Update the status field of the vertex to indicate that it is in the SPF
-// tree.
+// Update the status of the vertex to indicate that it is in the SPF tree.
 //
-      v->GetLSA ()->SetStatus (GlobalRoutingLSA::LSA_SPF_IN_SPFTREE);
+      index = m_lsdb->GetLSAIndex (v->GetVertexId ());
+      m_status[index] = GlobalRoutingLSA::LSA_SPF_IN_SPFTREE;
+      m_candidates[index] = 0;
+      m_distances[index] = v->GetDistanceFromRoot ();
 //
 // The current vertex has a parent pointer.  By calling this rather oddly 
 // named method (blame quagga) we add the current vertex to the list of 
@@ -1470,6 +1988,8 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 
     }  // end for loop
 
+  RecordTightLinks ();
+
 // Second stage of SPF calculation procedure
   SPFProcessStubs (m_spfroot);
   for (uint32_t i = 0; i < m_lsdb->GetNumExtLSAs (); i++)
@@ -1540,110 +2060,40 @@ GlobalRouteManagerImpl::SPFAddASExternal (GlobalRoutingLSA *extlsa, SPFVertex *v
     }
   NS_LOG_LOGIC ("External is on remote host: " 
                 << extlsa->GetAdvertisingRouter () << "; installing");
-
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
 //
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
+// The routes are for the router at the root of the SPF tree; there are none
+// if it is not a node of the simulation.
 //
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  if (m_root == 0)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to QI for that interface.  If there's no GlobalRouter interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
+      return;
+    }
+  Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = extlsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
+  // walk through all next-hop-IPs and out-going-interfaces for reaching
+  // the stub network gateway 'v' from the root node
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+    {
+      SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+      Ipv4Address nextHop = exit.first;
+      int32_t outIf = exit.second;
+      if (outIf >= 0)
         {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << node->GetId ());
-          continue;
+          AddRoute (Route::EXTERNAL, tempip, tempmask, nextHop, outIf);
+          NS_LOG_LOGIC ("Node " << m_spfroot->GetVertexId () <<
+                        " add external network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " via interface " << outIf);
         }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
+      else
         {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to QI
-// for that interface.  If the node is acting as an IP version 4 router, it
-// should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "QI for <Ipv4> interface failed");
-//
-// Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
-//
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = extlsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
-
-//
-// Here's why we did all of that work.  We're going to add a host route to the
-// host address found in the m_linkData field of the point-to-point link
-// record.  In the case of a point-to-point link, this is the local IP address
-// of the node connected to the link.  Each of these point-to-point links
-// will correspond to a local interface that has an IP address to which
-// the node at the root of the SPF tree can send packets.  The vertex <v> 
-// (corresponding to the node that has these links and interfaces) has 
-// an m_nextHop address precalculated for us that is the address to which the
-// root node should send packets to be forwarded to these IP addresses.
-// Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
-// which the packets should be send for forwarding.
-//
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              if (outIf >= 0)
-                {
-                  gr->AddASExternalRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add external network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+          NS_LOG_LOGIC ("Node " << m_spfroot->GetVertexId () <<
+                        " NOT able to add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " since outgoing interface id is negative");
+        }
+    }
 }
 
 
@@ -1703,118 +2153,41 @@ GlobalRouteManagerImpl::SPFIntraAddStub (GlobalRoutingLinkRecord *l, SPFVertex*
       return;
     }
   NS_LOG_LOGIC ("Stub is on remote host: " << v->GetVertexId () << "; installing");
+  if (m_root == 0)
+    {
+      return;
+    }
+  Ipv4Mask tempmask (l->GetLinkData ().Get ());
+  Ipv4Address tempip = l->GetLinkId ();
+  tempip = tempip.CombineMask (tempmask);
 //
-// The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
+// The vertex <v> (corresponding to the node that has the stub network) has
+// the next hops and outbound interfaces precalculated for us that the root
+// node should send packets to the network to.
 //
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  // walk through all next-hop-IPs and out-going-interfaces for reaching
+  // the stub network gateway 'v' from the root node
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to QI for that interface.  If there's no GlobalRouter interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
+      SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+      Ipv4Address nextHop = exit.first;
+      int32_t outIf = exit.second;
+      if (outIf >= 0)
         {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
+          AddRoute (Route::NETWORK, tempip, tempmask, nextHop, outIf);
+          NS_LOG_LOGIC ("Node " << m_spfroot->GetVertexId () <<
+                        " add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " via interface " << outIf);
         }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
+      else
         {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to QI
-// for that interface.  If the node is acting as an IP version 4 router, it
-// should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "QI for <Ipv4> interface failed");
-//
-// Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
-//
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask (l->GetLinkData ().Get ());
-          Ipv4Address tempip = l->GetLinkId ();
-          tempip = tempip.CombineMask (tempmask);
-//
-// Here's why we did all of that work.  We're going to add a host route to the
-// host address found in the m_linkData field of the point-to-point link
-// record.  In the case of a point-to-point link, this is the local IP address
-// of the node connected to the link.  Each of these point-to-point links
-// will correspond to a local interface that has an IP address to which
-// the node at the root of the SPF tree can send packets.  The vertex <v> 
-// (corresponding to the node that has these links and interfaces) has 
-// an m_nextHop address precalculated for us that is the address to which the
-// root node should send packets to be forwarded to these IP addresses.
-// Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
-// which the packets should be send for forwarding.
-//
-
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+          NS_LOG_LOGIC ("Node " << m_spfroot->GetVertexId () <<
+                        " NOT able to add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " since outgoing interface id is negative");
+        }
+    }
 }
 
 //
@@ -1829,70 +2202,19 @@ GlobalRouteManagerImpl::FindOutgoingInterfaceId (Ipv4Address a, Ipv4Mask amask)
 {
   NS_LOG_FUNCTION (a << amask);
 //
-// We have an IP address <a> and a vertex ID of the root of the SPF tree.
-// The question is what interface index does this address correspond to.
-// The answer is a little complicated since we have to find a pointer to
-// the node corresponding to the vertex ID, find the Ipv4 interface on that
-// node in order to iterate the interfaces and find the one corresponding to
-// the address in question.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-//
-// Walk the list of nodes in the system looking for the one corresponding to
-// the node at the root of the SPF tree.  This is the node for which we are
-// building the routing table.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
-
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-//
-// If the node doesn't have a GlobalRouter interface it can't be the one
-// we're interested in.
-//
-      if (rtr == 0)
-        {
-          continue;
-        }
-
-      if (rtr->GetRouterId () == routerId)
-        {
-//
-// This is the node we're building the routing table for.  We're going to need
-// the Ipv4 interface to look for the ipv4 interface index.  Since this node
-// is participating in routing IP version 4 packets, it certainly must have 
-// an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::FindOutgoingInterfaceId (): "
-                         "GetObject for <Ipv4> interface failed");
-//
-// Look through the interfaces on this node for one that has the IP address
+// We have an IP address <a> and the router at the root of the SPF tree.
+// Look through the interfaces of its node for one that has the IP address
 // we're looking for.  If we find one, return the corresponding interface
 // index, or -1 if not found.
 //
-          int32_t interface = ipv4->GetInterfaceForPrefix (a, amask);
-
-#if 0
-          if (interface < 0)
-            {
-              NS_FATAL_ERROR ("GlobalRouteManagerImpl::FindOutgoingInterfaceId(): "
-                              "Expected an interface associated with address a:" << a);
-            }
-#endif 
-          return interface;
-        }
+  if (m_root == 0)
+    {
+      return -1;
     }
-//
-// Couldn't find it.
-//
-  NS_LOG_LOGIC ("FindOutgoingInterfaceId():Can't find root node " << routerId);
-  return -1;
+  NS_ASSERT_MSG (m_root->ipv4, 
+                 "GlobalRouteManagerImpl::FindOutgoingInterfaceId (): "
+                 "GetObject for <Ipv4> interface failed");
+  return m_root->ipv4->GetInterfaceForPrefix (a, amask);
 }
 
 //
@@ -1918,71 +2240,22 @@ GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
 
   NS_ASSERT_MSG (m_spfroot, 
                  "GlobalRouteManagerImpl::SPFIntraAddRouter (): Root pointer not set");
-//
-// The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  if (m_root == 0)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to GetObject for that interface.  If there's no GlobalRouter interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to 
-// GetObject for that interface.  If the node is acting as an IP version 4 
-// router, it should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "GetObject for <Ipv4> interface failed");
+      return;
+    }
 //
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          GlobalRoutingLSA *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
+  GlobalRoutingLSA *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
+                 "Expected valid LSA in SPFVertex* v");
 
-          uint32_t nLinkRecords = lsa->GetNLinkRecords ();
+  uint32_t nLinkRecords = lsa->GetNLinkRecords ();
 //
 // Iterate through the link records on the vertex to which we're going to add
 // routes.  To make sure we're being clear, we're going to add routing table
@@ -1991,18 +2264,16 @@ GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
 // the local side of the point-to-point links found on the node described by
 // the vertex <v>.
 //
-          NS_LOG_LOGIC (" Node " << node->GetId () <<
-                        " found " << nLinkRecords << " link records in LSA " << lsa << "with LinkStateId "<< lsa->GetLinkStateId ());
-          for (uint32_t j = 0; j < nLinkRecords; ++j)
-            {
+  for (uint32_t j = 0; j < nLinkRecords; ++j)
+    {
 //
 // We are only concerned about point-to-point links
 //
-              GlobalRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
-              if (lr->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
-                {
-                  continue;
-                }
+      GlobalRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
+      if (lr->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
+        {
+          continue;
+        }
 //
 // Here's why we did all of that work.  We're going to add a host route to the
 // host address found in the m_linkData field of the point-to-point link
@@ -2016,44 +2287,30 @@ GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
 // Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
 // which the packets should be send for forwarding.
 //
-              Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-              if (router == 0)
-                {
-                  continue;
-                }
-              Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-              NS_ASSERT (gr);
-              // walk through all available exit directions due to ECMP,
-              // and add host route for each of the exit direction toward
-              // the vertex 'v'
-              for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-                {
-                  SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-                  Ipv4Address nextHop = exit.first;
-                  int32_t outIf = exit.second;
-                  if (outIf >= 0)
-                    {
-                      gr->AddHostRouteTo (lr->GetLinkData (), nextHop,
-                                          outIf);
-                      NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                    " adding host route to " << lr->GetLinkData () <<
-                                    " using next hop " << nextHop <<
-                                    " and outgoing interface " << outIf);
-                    }
-                  else
-                    {
-                      NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                    " NOT able to add host route to " << lr->GetLinkData () <<
-                                    " using next hop " << nextHop <<
-                                    " since outgoing interface id is negative " << outIf);
-                    }
-                } // for all routes from the root the vertex 'v'
+      // walk through all available exit directions due to ECMP,
+      // and add host route for each of the exit direction toward
+      // the vertex 'v'
+      for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+        {
+          SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+          Ipv4Address nextHop = exit.first;
+          int32_t outIf = exit.second;
+          if (outIf >= 0)
+            {
+              AddRoute (Route::HOST, lr->GetLinkData (), Ipv4Mask::GetOnes (), nextHop, outIf);
+              NS_LOG_LOGIC ("Node " << m_spfroot->GetVertexId () <<
+                            " adding host route to " << lr->GetLinkData () <<
+                            " using next hop " << nextHop <<
+                            " and outgoing interface " << outIf);
             }
-//
-// Done adding the routes for the selected node.
-//
-          return;
-        }
+          else
+            {
+              NS_LOG_LOGIC ("Node " << m_spfroot->GetVertexId () <<
+                            " NOT able to add host route to " << lr->GetLinkData () <<
+                            " using next hop " << nextHop <<
+                            " since outgoing interface id is negative " << outIf);
+            }
+        } // for all routes from the root the vertex 'v'
     }
 }
 void
@@ -2063,106 +2320,46 @@ GlobalRouteManagerImpl::SPFIntraAddTransit (SPFVertex* v)
 
   NS_ASSERT_MSG (m_spfroot, 
                  "GlobalRouteManagerImpl::SPFIntraAddTransit (): Root pointer not set");
-//
-// The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  if (m_root == 0)
     {
-      Ptr<Node> node = *i;
+      return;
+    }
 //
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to GetObject for that interface.  If there's no GlobalRouter interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
+// Get the Global Router Link State Advertisement of the transit network
+// we're adding the routes to.
+//
+  GlobalRoutingLSA *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
+                 "Expected valid LSA in SPFVertex* v");
+  Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = lsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
+  // walk through all available exit directions due to ECMP,
+  // and add host route for each of the exit direction toward
+  // the vertex 'v'
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+    {
+      SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+      Ipv4Address nextHop = exit.first;
+      int32_t outIf = exit.second;
 
-      if (rtr == 0)
+      if (outIf >= 0)
         {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
+          AddRoute (Route::NETWORK, tempip, tempmask, nextHop, outIf);
+          NS_LOG_LOGIC ("Node " << m_spfroot->GetVertexId () <<
+                        " add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " via interface " << outIf);
         }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
+      else
         {
-          NS_LOG_LOGIC ("setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to 
-// GetObject for that interface.  If the node is acting as an IP version 4 
-// router, it should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
-                         "GetObject for <Ipv4> interface failed");
-//
-// Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
-//
-          GlobalRoutingLSA *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = lsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all available exit directions due to ECMP,
-          // and add host route for each of the exit direction toward
-          // the vertex 'v'
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative " << outIf);
-                }
-            }
+          NS_LOG_LOGIC ("Node " << m_spfroot->GetVertexId () <<
+                        " NOT able to add network route to " << tempip <<
+                        " using next hop " << nextHop <<
+                        " since outgoing interface id is negative " << outIf);
         }
-    } 
+    }
 }
 
 // Derived from quagga ospf_vertex_add_parents ()
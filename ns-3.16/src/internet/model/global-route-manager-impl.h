@@ -30,6 +30,7 @@
 #include "ns3/object.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4-address.h"
+#include "ns3/ipv4.h"
 #include "global-router-interface.h"
 
 namespace ns3 {
@@ -548,6 +549,10 @@ private:
   ListOfSPFVertex_t m_parents;
   ListOfSPFVertex_t m_children;
   bool m_vertexProcessed; 
+  /// the position of the vertex in the CandidateQueue heap
+  uint32_t m_candidateIndex;
+  /// the order of the vertex among the candidates at the same distance
+  uint32_t m_candidateOrder;
 
 /**
  * @brief The SPFVertex copy construction is disallowed.  There's no need for
@@ -564,6 +569,7 @@ private:
   //friend std::ostream& operator<< (std::ostream& os, const ListOfIf_t& ifs);
   //friend std::ostream& operator<< (std::ostream& os, const ListOfAddr_t& addrs);
   friend std::ostream& operator<< (std::ostream& os, const SPFVertex::ListOfSPFVertex_t& vs);
+  friend class CandidateQueue;
 };
 
 /**
@@ -577,7 +583,10 @@ private:
  * also export their own LSAs.
  *
  * This class implements a searchable database of LSAs gathered from every
- * router in the simulation.
+ * router in the simulation.  The LSAs are numbered in the order they were
+ * inserted, and indexed by link state ID and by the link data of their
+ * transit network records, so that the SPF calculations can keep their
+ * per-LSA state in arrays and share the database without writing to it.
  */
 class GlobalRouteManagerLSDB
 {
@@ -648,6 +657,55 @@ public:
  */
   GlobalRoutingLSA* GetLSAByLinkData (Ipv4Address addr) const;
 
+/**
+ * @brief Get the number of LSAs in the database, external LSAs excepted.
+ * @internal
+ */
+  uint32_t GetNLSAs (void) const;
+
+/**
+ * @brief Get an LSA by its index, in the order the LSAs were inserted.
+ * @internal
+ *
+ * @param index The index of the LSA, less than GetNLSAs ()
+ */
+  GlobalRoutingLSA* GetLSAByIndex (uint32_t index) const;
+
+/**
+ * @brief Look up the index of the Link State Advertisement associated with
+ * the given link state ID (address).
+ * @internal
+ *
+ * @param addr The IP address associated with the LSA.
+ * @returns The index of the LSA, or SPF_INFINITY if there is none.
+ */
+  uint32_t GetLSAIndex (Ipv4Address addr) const;
+
+/**
+ * @brief Like GetLSAByLinkData, but return the index of the LSA, or
+ * SPF_INFINITY if there is none.
+ * @internal
+ */
+  uint32_t GetLSAIndexByLinkData (Ipv4Address addr) const;
+
+/**
+ * @brief Get the number of link records of the LSAs that precede an LSA,
+ * which numbers the link records of the whole database.
+ * @internal
+ *
+ * The link records of an LSA must not change after it is inserted.
+ *
+ * @param index The index of the LSA
+ */
+  uint32_t GetLinkRecordOffset (uint32_t index) const;
+
+/**
+ * @brief Get the number of link records of all the LSAs in the database,
+ * external LSAs excepted.
+ * @internal
+ */
+  uint32_t GetNLinkRecords (void) const;
+
 /**
  * @brief Set all LSA flags to an initialized state, for SPF computation
  * @internal
@@ -667,10 +725,16 @@ public:
 
 
 private:
-  typedef std::map<Ipv4Address, GlobalRoutingLSA*> LSDBMap_t;
-  typedef std::pair<Ipv4Address, GlobalRoutingLSA*> LSDBPair_t;
+  typedef std::map<Ipv4Address, uint32_t> LSDBMap_t;
+  typedef std::pair<Ipv4Address, uint32_t> LSDBPair_t;
 
+  // the indexes in m_lsas, by link state ID and by transit link data
   LSDBMap_t m_database;
+  LSDBMap_t m_linkData;
+  std::vector<GlobalRoutingLSA*> m_lsas;
+  // the number of link records before each LSA of m_lsas
+  std::vector<uint32_t> m_offsets;
+  uint32_t m_nLinkRecords;
   std::vector<GlobalRoutingLSA*> m_extdatabase;
 
 /**
@@ -695,6 +759,13 @@ private:
  * Then, it can compute shortest paths on a per-node basis to all routers, 
  * and finally configure each of the node's forwarding tables.
  *
+ * The SPF calculations of the different roots only read the LSDB, and
+ * record the routes they find instead of installing them: they are
+ * spread over the number of threads given by the "GlobalRoutingThreads"
+ * global value, and the routes are then installed in the order of the
+ * roots, so that the forwarding tables do not depend on the number of
+ * threads.
+ *
  * The design is guided by OSPFv2 RFC 2328 section 16.1.1 and quagga ospfd.
  */
 class GlobalRouteManagerImpl
@@ -727,6 +798,15 @@ public:
  */
   virtual void InitializeRoutes ();
 
+/**
+ * @brief Rebuild the routing database and update the per-node forwarding
+ * tables after a change of the topology
+ * @internal
+ *
+ * @see GlobalRouteManager::UpdateRoutes
+ */
+  virtual void UpdateRoutes ();
+
 /**
  * @brief Debugging routine; allow client code to supply a pre-built LSDB
  * @internal
@@ -754,8 +834,83 @@ private:
  */
   GlobalRouteManagerImpl& operator= (GlobalRouteManagerImpl& srmi);
 
+/**
+ * @brief Construct a worker for the SPF calculations of a manager, which
+ * shares its LSDB and its routers.
+ * @internal
+ */
+  GlobalRouteManagerImpl (GlobalRouteManagerImpl *manager);
+
+  // a route found by an SPF calculation, for the router at its root
+  struct Route
+  {
+    enum Type { HOST, NETWORK, EXTERNAL } type;
+    Ipv4Address dest;
+    Ipv4Mask mask;
+    Ipv4Address nextHop;
+    uint32_t outIf;
+  };
+  // the objects of a node that the SPF calculation rooted at it uses
+  struct Router
+  {
+    Ptr<Ipv4> ipv4;
+    Ptr<Ipv4GlobalRouting> routing;
+  };
+  // what an update needs to know about the last SPF calculation of a root
+  struct RootState
+  {
+    // whether the root only has a default route, through its neighbor
+    bool stub;
+    Ipv4Address neighbor;
+    // by link record offset, whether the point-to-point record is on a
+    // shortest path from the root
+    std::vector<bool> tight;
+  };
+  // the roots of a worker: every step-th root from first to end
+  struct Job
+  {
+    GlobalRouteManagerImpl *worker;
+    const std::vector<Ipv4Address> *roots;
+    uint32_t first;
+    uint32_t end;
+    uint32_t step;
+    std::vector<std::vector<Route> > *routes;
+    std::vector<RootState> *states;
+  };
+
+  static void RunJob (Job *job);
+  static void DeleteRoutes (Ptr<Ipv4GlobalRouting> gr);
+  static void InstallRoutes (Ptr<Ipv4GlobalRouting> gr, const std::vector<Route> &routes);
+  static uint32_t GetNThreads (void);
+  void BuildGlobalRoutingDatabase (GlobalRouteManagerLSDB *lsdb);
+  void BuildRouterMap (void);
+  std::vector<Ipv4Address> GetRoots (void) const;
+  void ComputeRoutes (const std::vector<Ipv4Address> &roots);
+  bool PatchRoutes (Ipv4Address root, Ptr<Ipv4GlobalRouting> gr,
+                    GlobalRouteManagerLSDB *lsdb,
+                    const std::vector<std::vector<uint32_t> > &removedRecords);
+  void AddRoute (Route::Type type, Ipv4Address dest, Ipv4Mask mask,
+                 Ipv4Address nextHop, uint32_t outIf);
+  void RecordTightLinks (void);
+
   SPFVertex* m_spfroot;
   GlobalRouteManagerLSDB* m_lsdb;
+  // the manager of a worker, 0 for the manager itself
+  GlobalRouteManagerImpl* m_manager;
+  // by router ID, the routers of the nodes of this system
+  std::map<Ipv4Address, Router> m_routers;
+  // by router ID, the roots whose routes were installed
+  std::map<Ipv4Address, RootState> m_states;
+
+  // the state of the current SPF calculation: the root, the routes found,
+  // and by LSA index, the status, candidate vertex and distance
+  const Router* m_root;
+  std::vector<Route> m_routes;
+  RootState m_state;
+  std::vector<GlobalRoutingLSA::SPFStatus> m_status;
+  std::vector<SPFVertex*> m_candidates;
+  std::vector<uint32_t> m_distances;
+
   bool CheckForStubNode (Ipv4Address root);
   void SPFCalculate (Ipv4Address root);
   void SPFProcessStubs (SPFVertex* v);
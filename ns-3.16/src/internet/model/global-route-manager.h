@@ -67,6 +67,21 @@ public:
  */
   static void InitializeRoutes ();
 
+/**
+ * @brief Bring the per-node forwarding tables up to date with the current
+ * topology, after links went down or up.
+ *
+ * The routing database is rebuilt and compared with the previous one.  If
+ * only point-to-point links were removed, the SPF calculation is run again
+ * only for the routers whose shortest path tree used one of them, and the
+ * routes of the other routers to the removed interfaces are deleted in
+ * place.  Otherwise, or if no routes were computed yet, this is the same as
+ * DeleteGlobalRoutes (), BuildGlobalRoutingDatabase () and
+ * InitializeRoutes ().
+ * @internal
+ */
+  static void UpdateRoutes ();
+
 private:
 /**
  * @brief Global Route Manager copy construction is disallowed.  There's no 
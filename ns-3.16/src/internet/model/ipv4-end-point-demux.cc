@@ -26,8 +26,31 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("Ipv4EndPointDemux");
 
+bool
+Ipv4EndPointDemux::Key::operator== (const Key &other) const
+{
+  return localPort == other.localPort && peerPort == other.peerPort &&
+         localAddress == other.localAddress && peerAddress == other.peerAddress;
+}
+
+size_t
+Ipv4EndPointDemux::KeyHash::operator() (const Key &key) const
+{
+  size_t h = key.localAddress.Get ();
+  h = h * 31 + key.peerAddress.Get ();
+  h = h * 31 + key.localPort;
+  h = h * 31 + key.peerPort;
+  return h;
+}
+
+size_t
+Ipv4EndPointDemux::EndPointHash::operator() (const Ipv4EndPoint *endPoint) const
+{
+  return reinterpret_cast<size_t> (endPoint) / sizeof (void *);
+}
+
 Ipv4EndPointDemux::Ipv4EndPointDemux ()
-  : m_ephemeral (49152), m_portLast (65535), m_portFirst (49152)
+  : m_ephemeral (49152), m_portLast (65535), m_portFirst (49152), m_serial (0)
 {
   NS_LOG_FUNCTION_NOARGS ();
 }
@@ -38,33 +61,34 @@ Ipv4EndPointDemux::~Ipv4EndPointDemux ()
   for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
     {
       Ipv4EndPoint *endPoint = *i;
+      endPoint->m_demux = 0;
       delete endPoint;
     }
   m_endPoints.clear ();
+  m_connections.clear ();
+  m_ports.clear ();
+  m_entries.clear ();
 }
 
 bool
 Ipv4EndPointDemux::LookupPortLocal (uint16_t port)
 {
   NS_LOG_FUNCTION_NOARGS ();
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
-    {
-      if ((*i)->GetLocalPort  () == port) 
-        {
-          return true;
-        }
-    }
-  return false;
+  return m_ports.find (port) != m_ports.end ();
 }
 
 bool
 Ipv4EndPointDemux::LookupLocal (Ipv4Address addr, uint16_t port)
 {
   NS_LOG_FUNCTION_NOARGS ();
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  Ports::iterator p = m_ports.find (port);
+  if (p == m_ports.end ())
+    {
+      return false;
+    }
+  for (EndPointsI i = p->second.endPoints.begin (); i != p->second.endPoints.end (); i++) 
     {
-      if ((*i)->GetLocalPort () == port &&
-          (*i)->GetLocalAddress () == addr) 
+      if ((*i)->GetLocalAddress () == addr) 
         {
           return true;
         }
@@ -82,10 +106,7 @@ Ipv4EndPointDemux::Allocate (void)
       NS_LOG_WARN ("Ephemeral port allocation failed.");
       return 0;
     }
-  Ipv4EndPoint *endPoint = new Ipv4EndPoint (Ipv4Address::GetAny (), port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
-  return endPoint;
+  return Insert (new Ipv4EndPoint (Ipv4Address::GetAny (), port));
 }
 
 Ipv4EndPoint *
@@ -98,10 +119,7 @@ Ipv4EndPointDemux::Allocate (Ipv4Address address)
       NS_LOG_WARN ("Ephemeral port allocation failed.");
       return 0;
     }
-  Ipv4EndPoint *endPoint = new Ipv4EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
-  return endPoint;
+  return Insert (new Ipv4EndPoint (address, port));
 }
 
 Ipv4EndPoint *
@@ -121,10 +139,7 @@ Ipv4EndPointDemux::Allocate (Ipv4Address address, uint16_t port)
       NS_LOG_WARN ("Duplicate address/port; failing.");
       return 0;
     }
-  Ipv4EndPoint *endPoint = new Ipv4EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
-  return endPoint;
+  return Insert (new Ipv4EndPoint (address, port));
 }
 
 Ipv4EndPoint *
@@ -132,40 +147,52 @@ Ipv4EndPointDemux::Allocate (Ipv4Address localAddress, uint16_t localPort,
                              Ipv4Address peerAddress, uint16_t peerPort)
 {
   NS_LOG_FUNCTION (this << localAddress << localPort << peerAddress << peerPort);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  Key key;
+  key.localAddress = localAddress;
+  key.peerAddress = peerAddress;
+  key.localPort = localPort;
+  key.peerPort = peerPort;
+  bool exists = (m_connections.find (key) != m_connections.end ());
+  Ports::iterator p = m_ports.find (localPort);
+  if (!exists && p != m_ports.end ())
     {
-      if ((*i)->GetLocalPort () == localPort &&
-          (*i)->GetLocalAddress () == localAddress &&
-          (*i)->GetPeerPort () == peerPort &&
-          (*i)->GetPeerAddress () == peerAddress) 
+      // an endpoint with a wildcard is a listener
+      for (EndPointsI i = p->second.listeners.begin (); i != p->second.listeners.end (); i++) 
         {
-          NS_LOG_WARN ("No way we can allocate this end-point.");
-          /* no way we can allocate this end-point. */
-          return 0;
+          if ((*i)->GetLocalAddress () == localAddress &&
+              (*i)->GetPeerPort () == peerPort &&
+              (*i)->GetPeerAddress () == peerAddress) 
+            {
+              exists = true;
+              break;
+            }
         }
     }
+  if (exists)
+    {
+      NS_LOG_WARN ("No way we can allocate this end-point.");
+      /* no way we can allocate this end-point. */
+      return 0;
+    }
   Ipv4EndPoint *endPoint = new Ipv4EndPoint (localAddress, localPort);
   endPoint->SetPeer (peerAddress, peerPort);
-  m_endPoints.push_back (endPoint);
-
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
-
-  return endPoint;
+  return Insert (endPoint);
 }
 
 void 
 Ipv4EndPointDemux::DeAllocate (Ipv4EndPoint *endPoint)
 {
   NS_LOG_FUNCTION_NOARGS ();
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  Entries::iterator e = m_entries.find (endPoint);
+  if (e == m_entries.end ())
     {
-      if (*i == endPoint)
-        {
-          delete endPoint;
-          m_endPoints.erase (i);
-          break;
-        }
+      return;
     }
+  Unindex (e->second);
+  m_endPoints.erase (e->second.all);
+  m_entries.erase (e);
+  endPoint->m_demux = 0;
+  delete endPoint;
 }
 
 /*
@@ -204,21 +231,61 @@ Ipv4EndPointDemux::Lookup (Ipv4Address daddr, uint16_t dport,
 
   NS_LOG_FUNCTION (this << daddr << dport << saddr << sport << incomingInterface);
   NS_LOG_DEBUG ("Looking up endpoint for destination address " << daddr);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  Ports::iterator p = m_ports.find (dport);
+  if (p == m_ports.end ())
+    {
+      NS_LOG_LOGIC ("No endpoint on port " << dport);
+      return retval1;
+    }
+
+  bool subnetDirected = false;
+  Ipv4Address incomingInterfaceAddr = daddr;  // may be a broadcast
+  for (uint32_t i = 0; i < incomingInterface->GetNAddresses (); i++)
+    {
+      Ipv4InterfaceAddress addr = incomingInterface->GetAddress (i);
+      if (addr.GetLocal ().CombineMask (addr.GetMask ()) == daddr.CombineMask (addr.GetMask ()) &&
+          daddr.IsSubnetDirectedBroadcast (addr.GetMask ()))
+        {
+          subnetDirected = true;
+          incomingInterfaceAddr = addr.GetLocal ();
+        }
+    }
+  bool isBroadcast = (daddr.IsBroadcast () || subnetDirected == true);
+  NS_LOG_DEBUG ("dest addr " << daddr << " broadcast? " << isBroadcast);
+
+  // A connected endpoint has no wildcard, it can only match all 4 exactly,
+  // against the interface address for a subnet directed broadcast
+  Key key;
+  key.localAddress = incomingInterfaceAddr;
+  key.peerAddress = saddr;
+  key.localPort = dport;
+  key.peerPort = sport;
+  Connections::iterator c = m_connections.find (key);
+  if (c != m_connections.end ())
+    {
+      for (EndPointsI i = c->second.begin (); i != c->second.end (); i++)
+        {
+          Ipv4EndPoint* endP = *i;
+          if (endP->GetBoundNetDevice () && endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
+            {
+              NS_LOG_LOGIC ("Skipping endpoint " << &endP
+                                                 << " because endpoint is bound to specific device and"
+                                                 << endP->GetBoundNetDevice ()
+                                                 << " does not match packet device " << incomingInterface->GetDevice ());
+              continue;
+            }
+          retval4.push_back (endP);
+        }
+    }
+
+  EndPoints listeners4;
+  for (EndPointsI i = p->second.listeners.begin (); i != p->second.listeners.end (); i++) 
     {
       Ipv4EndPoint* endP = *i;
       NS_LOG_DEBUG ("Looking at endpoint dport=" << endP->GetLocalPort ()
                                                  << " daddr=" << endP->GetLocalAddress ()
                                                  << " sport=" << endP->GetPeerPort ()
                                                  << " saddr=" << endP->GetPeerAddress ());
-      if (endP->GetLocalPort () != dport) 
-        {
-          NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                                             << " because endpoint dport "
-                                             << endP->GetLocalPort ()
-                                             << " does not match packet dport " << dport);
-          continue;
-        }
       if (endP->GetBoundNetDevice ())
         {
           if (endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
@@ -230,20 +297,6 @@ Ipv4EndPointDemux::Lookup (Ipv4Address daddr, uint16_t dport,
               continue;
             }
         }
-      bool subnetDirected = false;
-      Ipv4Address incomingInterfaceAddr = daddr;  // may be a broadcast
-      for (uint32_t i = 0; i < incomingInterface->GetNAddresses (); i++)
-        {
-          Ipv4InterfaceAddress addr = incomingInterface->GetAddress (i);
-          if (addr.GetLocal ().CombineMask (addr.GetMask ()) == daddr.CombineMask (addr.GetMask ()) &&
-              daddr.IsSubnetDirectedBroadcast (addr.GetMask ()))
-            {
-              subnetDirected = true;
-              incomingInterfaceAddr = addr.GetLocal ();
-            }
-        }
-      bool isBroadcast = (daddr.IsBroadcast () || subnetDirected == true);
-      NS_LOG_DEBUG ("dest addr " << daddr << " broadcast? " << isBroadcast);
       bool localAddressMatchesWildCard = 
         endP->GetLocalAddress () == Ipv4Address::GetAny ();
       bool localAddressMatchesExact = endP->GetLocalAddress () == daddr;
@@ -296,9 +349,13 @@ Ipv4EndPointDemux::Lookup (Ipv4Address daddr, uint16_t dport,
           remotePeerMatchesExact &&
           remoteAddressMatchesExact)
         { // All 4 match
-          retval4.push_back (endP);
+          listeners4.push_back (endP);
         }
     }
+  if (!listeners4.empty ())
+    {
+      retval4 = MergeInOrder (retval4, listeners4);
+    }
 
   // Here we find the most exact match
   if (!retval4.empty ()) return retval4;
@@ -317,12 +374,13 @@ Ipv4EndPointDemux::SimpleLookup (Ipv4Address daddr,
   // function.
   uint32_t genericity = 3;
   Ipv4EndPoint *generic = 0;
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  Ports::iterator p = m_ports.find (dport);
+  if (p == m_ports.end ())
+    {
+      return 0;
+    }
+  for (EndPointsI i = p->second.endPoints.begin (); i != p->second.endPoints.end (); i++) 
     {
-      if ((*i)->GetLocalPort () != dport) 
-        {
-          continue;
-        }
       if ((*i)->GetLocalAddress () == daddr &&
           (*i)->GetPeerPort () == sport &&
           (*i)->GetPeerAddress () == saddr) 
@@ -370,5 +428,113 @@ Ipv4EndPointDemux::AllocateEphemeralPort (void)
   return port;
 }
 
-} // namespace ns3
+Ipv4EndPoint *
+Ipv4EndPointDemux::Insert (Ipv4EndPoint *endPoint)
+{
+  Entry &entry = m_entries[endPoint];
+  entry.serial = m_serial++;
+  entry.all = m_endPoints.insert (m_endPoints.end (), endPoint);
+  Index (endPoint, entry);
+  endPoint->m_demux = this;
+  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  return endPoint;
+}
+
+void
+Ipv4EndPointDemux::Index (Ipv4EndPoint *endPoint, Entry &entry)
+{
+  entry.key.localAddress = endPoint->GetLocalAddress ();
+  entry.key.peerAddress = endPoint->GetPeerAddress ();
+  entry.key.localPort = endPoint->GetLocalPort ();
+  entry.key.peerPort = endPoint->GetPeerPort ();
+  entry.connected = entry.key.localAddress != Ipv4Address::GetAny () &&
+    entry.key.peerAddress != Ipv4Address::GetAny () &&
+    entry.key.peerPort != 0;
+
+  Port &port = m_ports[entry.key.localPort];
+  entry.port = InsertInOrder (port.endPoints, endPoint, entry.serial);
+  if (entry.connected)
+    {
+      entry.index = InsertInOrder (m_connections[entry.key], endPoint, entry.serial);
+    }
+  else
+    {
+      entry.index = InsertInOrder (port.listeners, endPoint, entry.serial);
+    }
+}
+
+void
+Ipv4EndPointDemux::Unindex (Entry &entry)
+{
+  Ports::iterator p = m_ports.find (entry.key.localPort);
+  NS_ASSERT (p != m_ports.end ());
+  p->second.endPoints.erase (entry.port);
+  if (entry.connected)
+    {
+      Connections::iterator c = m_connections.find (entry.key);
+      NS_ASSERT (c != m_connections.end ());
+      c->second.erase (entry.index);
+      if (c->second.empty ())
+        {
+          m_connections.erase (c);
+        }
+    }
+  else
+    {
+      p->second.listeners.erase (entry.index);
+    }
+  if (p->second.endPoints.empty ())
+    {
+      m_ports.erase (p);
+    }
+}
+
+void
+Ipv4EndPointDemux::Reindex (Ipv4EndPoint *endPoint)
+{
+  Entries::iterator e = m_entries.find (endPoint);
+  NS_ASSERT (e != m_entries.end ());
+  Unindex (e->second);
+  Index (endPoint, e->second);
+}
 
+// keeps the lists in allocation order; endpoints are nearly always
+// inserted at the end
+Ipv4EndPointDemux::EndPointsI
+Ipv4EndPointDemux::InsertInOrder (EndPoints &endPoints, Ipv4EndPoint *endPoint, uint64_t serial)
+{
+  EndPointsI i = endPoints.end ();
+  while (i != endPoints.begin ())
+    {
+      EndPointsI prev = i;
+      prev--;
+      if (m_entries[*prev].serial < serial)
+        {
+          break;
+        }
+      i = prev;
+    }
+  return endPoints.insert (i, endPoint);
+}
+
+Ipv4EndPointDemux::EndPoints
+Ipv4EndPointDemux::MergeInOrder (const EndPoints &a, const EndPoints &b)
+{
+  EndPoints merged;
+  std::list<Ipv4EndPoint *>::const_iterator i = a.begin ();
+  std::list<Ipv4EndPoint *>::const_iterator j = b.begin ();
+  while (i != a.end () || j != b.end ())
+    {
+      if (j == b.end () || (i != a.end () && m_entries[*i].serial < m_entries[*j].serial))
+        {
+          merged.push_back (*i++);
+        }
+      else
+        {
+          merged.push_back (*j++);
+        }
+    }
+  return merged;
+}
+
+} // namespace ns3
@@ -24,6 +24,7 @@
 #include <stdint.h>
 #include <list>
 #include "ns3/ipv4-address.h"
+#include "ns3/sgi-hashmap.h"
 #include "ipv4-interface.h"
 
 namespace ns3 {
@@ -38,6 +39,12 @@ class Ipv4EndPoint;
  * of endpoints, and has APIs to add and find endpoints in this demux.  This
  * code is shared in common to TCP and UDP protocols in ns3.  This demux
  * sits between ns3's layer four and the socket layer
+ *
+ * Endpoints are hashed on their local port, and connected endpoints (both
+ * addresses and the peer port set) on their full four-tuple, so a lookup
+ * only looks at the listeners of the destination port and at the exact
+ * match. Results, including their order, are those of a scan of the
+ * endpoints in allocation order.
  */
 
 class Ipv4EndPointDemux {
@@ -74,12 +81,68 @@ public:
   void DeAllocate (Ipv4EndPoint *endPoint);
 
 private:
+  friend class Ipv4EndPoint;
+
+  /**
+   * The four-tuple an endpoint is indexed under.
+   */
+  struct Key
+  {
+    Ipv4Address localAddress;
+    Ipv4Address peerAddress;
+    uint16_t localPort;
+    uint16_t peerPort;
+    bool operator== (const Key &other) const;
+  };
+  struct KeyHash
+  {
+    size_t operator() (const Key &key) const;
+  };
+  struct EndPointHash
+  {
+    size_t operator() (const Ipv4EndPoint *endPoint) const;
+  };
+  /**
+   * Where an endpoint is indexed, so that it can be unlinked when it is
+   * deallocated or when its four-tuple changes.
+   */
+  struct Entry
+  {
+    uint64_t serial;         // allocation order
+    Key key;
+    bool connected;          // in m_connections rather than a listener list
+    EndPointsI all;          // position in m_endPoints
+    EndPointsI port;         // position in the endpoints of its local port
+    EndPointsI index;        // position in its connection or listener list
+  };
+  struct Port
+  {
+    EndPoints endPoints;     // every endpoint of the port
+    EndPoints listeners;     // the ones with a wildcard
+  };
+  typedef sgi::hash_map<Key, EndPoints, KeyHash> Connections;
+  typedef sgi::hash_map<uint16_t, Port> Ports;
+  typedef sgi::hash_map<const Ipv4EndPoint *, Entry, EndPointHash> Entries;
+
   uint16_t AllocateEphemeralPort (void);
+  Ipv4EndPoint *Insert (Ipv4EndPoint *endPoint);
+  void Index (Ipv4EndPoint *endPoint, Entry &entry);
+  void Unindex (Entry &entry);
+  /**
+   * Called by an endpoint whose addresses or ports changed.
+   */
+  void Reindex (Ipv4EndPoint *endPoint);
+  EndPointsI InsertInOrder (EndPoints &endPoints, Ipv4EndPoint *endPoint, uint64_t serial);
+  EndPoints MergeInOrder (const EndPoints &a, const EndPoints &b);
 
   uint16_t m_ephemeral;
   uint16_t m_portLast;
   uint16_t m_portFirst;
-  EndPoints m_endPoints;
+  EndPoints m_endPoints;      // all endpoints, in allocation order
+  Connections m_connections;
+  Ports m_ports;
+  Entries m_entries;
+  uint64_t m_serial;
 };
 
 } // namespace ns3
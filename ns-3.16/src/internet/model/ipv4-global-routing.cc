@@ -73,7 +73,8 @@ Ipv4GlobalRouting::GetTypeId (void)
 Ipv4GlobalRouting::Ipv4GlobalRouting () 
   : m_randomEcmpRouting (false),
     m_flowEcmpRouting (false),
-    m_respondToInterfaceEvents (false)
+    m_respondToInterfaceEvents (false),
+    m_triesValid (true)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
@@ -94,6 +95,10 @@ Ipv4GlobalRouting::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, nextHop, interface);
   m_hostRoutes.push_back (route);
+  if (m_triesValid)
+    {
+      m_hostTrie.Insert (dest, Ipv4Mask::GetOnes (), route);
+    }
 }
 
 void 
@@ -104,6 +109,10 @@ Ipv4GlobalRouting::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, interface);
   m_hostRoutes.push_back (route);
+  if (m_triesValid)
+    {
+      m_hostTrie.Insert (dest, Ipv4Mask::GetOnes (), route);
+    }
 }
 
 void 
@@ -119,6 +128,10 @@ Ipv4GlobalRouting::AddNetworkRouteTo (Ipv4Address network,
                                                         nextHop,
                                                         interface);
   m_networkRoutes.push_back (route);
+  if (m_triesValid)
+    {
+      m_networkTrie.Insert (network, networkMask, route);
+    }
 }
 
 void 
@@ -132,6 +145,10 @@ Ipv4GlobalRouting::AddNetworkRouteTo (Ipv4Address network,
                                                         networkMask,
                                                         interface);
   m_networkRoutes.push_back (route);
+  if (m_triesValid)
+    {
+      m_networkTrie.Insert (network, networkMask, route);
+    }
 }
 
 void 
@@ -208,62 +225,122 @@ Ipv4GlobalRouting::GetTupleValue (const Ipv4Header &header, Ptr<const Packet> ip
   return tupleValue;
 }
 
+Ipv4RoutingTableEntry *
+Ipv4GlobalRouting::SelectRoute (const Ipv4RouteTrie::Routes &routes, Ptr<NetDevice> oif,
+                                const Ipv4Header &header, Ptr<const Packet> ipPayload)
+{
+  uint32_t nRoutes = routes.size ();
+  if (oif != 0)
+    {
+      nRoutes = 0;
+      for (uint32_t i = 0; i < routes.size (); i++)
+        {
+          if (oif == m_ipv4->GetNetDevice (routes[i]->GetInterface ()))
+            {
+              nRoutes++;
+            }
+        }
+      if (nRoutes == 0)
+        {
+          NS_LOG_LOGIC ("Not on requested interface, skipping");
+          return 0;
+        }
+    }
+  // select one of the routes uniformly at random if random
+  // ECMP routing is enabled, or map a flow consistently to a route
+  // if flow ECMP routing is enabled, or otherwise always select the 
+  // first route
+  uint32_t selectIndex;
+  if (m_randomEcmpRouting)
+    {
+      selectIndex = m_rand->GetInteger (0, nRoutes-1);
+    }
+  else  if (m_flowEcmpRouting && (nRoutes > 1))
+    {
+      selectIndex = GetTupleValue (header, ipPayload) % nRoutes;
+    }
+  else
+    {
+      selectIndex = 0;
+    }
+  if (oif == 0)
+    {
+      return routes[selectIndex];
+    }
+  for (uint32_t i = 0; i < routes.size (); i++)
+    {
+      if (oif == m_ipv4->GetNetDevice (routes[i]->GetInterface ()) && selectIndex-- == 0)
+        {
+          return routes[i];
+        }
+    }
+  NS_ASSERT (false);
+  return 0;
+}
+
+void
+Ipv4GlobalRouting::BuildTries (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_hostTrie.Clear ();
+  m_networkTrie.Clear ();
+  for (HostRoutesCI i = m_hostRoutes.begin (); 
+       i != m_hostRoutes.end (); 
+       i++) 
+    {
+      m_hostTrie.Insert ((*i)->GetDest (), Ipv4Mask::GetOnes (), *i);
+    }
+  for (NetworkRoutesCI j = m_networkRoutes.begin (); 
+       j != m_networkRoutes.end (); 
+       j++) 
+    {
+      m_networkTrie.Insert ((*j)->GetDestNetwork (), (*j)->GetDestNetworkMask (), *j);
+    }
+  m_triesValid = true;
+}
+
 Ptr<Ipv4Route>
 Ipv4GlobalRouting::LookupGlobal (const Ipv4Header &header, Ptr<const Packet> ipPayload, Ptr<NetDevice> oif)
 {
   NS_LOG_FUNCTION_NOARGS ();
   NS_ABORT_MSG_IF (m_randomEcmpRouting && m_flowEcmpRouting, "Ecmp mode selection");
   NS_LOG_LOGIC ("Looking for route for destination " << header.GetDestination());
-  Ptr<Ipv4Route> rtentry = 0;
-  // store all available routes that bring packets to their destination
-  typedef std::vector<Ipv4RoutingTableEntry*> RouteVec_t;
-  RouteVec_t allRoutes;
+  if (!m_triesValid)
+    {
+      BuildTries ();
+    }
+  Ipv4RoutingTableEntry *route = 0;
 
-  NS_LOG_LOGIC ("Number of m_hostRoutes = " << m_hostRoutes.size ());
-  for (HostRoutesCI i = m_hostRoutes.begin (); 
-       i != m_hostRoutes.end (); 
-       i++) 
+  // host routes first, then the network routes of the longest matching
+  // prefix; with an output device, the first of those with a route
+  // through it
+  if (oif == 0)
     {
-      NS_ASSERT ((*i)->IsHost ());
-      if ((*i)->GetDest ().IsEqual (header.GetDestination ())) 
+      const Ipv4RouteTrie::Routes *routes = m_hostTrie.Lookup (header.GetDestination ());
+      if (routes == 0)
         {
-          if (oif != 0)
-            {
-              if (oif != m_ipv4->GetNetDevice ((*i)->GetInterface ()))
-                {
-                  NS_LOG_LOGIC ("Not on requested interface, skipping");
-                  continue;
-                }
-            }
-          allRoutes.push_back (*i);
-          NS_LOG_LOGIC (allRoutes.size () << "Found global host route" << *i); 
+          routes = m_networkTrie.Lookup (header.GetDestination ());
+        }
+      if (routes != 0)
+        {
+          route = SelectRoute (*routes, oif, header, ipPayload);
         }
     }
-  if (allRoutes.size () == 0) // if no host route is found
+  else
     {
-      NS_LOG_LOGIC ("Number of m_networkRoutes" << m_networkRoutes.size ());
-      for (NetworkRoutesI j = m_networkRoutes.begin (); 
-           j != m_networkRoutes.end (); 
-           j++) 
+      const Ipv4RouteTrie::Routes *matches[Ipv4RouteTrie::MAX_MATCHES];
+      uint32_t nMatches = m_hostTrie.LookupAll (header.GetDestination (), matches);
+      for (uint32_t i = 0; i < nMatches && route == 0; i++)
         {
-          Ipv4Mask mask = (*j)->GetDestNetworkMask ();
-          Ipv4Address entry = (*j)->GetDestNetwork ();
-          if (mask.IsMatch (header.GetDestination (), entry)) 
-            {
-              if (oif != 0)
-                {
-                  if (oif != m_ipv4->GetNetDevice ((*j)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
-                }
-              allRoutes.push_back (*j);
-              NS_LOG_LOGIC (allRoutes.size () << "Found global network route" << *j);
-            }
+          route = SelectRoute (*matches[i], oif, header, ipPayload);
+        }
+      nMatches = route == 0 ? m_networkTrie.LookupAll (header.GetDestination (), matches) : 0;
+      for (uint32_t i = 0; i < nMatches && route == 0; i++)
+        {
+          route = SelectRoute (*matches[i], oif, header, ipPayload);
         }
     }
-  if (allRoutes.size () == 0)  // consider external if no host/network found
+  if (route == 0)  // consider external if no host/network found
     {
       for (ASExternalRoutesI k = m_ASexternalRoutes.begin ();
            k != m_ASexternalRoutes.end ();
@@ -274,41 +351,19 @@ Ipv4GlobalRouting::LookupGlobal (const Ipv4Header &header, Ptr<const Packet> ipP
           if (mask.IsMatch (header.GetDestination (), entry))
             {
               NS_LOG_LOGIC ("Found external route" << *k);
-              if (oif != 0)
+              route = SelectRoute (Ipv4RouteTrie::Routes (1, *k), oif, header, ipPayload);
+              if (route != 0)
                 {
-                  if (oif != m_ipv4->GetNetDevice ((*k)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
+                  break;
                 }
-              allRoutes.push_back (*k);
-              break;
             }
         }
     }
-  if (allRoutes.size () > 0 ) // if route(s) is found
+  if (route != 0) // if route is found
     {
-      // select one of the routes uniformly at random if random
-      // ECMP routing is enabled, or map a flow consistently to a route
-      // if flow ECMP routing is enabled, or otherwise always select the 
-      // first route
-      uint32_t selectIndex;
-      if (m_randomEcmpRouting)
-        {
-          selectIndex = m_rand->GetInteger (0, allRoutes.size ()-1);
-        }
-      else  if (m_flowEcmpRouting && (allRoutes.size () > 1))
-        {
-          selectIndex = GetTupleValue (header, ipPayload) % allRoutes.size ();
-        }
-      else
-        {
-          selectIndex = 0;
-        }
-      Ipv4RoutingTableEntry* route = allRoutes.at (selectIndex); 
+      NS_LOG_LOGIC ("Found global route" << *route);
       // create a Ipv4Route object from the selected routing table entry
-      rtentry = Create<Ipv4Route> ();
+      Ptr<Ipv4Route> rtentry = Create<Ipv4Route> ();
       rtentry->SetDestination (route->GetDest ());
       // XXX handle multi-address case
       rtentry->SetSource (m_ipv4->GetAddress (route->GetInterface (), 0).GetLocal ());
@@ -399,6 +454,7 @@ Ipv4GlobalRouting::RemoveRoute (uint32_t index)
               NS_LOG_LOGIC ("Removing route " << index << "; size = " << m_hostRoutes.size ());
               delete *i;
               m_hostRoutes.erase (i);
+              m_triesValid = false;
               NS_LOG_LOGIC ("Done removing host route " << index << "; host route remaining size = " << m_hostRoutes.size ());
               return;
             }
@@ -416,6 +472,7 @@ Ipv4GlobalRouting::RemoveRoute (uint32_t index)
           NS_LOG_LOGIC ("Removing route " << index << "; size = " << m_networkRoutes.size ());
           delete *j;
           m_networkRoutes.erase (j);
+          m_triesValid = false;
           NS_LOG_LOGIC ("Done removing network route " << index << "; network route remaining size = " << m_networkRoutes.size ());
           return;
         }
@@ -440,6 +497,66 @@ Ipv4GlobalRouting::RemoveRoute (uint32_t index)
   NS_ASSERT (false);
 }
 
+std::vector<Ipv4RoutingTableEntry>
+Ipv4GlobalRouting::GetHostRoutesTo (Ipv4Address dest) const
+{
+  NS_LOG_FUNCTION (dest);
+  std::vector<Ipv4RoutingTableEntry> routes;
+  for (HostRoutesCI i = m_hostRoutes.begin ();
+       i != m_hostRoutes.end ();
+       i++)
+    {
+      if ((*i)->GetDest () == dest)
+        {
+          routes.push_back (**i);
+        }
+    }
+  return routes;
+}
+
+void
+Ipv4GlobalRouting::RemoveHostRoutesTo (Ipv4Address dest)
+{
+  NS_LOG_FUNCTION (dest);
+  for (HostRoutesI i = m_hostRoutes.begin ();
+       i != m_hostRoutes.end (); )
+    {
+      if ((*i)->GetDest () == dest)
+        {
+          delete *i;
+          i = m_hostRoutes.erase (i);
+          m_triesValid = false;
+        }
+      else
+        {
+          i++;
+        }
+    }
+}
+
+bool
+Ipv4GlobalRouting::RemoveNetworkRouteTo (Ipv4Address network,
+                                         Ipv4Mask networkMask,
+                                         Ipv4Address nextHop,
+                                         uint32_t interface)
+{
+  NS_LOG_FUNCTION (network << networkMask << nextHop << interface);
+  for (NetworkRoutesI j = m_networkRoutes.begin ();
+       j != m_networkRoutes.end ();
+       j++)
+    {
+      if ((*j)->GetDestNetwork () == network && (*j)->GetDestNetworkMask () == networkMask
+          && (*j)->GetGateway () == nextHop && (*j)->GetInterface () == interface)
+        {
+          delete *j;
+          m_networkRoutes.erase (j);
+          m_triesValid = false;
+          return true;
+        }
+    }
+  return false;
+}
+
 int64_t
 Ipv4GlobalRouting::AssignStreams (int64_t stream)
 {
@@ -470,6 +587,8 @@ Ipv4GlobalRouting::DoDispose (void)
     {
       delete (*l);
     }
+  m_hostTrie.Clear ();
+  m_networkTrie.Clear ();
 
   Ipv4RoutingProtocol::DoDispose ();
 }
@@ -638,9 +757,7 @@ Ipv4GlobalRouting::NotifyInterfaceUp (uint32_t i)
   NS_LOG_FUNCTION (this << i);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      GlobalRouteManager::UpdateRoutes ();
     }
 }
 
@@ -650,9 +767,7 @@ Ipv4GlobalRouting::NotifyInterfaceDown (uint32_t i)
   NS_LOG_FUNCTION (this << i);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      GlobalRouteManager::UpdateRoutes ();
     }
 }
 
@@ -662,9 +777,7 @@ Ipv4GlobalRouting::NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress ad
   NS_LOG_FUNCTION (this << interface << address);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      GlobalRouteManager::UpdateRoutes ();
     }
 }
 
@@ -674,9 +787,7 @@ Ipv4GlobalRouting::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress
   NS_LOG_FUNCTION (this << interface << address);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      GlobalRouteManager::UpdateRoutes ();
     }
 }
 
@@ -21,12 +21,15 @@
 #define IPV4_GLOBAL_ROUTING_H
 
 #include <list>
+#include <vector>
 #include <stdint.h>
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-routing-protocol.h"
+#include "ns3/ipv4-routing-table-entry.h"
+#include "ns3/ipv4-route-trie.h"
 #include "ns3/random-variable-stream.h"
 
 namespace ns3 {
@@ -63,6 +66,13 @@ class Node;
  *
  * This class deals with Ipv4 unicast routes only.
  *
+ * The host and network routes are also indexed by longest prefix match
+ * tries (Ipv4RouteTrie), so that the cost of a lookup does not grow with
+ * the number of routes.  A destination with host routes uses them; other
+ * destinations use the network routes of the longest prefix that matches
+ * them.  Routes added are inserted in the tries as they
+ * come; removing routes rebuilds them at the next lookup.
+ *
  * \see Ipv4RoutingProtocol
  * \see GlobalRouteManager
  */
@@ -211,6 +221,35 @@ public:
  */
   void RemoveRoute (uint32_t i);
 
+/**
+ * \brief Get the host routes to a destination, in the order they were added.
+ *
+ * \param dest The Ipv4Address destination of the routes.
+ * \return copies of the host routes to dest, one for each equal cost path
+ */
+  std::vector<Ipv4RoutingTableEntry> GetHostRoutesTo (Ipv4Address dest) const;
+
+/**
+ * \brief Remove all the host routes to a destination.
+ *
+ * \param dest The Ipv4Address destination of the routes to remove.
+ */
+  void RemoveHostRoutesTo (Ipv4Address dest);
+
+/**
+ * \brief Remove the first network route that matches all of the arguments.
+ *
+ * \param network The Ipv4Address network of the route.
+ * \param networkMask The Ipv4Mask of the route.
+ * \param nextHop The next hop of the route.
+ * \param interface The network interface index of the route.
+ * \return true if a route was removed
+ */
+  bool RemoveNetworkRouteTo (Ipv4Address network,
+                             Ipv4Mask networkMask,
+                             Ipv4Address nextHop,
+                             uint32_t interface);
+
  /**
   * Assign a fixed random variable stream number to the random variables
   * used by this model.  Return the number of streams (possibly zero) that
@@ -247,11 +286,19 @@ private:
   uint32_t GetTupleValue (const Ipv4Header &header, Ptr<const Packet> ipPayload);
 
   Ptr<Ipv4Route> LookupGlobal (const Ipv4Header &header, Ptr<const Packet> ipPayload, Ptr<NetDevice> oif = 0);
+  Ipv4RoutingTableEntry *SelectRoute (const Ipv4RouteTrie::Routes &routes, Ptr<NetDevice> oif,
+                                      const Ipv4Header &header, Ptr<const Packet> ipPayload);
+  void BuildTries (void);
 
   HostRoutes m_hostRoutes;
   NetworkRoutes m_networkRoutes;
   ASExternalRoutes m_ASexternalRoutes; // External routes imported
 
+  Ipv4RouteTrie m_hostTrie;
+  Ipv4RouteTrie m_networkTrie;
+  /// false once routes were removed, until the tries are rebuilt
+  bool m_triesValid;
+
   Ptr<Ipv4> m_ipv4;
 };
 
@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ipv4-route-trie.h"
+
+NS_LOG_COMPONENT_DEFINE ("Ipv4RouteTrie");
+
+namespace ns3 {
+
+Ipv4RouteTrie::Ipv4RouteTrie ()
+{
+  NS_LOG_FUNCTION (this);
+  AddNode (0, 0);
+}
+
+uint32_t
+Ipv4RouteTrie::GetBit (uint32_t address, uint32_t index)
+{
+  return (address >> (31 - index)) & 1;
+}
+
+uint32_t
+Ipv4RouteTrie::GetMask (uint32_t length)
+{
+  return length == 0 ? 0 : 0xffffffff << (32 - length);
+}
+
+uint32_t
+Ipv4RouteTrie::AddNode (uint32_t prefix, uint32_t length)
+{
+  Node node;
+  node.prefix = prefix;
+  node.length = length;
+  node.child[0] = 0;
+  node.child[1] = 0;
+  node.routes = 0;
+  m_nodes.push_back (node);
+  return m_nodes.size () - 1;
+}
+
+void
+Ipv4RouteTrie::Insert (Ipv4Address network, Ipv4Mask mask, Ipv4RoutingTableEntry *route)
+{
+  NS_LOG_FUNCTION (this << network << mask << route);
+  uint32_t length = mask.GetPrefixLength ();
+  NS_ASSERT_MSG (mask.Get () == GetMask (length), "Ipv4RouteTrie::Insert (): non contiguous mask " << mask);
+  uint32_t key = network.Get () & GetMask (length);
+
+  // the prefix of node is always a prefix of key; the references into
+  // m_nodes are not kept across AddNode, which may move them
+  uint32_t node = 0;
+  while (m_nodes[node].length != length)
+    {
+      uint32_t bit = GetBit (key, m_nodes[node].length);
+      uint32_t next = m_nodes[node].child[bit];
+      if (next == 0)
+        {
+          uint32_t leaf = AddNode (key, length);
+          m_nodes[node].child[bit] = leaf;
+          node = leaf;
+          break;
+        }
+      uint32_t common = std::min (length, m_nodes[next].length);
+      uint32_t diff = (key ^ m_nodes[next].prefix) & GetMask (common);
+      if (diff == 0 && common == m_nodes[next].length)
+        {
+          node = next;
+          continue;
+        }
+      if (diff != 0)
+        {
+          common = 0;
+          while (GetBit (diff, common) == 0)
+            {
+              common++;
+            }
+        }
+      // key and the prefix of next diverge at bit common, or key ends there
+      uint32_t split = AddNode (key & GetMask (common), common);
+      m_nodes[split].child[GetBit (m_nodes[next].prefix, common)] = next;
+      m_nodes[node].child[bit] = split;
+      node = split;
+      if (common != length)
+        {
+          uint32_t leaf = AddNode (key, length);
+          m_nodes[split].child[GetBit (key, common)] = leaf;
+          node = leaf;
+        }
+      break;
+    }
+
+  if (m_nodes[node].routes == 0)
+    {
+      m_routes.push_back (Routes ());
+      m_nodes[node].routes = m_routes.size ();
+    }
+  m_routes[m_nodes[node].routes - 1].push_back (route);
+}
+
+void
+Ipv4RouteTrie::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_nodes.clear ();
+  m_routes.clear ();
+  AddNode (0, 0);
+}
+
+const Ipv4RouteTrie::Routes *
+Ipv4RouteTrie::Lookup (Ipv4Address dest) const
+{
+  uint32_t address = dest.Get ();
+  const Routes *best = 0;
+  uint32_t node = 0;
+  do
+    {
+      const Node &current = m_nodes[node];
+      if (((address ^ current.prefix) & GetMask (current.length)) != 0)
+        {
+          break;
+        }
+      if (current.routes != 0)
+        {
+          best = &m_routes[current.routes - 1];
+        }
+      if (current.length == 32)
+        {
+          break;
+        }
+      node = current.child[GetBit (address, current.length)];
+    }
+  while (node != 0);
+  return best;
+}
+
+uint32_t
+Ipv4RouteTrie::LookupAll (Ipv4Address dest, const Routes **matches) const
+{
+  uint32_t address = dest.Get ();
+  uint32_t n = 0;
+  uint32_t node = 0;
+  do
+    {
+      const Node &current = m_nodes[node];
+      if (((address ^ current.prefix) & GetMask (current.length)) != 0)
+        {
+          break;
+        }
+      if (current.routes != 0)
+        {
+          matches[n++] = &m_routes[current.routes - 1];
+        }
+      if (current.length == 32)
+        {
+          break;
+        }
+      node = current.child[GetBit (address, current.length)];
+    }
+  while (node != 0);
+  std::reverse (matches, matches + n);
+  return n;
+}
+
+} // namespace ns3
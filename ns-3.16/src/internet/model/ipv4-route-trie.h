@@ -0,0 +1,105 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef IPV4_ROUTE_TRIE_H
+#define IPV4_ROUTE_TRIE_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+class Ipv4RoutingTableEntry;
+
+/**
+ * \brief A longest prefix match table of IPv4 routes.
+ *
+ * The routes are stored in a path compressed binary trie (a PATRICIA
+ * trie) over a vector of nodes: a node only exists where a prefix ends or
+ * where two prefixes diverge, so a lookup visits at most one node per
+ * distinct prefix length on the path to the destination.  Each node holds
+ * the set of equal cost routes to its prefix in the order they were
+ * inserted, which is the order the ECMP selection indexes into.
+ *
+ * The trie does not own the routes.  There is no removal: the owner
+ * clears the trie and inserts the remaining routes again.
+ */
+class Ipv4RouteTrie
+{
+public:
+  /// The equal cost routes to a prefix, in insertion order.
+  typedef std::vector<Ipv4RoutingTableEntry *> Routes;
+
+  /// The most prefixes a destination can match, one per length from 0 to 32.
+  static const uint32_t MAX_MATCHES = 33;
+
+  Ipv4RouteTrie ();
+
+  /**
+   * \brief Add a route to the set of routes to a prefix.
+   *
+   * \param network the prefix; the bits outside of mask are ignored
+   * \param mask the mask of the prefix, contiguous
+   * \param route the route to add to the set
+   */
+  void Insert (Ipv4Address network, Ipv4Mask mask, Ipv4RoutingTableEntry *route);
+
+  /**
+   * \brief Remove all the routes.
+   */
+  void Clear (void);
+
+  /**
+   * \param dest the destination to look up
+   * \return the routes to the longest prefix that matches dest, or 0 if
+   * no prefix does
+   */
+  const Routes *Lookup (Ipv4Address dest) const;
+
+  /**
+   * \brief Get the routes to every prefix that matches a destination.
+   *
+   * \param dest the destination to look up
+   * \param matches an array of MAX_MATCHES elements, filled with the route
+   * sets from the longest matching prefix to the shortest
+   * \return the number of matching prefixes
+   */
+  uint32_t LookupAll (Ipv4Address dest, const Routes **matches) const;
+
+private:
+  struct Node
+  {
+    uint32_t prefix;
+    uint32_t length;
+    // indices in m_nodes, 0 for none since the root is nobody's child
+    uint32_t child[2];
+    // index in m_routes plus one, 0 for none
+    uint32_t routes;
+  };
+
+  static inline uint32_t GetBit (uint32_t address, uint32_t index);
+  static inline uint32_t GetMask (uint32_t length);
+  uint32_t AddNode (uint32_t prefix, uint32_t length);
+
+  // the root, at index 0, is the empty prefix
+  std::vector<Node> m_nodes;
+  std::vector<Routes> m_routes;
+};
+
+} // namespace ns3
+
+#endif /* IPV4_ROUTE_TRIE_H */
@@ -26,10 +26,32 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("Ipv6EndPointDemux");
 
+bool Ipv6EndPointDemux::Key::operator== (const Key &other) const
+{
+  return localPort == other.localPort && peerPort == other.peerPort
+         && localAddress == other.localAddress && peerAddress == other.peerAddress;
+}
+
+size_t Ipv6EndPointDemux::KeyHash::operator() (const Key &key) const
+{
+  Ipv6AddressHash addressHash;
+  size_t h = addressHash (key.localAddress);
+  h = h * 31 + addressHash (key.peerAddress);
+  h = h * 31 + key.localPort;
+  h = h * 31 + key.peerPort;
+  return h;
+}
+
+size_t Ipv6EndPointDemux::EndPointHash::operator() (const Ipv6EndPoint *endPoint) const
+{
+  return reinterpret_cast<size_t> (endPoint) / sizeof (void *);
+}
+
 Ipv6EndPointDemux::Ipv6EndPointDemux ()
   : m_ephemeral (49152),
     m_portFirst (49152),
-    m_portLast (65535)
+    m_portLast (65535),
+    m_serial (0)
 {
   NS_LOG_FUNCTION_NOARGS ();
 }
@@ -40,31 +62,32 @@ Ipv6EndPointDemux::~Ipv6EndPointDemux ()
   for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
     {
       Ipv6EndPoint *endPoint = *i;
+      endPoint->m_demux = 0;
       delete endPoint;
     }
   m_endPoints.clear ();
+  m_connections.clear ();
+  m_ports.clear ();
+  m_entries.clear ();
 }
 
 bool Ipv6EndPointDemux::LookupPortLocal (uint16_t port)
 {
   NS_LOG_FUNCTION (this << port);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
-    {
-      if ((*i)->GetLocalPort  () == port)
-        {
-          return true;
-        }
-    }
-  return false;
+  return m_ports.find (port) != m_ports.end ();
 }
 
 bool Ipv6EndPointDemux::LookupLocal (Ipv6Address addr, uint16_t port)
 {
   NS_LOG_FUNCTION (this << addr << port);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  Ports::iterator p = m_ports.find (port);
+  if (p == m_ports.end ())
+    {
+      return false;
+    }
+  for (EndPointsI i = p->second.endPoints.begin (); i != p->second.endPoints.end (); i++)
     {
-      if ((*i)->GetLocalPort () == port
-          && (*i)->GetLocalAddress () == addr)
+      if ((*i)->GetLocalAddress () == addr)
         {
           return true;
         }
@@ -81,10 +104,7 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate ()
       NS_LOG_WARN ("Ephemeral port allocation failed.");
       return 0;
     }
-  Ipv6EndPoint *endPoint = new Ipv6EndPoint (Ipv6Address::GetAny (), port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
-  return endPoint;
+  return Insert (new Ipv6EndPoint (Ipv6Address::GetAny (), port));
 }
 
 Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ipv6Address address)
@@ -96,10 +116,7 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ipv6Address address)
       NS_LOG_WARN ("Ephemeral port allocation failed.");
       return 0;
     }
-  Ipv6EndPoint *endPoint = new Ipv6EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
-  return endPoint;
+  return Insert (new Ipv6EndPoint (address, port));
 }
 
 Ipv6EndPoint* Ipv6EndPointDemux::Allocate (uint16_t port)
@@ -117,49 +134,58 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ipv6Address address, uint16_t port)
       NS_LOG_WARN ("Duplicate address/port; failing.");
       return 0;
     }
-  Ipv6EndPoint *endPoint = new Ipv6EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
-  return endPoint;
+  return Insert (new Ipv6EndPoint (address, port));
 }
 
 Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ipv6Address localAddress, uint16_t localPort,
                                            Ipv6Address peerAddress, uint16_t peerPort)
 {
   NS_LOG_FUNCTION (this << localAddress << localPort << peerAddress << peerPort);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  Key key;
+  key.localAddress = localAddress;
+  key.peerAddress = peerAddress;
+  key.localPort = localPort;
+  key.peerPort = peerPort;
+  bool exists = (m_connections.find (key) != m_connections.end ());
+  Ports::iterator p = m_ports.find (localPort);
+  if (!exists && p != m_ports.end ())
     {
-      if ((*i)->GetLocalPort () == localPort
-          && (*i)->GetLocalAddress () == localAddress
-          && (*i)->GetPeerPort () == peerPort
-          && (*i)->GetPeerAddress () == peerAddress)
+      /* an end point with a wildcard is a listener */
+      for (EndPointsI i = p->second.listeners.begin (); i != p->second.listeners.end (); i++)
         {
-          NS_LOG_WARN ("No way we can allocate this end-point.");
-          /* no way we can allocate this end-point. */
-          return 0;
+          if ((*i)->GetLocalAddress () == localAddress
+              && (*i)->GetPeerPort () == peerPort
+              && (*i)->GetPeerAddress () == peerAddress)
+            {
+              exists = true;
+              break;
+            }
         }
     }
+  if (exists)
+    {
+      NS_LOG_WARN ("No way we can allocate this end-point.");
+      /* no way we can allocate this end-point. */
+      return 0;
+    }
   Ipv6EndPoint *endPoint = new Ipv6EndPoint (localAddress, localPort);
   endPoint->SetPeer (peerAddress, peerPort);
-  m_endPoints.push_back (endPoint);
-
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
-
-  return endPoint;
+  return Insert (endPoint);
 }
 
 void Ipv6EndPointDemux::DeAllocate (Ipv6EndPoint *endPoint)
 {
   NS_LOG_FUNCTION_NOARGS ();
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  Entries::iterator e = m_entries.find (endPoint);
+  if (e == m_entries.end ())
     {
-      if (*i == endPoint)
-        {
-          delete endPoint;
-          m_endPoints.erase (i);
-          break;
-        }
+      return;
     }
+  Unindex (e->second);
+  m_endPoints.erase (e->second.all);
+  m_entries.erase (e);
+  endPoint->m_demux = 0;
+  delete endPoint;
 }
 
 /*
@@ -179,21 +205,45 @@ Ipv6EndPointDemux::EndPoints Ipv6EndPointDemux::Lookup (Ipv6Address daddr, uint1
   EndPoints retval4; /* Exact match on all 4 */
 
   NS_LOG_DEBUG ("Looking up endpoint for destination address " << daddr);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  Ports::iterator p = m_ports.find (dport);
+  if (p == m_ports.end ())
+    {
+      NS_LOG_LOGIC ("No endpoint on port " << dport);
+      return retval1;
+    }
+
+  /* A connected end point has no wildcard, it can only match all 4 exactly */
+  Key key;
+  key.localAddress = daddr;
+  key.peerAddress = saddr;
+  key.localPort = dport;
+  key.peerPort = sport;
+  Connections::iterator c = m_connections.find (key);
+  if (c != m_connections.end ())
+    {
+      for (EndPointsI i = c->second.begin (); i != c->second.end (); i++)
+        {
+          Ipv6EndPoint* endP = *i;
+          if (endP->GetBoundNetDevice () && endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
+            {
+              NS_LOG_LOGIC ("Skipping endpoint " << &endP
+                                                 << " because endpoint is bound to specific device and"
+                                                 << endP->GetBoundNetDevice ()
+                                                 << " does not match packet device " << incomingInterface->GetDevice ());
+              continue;
+            }
+          retval4.push_back (endP);
+        }
+    }
+
+  EndPoints listeners4;
+  for (EndPointsI i = p->second.listeners.begin (); i != p->second.listeners.end (); i++)
     {
       Ipv6EndPoint* endP = *i;
       NS_LOG_DEBUG ("Looking at endpoint dport=" << endP->GetLocalPort ()
                                                  << " daddr=" << endP->GetLocalAddress ()
                                                  << " sport=" << endP->GetPeerPort ()
                                                  << " saddr=" << endP->GetPeerAddress ());
-      if (endP->GetLocalPort () != dport)
-        {
-          NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                                             << " because endpoint dport "
-                                             << endP->GetLocalPort ()
-                                             << " does not match packet dport " << dport);
-          continue;
-        }
 
       if (endP->GetBoundNetDevice ())
         {
@@ -258,9 +308,13 @@ Ipv6EndPointDemux::EndPoints Ipv6EndPointDemux::Lookup (Ipv6Address daddr, uint1
           && remotePeerMatchesExact
           && remoteAddressMatchesExact)
         { /* All 4 match */
-          retval4.push_back (endP);
+          listeners4.push_back (endP);
         }
     }
+  if (!listeners4.empty ())
+    {
+      retval4 = MergeInOrder (retval4, listeners4);
+    }
 
   /* Here we find the most exact match */
   if (!retval4.empty ())
@@ -283,15 +337,15 @@ Ipv6EndPoint* Ipv6EndPointDemux::SimpleLookup (Ipv6Address dst, uint16_t dport,
   uint32_t genericity = 3;
   Ipv6EndPoint *generic = 0;
 
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  Ports::iterator p = m_ports.find (dport);
+  if (p == m_ports.end ())
+    {
+      return 0;
+    }
+  for (EndPointsI i = p->second.endPoints.begin (); i != p->second.endPoints.end (); i++)
     {
       uint32_t tmp = 0;
 
-      if ((*i)->GetLocalPort () != dport)
-        {
-          continue;
-        }
-
       if ((*i)->GetLocalAddress () == dst && (*i)->GetPeerPort () == sport
           && (*i)->GetPeerAddress () == src)
         {
@@ -345,5 +399,106 @@ Ipv6EndPointDemux::EndPoints Ipv6EndPointDemux::GetEndPoints () const
   return m_endPoints;
 }
 
-} /* namespace ns3 */
+Ipv6EndPoint* Ipv6EndPointDemux::Insert (Ipv6EndPoint *endPoint)
+{
+  Entry &entry = m_entries[endPoint];
+  entry.serial = m_serial++;
+  entry.all = m_endPoints.insert (m_endPoints.end (), endPoint);
+  Index (endPoint, entry);
+  endPoint->m_demux = this;
+  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  return endPoint;
+}
+
+void Ipv6EndPointDemux::Index (Ipv6EndPoint *endPoint, Entry &entry)
+{
+  entry.key.localAddress = endPoint->GetLocalAddress ();
+  entry.key.peerAddress = endPoint->GetPeerAddress ();
+  entry.key.localPort = endPoint->GetLocalPort ();
+  entry.key.peerPort = endPoint->GetPeerPort ();
+  entry.connected = entry.key.localAddress != Ipv6Address::GetAny ()
+    && entry.key.peerAddress != Ipv6Address::GetAny ()
+    && entry.key.peerPort != 0;
+
+  Port &port = m_ports[entry.key.localPort];
+  entry.port = InsertInOrder (port.endPoints, endPoint, entry.serial);
+  if (entry.connected)
+    {
+      entry.index = InsertInOrder (m_connections[entry.key], endPoint, entry.serial);
+    }
+  else
+    {
+      entry.index = InsertInOrder (port.listeners, endPoint, entry.serial);
+    }
+}
 
+void Ipv6EndPointDemux::Unindex (Entry &entry)
+{
+  Ports::iterator p = m_ports.find (entry.key.localPort);
+  NS_ASSERT (p != m_ports.end ());
+  p->second.endPoints.erase (entry.port);
+  if (entry.connected)
+    {
+      Connections::iterator c = m_connections.find (entry.key);
+      NS_ASSERT (c != m_connections.end ());
+      c->second.erase (entry.index);
+      if (c->second.empty ())
+        {
+          m_connections.erase (c);
+        }
+    }
+  else
+    {
+      p->second.listeners.erase (entry.index);
+    }
+  if (p->second.endPoints.empty ())
+    {
+      m_ports.erase (p);
+    }
+}
+
+void Ipv6EndPointDemux::Reindex (Ipv6EndPoint *endPoint)
+{
+  Entries::iterator e = m_entries.find (endPoint);
+  NS_ASSERT (e != m_entries.end ());
+  Unindex (e->second);
+  Index (endPoint, e->second);
+}
+
+Ipv6EndPointDemux::EndPointsI Ipv6EndPointDemux::InsertInOrder (EndPoints &endPoints, Ipv6EndPoint *endPoint, uint64_t serial)
+{
+  /* end points are nearly always inserted at the end */
+  EndPointsI i = endPoints.end ();
+  while (i != endPoints.begin ())
+    {
+      EndPointsI prev = i;
+      prev--;
+      if (m_entries[*prev].serial < serial)
+        {
+          break;
+        }
+      i = prev;
+    }
+  return endPoints.insert (i, endPoint);
+}
+
+Ipv6EndPointDemux::EndPoints Ipv6EndPointDemux::MergeInOrder (const EndPoints &a, const EndPoints &b)
+{
+  EndPoints merged;
+  std::list<Ipv6EndPoint *>::const_iterator i = a.begin ();
+  std::list<Ipv6EndPoint *>::const_iterator j = b.begin ();
+  while (i != a.end () || j != b.end ())
+    {
+      if (j == b.end () || (i != a.end () && m_entries[*i].serial < m_entries[*j].serial))
+        {
+          merged.push_back (*i++);
+        }
+      else
+        {
+          merged.push_back (*j++);
+        }
+    }
+  return merged;
+}
+
+} /* namespace ns3 */
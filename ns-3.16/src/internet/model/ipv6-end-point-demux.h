@@ -24,6 +24,7 @@
 #include <stdint.h>
 #include <list>
 #include "ns3/ipv6-address.h"
+#include "ns3/sgi-hashmap.h"
 #include "ipv6-interface.h"
 
 namespace ns3 {
@@ -33,6 +34,11 @@ class Ipv6EndPoint;
 /**
  * \class Ipv6EndPointDemux
  * \brief Demultiplexor for end points.
+ *
+ * Endpoints are hashed on their local port, and connected endpoints (both
+ * addresses and the peer port set) on their full four-tuple, so a lookup
+ * only looks at the listeners of the destination port and at the exact
+ * match.
  */
 class Ipv6EndPointDemux
 {
@@ -137,12 +143,111 @@ public:
   EndPoints GetEndPoints () const;
 
 private:
+  friend class Ipv6EndPoint;
+
+  /**
+   * \brief The four-tuple an end point is indexed under.
+   */
+  struct Key
+  {
+    Ipv6Address localAddress;
+    Ipv6Address peerAddress;
+    uint16_t localPort;
+    uint16_t peerPort;
+    bool operator== (const Key &other) const;
+  };
+
+  /**
+   * \brief Hash function of a four-tuple.
+   */
+  struct KeyHash
+  {
+    size_t operator() (const Key &key) const;
+  };
+
+  /**
+   * \brief Hash function of an end point pointer.
+   */
+  struct EndPointHash
+  {
+    size_t operator() (const Ipv6EndPoint *endPoint) const;
+  };
+
+  /**
+   * \brief Where an end point is indexed.
+   */
+  struct Entry
+  {
+    uint64_t serial;         /* allocation order */
+    Key key;
+    bool connected;          /* in m_connections rather than a listener list */
+    EndPointsI all;          /* position in m_endPoints */
+    EndPointsI port;         /* position in the end points of its local port */
+    EndPointsI index;        /* position in its connection or listener list */
+  };
+
+  /**
+   * \brief End points of a local port.
+   */
+  struct Port
+  {
+    EndPoints endPoints;     /* every end point of the port */
+    EndPoints listeners;     /* the ones with a wildcard */
+  };
+
+  typedef sgi::hash_map<Key, EndPoints, KeyHash> Connections;
+  typedef sgi::hash_map<uint16_t, Port> Ports;
+  typedef sgi::hash_map<const Ipv6EndPoint *, Entry, EndPointHash> Entries;
+
   /**
    * \brief Allocate a ephemeral port.
    * \return a port
    */
   uint16_t AllocateEphemeralPort ();
 
+  /**
+   * \brief Register a new end point.
+   * \param endPoint the end point
+   * \return the end point
+   */
+  Ipv6EndPoint* Insert (Ipv6EndPoint *endPoint);
+
+  /**
+   * \brief Index an end point under its current four-tuple.
+   * \param endPoint the end point
+   * \param entry its entry
+   */
+  void Index (Ipv6EndPoint *endPoint, Entry &entry);
+
+  /**
+   * \brief Remove an end point from the indexes.
+   * \param entry its entry
+   */
+  void Unindex (Entry &entry);
+
+  /**
+   * \brief Called by an end point whose addresses or ports changed.
+   * \param endPoint the end point
+   */
+  void Reindex (Ipv6EndPoint *endPoint);
+
+  /**
+   * \brief Insert an end point in a list kept in allocation order.
+   * \param endPoints the list
+   * \param endPoint the end point
+   * \param serial its allocation order
+   * \return its position
+   */
+  EndPointsI InsertInOrder (EndPoints &endPoints, Ipv6EndPoint *endPoint, uint64_t serial);
+
+  /**
+   * \brief Merge two lists kept in allocation order.
+   * \param a first list
+   * \param b second list
+   * \return the merged list
+   */
+  EndPoints MergeInOrder (const EndPoints &a, const EndPoints &b);
+
   /**
    * \brief The ephemeral port.
    */
@@ -159,9 +264,29 @@ private:
   uint16_t m_portLast;
 
   /**
-   * \brief A list of IPv6 end points.
+   * \brief A list of IPv6 end points, in allocation order.
    */
   EndPoints m_endPoints;
+
+  /**
+   * \brief Connected end points, by four-tuple.
+   */
+  Connections m_connections;
+
+  /**
+   * \brief End points by local port.
+   */
+  Ports m_ports;
+
+  /**
+   * \brief Where each end point is indexed.
+   */
+  Entries m_entries;
+
+  /**
+   * \brief Allocation counter.
+   */
+  uint64_t m_serial;
 };
 
 } /* namespace ns3 */
@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include <iostream>
+#include <algorithm>
 #include "tcp-header.h"
 #include "scoreboard.h"
 #include "ns3/buffer.h"
@@ -39,8 +40,176 @@ ScoreBoard::GetTypeId (void)
 }
 
 
+//word-level helpers on the segment bitmaps, bits past the end of a bitmap
+//are zero
+
+static inline uint64_t
+GetWord(const std::vector<uint64_t> &bits, uint32_t w)
+{
+  return w < bits.size() ? bits[w] : 0;
+}
+
+static inline bool
+TestBit(const std::vector<uint64_t> &bits, uint32_t k)
+{
+  return (GetWord(bits, k >> 6) >> (k & 63)) & 1;
+}
+
+//sets bits [from, to) and returns how many of them were clear
+static uint32_t
+SetRange(std::vector<uint64_t> &bits, uint32_t from, uint32_t to)
+{
+  if(from >= to)
+    return 0;
+  uint32_t last = (to - 1) >> 6;
+  if(last >= bits.size())
+    bits.resize(last + 1, 0);
+  uint32_t count = 0;
+  for(uint32_t w = from >> 6; w <= last; w++)
+  {
+    uint64_t mask = ~(uint64_t)0;
+    if(w == (from >> 6))
+      mask &= ~(uint64_t)0 << (from & 63);
+    if(w == last && (to & 63) != 0)
+      mask &= ((uint64_t)1 << (to & 63)) - 1;
+    count += __builtin_popcountll(mask & ~bits[w]);
+    bits[w] |= mask;
+  }
+  return count;
+}
+
+//clears bits [from, to) and returns how many of them were set
+static uint32_t
+ClearRange(std::vector<uint64_t> &bits, uint32_t from, uint32_t to)
+{
+  if(from >= to || (from >> 6) >= bits.size())
+    return 0;
+  uint32_t last = std::min<uint32_t>((to - 1) >> 6, bits.size() - 1);
+  uint32_t count = 0;
+  for(uint32_t w = from >> 6; w <= last; w++)
+  {
+    uint64_t mask = ~(uint64_t)0;
+    if(w == (from >> 6))
+      mask &= ~(uint64_t)0 << (from & 63);
+    if(w == ((to - 1) >> 6) && (to & 63) != 0)
+      mask &= ((uint64_t)1 << (to & 63)) - 1;
+    count += __builtin_popcountll(mask & bits[w]);
+    bits[w] &= ~mask;
+  }
+  return count;
+}
+
+//number of k in [from, to) set in a or b
+static uint32_t
+CountRange(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b, uint32_t from, uint32_t to)
+{
+  if(from >= to)
+    return 0;
+  uint32_t last = std::min<uint32_t>((to - 1) >> 6, std::max(a.size(), b.size()));
+  uint32_t count = 0;
+  for(uint32_t w = from >> 6; w <= last; w++)
+  {
+    uint64_t word = GetWord(a, w) | GetWord(b, w);
+    if(w == (from >> 6))
+      word &= ~(uint64_t)0 << (from & 63);
+    if(w == ((to - 1) >> 6) && (to & 63) != 0)
+      word &= ((uint64_t)1 << (to & 63)) - 1;
+    count += __builtin_popcountll(word);
+  }
+  return count;
+}
+
+//first k in [from, to) whose bit in (a | b) equals set, or to
+static uint32_t
+FindNext(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b, bool set, uint32_t from, uint32_t to)
+{
+  if(from >= to)
+    return to;
+  uint32_t words = std::max(a.size(), b.size());
+  uint32_t w = from >> 6;
+  uint64_t word = GetWord(a, w) | GetWord(b, w);
+  if(!set)
+    word = ~word;
+  word &= ~(uint64_t)0 << (from & 63);
+  while(word == 0)
+  {
+    w++;
+    if(((uint64_t)w << 6) >= to || (set && w >= words))
+      return to;
+    word = GetWord(a, w) | GetWord(b, w);
+    if(!set)
+      word = ~word;
+  }
+  uint64_t k = ((uint64_t)w << 6) + __builtin_ctzll(word);
+  return k < to ? (uint32_t)k : to;
+}
+
+//last k in [from, to) whose bit equals set, or to
+static uint32_t
+FindPrev(const std::vector<uint64_t> &bits, bool set, uint32_t from, uint32_t to)
+{
+  if(from >= to)
+    return to;
+  uint32_t last = to - 1;
+  if(set)
+  {
+    if(bits.empty() || from >= bits.size() * 64)
+      return to;
+    last = std::min<uint32_t>(last, bits.size() * 64 - 1);
+  }
+  uint32_t w = last >> 6;
+  uint64_t word = GetWord(bits, w);
+  if(!set)
+    word = ~word;
+  if((last & 63) != 63)
+    word &= ((uint64_t)1 << ((last & 63) + 1)) - 1;
+  while(word == 0)
+  {
+    if(((uint64_t)w << 6) <= from)
+      return to;
+    w--;
+    word = GetWord(bits, w);
+    if(!set)
+      word = ~word;
+  }
+  uint32_t k = (w << 6) + 63 - __builtin_clzll(word);
+  return k >= from ? k : to;
+}
+
+//position of the n-th highest set bit in [from, to), or to
+static uint32_t
+FindNthPrev(const std::vector<uint64_t> &bits, uint32_t n, uint32_t from, uint32_t to)
+{
+  if(from >= to || n == 0 || bits.empty())
+    return to;
+  uint32_t last = std::min<uint32_t>(to - 1, bits.size() * 64 - 1);
+  if(last < from)
+    return to;
+  for(uint32_t w = last >> 6; ; w--)
+  {
+    uint64_t word = bits[w];
+    if(w == (last >> 6) && (last & 63) != 63)
+      word &= ((uint64_t)1 << ((last & 63) + 1)) - 1;
+    if(w == (from >> 6))
+      word &= ~(uint64_t)0 << (from & 63);
+    uint32_t count = __builtin_popcountll(word);
+    if(count >= n)
+    {
+      while(--n > 0)
+        word &= ~((uint64_t)1 << (63 - __builtin_clzll(word)));
+      return (w << 6) + 63 - __builtin_clzll(word);
+    }
+    n -= count;
+    if(w == (from >> 6))
+      return to;
+  }
+}
+
+
 ScoreBoard::ScoreBoard(void):
   m_highReTx(0),
+  m_size(0),
+  m_sackedCount(0),
   m_mss(1460),
   m_retxThresh(3)
 {
@@ -52,31 +221,74 @@ ScoreBoard::~ScoreBoard()
 {
 }
 
+bool
+ScoreBoard::GetIndex(SequenceNumber32 seqNo, uint32_t &index) const
+{
+  uint32_t v = seqNo.GetValue();
+  if(v == 0 || (v - 1) % m_mss != 0)
+    return false;
+  index = (v - 1) / m_mss;
+  return true;
+}
+
+//number of segments starting below seqNo
+uint32_t
+ScoreBoard::GetIndexCeil(SequenceNumber32 seqNo) const
+{
+  uint64_t v = seqNo.GetValue();
+  if(v <= 1)
+    return 0;
+  return (uint32_t)((v - 1 + m_mss - 1) / m_mss);
+}
+
+SequenceNumber32
+ScoreBoard::GetSequence(uint32_t index) const
+{
+  return SequenceNumber32(1 + index * m_mss);
+}
+
+bool
+ScoreBoard::IsPresent(uint32_t index) const
+{
+  return index < m_size || TestBit(m_beyond, index);
+}
+
+//first segment at or above index that is not on the scoreboard
+uint32_t
+ScoreBoard::GetFirstAbsent(uint32_t index) const
+{
+  if(index < m_size)
+    index = m_size;
+  return FindNext(m_beyond, m_beyond, false, index, 0xffffffff);
+}
+
+//unsacked segments of [from, to) below the returned index have at least
+//m_retxThresh sacked segments above them in [from, to)
+uint32_t
+ScoreBoard::GetLostBoundary(uint32_t from, uint32_t to) const
+{
+  uint32_t k = FindNthPrev(m_sacked, m_retxThresh, from, to);
+  return k == to ? from : k;
+}
+
 
 void
 ScoreBoard::CreateScoreBoard(int size, uint32_t mss, uint32_t retxThresh)
 {
   m_mss = mss;
   m_retxThresh = retxThresh;
-  for (int i=1 ; i<size;)
-  {
-      SequenceNumber32 seq(i);
-      m_sbn[seq].acked = false;
-      m_sbn[seq].sacked = false;
-      i = i + mss;
-  }
+  uint32_t n = size > 1 ? GetIndexCeil(SequenceNumber32(size)) : 0;
+  ClearRange(m_acked, 0, n);
+  m_sackedCount -= ClearRange(m_sacked, 0, n);
+  m_size = std::max(m_size, n);
 }
 
 void
 ScoreBoard::ClearScoreBoard()
 {
-  SequenceNumber32 seqNo = SequenceNumber32(1);
-  while (m_sbn.find(seqNo) != m_sbn.end())
-  {
-      m_sbn[seqNo].acked = false;
-      m_sbn[seqNo].sacked = false;
-      seqNo += m_mss; 
-  }
+  uint32_t end = GetFirstAbsent(0);
+  ClearRange(m_acked, 0, end);
+  m_sackedCount -= ClearRange(m_sacked, 0, end);
 }
 
 
@@ -86,13 +298,22 @@ ScoreBoard::UpdateScoreBoard(const TcpHeader &tcpHeader)
     if (0 == (tcpHeader.GetFlags () & TcpHeader::ACK))
       return;
 
-    SequenceNumber32 cumAck = tcpHeader.GetAckNumber() - m_mss;
-
-    //marking data as acked
-    while((m_sbn.find(cumAck) != m_sbn.end()) && (m_sbn[cumAck].acked == false))
+    //marking data as acked, walking back from the cumulative ack to the
+    //first segment that is already acked or not on the scoreboard
+    uint32_t k;
+    if(GetIndex(tcpHeader.GetAckNumber() - m_mss, k) && IsPresent(k) && !TestBit(m_acked, k))
     {
-       m_sbn[cumAck].acked = true;
-       cumAck -= m_mss;
+       uint32_t from = 0;
+       uint32_t j = FindPrev(m_acked, true, 0, k);
+       if(j != k)
+         from = j + 1;
+       if(k > m_size)
+       {
+         j = FindPrev(m_beyond, false, m_size, k);
+         if(j != k)
+           from = std::max(from, j + 1);
+       }
+       SetRange(m_acked, from, k + 1);
     }
 
     //marking SACKed data
@@ -104,12 +325,12 @@ ScoreBoard::UpdateScoreBoard(const TcpHeader &tcpHeader)
      for(int i = 0; i < (int)sackblock_Count; i++)
      {
        SackBlock s = sack_option->GetSack(i);
-       SequenceNumber32 seqNo = s.first;
-       while(seqNo < s.second)
-       {
-          m_sbn[seqNo].sacked = true;
-          seqNo += m_mss; 
-       }
+       uint32_t end = GetIndexCeil(s.second);
+       if(!GetIndex(s.first, k) || k >= end)
+         continue;
+       m_sackedCount += SetRange(m_sacked, k, end);
+       if(end > m_size)
+         SetRange(m_beyond, std::max(k, m_size), end);
      }
 
 }
@@ -117,42 +338,39 @@ ScoreBoard::UpdateScoreBoard(const TcpHeader &tcpHeader)
 bool
 ScoreBoard::IsLost(SequenceNumber32 seqNo, SequenceNumber32 nextTxSequence)
 {
-  NS_ASSERT(m_sbn.find(seqNo) != m_sbn.end());
-  if(m_sbn.find(seqNo) == m_sbn.end())
+  uint32_t k;
+  bool found = GetIndex(seqNo, k) && IsPresent(k);
+  NS_ASSERT(found);
+  if(!found)
     return false;
-  if((m_sbn[seqNo].acked) || (m_sbn[seqNo].sacked))
+  if(TestBit(m_acked, k) || TestBit(m_sacked, k))
+    return false;
+  if(m_sackedCount < m_retxThresh)
     return false;
 
-  int count = 0;
-  SequenceNumber32 temp = seqNo + m_mss;
-  while((temp < nextTxSequence) && (m_sbn.find(temp) != m_sbn.end()))
-  {
-      NS_ASSERT(!m_sbn[temp].acked);
-      if(m_sbn[temp].sacked)
-        count++;
-      if(count == (int)m_retxThresh)
-        return true;
-      temp += m_mss;
-  }
-  return false;
-
+  uint32_t end = std::min(GetIndexCeil(nextTxSequence), GetFirstAbsent(k + 1));
+  return (k + 1 < end) && (CountRange(m_sacked, m_sacked, k + 1, end) >= m_retxThresh);
 }
 
 uint32_t
 ScoreBoard::SetPipe(SequenceNumber32 headSequence, SequenceNumber32 nextTxSequence)
 {
-  uint32_t pipe = 0;
-  SequenceNumber32 seqNo = headSequence;
-  while((seqNo < nextTxSequence) && (m_sbn.find(seqNo) != m_sbn.end()))
+  uint32_t head;
+  if(!GetIndex(headSequence, head) || !IsPresent(head))
+    return 0;
+  uint32_t end = std::min(GetIndexCeil(nextTxSequence), GetFirstAbsent(head));
+  if(end <= head)
+    return 0;
+
+  //unsacked segments count once unless lost, and once more if retransmitted
+  uint32_t pipe = (end - head) - CountRange(m_sacked, m_sacked, head, end);
+  uint32_t lostEnd = GetLostBoundary(head, end);
+  pipe -= (lostEnd - head) - CountRange(m_acked, m_sacked, head, lostEnd);
+  if(m_highReTx.GetValue() >= 1)
   {
-    if(!m_sbn[seqNo].sacked)
-    {
-        if(!IsLost(seqNo, nextTxSequence))
-            pipe++;
-        if(seqNo <= m_highReTx)
-            pipe++;
-    }
-    seqNo += m_mss;
+    uint32_t reTxEnd = std::min(end, (m_highReTx.GetValue() - 1) / m_mss + 1);
+    if(reTxEnd > head)
+      pipe += (reTxEnd - head) - CountRange(m_sacked, m_sacked, head, reTxEnd);
   }
   return (pipe*m_mss);
 }
@@ -160,24 +378,21 @@ ScoreBoard::SetPipe(SequenceNumber32 headSequence, SequenceNumber32 nextTxSequen
 SequenceNumber32
 ScoreBoard::GetNextSegment(SequenceNumber32 headSequence, SequenceNumber32 nextTxSequence)
 {
-  
-  SequenceNumber32 seqNo = headSequence;
-  while((seqNo < nextTxSequence) && (m_sbn.find(seqNo) != m_sbn.end()))
+  uint32_t head;
+  if(GetIndex(headSequence, head) && IsPresent(head))
   {
-    if((seqNo > m_highReTx) && (IsLost(seqNo, nextTxSequence)))
-      return seqNo;
-    seqNo += m_mss;
+    uint32_t end = std::min(GetIndexCeil(nextTxSequence), GetFirstAbsent(head));
+    uint32_t lostEnd = GetLostBoundary(head, end);
+    uint32_t from = head;
+    if(m_highReTx.GetValue() >= 1)
+      from = std::max(from, (m_highReTx.GetValue() - 1) / m_mss + 1);
+    uint32_t k = FindNext(m_acked, m_sacked, false, from, lostEnd);
+    if(k < lostEnd)
+      return GetSequence(k);
   }
 
   //added for double tcp case, otherwise just return m_nextTxSequence
-  seqNo = nextTxSequence;
-  while(m_sbn.find(seqNo) != m_sbn.end())
-  {
-    if((!m_sbn[seqNo].sacked) && (!m_sbn[seqNo].acked))
-      return seqNo;
-    seqNo += m_mss;
-  }
-  return SequenceNumber32(0);
+  return GetNextAggSegment(nextTxSequence);
 }
 
 //For double tcp
@@ -186,14 +401,14 @@ ScoreBoard::GetNextAggSegment(SequenceNumber32 nextTxSequence)
 {
  
   //added for double tcp case, otherwise just return m_nextTxSequence
-  SequenceNumber32 seqNo = nextTxSequence;
-  while(m_sbn.find(seqNo) != m_sbn.end())
-  {
-    if((!m_sbn[seqNo].sacked) && (!m_sbn[seqNo].acked))
-      return seqNo;
-    seqNo += m_mss;
-  }
-  return SequenceNumber32(0);
+  uint32_t k;
+  if(!GetIndex(nextTxSequence, k) || !IsPresent(k))
+    return SequenceNumber32(0);
+  uint32_t end = GetFirstAbsent(k);
+  k = FindNext(m_acked, m_sacked, false, k, end);
+  if(k == end)
+    return SequenceNumber32(0);
+  return GetSequence(k);
 }
 
 
@@ -202,11 +417,14 @@ ScoreBoard::GetNextAggSegment(SequenceNumber32 nextTxSequence)
 void 
 ScoreBoard::Print(std::ostream &os, SequenceNumber32 nextTxSequence, SequenceNumber32 headSequence)
 {
-    os<<"Size of scoreboard:"<<m_sbn.size()<<"\n";
+    uint32_t end = std::max<uint32_t>(m_size, m_beyond.size() * 64);
+    os<<"Size of scoreboard:"<<m_size + CountRange(m_beyond, m_beyond, m_size, end)<<"\n";
     os<<"NextTx: "<<nextTxSequence<<"\t Head Sequence: "<<headSequence<<"\n";
-    for(std::map<SequenceNumber32,ScoreBoardNode>::iterator it=m_sbn.begin(); it!=m_sbn.end(); ++it)
+    for(uint32_t k = 0; k < end; k++)
     {
-      os<<it->first<<"\t Acked: "<<(it->second).acked<<"\t Sacked: "<<(it->second).sacked<<"\t Lost: "<<IsLost(it->first,nextTxSequence)<<"\n"; 
+      if(!IsPresent(k))
+        continue;
+      os<<GetSequence(k)<<"\t Acked: "<<TestBit(m_acked, k)<<"\t Sacked: "<<TestBit(m_sacked, k)<<"\t Lost: "<<IsLost(GetSequence(k),nextTxSequence)<<"\n"; 
     }
     os<<"Pipe: "<<SetPipe(headSequence, nextTxSequence)<<"\n";
     os<<"High ReTx: "<<m_highReTx<<"\n";
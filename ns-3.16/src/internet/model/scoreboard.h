@@ -22,7 +22,7 @@
 #define SCOREBOARD
 
 #include <stdint.h>
-#include <map>
+#include <vector>
 #include "ns3/header.h"
 #include "ns3/tcp-option.h"
 #include "ns3/buffer.h"
@@ -35,13 +35,19 @@
 
 namespace ns3 {
 
-struct ScoreBoardNode
-{
-  bool acked;
-  bool sacked;
-  bool lowPr;
-};
-
+/**
+ * SACK scoreboard of a TcpRC3Sack sender.
+ *
+ * Segment k of the flow starts at sequence number 1 + k * mss. The state of
+ * every segment is kept in bitmaps indexed by k (one bit per segment for
+ * acked and sacked) which only grow as far as the highest bit
+ * ever set, so the scoreboard costs a few bytes per in-flight window rather
+ * than one map node per segment of the flow. Lost-segment and pipe queries
+ * are answered with word-wide scans and population counts.
+ *
+ * Only segment-aligned sequence numbers are tracked; SACK blocks whose left
+ * edge is not on a segment boundary are ignored.
+ */
 class ScoreBoard
 {
   public:
@@ -64,7 +70,20 @@ class ScoreBoard
 
 
   private:
-    std::map<SequenceNumber32, ScoreBoardNode > m_sbn;
+    typedef std::vector<uint64_t> Bitmap;
+
+    bool GetIndex(SequenceNumber32 seqNo, uint32_t &index) const;
+    uint32_t GetIndexCeil(SequenceNumber32 seqNo) const;
+    SequenceNumber32 GetSequence(uint32_t index) const;
+    bool IsPresent(uint32_t index) const;
+    uint32_t GetFirstAbsent(uint32_t index) const;
+    uint32_t GetLostBoundary(uint32_t from, uint32_t to) const;
+
+    Bitmap m_acked;
+    Bitmap m_sacked;
+    Bitmap m_beyond;         // segments past m_size that were created by a SACK block
+    uint32_t m_size;         // segments created by CreateScoreBoard
+    uint32_t m_sackedCount;  // number of bits set in m_sacked
     uint32_t m_mss; //segment size
     uint32_t m_retxThresh;
 };
@@ -22,9 +22,9 @@
   if (m_node) { std::clog << Simulator::Now ().GetSeconds () << " [node " << m_node->GetId () << "] "; }
 #include <cstdio>
 #include <iostream>
-#include <fstream>
 #include "tcp-rc3-sack.h"
 #include "ns3/pointer.h"
+#include "ns3/string.h"
 #include "ns3/log.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/simulator.h"
@@ -36,6 +36,7 @@
 #include "ns3/my-priority-tag.h"
 #include "ns3/queue.h"
 #include "ns3/priority-queue.h"
+#include "ns3/record-sink.h"
 #include "ipv4-end-point.h"
 #include "ipv6-end-point.h"
 #include "tcp-l4-protocol.h"
@@ -107,17 +108,39 @@ TcpRC3Sack::GetTypeId (void)
 		    BooleanValue (false),
 		    MakeBooleanAccessor (&TcpRC3Sack::m_logCleanUp),
 		    MakeBooleanChecker ())
+    .AddAttribute ("RtoFile", "The file RTOs are logged to",
+		    StringValue ("rto.txt"),
+		    MakeStringAccessor (&TcpRC3Sack::m_rtoFile),
+		    MakeStringChecker ())
+    .AddAttribute ("AcksFile", "The file acks are logged to",
+		    StringValue ("acks.txt"),
+		    MakeStringAccessor (&TcpRC3Sack::m_acksFile),
+		    MakeStringChecker ())
+    .AddAttribute ("CleanUpFile", "The file cleanups are logged to",
+		    StringValue ("cleanup.txt"),
+		    MakeStringAccessor (&TcpRC3Sack::m_cleanUpFile),
+		    MakeStringChecker ())
     .AddAttribute ("FlushOut", "Flush Out",
 		    BooleanValue (false),
 		    MakeBooleanAccessor (&TcpRC3Sack::m_flushOut),
 		    MakeBooleanChecker ())
+    .AddAttribute ("PacedLowPriority", "Hand low priority packets to a PriorityQueue DeviceQueue as deferred runs that are built as the device drains them",
+		    BooleanValue (false),
+		    MakeBooleanAccessor (&TcpRC3Sack::m_pacedLowPriority),
+		    MakeBooleanChecker ())
     .AddAttribute("DeviceQueue", "Device Queue",
        PointerValue(), 
        MakePointerAccessor(&TcpRC3Sack::m_devQueue),     
         MakePointerChecker<Queue>())
   .AddTraceSource ("CongestionWindow",
                      "The TCP connection's congestion window",
-                     MakeTraceSourceAccessor (&TcpRC3Sack::m_cWnd));
+                     MakeTraceSourceAccessor (&TcpRC3Sack::m_cWnd))
+  .AddTraceSource ("Retransmission",
+                     "A segment of the flow with the given FlowId is retransmitted, by fast retransmit or timeout",
+                     MakeTraceSourceAccessor (&TcpRC3Sack::m_retransmitTrace))
+  .AddTraceSource ("Timeout",
+                     "The retransmission timer of the flow with the given FlowId expired",
+                     MakeTraceSourceAccessor (&TcpRC3Sack::m_timeoutTrace));
     return tid;
 }
 
@@ -137,7 +160,11 @@ TcpRC3Sack::TcpRC3Sack (void)
     m_logRTO (false), // mute valgrind, actual value set by the attribute system
     m_logAcks (false), // mute valgrind, actual value set by the attribute system
     m_logCleanUp (false), // mute valgrind, actual value set by the attribute system
+    m_rtoStream (0),
+    m_acksStream (0),
+    m_cleanUpStream (0),
     m_flushOut (false), // mute valgrind, actual value set by the attribute system
+    m_pacedLowPriority (false), // mute valgrind, actual value set by the attribute system
     m_devQueue(0),
     m_flowid(0),
     m_flowsize(0),
@@ -167,7 +194,14 @@ TcpRC3Sack::TcpRC3Sack (const TcpRC3Sack& sock)
     m_logRTO (false), // mute valgrind, actual value set by the attribute system
     m_logAcks (false), // mute valgrind, actual value set by the attribute system
     m_logCleanUp (false), // mute valgrind, actual value set by the attribute system
+    m_rtoFile (sock.m_rtoFile),
+    m_acksFile (sock.m_acksFile),
+    m_cleanUpFile (sock.m_cleanUpFile),
+    m_rtoStream (0),
+    m_acksStream (0),
+    m_cleanUpStream (0),
     m_flushOut (false), // mute valgrind, actual value set by the attribute system
+    m_pacedLowPriority (false), // mute valgrind, actual value set by the attribute system
     m_devQueue(0),
     m_flowid(0),
     m_flowsize(0),
@@ -240,6 +274,7 @@ TcpRC3Sack::NewAck (const SequenceNumber32& seq)
 
       TcpSocketBase::NewAck (seq); // update m_nextTxSequence and send new data if allowed by window
      drops++;
+      m_retransmitTrace (m_flowid);
       DoRetransmit (); // Assume the next seq is lost. Retransmit lost packet
       return;
     }
@@ -290,6 +325,7 @@ TcpRC3Sack::DupAck (const TcpHeader& t, uint32_t count)
       NS_LOG_INFO ("Triple dupack. Enter fast recovery mode. Reset cwnd to " << m_cWnd <<
                    ", ssthresh to " << m_ssThresh << " at fast recovery seqnum " << m_recover << " bytes in flight: " << BytesInFlight () / 2.0);
       drops++;
+      m_retransmitTrace (m_flowid);
       DoRetransmit ();
 
       /***SACK CHANGE***/
@@ -341,12 +377,14 @@ TcpRC3Sack::Retransmit (void)
                ", ssthresh to " << m_ssThresh << ", restart from seqnum " << m_nextTxSequence);
   if(m_logRTO)
   {
-    ofstream ofs("rto.txt", ios::app);
-    ofs<<Simulator::Now().GetSeconds()<<"\t"<<m_flowid<<"\t"<<(uint16_t)m_priority<<"\n";
-    ofs.close();
+    if(m_rtoStream == 0)
+      m_rtoStream = RecordSink::GetStream (m_rtoFile, "dIH");
+    m_rtoStream->Add (Simulator::Now ().GetSeconds ()).Add (m_flowid).Add ((uint16_t)m_priority).End ();
   }
   m_rtt->IncreaseMultiplier ();             // Double the next RTO
   drops++;
+  m_timeoutTrace (m_flowid);
+  m_retransmitTrace (m_flowid);
   DoRetransmit ();                          // Retransmit the packet
 }
 
@@ -424,7 +462,7 @@ TcpRC3Sack::Send (Ptr<Packet> p, uint32_t flags)
   if (m_state == ESTABLISHED || m_state == SYN_SENT || m_state == CLOSE_WAIT)
     {    
       // Store the packet into Tx buffer
-      if (!m_txBuffer.Add (p)) 
+      if (!(m_virtualPayload ? m_txBuffer.AddVirtual (p->GetSize ()) : m_txBuffer.Add (p))) 
         { // TxBuffer overflow, send failed
           m_errno = ERROR_MSGSIZE;
           return -1;
@@ -664,25 +702,9 @@ void
 TcpRC3Sack::FillSackStack(SequenceNumber32 seqno)
 {
     //find left and right edges
-    SequenceNumber32 leftEdge = seqno;
-    while(leftEdge > SequenceNumber32(1))
-    {
-        if(m_rxBuffer.m_data.find(leftEdge - m_segmentSize) != m_rxBuffer.m_data.end())
-            leftEdge = leftEdge - m_segmentSize;
-        else
-            break;
-    } 
-   
-
-
-    SequenceNumber32 rightEdge = seqno + m_segmentSize;
-    while(1)
-    {
-        if(m_rxBuffer.m_data.find(rightEdge) != m_rxBuffer.m_data.end())
-            rightEdge = rightEdge + m_segmentSize;
-        else
-            break;
-    } 
+    SequenceNumber32 leftEdge;
+    SequenceNumber32 rightEdge;
+    m_rxBuffer.GetSegmentRun(seqno, m_segmentSize, leftEdge, rightEdge);
 
     //TODO: Take care of case where packets are not multiples of MSS
     
@@ -788,9 +810,8 @@ TcpRC3Sack::ReceivedData (Ptr<Packet> p, const TcpHeader& tcpHeader)
           }
         else if (m_delAckEvent.IsExpired ())
           {
-            m_delAckEvent = Simulator::Schedule (m_delAckTimeout,
-                                                 &TcpSocketBase::DelAckTimeout, this);
-            NS_LOG_LOGIC (this << " scheduled delayed ACK at " << (Simulator::Now () + Simulator::GetDelayLeft (m_delAckEvent)).GetSeconds ());
+            m_delAckEvent.Schedule (m_delAckTimeout);
+            NS_LOG_LOGIC (this << " scheduled delayed ACK at " << (Simulator::Now () + m_delAckEvent.GetDelayLeft ()).GetSeconds ());
           }
       }
   }
@@ -851,10 +872,10 @@ TcpRC3Sack::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
 
   if(m_logAcks)
   {
-    ofstream ofs("acks.txt", ios::app);
+    if(m_acksStream == 0)
+      m_acksStream = RecordSink::GetStream (m_acksFile, "dI");
     if(m_flowid == 0)
-        ofs<<Simulator::Now().GetSeconds()<<"\t"<<tcpHeader.GetAckNumber()<<"\n";
-    ofs.close();
+        m_acksStream->Add (Simulator::Now ().GetSeconds ()).Add (tcpHeader.GetAckNumber ().GetValue ()).End ();
   }
 
   if((rc3_p2) && (tcpHeader.GetAckNumber() >= SequenceNumber32(p2_block_max)) && (tcpHeader.GetAckNumber() != m_bumpedSeq))
@@ -889,9 +910,9 @@ TcpRC3Sack::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
             NS_LOG_INFO("ACK BUMP case1! Win! " << tcpHeader.GetAckNumber() << " " << m_nextTxSequence); //JUSTINE
             if(m_logCleanUp)
             {
-               ofstream ofs("cleanup.txt", ios::app);
-              ofs<<Simulator::Now().GetSeconds()<<"\t"<<m_flowid<<"\t"<<(m_txBuffer.TailSequence() - 1)<<"\n";
-              ofs.close();
+              if(m_cleanUpStream == 0)
+                m_cleanUpStream = RecordSink::GetStream (m_cleanUpFile, "dII");
+              m_cleanUpStream->Add (Simulator::Now ().GetSeconds ()).Add (m_flowid).Add ((m_txBuffer.TailSequence () - 1).GetValue ()).End ();
             }
 
             m_bumpedSeq = tcpHeader.GetAckNumber(); 
@@ -919,9 +940,9 @@ TcpRC3Sack::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
           NS_LOG_INFO("ACK BUMP case2 (normal)! Win! " << tcpHeader.GetAckNumber() << " " << m_nextTxSequence); //JUSTINE
           if(m_logCleanUp)
           {
-             ofstream ofs("cleanup.txt", ios::app);
-             ofs<<Simulator::Now().GetSeconds()<<"\t"<<m_flowid<<"\t"<<(m_txBuffer.TailSequence() - 1)<<"\n";
-             ofs.close();
+             if(m_cleanUpStream == 0)
+               m_cleanUpStream = RecordSink::GetStream (m_cleanUpFile, "dII");
+             m_cleanUpStream->Add (Simulator::Now ().GetSeconds ()).Add (m_flowid).Add ((m_txBuffer.TailSequence () - 1).GetValue ()).End ();
           }
 
           m_bumpedSeq = tcpHeader.GetAckNumber();
@@ -1032,7 +1053,8 @@ TcpRC3Sack::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool withAck
       NS_LOG_LOGIC (this << " SendDataPacket Schedule ReTxTimeout at time " <<
                     Simulator::Now ().GetSeconds () << " to expire at time " <<
                     (Simulator::Now () + m_rto.Get ()).GetSeconds () );
-      m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::ReTxTimeout, this);
+      m_retxEvent.SetArguments ((uint8_t) 0);
+      m_retxEvent.Schedule (m_rto);
     }
   NS_LOG_LOGIC ("Send packet via TcpL4Protocol with flags 0x" << std::hex << static_cast<uint32_t> (flags) << std::dec);
   if (m_endPoint)
@@ -1201,7 +1223,8 @@ TcpRC3Sack::SendEmptyPacket (uint8_t flags, uint8_t priority, bool withSack)
       NS_LOG_LOGIC ("Schedule retransmission timeout at time "
                     << Simulator::Now ().GetSeconds () << " to expire at time "
                     << (Simulator::Now () + m_rto.Get ()).GetSeconds ());
-      m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::SendEmptyPacket, this, flags);
+      m_retxEvent.SetArguments (flags);
+      m_retxEvent.Schedule (m_rto);
     }
 }
 
@@ -1301,16 +1324,47 @@ TcpRC3Sack::SendPendingData (bool withAck)
 void
 TcpRC3Sack::StartRLPLoop()
 {
-  
+  Ptr<PriorityQueue> pq = m_pacedLowPriority ? DynamicCast<PriorityQueue> (m_devQueue) : 0;
+  if(pq == 0)
+  {
    for(int i = 0; i < int(m_txBuffer.Size()/m_segmentSize); i++){
       if(!SendLowPriorityPacket())
             break;
    }
+   return;
+  }
+
+  //same packets as above, but the device queue only keeps the first packet
+  //of each run of consecutive segments and builds the others as it drains
+  PriorityQueue::MaterializeCallback materialize = MakeCallback (&TcpRC3Sack::SendLowPriorityPacketAt, Ptr<TcpRC3Sack> (this));
+  for(int i = 0; i < int(m_txBuffer.Size()/m_segmentSize); i++){
+      SequenceNumber32 seq;
+      uint8_t priority;
+      if(!NextLowPriorityPacket(seq, priority))
+            break;
+      if(pq->DeferPacket(m_flowid, priority, seq.GetValue(), materialize))
+            continue;
+      SendLowPriorityPacketAt(seq.GetValue(), priority);
+      pq->AdoptLastPacket(m_flowid, priority, seq.GetValue(), materialize);
+  }
 }
 
 
 bool
 TcpRC3Sack::SendLowPriorityPacket()
+{
+  SequenceNumber32 seq;
+  uint8_t priority;
+  if(!NextLowPriorityPacket(seq, priority))
+    return false;
+  SendLowPriorityPacketAt(seq.GetValue(), priority);
+  return true;
+}
+
+//picks the next low priority segment, walking back from the tail of the
+//buffer, and its priority
+bool
+TcpRC3Sack::NextLowPriorityPacket(SequenceNumber32 &seq, uint8_t &priority)
 {
   if(m_state != ESTABLISHED) return false;
   
@@ -1321,7 +1375,7 @@ TcpRC3Sack::SendLowPriorityPacket()
 
   uint32_t maxSize = m_segmentSize;
  
-  SequenceNumber32 seq(p2_block_max - p2_block_bytes_sent - maxSize);
+  seq = SequenceNumber32(p2_block_max - p2_block_bytes_sent - maxSize);
   
   if(seq + maxSize <= m_nextTxSequence)
   {
@@ -1341,12 +1395,7 @@ TcpRC3Sack::SendLowPriorityPacket()
 
   p2_block_bytes_sent += maxSize;
 
-  NS_LOG_FUNCTION (this << seq << maxSize );
-  Ptr<Packet> p = m_txBuffer.CopyFromSequence (maxSize, seq);
-  uint8_t flags =  0; 
-
-
-  uint8_t priority = 1;
+  priority = 1;
 
   uint32_t maxseq = p2_block_max;
   int packetCounter;
@@ -1356,13 +1405,37 @@ TcpRC3Sack::SendLowPriorityPacket()
   if(m_multipriorities)
       priority = ceil(log10(temp));
 
+  NS_LOG_INFO(this<<"Sending rc3 data "<<seq<<" "<<packetCounter<<" "<<m_flowid<<" "<<(uint16_t)priority);
+  return true;
+}
+
+void
+TcpRC3Sack::SendLowPriorityPacketAt(uint32_t sequence, uint8_t priority)
+{
+  if (m_endPoint == 0 && m_endPoint6 == 0)
+    return;
+
+  SequenceNumber32 seq(sequence);
+  uint32_t maxSize = m_segmentSize;
+  NS_LOG_FUNCTION (this << seq << maxSize );
+  Ptr<Packet> p;
+  if(seq < m_txBuffer.HeadSequence())
+    {
+      //a deferred packet whose data was acked meanwhile, only its size matters
+      p = Create<Packet> (maxSize);
+    }
+  else
+    {
+      p = m_txBuffer.CopyFromSequence (maxSize, seq);
+    }
+  uint8_t flags =  0; 
+
 
   MyPriorityTag tag;
   tag.SetId(m_flowid);
   tag.SetPriority(priority);
   p -> AddPacketTag(tag);
 
-  NS_LOG_INFO(this<<"Sending rc3 data "<<seq<<" "<<packetCounter<<" "<<tag.GetId()<<" "<<(uint16_t)tag.GetPriority());
   if (IsManualIpTos ())
     {    
       SocketIpTosTag ipTosTag;
@@ -1420,7 +1493,6 @@ TcpRC3Sack::SendLowPriorityPacket()
   // Update highTxMark
   //m_highTxMark = std::max (seq + sz, m_highTxMark.Get ());
   //m_nextTxSequence += sz;
-  return true;
 }
 
 } // namespace ns3
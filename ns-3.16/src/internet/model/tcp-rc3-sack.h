@@ -26,9 +26,12 @@
 #define SACKSTACKSZ 3
 #include <deque>
 #include "ns3/queue.h"
+#include "ns3/traced-callback.h"
 
 namespace ns3 {
 
+class RecordStream;
+
 /**
  * \ingroup socket
  * \ingroup tcp
@@ -92,6 +95,8 @@ protected:
 
   void StartRLPLoop();
   bool SendLowPriorityPacket();
+  bool NextLowPriorityPacket(SequenceNumber32 &seq, uint8_t &priority);
+  void SendLowPriorityPacketAt(uint32_t seq, uint8_t priority);
 
 
 private:
@@ -105,6 +110,8 @@ private:
   uint32_t               p2_sent_count;
 protected:
   TracedValue<uint32_t>  m_cWnd;         //< Congestion window
+  TracedCallback<uint32_t> m_retransmitTrace; //< Retransmissions, with the flow id
+  TracedCallback<uint32_t> m_timeoutTrace;    //< Retransmission timeouts, with the flow id
   uint32_t               m_ssThresh;     //< Slow Start Threshold
   uint32_t               m_initialCWnd;  //< Initial cWnd value
   SequenceNumber32       m_recover;      //< Previous highest Tx seqnum for fast recovery
@@ -118,7 +125,14 @@ protected:
   bool                   m_logRTO;
   bool                   m_logAcks;
   bool                   m_logCleanUp;
+  std::string            m_rtoFile;
+  std::string            m_acksFile;
+  std::string            m_cleanUpFile;
+  RecordStream          *m_rtoStream;     // the streams are opened by their first record
+  RecordStream          *m_acksStream;
+  RecordStream          *m_cleanUpStream;
   bool                   m_flushOut;
+  bool                   m_pacedLowPriority; //defer low priority packets in m_devQueue
   Ptr<Queue>             m_devQueue;
   uint32_t               m_flowid;
   uint32_t               m_flowsize;
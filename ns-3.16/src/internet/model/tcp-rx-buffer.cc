@@ -152,8 +152,14 @@ TcpRxBuffer::Add (Ptr<Packet> p, TcpHeader const& tcph)
       if (maxSeq < tailSeq) tailSeq = maxSeq;
       if (tailSeq < headSeq) headSeq = tailSeq;
     }
-  // Remove overlapped bytes from packet
-  BufIterator i = m_data.begin ();
+  // Remove overlapped bytes from packet. The buffered packets do not
+  // overlap, so only the one holding headSeq and the following ones can
+  // overlap the new packet.
+  BufIterator i = m_data.upper_bound (headSeq);
+  if (i != m_data.begin ())
+    {
+      --i;
+    }
   while (i != m_data.end () && i->first <= tailSeq)
     {
       SequenceNumber32 lastByteSeq = i->first + SequenceNumber32 (i->second->GetSize ());
@@ -195,18 +201,15 @@ TcpRxBuffer::Add (Ptr<Packet> p, TcpHeader const& tcph)
   NS_LOG_LOGIC ("Buffered packet of seqno=" << headSeq << " len=" << p->GetSize ());
   // Update variables
   m_size += p->GetSize ();      // Occupancy
-  for (BufIterator i = m_data.begin (); i != m_data.end (); ++i)
+  AddBlock (headSeq, tailSeq);
+  // The in-sequence data now extends to the tail of the block holding
+  // m_nextRxSeq, if it is buffered
+  SequenceNumber32 blockHead;
+  SequenceNumber32 blockTail;
+  if (GetBlock (m_nextRxSeq, blockHead, blockTail))
     {
-      if (i->first < m_nextRxSeq)
-        {
-          continue;
-        }
-      else if (i->first > m_nextRxSeq)
-        {
-          break;
-        };
-      m_nextRxSeq = i->first + SequenceNumber32 (i->second->GetSize ());
-      m_availBytes += i->second->GetSize ();
+      m_availBytes += blockTail - m_nextRxSeq.Get ();
+      m_nextRxSeq = blockTail;
     }
   NS_LOG_LOGIC ("Updated buffer occupancy=" << m_size << " nextRxSeq=" << m_nextRxSeq);
   if (m_gotFin && m_nextRxSeq == m_finSeq)
@@ -256,9 +259,100 @@ TcpRxBuffer::Extract (uint32_t maxSize)
       NS_LOG_LOGIC ("Nothing extracted.");
       return 0;
     }
+  // The data was taken from the head of the first block
+  std::map<SequenceNumber32, SequenceNumber32>::iterator first = m_blocks.begin ();
+  SequenceNumber32 blockTail = first->second;
+  SequenceNumber32 blockHead = first->first + SequenceNumber32 (outPkt->GetSize ());
+  m_blocks.erase (first);
+  if (blockHead < blockTail)
+    {
+      m_blocks.insert (m_blocks.begin (), std::make_pair (blockHead, blockTail));
+    }
   NS_LOG_LOGIC ("Extracted " << outPkt->GetSize ( ) << " bytes, bufsize=" << m_size
                              << ", num pkts in buffer=" << m_data.size ());
   return outPkt;
 }
 
+bool
+TcpRxBuffer::GetBlock (SequenceNumber32 seq, SequenceNumber32 &left, SequenceNumber32 &right) const
+{
+  std::map<SequenceNumber32, SequenceNumber32>::const_iterator i = m_blocks.upper_bound (seq);
+  if (i == m_blocks.begin ())
+    {
+      return false;
+    }
+  --i;
+  if (i->second <= seq)
+    {
+      return false;
+    }
+  left = i->first;
+  right = i->second;
+  return true;
+}
+
+void
+TcpRxBuffer::GetSegmentRun (SequenceNumber32 seq, uint32_t segmentSize,
+                            SequenceNumber32 &left, SequenceNumber32 &right) const
+{
+  // Walk the keys of m_data from seq in both directions: every key is
+  // visited at most once, instead of one lookup per segment
+  std::map<SequenceNumber32, Ptr<Packet> >::const_iterator i = m_data.lower_bound (seq);
+  left = seq;
+  while (left > SequenceNumber32 (1))
+    {
+      SequenceNumber32 target = left - segmentSize;
+      while (i != m_data.begin ())
+        {
+          std::map<SequenceNumber32, Ptr<Packet> >::const_iterator prev = i;
+          --prev;
+          if (prev->first < target)
+            {
+              break;
+            }
+          i = prev;
+        }
+      if (i == m_data.end () || i->first != target)
+        {
+          break;
+        }
+      left = target;
+    }
+
+  right = seq + SequenceNumber32 (segmentSize);
+  i = m_data.lower_bound (right);
+  while (i != m_data.end () && i->first == right)
+    {
+      right = right + SequenceNumber32 (segmentSize);
+      while (i != m_data.end () && i->first < right)
+        {
+          ++i;
+        }
+    }
+}
+
+void
+TcpRxBuffer::AddBlock (SequenceNumber32 head, SequenceNumber32 tail)
+{
+  NS_LOG_FUNCTION (this << head << tail);
+  // Merge with the blocks overlapping or adjacent to [head, tail)
+  std::map<SequenceNumber32, SequenceNumber32>::iterator i = m_blocks.upper_bound (head);
+  if (i != m_blocks.begin ())
+    {
+      std::map<SequenceNumber32, SequenceNumber32>::iterator prev = i;
+      --prev;
+      if (prev->second >= head)
+        {
+          i = prev;
+        }
+    }
+  while (i != m_blocks.end () && i->first <= tail)
+    {
+      head = std::min (head, i->first);
+      tail = std::max (tail, i->second);
+      m_blocks.erase (i++);
+    }
+  m_blocks.insert (i, std::make_pair (head, tail));
+}
+
 } //namepsace ns3
@@ -72,6 +72,33 @@ public:
    * The extracted data is going to be forwarded to the application.
    */
   Ptr<Packet> Extract (uint32_t maxSize);
+
+  /**
+   * Find the contiguous block of buffered data which holds a sequence
+   * number, e.g. to build the SACK block of an out of order segment.
+   *
+   * \param seq a sequence number
+   * \param left set to the first sequence number of the block
+   * \param right set to the sequence number following the block
+   * \return true if seq is buffered, false otherwise
+   */
+  bool GetBlock (SequenceNumber32 seq, SequenceNumber32 &left, SequenceNumber32 &right) const;
+
+  /**
+   * Find the run of buffered segments starting every segmentSize bytes
+   * around a sequence number, as advertised in the SACK blocks of
+   * TcpRC3Sack. Unlike GetBlock, the run stops at the first segment
+   * which does not start on the segmentSize grid of seq.
+   *
+   * \param seq the sequence number of a received segment
+   * \param segmentSize the segment size of the grid
+   * \param left set to the first sequence number of the run
+   * \param right set to the sequence number following the run
+   */
+  void GetSegmentRun (SequenceNumber32 seq, uint32_t segmentSize,
+                      SequenceNumber32 &left, SequenceNumber32 &right) const;
+private:
+  void AddBlock (SequenceNumber32 head, SequenceNumber32 tail);
 public:
   typedef std::map<SequenceNumber32, Ptr<Packet> >::iterator BufIterator;
   TracedValue<SequenceNumber32> m_nextRxSeq; //< Seqnum of the first missing byte in data (RCV.NXT)
@@ -82,6 +109,8 @@ public:
   uint32_t m_availBytes;                     //< Number of bytes available to read, i.e. contiguous block at head
   std::map<SequenceNumber32, Ptr<Packet> > m_data;
   //< Corresponding data (may be null)
+  std::map<SequenceNumber32, SequenceNumber32> m_blocks;
+  //< The buffered data as disjoint, non adjacent [head, tail) ranges, keyed by head
 };
 
 } //namepsace ns3
@@ -39,6 +39,7 @@
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
+#include "ns3/boolean.h"
 #include "ns3/trace-source-accessor.h"
 #include "tcp-socket-base.h"
 #include "tcp-l4-protocol.h"
@@ -75,6 +76,13 @@ TcpSocketBase::GetTypeId (void)
                    UintegerValue (65535),
                    MakeUintegerAccessor (&TcpSocketBase::m_maxWinSize),
                    MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("VirtualPayload",
+                   "Keep only the size of the packets sent by the application in the Tx buffer and "
+                   "send zero-filled segments. For applications sending size-only packets: "
+                   "the content and the tags of the packets are not sent.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_virtualPayload),
+                   MakeBooleanChecker ())
     .AddAttribute ("IcmpCallback", "Callback invoked whenever an icmp error is received on this socket.",
                    CallbackValue (),
                    MakeCallbackAccessor (&TcpSocketBase::m_icmpCallback),
@@ -118,6 +126,7 @@ TcpSocketBase::TcpSocketBase (void)
     m_highTxMark (0),
     m_rxBuffer (0),
     m_txBuffer (0),
+    m_virtualPayload (false),
     m_state (CLOSED),
     m_errno (ERROR_NOTERROR),
     m_closeNotified (false),
@@ -130,6 +139,10 @@ TcpSocketBase::TcpSocketBase (void)
     m_rWnd (0)
 {
   NS_LOG_FUNCTION (this);
+  m_retxEvent.SetFunction (&TcpSocketBase::RetxExpired, this);
+  m_lastAckEvent.SetFunction (&TcpSocketBase::LastAckTimeout, this);
+  m_delAckEvent.SetFunction (&TcpSocketBase::DelAckTimeout, this);
+  m_persistEvent.SetFunction (&TcpSocketBase::PersistTimeout, this);
 }
 
 TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
@@ -152,6 +165,7 @@ TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
     m_highTxMark (sock.m_highTxMark),
     m_rxBuffer (sock.m_rxBuffer),
     m_txBuffer (sock.m_txBuffer),
+    m_virtualPayload (sock.m_virtualPayload),
     m_state (sock.m_state),
     m_errno (sock.m_errno),
     m_closeNotified (sock.m_closeNotified),
@@ -166,6 +180,10 @@ TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
 {
   NS_LOG_FUNCTION (this);
   NS_LOG_LOGIC ("Invoked the copy constructor");
+  m_retxEvent.SetFunction (&TcpSocketBase::RetxExpired, this);
+  m_lastAckEvent.SetFunction (&TcpSocketBase::LastAckTimeout, this);
+  m_delAckEvent.SetFunction (&TcpSocketBase::DelAckTimeout, this);
+  m_persistEvent.SetFunction (&TcpSocketBase::PersistTimeout, this);
   // Copy the rtt estimator if it is set
   if (sock.m_rtt)
     {
@@ -493,7 +511,7 @@ TcpSocketBase::Send (Ptr<Packet> p, uint32_t flags)
   if (m_state == ESTABLISHED || m_state == SYN_SENT || m_state == CLOSE_WAIT)
     {
       // Store the packet into Tx buffer
-      if (!m_txBuffer.Add (p))
+      if (!(m_virtualPayload ? m_txBuffer.AddVirtual (p->GetSize ()) : m_txBuffer.Add (p)))
         { // TxBuffer overflow, send failed
           m_errno = ERROR_MSGSIZE;
           return -1;
@@ -1483,8 +1501,7 @@ TcpSocketBase::DoPeerClose (void)
   if (m_state == LAST_ACK)
     {
       NS_LOG_LOGIC ("TcpSocketBase " << this << " scheduling LATO1");
-      m_lastAckEvent = Simulator::Schedule (m_rtt->RetransmitTimeout (),
-                                            &TcpSocketBase::LastAckTimeout, this);
+      m_lastAckEvent.Schedule (m_rtt->RetransmitTimeout ());
     }
 }
 
@@ -1505,7 +1522,7 @@ TcpSocketBase::Destroy (void)
         }
     }
   NS_LOG_LOGIC (this << " Cancelled ReTxTimeout event which was set to expire at " <<
-                (Simulator::Now () + Simulator::GetDelayLeft (m_retxEvent)).GetSeconds ());
+                (Simulator::Now () + m_retxEvent.GetDelayLeft ()).GetSeconds ());
   CancelAllTimers ();
 }
 
@@ -1526,7 +1543,7 @@ TcpSocketBase::Destroy6 (void)
         }
     }
   NS_LOG_LOGIC (this << " Cancelled ReTxTimeout event which was set to expire at " <<
-                (Simulator::Now () + Simulator::GetDelayLeft (m_retxEvent)).GetSeconds ());
+                (Simulator::Now () + m_retxEvent.GetDelayLeft ()).GetSeconds ());
   CancelAllTimers ();
 }
 
@@ -1641,7 +1658,8 @@ TcpSocketBase::SendEmptyPacket (uint8_t flags)
       NS_LOG_LOGIC ("Schedule retransmission timeout at time "
                     << Simulator::Now ().GetSeconds () << " to expire at time "
                     << (Simulator::Now () + m_rto.Get ()).GetSeconds ());
-      m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::SendEmptyPacket, this, flags);
+      m_retxEvent.SetArguments (flags);
+      m_retxEvent.Schedule (m_rto);
     }
 }
 
@@ -1886,7 +1904,8 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
       NS_LOG_LOGIC (this << " SendDataPacket Schedule ReTxTimeout at time " <<
                     Simulator::Now ().GetSeconds () << " to expire at time " <<
                     (Simulator::Now () + m_rto.Get ()).GetSeconds () );
-      m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::ReTxTimeout, this);
+      m_retxEvent.SetArguments ((uint8_t) 0);
+      m_retxEvent.Schedule (m_rto);
     }
   NS_LOG_LOGIC ("Send packet via TcpL4Protocol with flags 0x" << std::hex << static_cast<uint32_t> (flags) << std::dec);
   //std::cout << "Sending packet... " << Simulator::Now().GetSeconds() << std::endl;
@@ -2037,9 +2056,8 @@ TcpSocketBase::ReceivedData (Ptr<Packet> p, const TcpHeader& tcpHeader)
         }
       else if (m_delAckEvent.IsExpired ())
         {
-          m_delAckEvent = Simulator::Schedule (m_delAckTimeout,
-                                               &TcpSocketBase::DelAckTimeout, this);
-          NS_LOG_LOGIC (this << " scheduled delayed ACK at " << (Simulator::Now () + Simulator::GetDelayLeft (m_delAckEvent)).GetSeconds ());
+          m_delAckEvent.Schedule (m_delAckTimeout);
+          NS_LOG_LOGIC (this << " scheduled delayed ACK at " << (Simulator::Now () + m_delAckEvent.GetDelayLeft ()).GetSeconds ());
         }
     }
   // Notify app to receive if necessary
@@ -2093,26 +2111,27 @@ TcpSocketBase::NewAck (SequenceNumber32 const& ack)
   if (m_state != SYN_RCVD)
     { // Set RTO unless the ACK is received in SYN_RCVD state
       NS_LOG_LOGIC (this << " Cancelled ReTxTimeout event which was set to expire at " <<
-                    (Simulator::Now () + Simulator::GetDelayLeft (m_retxEvent)).GetSeconds ());
+                    (Simulator::Now () + m_retxEvent.GetDelayLeft ()).GetSeconds ());
       m_retxEvent.Cancel ();
       // On recieving a "New" ack we restart retransmission timer .. RFC 2988
       m_rto = m_rtt->RetransmitTimeout ();
       NS_LOG_LOGIC (this << " Schedule ReTxTimeout at time " <<
                     Simulator::Now ().GetSeconds () << " to expire at time " <<
                     (Simulator::Now () + m_rto.Get ()).GetSeconds ());
-      m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::ReTxTimeout, this);
+      m_retxEvent.SetArguments ((uint8_t) 0);
+      m_retxEvent.Schedule (m_rto);
     }
   if (m_rWnd.Get () == 0 && m_persistEvent.IsExpired ())
     { // Zero window: Enter persist state to send 1 byte to probe
       NS_LOG_LOGIC (this << "Enter zerowindow persist state");
       NS_LOG_LOGIC (this << "Cancelled ReTxTimeout event which was set to expire at " <<
-                    (Simulator::Now () + Simulator::GetDelayLeft (m_retxEvent)).GetSeconds ());
+                    (Simulator::Now () + m_retxEvent.GetDelayLeft ()).GetSeconds ());
       m_retxEvent.Cancel ();
       NS_LOG_LOGIC ("Schedule persist timeout at time " <<
                     Simulator::Now ().GetSeconds () << " to expire at time " <<
                     (Simulator::Now () + m_persistTimeout).GetSeconds ());
-      m_persistEvent = Simulator::Schedule (m_persistTimeout, &TcpSocketBase::PersistTimeout, this);
-      NS_ASSERT (m_persistTimeout == Simulator::GetDelayLeft (m_persistEvent));
+      m_persistEvent.Schedule (m_persistTimeout);
+      NS_ASSERT (m_persistTimeout == m_persistEvent.GetDelayLeft ());
     }
   // Note the highest ACK and tell app to send more
   NS_LOG_INFO ("TCP " << this << " NewAck " << ack <<
@@ -2129,7 +2148,7 @@ TcpSocketBase::NewAck (SequenceNumber32 const& ack)
   if (m_txBuffer.Size () == 0 && m_state != FIN_WAIT_1 && m_state != CLOSING)
     { // No retransmit timer if no data to retransmit
       NS_LOG_LOGIC (this << " Cancelled ReTxTimeout event which was set to expire at " <<
-                    (Simulator::Now () + Simulator::GetDelayLeft (m_retxEvent)).GetSeconds ());
+                    (Simulator::Now () + m_retxEvent.GetDelayLeft ()).GetSeconds ());
       m_retxEvent.Cancel ();
     }
   // Try to send more data
@@ -2156,6 +2175,21 @@ TcpSocketBase::ReTxTimeout ()
   Retransmit ();
 }
 
+// The retransmission timer guards either data, or a SYN or FIN sent by
+// SendEmptyPacket(), which is resent with the same flags
+void
+TcpSocketBase::RetxExpired (uint8_t flags)
+{
+  if (flags == 0)
+    {
+      ReTxTimeout ();
+    }
+  else
+    {
+      SendEmptyPacket (flags);
+    }
+}
+
 void
 TcpSocketBase::DelAckTimeout (void)
 {
@@ -2217,7 +2251,7 @@ TcpSocketBase::PersistTimeout ()
   NS_LOG_LOGIC ("Schedule persist timeout at time "
                 << Simulator::Now ().GetSeconds () << " to expire at time "
                 << (Simulator::Now () + m_persistTimeout).GetSeconds ());
-  m_persistEvent = Simulator::Schedule (m_persistTimeout, &TcpSocketBase::PersistTimeout, this);
+  m_persistEvent.Schedule (m_persistTimeout);
 }
 
 void
@@ -32,6 +32,7 @@
 #include "ns3/ipv4-interface.h"
 #include "ns3/ipv6-header.h"
 #include "ns3/event-id.h"
+#include "ns3/rearmable-timer.h"
 #include "tcp-tx-buffer.h"
 #include "tcp-rx-buffer.h"
 #include "rtt-estimator.h"
@@ -185,6 +186,7 @@ protected:
   virtual void NewAck (SequenceNumber32 const& seq); // Update buffers w.r.t. ACK
   virtual void DupAck (const TcpHeader& t, uint32_t count) = 0; // Received dupack
   virtual void ReTxTimeout (void); // Call Retransmit() upon RTO event
+  void RetxExpired (uint8_t flags); // Resend the flags if any, else ReTxTimeout()
   virtual void Retransmit (void); // Halving cwnd and call DoRetransmit()
   virtual void DelAckTimeout (void);  // Action upon delay ACK timeout, i.e. send an ACK
   virtual void LastAckTimeout (void); // Timeout at LAST_ACK, close the connection
@@ -195,10 +197,10 @@ protected:
 
 protected:
   // Counters and events
-  EventId           m_retxEvent;       //< Retransmission event
-  EventId           m_lastAckEvent;    //< Last ACK timeout event
-  EventId           m_delAckEvent;     //< Delayed ACK timeout event
-  EventId           m_persistEvent;    //< Persist event: Send 1 byte to probe for a non-zero Rx window
+  RearmableTimer    m_retxEvent;       //< Retransmission timer
+  RearmableTimer    m_lastAckEvent;    //< Last ACK timeout timer
+  RearmableTimer    m_delAckEvent;     //< Delayed ACK timer
+  RearmableTimer    m_persistEvent;    //< Persist timer: Send 1 byte to probe for a non-zero Rx window
   EventId           m_timewaitEvent;   //< TIME_WAIT expiration event: Move this socket to CLOSED state
   uint32_t          m_dupAckCount;     //< Dupack counter
   uint32_t          m_delAckCount;     //< Delayed ACK counter
@@ -228,6 +230,7 @@ protected:
   TracedValue<SequenceNumber32> m_highTxMark;     //< Highest seqno ever sent, regardless of ReTx
   TcpRxBuffer                   m_rxBuffer;       //< Rx buffer (reordering buffer)
   TcpTxBuffer                   m_txBuffer;       //< Tx buffer
+  bool                          m_virtualPayload; //< Buffer the sent data as a byte count only
 
   // State-related attributes
   TracedValue<TcpStates_t> m_state;         //< TCP state
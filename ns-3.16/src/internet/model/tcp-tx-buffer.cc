@@ -53,7 +53,7 @@ TcpTxBuffer::GetTypeId (void)
  * initialized below is insignificant.
  */
 TcpTxBuffer::TcpTxBuffer (uint32_t n)
-  : m_firstByteSeq (n), m_size (0), m_maxBuffer (32768), m_data (0)
+  : m_firstByteSeq (n), m_size (0), m_maxBuffer (32768), m_headOffset (0)
 {
 }
 
@@ -101,14 +101,38 @@ bool
 TcpTxBuffer::Add (Ptr<Packet> p)
 {
   NS_LOG_FUNCTION (this << p);
-  NS_LOG_LOGIC ("Packet of size " << p->GetSize () << " appending to window starting at "
+  return Append (p, p->GetSize ());
+}
+
+bool
+TcpTxBuffer::AddVirtual (uint32_t size)
+{
+  NS_LOG_FUNCTION (this << size);
+  return Append (0, size);
+}
+
+bool
+TcpTxBuffer::Append (Ptr<Packet> p, uint32_t size)
+{
+  NS_LOG_LOGIC ("Packet of size " << size << " appending to window starting at "
                                   << m_firstByteSeq << ", availSize="<< Available ());
-  if (p->GetSize () <= Available ())
+  if (size <= Available ())
     {
-      if (p->GetSize () > 0)
+      if (size > 0)
         {
-          m_data.push_back (p);
-          m_size += p->GetSize ();
+          if (p == 0 && !m_data.empty () && m_data.back ().packet == 0)
+            { // Consecutive virtual payload is kept as a single segment
+              m_data.back ().size += size;
+            }
+          else
+            {
+              Segment segment;
+              segment.packet = p;
+              segment.size = size;
+              segment.start = m_headOffset + m_size;
+              m_data.push_back (segment);
+            }
+          m_size += size;
           NS_LOG_LOGIC ("Updated size=" << m_size << ", lastSeq=" << m_firstByteSeq + SequenceNumber32 (m_size));
         }
       return true;
@@ -117,6 +141,27 @@ TcpTxBuffer::Add (Ptr<Packet> p)
   return false;
 }
 
+TcpTxBuffer::BufIterator
+TcpTxBuffer::Find (uint64_t offset)
+{
+  // Binary search of the last segment starting at or before offset
+  uint32_t low = 0;
+  uint32_t high = m_data.size ();
+  while (high - low > 1)
+    {
+      uint32_t middle = low + (high - low) / 2;
+      if (m_data[middle].start <= offset)
+        {
+          low = middle;
+        }
+      else
+        {
+          high = middle;
+        }
+    }
+  return m_data.begin () + low;
+}
+
 uint32_t
 TcpTxBuffer::SizeFromSequence (const SequenceNumber32& seq) const
 {
@@ -144,59 +189,43 @@ TcpTxBuffer::CopyFromSequence (uint32_t numBytes, const SequenceNumber32& seq)
     }
 
   // Extract data from the buffer and return
-  uint32_t offset = seq - m_firstByteSeq.Get ();
-  uint32_t count = 0;      // Offset of the first byte of a packet in the buffer
-  uint32_t pktSize = 0;
-  bool beginFound = false;
-  int pktCount = 0;
-  Ptr<Packet> outPacket;
-  NS_LOG_LOGIC ("There are " << m_data.size () << " number of packets in buffer");
-  for (BufIterator i = m_data.begin (); i != m_data.end (); ++i)
+  uint32_t delta = seq - m_firstByteSeq.Get ();  // Offset of seq from the head of the buffer
+  uint64_t offset = m_headOffset + delta;
+  BufIterator i = Find (offset);
+  uint32_t packetOffset = offset - i->start;
+  uint32_t fragmentLength = std::min (s, i->size - packetOffset);
+  NS_LOG_LOGIC ("First byte found in the packet at buffer offset " << i->start - m_headOffset
+                                                                     << ", packet len=" << i->size);
+  Ptr<Packet> outPacket = CreateFragment (*i, packetOffset, fragmentLength);
+  while (outPacket->GetSize () < s)
     {
-      pktCount++;
-      pktSize = (*i)->GetSize ();
-      if (!beginFound)
-        { // Look for first fragment
-          if (count + pktSize > offset)
-            {
-              NS_LOG_LOGIC ("First byte found in packet #" << pktCount << " at buffer offset " << count
-                                                           << ", packet len=" << pktSize);
-              beginFound = true;
-              uint32_t packetOffset = offset - count;
-              uint32_t fragmentLength = count + pktSize - offset;
-              if (fragmentLength >= s)
-                { // Data to be copied falls entirely in this packet
-                  return (*i)->CreateFragment (packetOffset, s);
-                }
-              else
-                { // This packet only fulfills part of the request
-                  outPacket = (*i)->CreateFragment (packetOffset, fragmentLength);
-                }
-              NS_LOG_LOGIC ("Output packet is now of size " << outPacket->GetSize ());
-            }
-        }
-      else if (count + pktSize >= offset + s)
-        { // Last packet fragment found
-          NS_LOG_LOGIC ("Last byte found in packet #" << pktCount << " at buffer offset " << count
-                                                      << ", packet len=" << pktSize);
-          uint32_t fragmentLength = offset + s - count;
-          Ptr<Packet> endFragment = (*i)->CreateFragment (0, fragmentLength);
-          outPacket->AddAtEnd (endFragment);
-          NS_LOG_LOGIC ("Output packet is now of size " << outPacket->GetSize ());
-          break;
+      ++i;
+      uint32_t remaining = s - outPacket->GetSize ();
+      if (i->size < remaining && i->packet != 0)
+        {
+          NS_LOG_LOGIC ("Appending to output the packet of offset " << i->start - m_headOffset << " len=" << i->size);
+          outPacket->AddAtEnd (i->packet);
         }
       else
         {
-          NS_LOG_LOGIC ("Appending to output the packet #" << pktCount << " of offset " << count << " len=" << pktSize);
-          outPacket->AddAtEnd (*i);
-          NS_LOG_LOGIC ("Output packet is now of size " << outPacket->GetSize ());
+          outPacket->AddAtEnd (CreateFragment (*i, 0, std::min (remaining, i->size)));
         }
-      count += pktSize;
+      NS_LOG_LOGIC ("Output packet is now of size " << outPacket->GetSize ());
     }
   NS_ASSERT (outPacket->GetSize () == s);
   return outPacket;
 }
 
+Ptr<Packet>
+TcpTxBuffer::CreateFragment (const Segment &segment, uint32_t offset, uint32_t length) const
+{
+  if (segment.packet == 0)
+    {
+      return Create<Packet> (length);
+    }
+  return segment.packet->CreateFragment (offset, length);
+}
+
 void
 TcpTxBuffer::SetHeadSequence (const SequenceNumber32& seq)
 {
@@ -213,32 +242,31 @@ TcpTxBuffer::DiscardUpTo (const SequenceNumber32& seq)
   // Cases do not need to scan the buffer
   if (m_firstByteSeq >= seq) return;
 
-  // Scan the buffer and discard packets
+  // Discard the segments behind the seqnum, and fragment the one holding it
   uint32_t offset = seq - m_firstByteSeq.Get ();  // Number of bytes to remove
-  uint32_t pktSize;
+  offset = std::min (offset, m_size);
+  uint64_t head = m_headOffset + offset;
   NS_LOG_LOGIC ("Offset=" << offset);
-  BufIterator i = m_data.begin ();
-  while (i != m_data.end ())
+  while (!m_data.empty () && m_data.front ().start + m_data.front ().size <= head)
     {
-      if (offset > (*i)->GetSize ())
-        { // This packet is behind the seqnum. Remove this packet from the buffer
-          pktSize = (*i)->GetSize ();
-          m_size -= pktSize;
-          offset -= pktSize;
-          m_firstByteSeq += pktSize;
-          i = m_data.erase (i);
-          NS_LOG_LOGIC ("Removed one packet of size " << pktSize << ", offset=" << offset);
-        }
-      else if (offset > 0)
-        { // Part of the packet is behind the seqnum. Fragment
-          pktSize = (*i)->GetSize () - offset;
-          *i = (*i)->CreateFragment (offset, pktSize);
-          m_size -= offset;
-          m_firstByteSeq += offset;
-          NS_LOG_LOGIC ("Fragmented one packet by size " << offset << ", new size=" << pktSize);
-          break;
+      NS_LOG_LOGIC ("Removed one packet of size " << m_data.front ().size);
+      m_data.pop_front ();
+    }
+  if (!m_data.empty () && m_data.front ().start < head)
+    {
+      Segment &front = m_data.front ();
+      uint32_t cut = head - front.start;
+      if (front.packet != 0)
+        {
+          front.packet = front.packet->CreateFragment (cut, front.size - cut);
         }
+      front.size -= cut;
+      front.start = head;
+      NS_LOG_LOGIC ("Fragmented one packet by size " << cut << ", new size=" << front.size);
     }
+  m_size -= offset;
+  m_headOffset = head;
+  m_firstByteSeq += offset;
   // Catching the case of ACKing a FIN
   if (m_size == 0)
     {
@@ -21,7 +21,7 @@
 #ifndef TCP_TX_BUFFER_H
 #define TCP_TX_BUFFER_H
 
-#include <list>
+#include <deque>
 #include "ns3/traced-value.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/object.h"
@@ -84,6 +84,17 @@ public:
    */
   bool Add (Ptr<Packet> p);
 
+  /**
+   * Append size bytes of zero-filled payload to the end of the buffer
+   * without storing any packet: the segments copied from these bytes are
+   * created with Create<Packet> (size). For applications which only send
+   * size-only packets, see TcpSocketBase::VirtualPayload.
+   *
+   * \param size The number of bytes to append
+   * \return Boolean to indicate success
+   */
+  bool AddVirtual (uint32_t size);
+
   /**
    * Returns the number of bytes from the buffer in the range [seq, tailSequence)
    */
@@ -108,12 +119,26 @@ public:
   void DiscardUpTo (const SequenceNumber32& seq);
 
 private:
-  typedef std::list<Ptr<Packet> >::iterator BufIterator;
+  /**
+   * The data appended by one Add, or by consecutive AddVirtual
+   */
+  struct Segment
+  {
+    Ptr<Packet> packet;                         //< The data, null for virtual payload
+    uint32_t size;                              //< Number of data bytes
+    uint64_t start;                             //< Offset of the first byte since the buffer was created
+  };
+  typedef std::deque<Segment>::iterator BufIterator;
+
+  BufIterator Find (uint64_t offset);
+  Ptr<Packet> CreateFragment (const Segment &segment, uint32_t offset, uint32_t length) const;
+  bool Append (Ptr<Packet> p, uint32_t size);
 
   TracedValue<SequenceNumber32> m_firstByteSeq; //< Sequence number of the first byte in data (SND.UNA)
   uint32_t m_size;                              //< Number of data bytes
   uint32_t m_maxBuffer;                         //< Max number of data bytes in buffer (SND.WND)
-  std::list<Ptr<Packet> > m_data;               //< Corresponding data (may be null)
+  uint64_t m_headOffset;                        //< Offset of m_firstByteSeq since the buffer was created
+  std::deque<Segment> m_data;                   //< Corresponding data, ordered by start
 };
 
 } // namepsace ns3
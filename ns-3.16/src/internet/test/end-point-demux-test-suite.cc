@@ -0,0 +1,447 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/node.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/loopback-net-device.h"
+#include "ns3/ipv4-interface.h"
+#include "ns3/ipv4-end-point.h"
+#include "ns3/ipv4-end-point-demux.h"
+#include "ns3/ipv6-interface.h"
+#include "ns3/ipv6-end-point.h"
+#include "ns3/ipv6-end-point-demux.h"
+
+using namespace ns3;
+
+// The matching rules of the original list scanning Ipv4EndPointDemux::Lookup,
+// applied to the end points in allocation order
+static Ipv4EndPointDemux::EndPoints
+ScanLookup (const Ipv4EndPointDemux::EndPoints &endPoints,
+            Ipv4Address daddr, uint16_t dport, Ipv4Address saddr, uint16_t sport,
+            Ptr<Ipv4Interface> incomingInterface)
+{
+  Ipv4EndPointDemux::EndPoints retval1, retval2, retval3, retval4;
+  for (Ipv4EndPointDemux::EndPoints::const_iterator i = endPoints.begin (); i != endPoints.end (); i++)
+    {
+      Ipv4EndPoint* endP = *i;
+      if (endP->GetLocalPort () != dport)
+        {
+          continue;
+        }
+      if (endP->GetBoundNetDevice () && endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
+        {
+          continue;
+        }
+      bool subnetDirected = false;
+      Ipv4Address incomingInterfaceAddr = daddr;
+      for (uint32_t j = 0; j < incomingInterface->GetNAddresses (); j++)
+        {
+          Ipv4InterfaceAddress addr = incomingInterface->GetAddress (j);
+          if (addr.GetLocal ().CombineMask (addr.GetMask ()) == daddr.CombineMask (addr.GetMask ()) &&
+              daddr.IsSubnetDirectedBroadcast (addr.GetMask ()))
+            {
+              subnetDirected = true;
+              incomingInterfaceAddr = addr.GetLocal ();
+            }
+        }
+      bool isBroadcast = (daddr.IsBroadcast () || subnetDirected == true);
+      bool localAddressMatchesWildCard = endP->GetLocalAddress () == Ipv4Address::GetAny ();
+      bool localAddressMatchesExact = endP->GetLocalAddress () == daddr;
+      if (isBroadcast && (endP->GetLocalAddress () != Ipv4Address::GetAny ()))
+        {
+          localAddressMatchesExact = (endP->GetLocalAddress () == incomingInterfaceAddr);
+        }
+      if (!(localAddressMatchesExact || localAddressMatchesWildCard))
+        continue;
+      bool remotePeerMatchesExact = endP->GetPeerPort () == sport;
+      bool remotePeerMatchesWildCard = endP->GetPeerPort () == 0;
+      bool remoteAddressMatchesExact = endP->GetPeerAddress () == saddr;
+      bool remoteAddressMatchesWildCard = endP->GetPeerAddress () == Ipv4Address::GetAny ();
+      if (!(remotePeerMatchesExact || remotePeerMatchesWildCard))
+        continue;
+      if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
+        continue;
+      if (localAddressMatchesWildCard && remotePeerMatchesWildCard && remoteAddressMatchesWildCard)
+        {
+          retval1.push_back (endP);
+        }
+      if ((localAddressMatchesExact || (isBroadcast && localAddressMatchesWildCard)) &&
+          remotePeerMatchesWildCard && remoteAddressMatchesWildCard)
+        {
+          retval2.push_back (endP);
+        }
+      if (localAddressMatchesWildCard && remotePeerMatchesExact && remoteAddressMatchesExact)
+        {
+          retval3.push_back (endP);
+        }
+      if (localAddressMatchesExact && remotePeerMatchesExact && remoteAddressMatchesExact)
+        {
+          retval4.push_back (endP);
+        }
+    }
+  if (!retval4.empty ()) return retval4;
+  if (!retval3.empty ()) return retval3;
+  if (!retval2.empty ()) return retval2;
+  return retval1;
+}
+
+// The original list scanning Ipv6EndPointDemux::Lookup
+static Ipv6EndPointDemux::EndPoints
+ScanLookup (const Ipv6EndPointDemux::EndPoints &endPoints,
+            Ipv6Address daddr, uint16_t dport, Ipv6Address saddr, uint16_t sport,
+            Ptr<Ipv6Interface> incomingInterface)
+{
+  Ipv6EndPointDemux::EndPoints retval1, retval2, retval3, retval4;
+  for (Ipv6EndPointDemux::EndPoints::const_iterator i = endPoints.begin (); i != endPoints.end (); i++)
+    {
+      Ipv6EndPoint* endP = *i;
+      if (endP->GetLocalPort () != dport)
+        {
+          continue;
+        }
+      if (endP->GetBoundNetDevice () && endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
+        {
+          continue;
+        }
+      bool localAddressMatchesWildCard = endP->GetLocalAddress () == Ipv6Address::GetAny ();
+      bool localAddressMatchesExact = endP->GetLocalAddress () == daddr;
+      bool localAddressMatchesAllRouters = endP->GetLocalAddress () == Ipv6Address::GetAllRoutersMulticast ();
+      if (!(localAddressMatchesExact || localAddressMatchesWildCard))
+        continue;
+      bool remotePeerMatchesExact = endP->GetPeerPort () == sport;
+      bool remotePeerMatchesWildCard = endP->GetPeerPort () == 0;
+      bool remoteAddressMatchesExact = endP->GetPeerAddress () == saddr;
+      bool remoteAddressMatchesWildCard = endP->GetPeerAddress () == Ipv6Address::GetAny ();
+      if (!(remotePeerMatchesExact || remotePeerMatchesWildCard))
+        continue;
+      if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
+        continue;
+      if (localAddressMatchesWildCard && remotePeerMatchesWildCard && remoteAddressMatchesWildCard)
+        {
+          retval1.push_back (endP);
+        }
+      if ((localAddressMatchesExact || localAddressMatchesAllRouters) &&
+          remotePeerMatchesWildCard && remoteAddressMatchesWildCard)
+        {
+          retval2.push_back (endP);
+        }
+      if (localAddressMatchesWildCard && remotePeerMatchesExact && remoteAddressMatchesExact)
+        {
+          retval3.push_back (endP);
+        }
+      if (localAddressMatchesExact && remotePeerMatchesExact && remoteAddressMatchesExact)
+        {
+          retval4.push_back (endP);
+        }
+    }
+  if (!retval4.empty ()) return retval4;
+  if (!retval3.empty ()) return retval3;
+  if (!retval2.empty ()) return retval2;
+  return retval1;
+}
+
+// The original list scanning SimpleLookup, for both address families
+template <typename EndPoints, typename Address>
+static typename EndPoints::value_type
+ScanSimpleLookup (const EndPoints &endPoints, Address dst, uint16_t dport, Address src, uint16_t sport, Address any)
+{
+  uint32_t genericity = 3;
+  typename EndPoints::value_type generic = 0;
+  for (typename EndPoints::const_iterator i = endPoints.begin (); i != endPoints.end (); i++)
+    {
+      if ((*i)->GetLocalPort () != dport)
+        {
+          continue;
+        }
+      if ((*i)->GetLocalAddress () == dst && (*i)->GetPeerPort () == sport &&
+          (*i)->GetPeerAddress () == src)
+        {
+          return *i;
+        }
+      uint32_t tmp = 0;
+      if ((*i)->GetLocalAddress () == any)
+        {
+          tmp++;
+        }
+      if ((*i)->GetPeerAddress () == any)
+        {
+          tmp++;
+        }
+      if (tmp < genericity)
+        {
+          generic = (*i);
+          genericity = tmp;
+        }
+    }
+  return generic;
+}
+
+// Few addresses and ports so that wildcards, duplicates and exact
+// matches all show up
+static const uint16_t g_ports[] = { 80, 81, 5000 };
+
+class Ipv4EndPointDemuxTestCase : public TestCase
+{
+public:
+  Ipv4EndPointDemuxTestCase ();
+  virtual void DoRun (void);
+private:
+  Ipv4Address RandomAddress (Ptr<UniformRandomVariable> rng);
+};
+
+Ipv4EndPointDemuxTestCase::Ipv4EndPointDemuxTestCase ()
+  : TestCase ("Hashed Ipv4EndPointDemux against the list scan")
+{
+}
+
+Ipv4Address
+Ipv4EndPointDemuxTestCase::RandomAddress (Ptr<UniformRandomVariable> rng)
+{
+  switch (rng->GetInteger (0, 5))
+    {
+    case 0:
+      return Ipv4Address::GetAny ();
+    case 1:
+      return Ipv4Address ("10.0.0.1");
+    case 2:
+      return Ipv4Address ("10.0.0.2");
+    case 3:
+      return Ipv4Address ("10.0.0.255");
+    case 4:
+      return Ipv4Address ("255.255.255.255");
+    default:
+      return Ipv4Address ("10.1.1.1");
+    }
+}
+
+void
+Ipv4EndPointDemuxTestCase::DoRun (void)
+{
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<LoopbackNetDevice> device = CreateObject<LoopbackNetDevice> ();
+  Ptr<LoopbackNetDevice> other = CreateObject<LoopbackNetDevice> ();
+  node->AddDevice (device);
+  node->AddDevice (other);
+  Ptr<Ipv4Interface> interface = CreateObject<Ipv4Interface> ();
+  interface->SetNode (node);
+  interface->SetDevice (device);
+  interface->AddAddress (Ipv4InterfaceAddress ("10.0.0.1", "255.255.255.0"));
+
+  Ipv4EndPointDemux demux;
+  std::vector<Ipv4EndPoint *> live;
+  for (uint32_t round = 0; round < 3000; round++)
+    {
+      uint32_t action = rng->GetInteger (0, 9);
+      uint16_t port = g_ports[rng->GetInteger (0, 2)];
+      Ipv4EndPoint *endPoint = 0;
+      if (action == 0 && !live.empty ())
+        {
+          uint32_t victim = rng->GetInteger (0, live.size () - 1);
+          demux.DeAllocate (live[victim]);
+          live.erase (live.begin () + victim);
+        }
+      else if (action == 1)
+        {
+          endPoint = demux.Allocate (RandomAddress (rng), port);
+        }
+      else if (action == 2)
+        {
+          endPoint = demux.Allocate (RandomAddress (rng), port, RandomAddress (rng), g_ports[rng->GetInteger (0, 2)]);
+        }
+      else if (action == 3 && !live.empty ())
+        {
+          // the way a socket fills its end point on connect
+          Ipv4EndPoint *changed = live[rng->GetInteger (0, live.size () - 1)];
+          changed->SetPeer (RandomAddress (rng), rng->GetInteger (0, 1) ? 0 : g_ports[rng->GetInteger (0, 2)]);
+          if (rng->GetInteger (0, 1))
+            {
+              changed->SetLocalAddress (RandomAddress (rng));
+            }
+        }
+      if (endPoint != 0)
+        {
+          uint32_t bound = rng->GetInteger (0, 5);
+          if (bound == 0)
+            {
+              endPoint->BindToNetDevice (device);
+            }
+          else if (bound == 1)
+            {
+              endPoint->BindToNetDevice (other);
+            }
+          live.push_back (endPoint);
+        }
+
+      Ipv4EndPointDemux::EndPoints all = demux.GetAllEndPoints ();
+      NS_TEST_ASSERT_MSG_EQ (all.size (), live.size (), "end point count differs");
+      for (uint32_t q = 0; q < 4; q++)
+        {
+          Ipv4Address daddr = RandomAddress (rng);
+          Ipv4Address saddr = RandomAddress (rng);
+          uint16_t dport = g_ports[rng->GetInteger (0, 2)];
+          uint16_t sport = g_ports[rng->GetInteger (0, 2)];
+          bool same = demux.Lookup (daddr, dport, saddr, sport, interface) ==
+            ScanLookup (all, daddr, dport, saddr, sport, interface);
+          NS_TEST_EXPECT_MSG_EQ (same, true, "Lookup " << daddr << ":" << dport << " from " << saddr << ":" << sport << " differs");
+          NS_TEST_EXPECT_MSG_EQ (demux.SimpleLookup (daddr, dport, saddr, sport),
+                                 ScanSimpleLookup (all, daddr, dport, saddr, sport, Ipv4Address::GetAny ()),
+                                 "SimpleLookup " << daddr << ":" << dport << " from " << saddr << ":" << sport << " differs");
+          bool local = false;
+          bool localPort = false;
+          for (Ipv4EndPointDemux::EndPointsI i = all.begin (); i != all.end (); i++)
+            {
+              localPort |= (*i)->GetLocalPort () == dport;
+              local |= (*i)->GetLocalPort () == dport && (*i)->GetLocalAddress () == daddr;
+            }
+          NS_TEST_EXPECT_MSG_EQ (demux.LookupPortLocal (dport), localPort, "LookupPortLocal differs");
+          NS_TEST_EXPECT_MSG_EQ (demux.LookupLocal (daddr, dport), local, "LookupLocal differs");
+        }
+    }
+}
+
+class Ipv6EndPointDemuxTestCase : public TestCase
+{
+public:
+  Ipv6EndPointDemuxTestCase ();
+  virtual void DoRun (void);
+private:
+  Ipv6Address RandomAddress (Ptr<UniformRandomVariable> rng);
+};
+
+Ipv6EndPointDemuxTestCase::Ipv6EndPointDemuxTestCase ()
+  : TestCase ("Hashed Ipv6EndPointDemux against the list scan")
+{
+}
+
+Ipv6Address
+Ipv6EndPointDemuxTestCase::RandomAddress (Ptr<UniformRandomVariable> rng)
+{
+  switch (rng->GetInteger (0, 4))
+    {
+    case 0:
+      return Ipv6Address::GetAny ();
+    case 1:
+      return Ipv6Address ("2001:1::1");
+    case 2:
+      return Ipv6Address ("2001:1::2");
+    case 3:
+      return Ipv6Address::GetAllRoutersMulticast ();
+    default:
+      return Ipv6Address ("2001:2::1");
+    }
+}
+
+void
+Ipv6EndPointDemuxTestCase::DoRun (void)
+{
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<LoopbackNetDevice> device = CreateObject<LoopbackNetDevice> ();
+  Ptr<LoopbackNetDevice> other = CreateObject<LoopbackNetDevice> ();
+  node->AddDevice (device);
+  node->AddDevice (other);
+  Ptr<Ipv6Interface> interface = CreateObject<Ipv6Interface> ();
+  interface->SetNode (node);
+  interface->SetDevice (device);
+
+  Ipv6EndPointDemux demux;
+  std::vector<Ipv6EndPoint *> live;
+  for (uint32_t round = 0; round < 3000; round++)
+    {
+      uint32_t action = rng->GetInteger (0, 9);
+      uint16_t port = g_ports[rng->GetInteger (0, 2)];
+      Ipv6EndPoint *endPoint = 0;
+      if (action == 0 && !live.empty ())
+        {
+          uint32_t victim = rng->GetInteger (0, live.size () - 1);
+          demux.DeAllocate (live[victim]);
+          live.erase (live.begin () + victim);
+        }
+      else if (action == 1)
+        {
+          endPoint = demux.Allocate (RandomAddress (rng), port);
+        }
+      else if (action == 2)
+        {
+          endPoint = demux.Allocate (RandomAddress (rng), port, RandomAddress (rng), g_ports[rng->GetInteger (0, 2)]);
+        }
+      else if (action == 3 && !live.empty ())
+        {
+          Ipv6EndPoint *changed = live[rng->GetInteger (0, live.size () - 1)];
+          changed->SetPeer (RandomAddress (rng), rng->GetInteger (0, 1) ? 0 : g_ports[rng->GetInteger (0, 2)]);
+          if (rng->GetInteger (0, 1))
+            {
+              changed->SetLocalAddress (RandomAddress (rng));
+            }
+          if (rng->GetInteger (0, 3) == 0)
+            {
+              changed->SetLocalPort (g_ports[rng->GetInteger (0, 2)]);
+            }
+        }
+      if (endPoint != 0)
+        {
+          uint32_t bound = rng->GetInteger (0, 5);
+          if (bound == 0)
+            {
+              endPoint->BindToNetDevice (device);
+            }
+          else if (bound == 1)
+            {
+              endPoint->BindToNetDevice (other);
+            }
+          live.push_back (endPoint);
+        }
+
+      Ipv6EndPointDemux::EndPoints all = demux.GetEndPoints ();
+      NS_TEST_ASSERT_MSG_EQ (all.size (), live.size (), "end point count differs");
+      for (uint32_t q = 0; q < 4; q++)
+        {
+          Ipv6Address daddr = RandomAddress (rng);
+          Ipv6Address saddr = RandomAddress (rng);
+          uint16_t dport = g_ports[rng->GetInteger (0, 2)];
+          uint16_t sport = g_ports[rng->GetInteger (0, 2)];
+          bool same = demux.Lookup (daddr, dport, saddr, sport, interface) ==
+            ScanLookup (all, daddr, dport, saddr, sport, interface);
+          NS_TEST_EXPECT_MSG_EQ (same, true, "Lookup " << daddr << ":" << dport << " from " << saddr << ":" << sport << " differs");
+          NS_TEST_EXPECT_MSG_EQ (demux.SimpleLookup (daddr, dport, saddr, sport),
+                                 ScanSimpleLookup (all, daddr, dport, saddr, sport, Ipv6Address::GetAny ()),
+                                 "SimpleLookup " << daddr << ":" << dport << " from " << saddr << ":" << sport << " differs");
+          bool local = false;
+          bool localPort = false;
+          for (Ipv6EndPointDemux::EndPointsI i = all.begin (); i != all.end (); i++)
+            {
+              localPort |= (*i)->GetLocalPort () == dport;
+              local |= (*i)->GetLocalPort () == dport && (*i)->GetLocalAddress () == daddr;
+            }
+          NS_TEST_EXPECT_MSG_EQ (demux.LookupPortLocal (dport), localPort, "LookupPortLocal differs");
+          NS_TEST_EXPECT_MSG_EQ (demux.LookupLocal (daddr, dport), local, "LookupLocal differs");
+        }
+    }
+}
+
+static class EndPointDemuxTestSuite : public TestSuite
+{
+public:
+  EndPointDemuxTestSuite ()
+    : TestSuite ("end-point-demux", UNIT)
+  {
+    AddTestCase (new Ipv4EndPointDemuxTestCase ());
+    AddTestCase (new Ipv6EndPointDemuxTestCase ());
+  }
+} g_endPointDemuxTestSuite;
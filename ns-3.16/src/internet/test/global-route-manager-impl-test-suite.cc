@@ -26,10 +26,246 @@
 #include "ns3/global-route-manager-impl.h"
 #include "ns3/candidate-queue.h"
 #include "ns3/simulator.h"
+#include "ns3/config.h"
+#include "ns3/uinteger.h"
+#include "ns3/node-container.h"
+#include "ns3/net-device-container.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/error-model.h"
+#include "ns3/simple-channel.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/ipv4-global-routing.h"
+#include "ns3/global-router-interface.h"
 #include <cstdlib> // for rand()
+#include <sstream>
+#include <vector>
 
 using namespace ns3;
 
+/**
+ * Check that the candidate queue pops the closest vertex first, networks
+ * before routers at the same distance, and the earliest pushed or updated
+ * vertex first among equals.
+ */
+class CandidateQueueTestCase : public TestCase
+{
+public:
+  CandidateQueueTestCase ();
+  virtual void DoRun (void);
+};
+
+CandidateQueueTestCase::CandidateQueueTestCase ()
+  : TestCase ("Check the order of the candidate queue")
+{
+}
+
+void
+CandidateQueueTestCase::DoRun (void)
+{
+  CandidateQueue candidate;
+  std::vector<SPFVertex *> vertices;
+  for (uint32_t i = 0; i < 200; i++)
+    {
+      SPFVertex *v = new SPFVertex;
+      v->SetVertexId (Ipv4Address (i));
+      v->SetDistanceFromRoot (std::rand () % 10);
+      v->SetVertexType (std::rand () % 2 ? SPFVertex::VertexRouter : SPFVertex::VertexNetwork);
+      candidate.Push (v);
+      vertices.push_back (v);
+    }
+  // lower the distance of every tenth vertex: it comes after the vertices
+  // pushed at that distance
+  std::vector<SPFVertex *> updated;
+  for (uint32_t i = 0; i < vertices.size (); )
+    {
+      SPFVertex *v = vertices[i];
+      if (v->GetVertexId ().Get () % 10 == 0 && v->GetDistanceFromRoot () > 0)
+        {
+          v->SetDistanceFromRoot (v->GetDistanceFromRoot () - 1);
+          candidate.Update (v);
+          vertices.erase (vertices.begin () + i);
+          updated.push_back (v);
+        }
+      else
+        {
+          i++;
+        }
+    }
+  vertices.insert (vertices.end (), updated.begin (), updated.end ());
+  std::vector<SPFVertex *> expected;
+  for (uint32_t distance = 0; distance < 10; distance++)
+    {
+      for (uint32_t i = 0; i < vertices.size (); i++)
+        {
+          if (vertices[i]->GetDistanceFromRoot () == distance
+              && vertices[i]->GetVertexType () == SPFVertex::VertexNetwork)
+            {
+              expected.push_back (vertices[i]);
+            }
+        }
+      for (uint32_t i = 0; i < vertices.size (); i++)
+        {
+          if (vertices[i]->GetDistanceFromRoot () == distance
+              && vertices[i]->GetVertexType () == SPFVertex::VertexRouter)
+            {
+              expected.push_back (vertices[i]);
+            }
+        }
+    }
+  uint32_t size = candidate.Size ();
+  NS_TEST_ASSERT_MSG_EQ (size, 200, "wrong size");
+  for (uint32_t i = 0; i < expected.size (); i++)
+    {
+      SPFVertex *v = candidate.Pop ();
+      NS_TEST_ASSERT_MSG_EQ (v->GetVertexId (), expected[i]->GetVertexId (), "wrong vertex popped at " << i);
+    }
+  bool empty = candidate.Empty ();
+  NS_TEST_ASSERT_MSG_EQ (empty, true, "vertices left in the queue");
+  for (uint32_t i = 0; i < vertices.size (); i++)
+    {
+      delete vertices[i];
+    }
+}
+
+/**
+ * A point-to-point SimpleNetDevice, for the global router to see
+ * point-to-point links.
+ */
+class PointToPointSimpleNetDevice : public SimpleNetDevice
+{
+public:
+  virtual bool IsPointToPoint (void) const
+  {
+    return true;
+  }
+};
+
+/**
+ * On a grid of routers with hosts, the routes updated after a link goes
+ * down or up, and those computed with several threads, are the routes
+ * computed from scratch.
+ */
+class GlobalRoutingUpdateTestCase : public TestCase
+{
+public:
+  GlobalRoutingUpdateTestCase ();
+  virtual void DoRun (void);
+private:
+  std::string GetTables (void) const;
+  void Link (Ptr<Node> a, Ptr<Node> b);
+
+  NodeContainer m_nodes;
+  Ipv4AddressHelper m_address;
+};
+
+GlobalRoutingUpdateTestCase::GlobalRoutingUpdateTestCase ()
+  : TestCase ("Check that updated routes are the routes computed from scratch")
+{
+}
+
+void
+GlobalRoutingUpdateTestCase::Link (Ptr<Node> a, Ptr<Node> b)
+{
+  Ptr<SimpleChannel> channel = CreateObject<SimpleChannel> ();
+  NetDeviceContainer devices;
+  Ptr<Node> nodes[2] = { a, b };
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<SimpleNetDevice> device = CreateObject<PointToPointSimpleNetDevice> ();
+      device->SetAddress (Mac48Address::Allocate ());
+      device->SetChannel (channel);
+      nodes[i]->AddDevice (device);
+      devices.Add (device);
+    }
+  m_address.Assign (devices);
+  m_address.NewNetwork ();
+}
+
+std::string
+GlobalRoutingUpdateTestCase::GetTables (void) const
+{
+  std::ostringstream tables;
+  for (uint32_t i = 0; i < m_nodes.GetN (); i++)
+    {
+      Ptr<Ipv4GlobalRouting> routing = m_nodes.Get (i)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+      tables << "node " << i << std::endl;
+      for (uint32_t j = 0; j < routing->GetNRoutes (); j++)
+        {
+          tables << *routing->GetRoute (j) << std::endl;
+        }
+    }
+  return tables.str ();
+}
+
+void
+GlobalRoutingUpdateTestCase::DoRun (void)
+{
+  // a 4x4 grid of routers, with a host on two corners
+  const uint32_t side = 4;
+  m_nodes.Create (side * side + 2);
+  InternetStackHelper internet;
+  internet.Install (m_nodes);
+  m_address.SetBase ("10.0.0.0", "255.255.255.252");
+  for (uint32_t i = 0; i < side; i++)
+    {
+      for (uint32_t j = 0; j < side; j++)
+        {
+          if (j + 1 < side)
+            {
+              Link (m_nodes.Get (i * side + j), m_nodes.Get (i * side + j + 1));
+            }
+          if (i + 1 < side)
+            {
+              Link (m_nodes.Get (i * side + j), m_nodes.Get ((i + 1) * side + j));
+            }
+        }
+    }
+  Link (m_nodes.Get (0), m_nodes.Get (side * side));
+  Link (m_nodes.Get (side * side - 1), m_nodes.Get (side * side + 1));
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  std::string initial = GetTables ();
+
+  // take every interface of the grid down and up again, and also leave
+  // two links down at once
+  for (uint32_t n = 0; n < side * side; n++)
+    {
+      Ptr<Ipv4> ipv4 = m_nodes.Get (n)->GetObject<Ipv4> ();
+      for (uint32_t i = 1; i < ipv4->GetNInterfaces (); i++)
+        {
+          ipv4->SetDown (i);
+          Ipv4GlobalRoutingHelper::UpdateRoutingTables ();
+          std::string updated = GetTables ();
+          Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+          std::string computed = GetTables ();
+          NS_TEST_ASSERT_MSG_EQ (updated, computed, "wrong routes after interface " << i << " of node " << n << " went down");
+
+          Ptr<Ipv4> other = m_nodes.Get ((n + 5) % (side * side))->GetObject<Ipv4> ();
+          other->SetDown (1);
+          Ipv4GlobalRoutingHelper::UpdateRoutingTables ();
+          updated = GetTables ();
+          Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+          computed = GetTables ();
+          NS_TEST_ASSERT_MSG_EQ (updated, computed, "wrong routes with two links down");
+
+          other->SetUp (1);
+          ipv4->SetUp (i);
+          Ipv4GlobalRoutingHelper::UpdateRoutingTables ();
+          updated = GetTables ();
+          NS_TEST_ASSERT_MSG_EQ (updated, initial, "wrong routes after interface " << i << " of node " << n << " came up");
+        }
+    }
+
+  Config::SetGlobal ("GlobalRoutingThreads", UintegerValue (4));
+  Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+  std::string threaded = GetTables ();
+  Config::SetGlobal ("GlobalRoutingThreads", UintegerValue (0));
+  NS_TEST_ASSERT_MSG_EQ (threaded, initial, "the routes depend on the number of threads");
+
+  Simulator::Destroy ();
+}
+
 class GlobalRouteManagerImplTestCase : public TestCase
 {
 public:
@@ -221,5 +457,7 @@ public:
     : TestSuite ("global-route-manager-impl", UNIT)
   {
     AddTestCase (new GlobalRouteManagerImplTestCase ());
+    AddTestCase (new CandidateQueueTestCase ());
+    AddTestCase (new GlobalRoutingUpdateTestCase ());
   }
 } g_globalRoutingManagerImplTestSuite;
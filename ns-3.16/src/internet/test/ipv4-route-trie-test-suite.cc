@@ -0,0 +1,119 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/test.h"
+#include "ns3/ipv4-route-trie.h"
+#include "ns3/ipv4-routing-table-entry.h"
+
+#include <cstdlib> // for rand()
+#include <vector>
+
+using namespace ns3;
+
+class Ipv4RouteTrieTestCase : public TestCase
+{
+public:
+  Ipv4RouteTrieTestCase ();
+  virtual void DoRun (void);
+
+private:
+  Ipv4Address GetRandomAddress (void);
+};
+
+Ipv4RouteTrieTestCase::Ipv4RouteTrieTestCase ()
+  : TestCase ("Check the Ipv4RouteTrie lookups against a linear scan of the routes")
+{
+}
+
+Ipv4Address
+Ipv4RouteTrieTestCase::GetRandomAddress (void)
+{
+  // few distinct high bits, so that the prefixes nest and share paths
+  return Ipv4Address ((std::rand () % 4) << 30 | (std::rand () % 4) << 22
+                      | (std::rand () % 16) << 8 | std::rand () % 4);
+}
+
+void
+Ipv4RouteTrieTestCase::DoRun (void)
+{
+  std::vector<Ipv4RoutingTableEntry> entries;
+  for (uint32_t i = 0; i < 400; i++)
+    {
+      Ipv4Mask mask (i % 33 == 0 ? 0 : 0xffffffff << (32 - i % 33));
+      Ipv4Address network = GetRandomAddress ().CombineMask (mask);
+      entries.push_back (Ipv4RoutingTableEntry::CreateNetworkRouteTo (network, mask, i));
+    }
+  Ipv4RouteTrie trie;
+  bool ok = true;
+  for (uint32_t round = 0; round < 2; round++)
+    {
+      for (uint32_t i = 0; i < entries.size (); i++)
+        {
+          trie.Insert (entries[i].GetDestNetwork (), entries[i].GetDestNetworkMask (), &entries[i]);
+        }
+      for (uint32_t j = 0; j < 2000; j++)
+        {
+          Ipv4Address dest = GetRandomAddress ();
+          // the expected sets, by prefix length, in insertion order
+          std::vector<Ipv4RouteTrie::Routes> expected (33);
+          for (uint32_t i = 0; i < entries.size (); i++)
+            {
+              if (entries[i].GetDestNetworkMask ().IsMatch (dest, entries[i].GetDestNetwork ()))
+                {
+                  expected[entries[i].GetDestNetworkMask ().GetPrefixLength ()].push_back (&entries[i]);
+                }
+            }
+          const Ipv4RouteTrie::Routes *matches[Ipv4RouteTrie::MAX_MATCHES];
+          uint32_t nMatches = trie.LookupAll (dest, matches);
+          const Ipv4RouteTrie::Routes *longest = trie.Lookup (dest);
+          uint32_t n = 0;
+          for (int32_t length = 32; length >= 0; length--)
+            {
+              if (!expected[length].empty ())
+                {
+                  ok = ok && n < nMatches && *matches[n] == expected[length];
+                  ok = ok && (n != 0 || (longest != 0 && *longest == expected[length]));
+                  n++;
+                }
+            }
+          ok = ok && n == nMatches && (n != 0 || longest == 0);
+        }
+      trie.Clear ();
+      // without the default routes the lookups can fail
+      for (uint32_t i = 0; i < entries.size (); )
+        {
+          if (entries[i].GetDestNetworkMask ().GetPrefixLength () == 0)
+            {
+              entries.erase (entries.begin () + i);
+            }
+          else
+            {
+              i++;
+            }
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (ok, true, "the trie and the linear scan disagree");
+}
+
+static class Ipv4RouteTrieTestSuite : public TestSuite
+{
+public:
+  Ipv4RouteTrieTestSuite ()
+    : TestSuite ("ipv4-route-trie", UNIT)
+  {
+    AddTestCase (new Ipv4RouteTrieTestCase ());
+  }
+} g_ipv4RouteTrieTestSuite;
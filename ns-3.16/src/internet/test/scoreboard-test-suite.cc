@@ -0,0 +1,260 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/scoreboard.h"
+#include "ns3/tcp-header.h"
+#include "ns3/tcp-option-sack.h"
+
+using namespace ns3;
+
+// The original std::map based scoreboard, used as the reference model
+class MapScoreBoard
+{
+public:
+  struct Node
+  {
+    bool acked;
+    bool sacked;
+  };
+
+  MapScoreBoard () : m_highReTx (0), m_mss (0), m_retxThresh (0) {}
+
+  void CreateScoreBoard (int size, uint32_t mss, uint32_t retxThresh)
+  {
+    m_mss = mss;
+    m_retxThresh = retxThresh;
+    for (int i = 1; i < size; i += mss)
+      {
+        m_sbn[SequenceNumber32 (i)].acked = false;
+        m_sbn[SequenceNumber32 (i)].sacked = false;
+      }
+  }
+  void ClearScoreBoard ()
+  {
+    SequenceNumber32 seqNo = SequenceNumber32 (1);
+    while (m_sbn.find (seqNo) != m_sbn.end ())
+      {
+        m_sbn[seqNo].acked = false;
+        m_sbn[seqNo].sacked = false;
+        seqNo += m_mss;
+      }
+  }
+  void UpdateScoreBoard (SequenceNumber32 ack, const std::vector<SackBlock> &blocks)
+  {
+    SequenceNumber32 cumAck = ack - m_mss;
+    while ((m_sbn.find (cumAck) != m_sbn.end ()) && (m_sbn[cumAck].acked == false))
+      {
+        m_sbn[cumAck].acked = true;
+        cumAck -= m_mss;
+      }
+    for (uint32_t i = 0; i < blocks.size (); i++)
+      {
+        for (SequenceNumber32 seqNo = blocks[i].first; seqNo < blocks[i].second; seqNo += m_mss)
+          {
+            m_sbn[seqNo].sacked = true;
+          }
+      }
+  }
+  bool IsPresent (SequenceNumber32 seqNo)
+  {
+    return m_sbn.find (seqNo) != m_sbn.end ();
+  }
+  bool IsLost (SequenceNumber32 seqNo, SequenceNumber32 nextTxSequence)
+  {
+    if ((m_sbn[seqNo].acked) || (m_sbn[seqNo].sacked))
+      {
+        return false;
+      }
+    uint32_t count = 0;
+    SequenceNumber32 temp = seqNo + m_mss;
+    while ((temp < nextTxSequence) && (m_sbn.find (temp) != m_sbn.end ()))
+      {
+        if (m_sbn[temp].sacked)
+          {
+            count++;
+          }
+        if (count == m_retxThresh)
+          {
+            return true;
+          }
+        temp += m_mss;
+      }
+    return false;
+  }
+  uint32_t SetPipe (SequenceNumber32 headSequence, SequenceNumber32 nextTxSequence)
+  {
+    uint32_t pipe = 0;
+    SequenceNumber32 seqNo = headSequence;
+    while ((seqNo < nextTxSequence) && (m_sbn.find (seqNo) != m_sbn.end ()))
+      {
+        if (!m_sbn[seqNo].sacked)
+          {
+            if (!IsLost (seqNo, nextTxSequence))
+              {
+                pipe++;
+              }
+            if (seqNo <= m_highReTx)
+              {
+                pipe++;
+              }
+          }
+        seqNo += m_mss;
+      }
+    return (pipe * m_mss);
+  }
+  SequenceNumber32 GetNextSegment (SequenceNumber32 headSequence, SequenceNumber32 nextTxSequence)
+  {
+    SequenceNumber32 seqNo = headSequence;
+    while ((seqNo < nextTxSequence) && (m_sbn.find (seqNo) != m_sbn.end ()))
+      {
+        if ((seqNo > m_highReTx) && (IsLost (seqNo, nextTxSequence)))
+          {
+            return seqNo;
+          }
+        seqNo += m_mss;
+      }
+    return GetNextAggSegment (nextTxSequence);
+  }
+  SequenceNumber32 GetNextAggSegment (SequenceNumber32 nextTxSequence)
+  {
+    SequenceNumber32 seqNo = nextTxSequence;
+    while (m_sbn.find (seqNo) != m_sbn.end ())
+      {
+        if ((!m_sbn[seqNo].sacked) && (!m_sbn[seqNo].acked))
+          {
+            return seqNo;
+          }
+        seqNo += m_mss;
+      }
+    return SequenceNumber32 (0);
+  }
+
+  SequenceNumber32 m_highReTx;
+  std::map<SequenceNumber32, Node> m_sbn;
+  uint32_t m_mss;
+  uint32_t m_retxThresh;
+};
+
+class ScoreBoardRandomTestCase : public TestCase
+{
+public:
+  ScoreBoardRandomTestCase (uint32_t segments, uint32_t retxThresh);
+  virtual void DoRun (void);
+private:
+  uint32_t m_segments;
+  uint32_t m_retxThresh;
+};
+
+ScoreBoardRandomTestCase::ScoreBoardRandomTestCase (uint32_t segments, uint32_t retxThresh)
+  : TestCase ("Bitmap scoreboard against the map based scoreboard"),
+    m_segments (segments),
+    m_retxThresh (retxThresh)
+{
+}
+
+void
+ScoreBoardRandomTestCase::DoRun (void)
+{
+  const uint32_t mss = 100;
+  // the last segment of the flow is a partial one
+  const int size = m_segments * mss - 40;
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+
+  ScoreBoard sb;
+  MapScoreBoard ref;
+  sb.CreateScoreBoard (size, mss, m_retxThresh);
+  ref.CreateScoreBoard (size, mss, m_retxThresh);
+
+  uint32_t cumAck = 0;
+  for (uint32_t round = 0; round < 300; round++)
+    {
+      // cumulative ack moves forward most of the time, SACK blocks lie
+      // above it and sometimes past the end of the flow
+      if (rng->GetInteger (0, 3) == 0)
+        {
+          cumAck = std::min (cumAck + rng->GetInteger (0, 4), m_segments + 4);
+        }
+      TcpHeader header;
+      header.SetFlags (TcpHeader::ACK);
+      header.SetAckNumber (SequenceNumber32 (1 + cumAck * mss));
+      Ptr<TcpOptionSack> sack = CreateObject<TcpOptionSack> ();
+      std::vector<SackBlock> blocks;
+      uint32_t nBlocks = rng->GetInteger (0, 3);
+      for (uint32_t i = 0; i < nBlocks; i++)
+        {
+          uint32_t left = cumAck + 1 + rng->GetInteger (0, 40);
+          uint32_t right = left + 1 + rng->GetInteger (0, 5);
+          // a right edge at the end of the partial segment
+          SackBlock block (SequenceNumber32 (1 + left * mss),
+                           right >= m_segments ? SequenceNumber32 (size) : SequenceNumber32 (1 + right * mss));
+          if (block.second <= block.first)
+            {
+              continue;
+            }
+          sack->AddSack (block);
+          blocks.push_back (block);
+        }
+      if (!blocks.empty ())
+        {
+          header.AppendOption (sack);
+        }
+      sb.UpdateScoreBoard (header);
+      ref.UpdateScoreBoard (header.GetAckNumber (), blocks);
+
+      if (rng->GetInteger (0, 50) == 0)
+        {
+          sb.ClearScoreBoard ();
+          ref.ClearScoreBoard ();
+        }
+
+      SequenceNumber32 highReTx = rng->GetInteger (0, 1) ? SequenceNumber32 (0)
+        : SequenceNumber32 (1 + rng->GetInteger (0, m_segments) * mss + rng->GetInteger (0, 1));
+      sb.m_highReTx = highReTx;
+      ref.m_highReTx = highReTx;
+      SequenceNumber32 head (1 + cumAck * mss);
+      SequenceNumber32 nextTx (1 + (cumAck + 1 + rng->GetInteger (0, 50)) * mss - rng->GetInteger (0, 1) * 30);
+
+      NS_TEST_EXPECT_MSG_EQ (sb.SetPipe (head, nextTx), ref.SetPipe (head, nextTx), "pipe differs");
+      NS_TEST_EXPECT_MSG_EQ (sb.GetNextSegment (head, nextTx), ref.GetNextSegment (head, nextTx), "next segment differs");
+      NS_TEST_EXPECT_MSG_EQ (sb.GetNextAggSegment (nextTx), ref.GetNextAggSegment (nextTx), "next agg segment differs");
+      for (uint32_t k = 0; k < m_segments + 50; k++)
+        {
+          SequenceNumber32 seq (1 + k * mss);
+          if (ref.IsPresent (seq))
+            {
+              NS_TEST_EXPECT_MSG_EQ (sb.IsLost (seq, nextTx), ref.IsLost (seq, nextTx), "loss state of " << seq << " differs");
+            }
+          NS_TEST_EXPECT_MSG_EQ (sb.GetNextAggSegment (seq), ref.GetNextAggSegment (seq), "next agg segment from " << seq << " differs");
+        }
+    }
+}
+
+static class ScoreBoardTestSuite : public TestSuite
+{
+public:
+  ScoreBoardTestSuite ()
+    : TestSuite ("scoreboard", UNIT)
+  {
+    AddTestCase (new ScoreBoardRandomTestCase (10, 3));
+    AddTestCase (new ScoreBoardRandomTestCase (70, 3));
+    AddTestCase (new ScoreBoardRandomTestCase (200, 1));
+  }
+} g_scoreBoardTestSuite;
@@ -0,0 +1,158 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/packet.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/tcp-header.h"
+#include "ns3/tcp-rx-buffer.h"
+
+using namespace ns3;
+
+class TcpRxBufferRandomTestCase : public TestCase
+{
+public:
+  TcpRxBufferRandomTestCase (uint32_t mss, bool aligned);
+  virtual void DoRun (void);
+private:
+  uint32_t m_mss;
+  bool m_aligned;
+};
+
+TcpRxBufferRandomTestCase::TcpRxBufferRandomTestCase (uint32_t mss, bool aligned)
+  : TestCase (aligned ? "TcpRxBuffer with segments on MSS boundaries" : "TcpRxBuffer with overlapping segments"),
+    m_mss (mss),
+    m_aligned (aligned)
+{
+}
+
+void
+TcpRxBufferRandomTestCase::DoRun (void)
+{
+  // the reference is a map of the received bytes of sequence 1 + i
+  const uint32_t n = 200 * m_mss;
+  std::vector<bool> received (n + m_mss, false);
+  uint32_t nextRx = 0;      // first byte not received in sequence
+  uint32_t delivered = 0;   // first byte not extracted
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+
+  TcpRxBuffer buffer (1);
+  buffer.SetMaxBufferSize (1 << 30);
+  for (uint32_t round = 0; round < 2000; round++)
+    {
+      // segments mostly ahead of the next expected byte, as with the
+      // tail first low priority segments of RC3
+      uint32_t start;
+      uint32_t length;
+      if (m_aligned)
+        {
+          start = rng->GetInteger (0, n / m_mss - 1) * m_mss;
+          length = start + m_mss > n ? n - start : m_mss;
+        }
+      else
+        {
+          start = rng->GetInteger (0, n - 1);
+          length = std::min (rng->GetInteger (1, 3 * m_mss), n - start);
+        }
+      TcpHeader header;
+      header.SetSequenceNumber (SequenceNumber32 (1 + start));
+      buffer.Add (Create<Packet> (length), header);
+      for (uint32_t i = std::max (start, nextRx); i < start + length; i++)
+        {
+          received[i] = true;
+        }
+      while (received[nextRx])
+        {
+          nextRx++;
+        }
+
+      if (rng->GetInteger (0, 3) == 0)
+        {
+          uint32_t maxSize = rng->GetInteger (1, 4 * m_mss);
+          uint32_t extracted = std::min (maxSize, nextRx - delivered);
+          Ptr<Packet> p = buffer.Extract (maxSize);
+          NS_TEST_ASSERT_MSG_EQ ((p == 0 ? 0 : p->GetSize ()), extracted, "extracted size differs");
+          for (uint32_t i = delivered; i < delivered + extracted; i++)
+            {
+              received[i] = false;
+            }
+          delivered += extracted;
+        }
+
+      uint32_t size = 0;
+      for (uint32_t i = delivered; i < n; i++)
+        {
+          size += received[i] ? 1 : 0;
+        }
+      NS_TEST_ASSERT_MSG_EQ (buffer.NextRxSequence (), SequenceNumber32 (1 + nextRx), "next rx sequence differs");
+      NS_TEST_ASSERT_MSG_EQ (buffer.Available (), nextRx - delivered, "available bytes differ");
+      NS_TEST_ASSERT_MSG_EQ (buffer.Size (), size, "buffer size differs");
+
+      // the block holding a few random bytes
+      for (uint32_t k = 0; k < 10; k++)
+        {
+          uint32_t probe = rng->GetInteger (0, n - 1);
+          SequenceNumber32 left;
+          SequenceNumber32 right;
+          bool found = buffer.GetBlock (SequenceNumber32 (1 + probe), left, right);
+          NS_TEST_ASSERT_MSG_EQ (found, (bool)received[probe], "buffered state of " << probe << " differs");
+          if (found)
+            {
+              uint32_t l = probe;
+              while (l > delivered && received[l - 1])
+                {
+                  l--;
+                }
+              uint32_t r = probe;
+              while (received[r])
+                {
+                  r++;
+                }
+              NS_TEST_ASSERT_MSG_EQ (left, SequenceNumber32 (1 + l), "left edge of the block of " << probe << " differs");
+              NS_TEST_ASSERT_MSG_EQ (right, SequenceNumber32 (1 + r), "right edge of the block of " << probe << " differs");
+            }
+
+          // the segment run, against one lookup per segment
+          SequenceNumber32 seq (1 + probe);
+          SequenceNumber32 expectedLeft = seq;
+          while (expectedLeft > SequenceNumber32 (1)
+                 && buffer.m_data.find (expectedLeft - m_mss) != buffer.m_data.end ())
+            {
+              expectedLeft = expectedLeft - m_mss;
+            }
+          SequenceNumber32 expectedRight = seq + m_mss;
+          while (buffer.m_data.find (expectedRight) != buffer.m_data.end ())
+            {
+              expectedRight = expectedRight + m_mss;
+            }
+          buffer.GetSegmentRun (seq, m_mss, left, right);
+          NS_TEST_ASSERT_MSG_EQ (left, expectedLeft, "left edge of the segment run of " << probe << " differs");
+          NS_TEST_ASSERT_MSG_EQ (right, expectedRight, "right edge of the segment run of " << probe << " differs");
+        }
+    }
+}
+
+static class TcpRxBufferTestSuite : public TestSuite
+{
+public:
+  TcpRxBufferTestSuite ()
+    : TestSuite ("tcp-rx-buffer", UNIT)
+  {
+    AddTestCase (new TcpRxBufferRandomTestCase (100, true));
+    AddTestCase (new TcpRxBufferRandomTestCase (100, false));
+  }
+} g_tcpRxBufferTestSuite;
@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/packet.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/tcp-tx-buffer.h"
+
+using namespace ns3;
+
+class TcpTxBufferRandomTestCase : public TestCase
+{
+public:
+  TcpTxBufferRandomTestCase (bool withVirtual);
+  virtual void DoRun (void);
+private:
+  bool m_withVirtual;
+};
+
+TcpTxBufferRandomTestCase::TcpTxBufferRandomTestCase (bool withVirtual)
+  : TestCase (withVirtual ? "TcpTxBuffer with data and virtual payload" : "TcpTxBuffer with data"),
+    m_withVirtual (withVirtual)
+{
+}
+
+void
+TcpTxBufferRandomTestCase::DoRun (void)
+{
+  // the reference is the content of the bytes from the head sequence on,
+  // the virtual payload being zeros
+  std::vector<uint8_t> reference;
+  uint32_t head = 1000;
+  uint8_t next = 1;
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+
+  TcpTxBuffer buffer (head);
+  buffer.SetMaxBufferSize (100000);
+  for (uint32_t round = 0; round < 2000; round++)
+    {
+      uint32_t action = rng->GetInteger (0, 9);
+      if (action < 3)
+        {
+          uint32_t size = rng->GetInteger (0, 3000);
+          bool fits = reference.size () + size <= 100000;
+          if (m_withVirtual && rng->GetInteger (0, 1) == 0)
+            {
+              NS_TEST_ASSERT_MSG_EQ (buffer.AddVirtual (size), fits, "unexpected AddVirtual result");
+              if (fits)
+                {
+                  reference.insert (reference.end (), size, 0);
+                }
+            }
+          else
+            {
+              std::vector<uint8_t> data (size);
+              for (uint32_t i = 0; i < size; i++)
+                {
+                  data[i] = next++;
+                  next = next == 0 ? 1 : next;
+                }
+              NS_TEST_ASSERT_MSG_EQ (buffer.Add (Create<Packet> (size ? &data[0] : 0, size)), fits, "unexpected Add result");
+              if (fits)
+                {
+                  reference.insert (reference.end (), data.begin (), data.end ());
+                }
+            }
+        }
+      else if (action < 5)
+        {
+          uint32_t discard = rng->GetInteger (0, std::min<uint32_t> (reference.size (), 5000));
+          head += discard;
+          reference.erase (reference.begin (), reference.begin () + discard);
+          buffer.DiscardUpTo (SequenceNumber32 (head));
+        }
+      else if (!reference.empty ())
+        {
+          uint32_t offset = rng->GetInteger (0, reference.size () - 1);
+          uint32_t numBytes = rng->GetInteger (1, 4000);
+          Ptr<Packet> p = buffer.CopyFromSequence (numBytes, SequenceNumber32 (head + offset));
+          uint32_t size = std::min<uint32_t> (numBytes, reference.size () - offset);
+          NS_TEST_ASSERT_MSG_EQ (p->GetSize (), size, "copied size differs");
+          std::vector<uint8_t> copied (size);
+          p->CopyData (&copied[0], size);
+          NS_TEST_ASSERT_MSG_EQ ((copied == std::vector<uint8_t> (reference.begin () + offset, reference.begin () + offset + size)),
+                                 true, "copied data differs at offset " << offset);
+        }
+      NS_TEST_ASSERT_MSG_EQ (buffer.HeadSequence (), SequenceNumber32 (head), "head sequence differs");
+      NS_TEST_ASSERT_MSG_EQ (buffer.Size (), reference.size (), "buffer size differs");
+    }
+}
+
+static class TcpTxBufferTestSuite : public TestSuite
+{
+public:
+  TcpTxBufferTestSuite ()
+    : TestSuite ("tcp-tx-buffer", UNIT)
+  {
+    AddTestCase (new TcpTxBufferRandomTestCase (false));
+    AddTestCase (new TcpTxBufferRandomTestCase (true));
+  }
+} g_tcpTxBufferTestSuite;
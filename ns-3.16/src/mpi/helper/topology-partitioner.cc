@@ -0,0 +1,388 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "topology-partitioner.h"
+
+#include "ns3/node.h"
+#include "ns3/node-list.h"
+#include "ns3/net-device.h"
+#include "ns3/channel.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <deque>
+#include <set>
+
+NS_LOG_COMPONENT_DEFINE ("TopologyPartitioner");
+
+namespace ns3 {
+
+// no lookahead and no node
+static const uint64_t NO_DELAY = ~(uint64_t)0;
+static const uint32_t NO_NODE = 0xffffffff;
+
+namespace {
+
+// the groups of nodes are packed largest first, the smallest node id
+// first among equal loads
+struct CompareGroups
+{
+  CompareGroups (const std::vector<double> &loads) : m_loads (loads) {}
+  bool operator () (uint32_t a, uint32_t b) const
+  {
+    return m_loads[a] > m_loads[b] || (m_loads[a] == m_loads[b] && a < b);
+  }
+  const std::vector<double> &m_loads;
+};
+
+} // anonymous namespace
+
+TopologyPartitioner::TopologyPartitioner ()
+  : m_barrierCost (100)
+{
+  NS_LOG_FUNCTION (this);
+  m_result.lookAhead = NO_DELAY;
+  m_result.nCutLinks = 0;
+  m_result.speedup = 1;
+}
+
+void
+TopologyPartitioner::AddNode (uint32_t node)
+{
+  if (node >= m_loads.size ())
+    {
+      m_loads.resize (node + 1, 0);
+    }
+}
+
+void
+TopologyPartitioner::AddLink (uint32_t a, uint32_t b, Time delay)
+{
+  NS_LOG_FUNCTION (this << a << b << delay);
+  AddNode (a);
+  AddNode (b);
+  Link link;
+  link.a = a;
+  link.b = b;
+  link.delay = delay.GetTimeStep ();
+  m_links.push_back (link);
+  m_neighbors.clear ();
+  m_parents.clear ();
+}
+
+void
+TopologyPartitioner::AddChannels (void)
+{
+  NS_LOG_FUNCTION (this);
+  // every channel once, from its first device
+  std::set<Ptr<Channel> > channels;
+  for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); node++)
+    {
+      AddNode ((*node)->GetId ());
+      for (uint32_t i = 0; i < (*node)->GetNDevices (); i++)
+        {
+          Ptr<Channel> channel = (*node)->GetDevice (i)->GetChannel ();
+          if (channel == 0 || !channels.insert (channel).second)
+            {
+              continue;
+            }
+          TimeValue delay;
+          if (!channel->GetAttributeFailSafe ("Delay", delay))
+            {
+              delay.Set (Seconds (0));
+            }
+          for (uint32_t j = 1; j < channel->GetNDevices (); j++)
+            {
+              AddLink (channel->GetDevice (0)->GetNode ()->GetId (),
+                       channel->GetDevice (j)->GetNode ()->GetId (), delay.Get ());
+            }
+        }
+    }
+}
+
+void
+TopologyPartitioner::AddLoad (uint32_t node, double load)
+{
+  AddNode (node);
+  m_loads[node] += load;
+}
+
+const std::vector<uint32_t> &
+TopologyPartitioner::GetParents (uint32_t source)
+{
+  std::map<uint32_t, std::vector<uint32_t> >::const_iterator cached = m_parents.find (source);
+  if (cached != m_parents.end ())
+    {
+      return cached->second;
+    }
+  if (m_neighbors.empty ())
+    {
+      m_neighbors.resize (m_loads.size ());
+      for (std::vector<Link>::const_iterator i = m_links.begin (); i != m_links.end (); i++)
+        {
+          m_neighbors[i->a].push_back (i->b);
+          m_neighbors[i->b].push_back (i->a);
+        }
+    }
+  std::vector<uint32_t> &parents = m_parents[source];
+  parents.assign (m_loads.size (), NO_NODE);
+  parents[source] = source;
+  std::deque<uint32_t> queue (1, source);
+  while (!queue.empty ())
+    {
+      uint32_t node = queue.front ();
+      queue.pop_front ();
+      for (std::vector<uint32_t>::const_iterator i = m_neighbors[node].begin (); i != m_neighbors[node].end (); i++)
+        {
+          if (parents[*i] == NO_NODE)
+            {
+              parents[*i] = node;
+              queue.push_back (*i);
+            }
+        }
+    }
+  return parents;
+}
+
+void
+TopologyPartitioner::AddFlow (uint32_t source, uint32_t destination, double load)
+{
+  AddNode (source);
+  AddNode (destination);
+  const std::vector<uint32_t> &parents = GetParents (source);
+  if (parents[destination] == NO_NODE)
+    {
+      m_loads[source] += load;
+      m_loads[destination] += load;
+      return;
+    }
+  for (uint32_t node = destination; node != source; node = parents[node])
+    {
+      m_loads[node] += load;
+    }
+  m_loads[source] += load;
+}
+
+void
+TopologyPartitioner::SetBarrierCost (double cost)
+{
+  m_barrierCost = cost;
+}
+
+uint32_t
+TopologyPartitioner::Find (std::vector<uint32_t> &parent, uint32_t i)
+{
+  while (parent[i] != i)
+    {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+  return i;
+}
+
+void
+TopologyPartitioner::PartitionAbove (uint64_t threshold, uint32_t n, const std::vector<double> &loads,
+                                     struct Result &result) const
+{
+  // the links shorter than the threshold join their ends in a group,
+  // named after its smallest node id
+  uint32_t nNodes = loads.size ();
+  std::vector<uint32_t> parent (nNodes);
+  for (uint32_t i = 0; i < nNodes; i++)
+    {
+      parent[i] = i;
+    }
+  for (std::vector<Link>::const_iterator i = m_links.begin (); i != m_links.end (); i++)
+    {
+      if (i->delay < threshold)
+        {
+          uint32_t a = Find (parent, i->a);
+          uint32_t b = Find (parent, i->b);
+          parent[std::max (a, b)] = std::min (a, b);
+        }
+    }
+  std::vector<double> groupLoads (nNodes, 0);
+  std::vector<uint32_t> groups;
+  for (uint32_t i = 0; i < nNodes; i++)
+    {
+      uint32_t group = Find (parent, i);
+      if (group == i)
+        {
+          groups.push_back (i);
+        }
+      groupLoads[group] += loads[i];
+    }
+  std::sort (groups.begin (), groups.end (), CompareGroups (groupLoads));
+
+  std::vector<uint32_t> partitionOfGroup (nNodes, 0);
+  result.loads.assign (n, 0);
+  for (std::vector<uint32_t>::const_iterator i = groups.begin (); i != groups.end (); i++)
+    {
+      uint32_t lightest = std::min_element (result.loads.begin (), result.loads.end ()) - result.loads.begin ();
+      partitionOfGroup[*i] = lightest;
+      result.loads[lightest] += groupLoads[*i];
+    }
+  result.partition.resize (nNodes);
+  for (uint32_t i = 0; i < nNodes; i++)
+    {
+      result.partition[i] = partitionOfGroup[Find (parent, i)];
+    }
+
+  result.lookAhead = NO_DELAY;
+  result.nCutLinks = 0;
+  for (std::vector<Link>::const_iterator i = m_links.begin (); i != m_links.end (); i++)
+    {
+      if (result.partition[i->a] != result.partition[i->b])
+        {
+          result.nCutLinks++;
+          result.lookAhead = std::min (result.lookAhead, i->delay);
+        }
+    }
+
+  double total = 0;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      total += result.loads[i];
+    }
+  double cost = *std::max_element (result.loads.begin (), result.loads.end ());
+  if (result.lookAhead == 0)
+    {
+      result.speedup = 0;
+      return;
+    }
+  if (result.lookAhead != NO_DELAY)
+    {
+      cost += m_barrierCost / TimeStep (result.lookAhead).GetSeconds ();
+    }
+  result.speedup = total / cost;
+}
+
+void
+TopologyPartitioner::Partition (uint32_t n)
+{
+  NS_LOG_FUNCTION (this << n);
+  NS_ASSERT (n > 0);
+  std::vector<double> loads = m_loads;
+  if (std::count (loads.begin (), loads.end (), 0.0) == (int)loads.size ())
+    {
+      loads.assign (loads.size (), 1);
+    }
+
+  // every delay is a candidate threshold, and so is no delay at all
+  std::vector<uint64_t> thresholds;
+  for (std::vector<Link>::const_iterator i = m_links.begin (); i != m_links.end (); i++)
+    {
+      thresholds.push_back (i->delay);
+    }
+  thresholds.push_back (NO_DELAY);
+  std::sort (thresholds.begin (), thresholds.end ());
+  thresholds.erase (std::unique (thresholds.begin (), thresholds.end ()), thresholds.end ());
+
+  bool found = false;
+  for (std::vector<uint64_t>::const_iterator i = thresholds.begin (); i != thresholds.end (); i++)
+    {
+      struct Result result;
+      PartitionAbove (*i, n, loads, result);
+      NS_LOG_LOGIC ("threshold " << *i << " lookahead " << result.lookAhead << " speedup " << result.speedup);
+      // the best speedup, the longest lookahead among equals
+      if (!found || result.speedup > m_result.speedup
+          || (result.speedup == m_result.speedup && result.lookAhead > m_result.lookAhead))
+        {
+          m_result = result;
+          found = true;
+        }
+    }
+}
+
+uint32_t
+TopologyPartitioner::GetPartition (uint32_t node) const
+{
+  return node < m_result.partition.size () ? m_result.partition[node] : 0;
+}
+
+uint32_t
+TopologyPartitioner::GetNNodes (void) const
+{
+  return m_loads.size ();
+}
+
+Time
+TopologyPartitioner::GetLookAhead (void) const
+{
+  return TimeStep (m_result.lookAhead == NO_DELAY ? 0x7fffffffffffffffLL : m_result.lookAhead);
+}
+
+uint32_t
+TopologyPartitioner::GetNCutLinks (void) const
+{
+  return m_result.nCutLinks;
+}
+
+double
+TopologyPartitioner::GetImbalance (void) const
+{
+  if (m_result.loads.empty ())
+    {
+      return 1;
+    }
+  double total = 0;
+  for (uint32_t i = 0; i < m_result.loads.size (); i++)
+    {
+      total += m_result.loads[i];
+    }
+  if (total == 0)
+    {
+      return 1;
+    }
+  return *std::max_element (m_result.loads.begin (), m_result.loads.end ()) * m_result.loads.size () / total;
+}
+
+double
+TopologyPartitioner::GetPredictedSpeedup (void) const
+{
+  return m_result.speedup;
+}
+
+void
+TopologyPartitioner::Print (std::ostream &os) const
+{
+  uint32_t n = m_result.loads.size ();
+  os << n << " partitions of " << GetNNodes () << " nodes: lookahead ";
+  if (m_result.lookAhead == NO_DELAY)
+    {
+      os << "unbounded";
+    }
+  else
+    {
+      os << TimeStep (m_result.lookAhead).GetSeconds () * 1000 << "ms";
+    }
+  os << ", " << m_result.nCutLinks << " links cut, load imbalance " << GetImbalance ()
+     << ", predicted speedup " << m_result.speedup << std::endl;
+  double total = 0;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      total += m_result.loads[i];
+    }
+  for (uint32_t i = 0; i < n; i++)
+    {
+      os << "  partition " << i << ": "
+         << std::count (m_result.partition.begin (), m_result.partition.end (), i) << " nodes, "
+         << (total > 0 ? 100 * m_result.loads[i] / total : 0) << "% of the load" << std::endl;
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,164 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TOPOLOGY_PARTITIONER_H
+#define TOPOLOGY_PARTITIONER_H
+
+#include "ns3/nstime.h"
+
+#include <stdint.h>
+#include <map>
+#include <ostream>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup mpi
+ *
+ * \brief Splits a topology into the partitions of a parallel run
+ *
+ * The links between partitions set the lookahead of a conservative
+ * parallel run, DistributedSimulatorImpl or MultithreadedSimulatorImpl:
+ * the smallest delay of these links. The partitioner keeps the links
+ * shorter than a threshold inside the partitions, packs the groups of
+ * nodes they connect into partitions of balanced load (largest group
+ * first, into the least loaded partition) and keeps the threshold which
+ * gives the best predicted speedup.
+ *
+ * The load of a node is an estimate of the number of events it
+ * processes per simulated second, given with AddLoad or spread by
+ * AddFlow over the nodes of the shortest path of a flow. Without any
+ * load, the nodes count as one each. The predicted speedup compares the
+ * sequential time, the total load, with the time of the most loaded
+ * partition plus one barrier per lookahead window:
+ *
+ *   speedup = total / (max partition load + BarrierCost / lookahead)
+ *
+ * where BarrierCost is the time of a barrier expressed in events.
+ *
+ * The result gives the partition of each node, for
+ * MultithreadedSimulatorImpl::SetPartition or the system id of the
+ * nodes of a distributed run.
+ */
+class TopologyPartitioner
+{
+public:
+  TopologyPartitioner ();
+
+  /**
+   * \param a a node id
+   * \param b another node id
+   * \param delay the delay of the link between a and b
+   */
+  void AddLink (uint32_t a, uint32_t b, Time delay);
+  /**
+   * Adds the channels of all the nodes of the NodeList: those with a
+   * "Delay" attribute with their delay, the others as links which can
+   * not be cut.
+   */
+  void AddChannels (void);
+  /**
+   * \param node a node id
+   * \param load the events the node processes per simulated second
+   */
+  void AddLoad (uint32_t node, double load);
+  /**
+   * \param source the node id of the source of a flow
+   * \param destination the node id of its destination
+   * \param load the events per simulated second of the flow at each
+   *        node it crosses
+   *
+   * Adds the load to the nodes of the path of the fewest links from
+   * source to destination, as the global routing would choose it.
+   */
+  void AddFlow (uint32_t source, uint32_t destination, double load);
+  /**
+   * \param cost the time of a barrier between two windows, as a
+   *        number of events (default 100)
+   */
+  void SetBarrierCost (double cost);
+
+  /**
+   * \param n the number of partitions
+   */
+  void Partition (uint32_t n);
+
+  /**
+   * \param node a node id
+   * \returns the partition of the node
+   */
+  uint32_t GetPartition (uint32_t node) const;
+  /**
+   * \returns the number of nodes
+   */
+  uint32_t GetNNodes (void) const;
+  /**
+   * \returns the smallest delay of the links between partitions, or
+   *          the maximum simulation time if there is none
+   */
+  Time GetLookAhead (void) const;
+  /**
+   * \returns the number of links between partitions
+   */
+  uint32_t GetNCutLinks (void) const;
+  /**
+   * \returns the load of the most loaded partition over the mean load
+   */
+  double GetImbalance (void) const;
+  /**
+   * \returns the predicted speedup over a sequential run
+   */
+  double GetPredictedSpeedup (void) const;
+  /**
+   * \param os the stream to print the partitioning to
+   */
+  void Print (std::ostream &os) const;
+
+private:
+  struct Link
+  {
+    uint32_t a;
+    uint32_t b;
+    uint64_t delay;
+  };
+  struct Result
+  {
+    std::vector<uint32_t> partition;
+    std::vector<double> loads;
+    uint64_t lookAhead;
+    uint32_t nCutLinks;
+    double speedup;
+  };
+
+  void AddNode (uint32_t node);
+  const std::vector<uint32_t> &GetParents (uint32_t source);
+  void PartitionAbove (uint64_t threshold, uint32_t n, const std::vector<double> &loads,
+                       struct Result &result) const;
+  static uint32_t Find (std::vector<uint32_t> &parent, uint32_t i);
+
+  std::vector<Link> m_links;
+  std::vector<double> m_loads;
+  // the breadth first trees of the sources of AddFlow
+  std::vector<std::vector<uint32_t> > m_neighbors;
+  std::map<uint32_t, std::vector<uint32_t> > m_parents;
+  double m_barrierCost;
+  struct Result m_result;
+};
+
+} // namespace ns3
+
+#endif /* TOPOLOGY_PARTITIONER_H */
@@ -0,0 +1,1001 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "multithreaded-simulator-impl.h"
+
+#include "ns3/simulator.h"
+#include "ns3/scheduler.h"
+#include "ns3/event-impl.h"
+#include "ns3/system-thread.h"
+#include "ns3/pool-allocator.h"
+#include "ns3/channel.h"
+#include "ns3/node.h"
+#include "ns3/node-list.h"
+#include "ns3/net-device.h"
+#include "ns3/uinteger.h"
+#include "ns3/ptr.h"
+#include "ns3/assert.h"
+#include "ns3/fatal-error.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unistd.h>
+
+// Note: as in DefaultSimulatorImpl, the event handling functions do not
+// log, all the more so since they run on several threads.
+
+NS_LOG_COMPONENT_DEFINE ("MultithreadedSimulatorImpl");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (MultithreadedSimulatorImpl);
+
+// timestamp of "no event" and "no stop time"
+static const uint64_t NO_TS = ~(uint64_t)0;
+// no record, for the events scheduled before the window
+static const uint32_t NO_RECORD = 0xffffffff;
+
+struct MultithreadedSimulatorImpl::Partition
+{
+  // an event of the current window which scheduled others
+  struct Record
+  {
+    uint64_t ts;
+    // the uid of the event if it was scheduled before the window,
+    // otherwise the record of the event which scheduled it and its rank
+    // among the events that one scheduled
+    uint32_t uid;
+    uint32_t parent;
+    uint32_t seq;
+    // the number of uids taken by the events it scheduled, and the first
+    // of them, set when the window is merged
+    uint32_t count;
+    uint32_t base;
+  };
+  // the parent of an event of the window with a temporary uid
+  struct Local
+  {
+    uint32_t parent;
+    uint32_t seq;
+  };
+  // an event held back until its uid is known
+  struct Held
+  {
+    Scheduler::Event ev;
+    uint32_t parent;
+    uint32_t seq;
+  };
+
+  MultithreadedSimulatorImpl *impl;
+  uint32_t id;
+  Ptr<Scheduler> events;
+  uint64_t currentTs;
+  uint32_t currentUid;
+  uint32_t currentContext;
+  EventImpl *currentEvent;
+  // the record of the current event, if it scheduled any
+  uint32_t currentRecord;
+  std::vector<Record> records;
+  // the temporary uids of the window are base, base + 1...
+  uint32_t base;
+  std::vector<Local> locals;
+  // the events scheduled during the window for the next ones, by
+  // destination partition
+  std::vector<std::vector<Held> > outgoing;
+  // the events received from each partition at the end of the window,
+  // which its own thread may fill again meanwhile
+  std::vector<std::vector<Held> > incoming;
+  // the end of the window, and the stop event it must not reach
+  uint64_t end;
+  Key stop;
+  // the Stop (time) requests made during the window
+  std::vector<Held> stopRequests;
+  bool stopNow;
+  // removed events, dropped when they come up
+  std::set<EventImpl *> removed;
+};
+
+__thread MultithreadedSimulatorImpl::Partition *MultithreadedSimulatorImpl::m_current = 0;
+
+TypeId
+MultithreadedSimulatorImpl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MultithreadedSimulatorImpl")
+    .SetParent<SimulatorImpl> ()
+    .AddConstructor<MultithreadedSimulatorImpl> ()
+    .AddAttribute ("Partitions",
+                   "The number of partitions, each run by its own thread. "
+                   "0 means one per online processor.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&MultithreadedSimulatorImpl::m_nPartitions),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("LookAhead",
+                   "The smallest delay of an event scheduled for a node of another "
+                   "partition. 0 means the smallest delay of the point to point "
+                   "channels between partitions, which is also an upper bound.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&MultithreadedSimulatorImpl::m_lookAheadAttribute),
+                   MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+MultithreadedSimulatorImpl::MultithreadedSimulatorImpl ()
+{
+  NS_LOG_FUNCTION (this);
+  // uids are allocated from 4, as with DefaultSimulatorImpl
+  m_uid = 4;
+  m_currentTs = 0;
+  m_currentContext = 0xffffffff;
+  m_running = false;
+  m_serial = false;
+  m_end = 0;
+  m_windowStop = Key (NO_TS, 0);
+  m_stopped = false;
+  m_nPartitions = 0;
+  m_lookAhead = NO_TS;
+  pthread_mutex_init (&m_barrierMutex, 0);
+  pthread_cond_init (&m_barrierCondition, 0);
+  m_barrierCount = 0;
+  m_barrierGeneration = 0;
+}
+
+MultithreadedSimulatorImpl::~MultithreadedSimulatorImpl ()
+{
+  NS_LOG_FUNCTION (this);
+  pthread_cond_destroy (&m_barrierCondition);
+  pthread_mutex_destroy (&m_barrierMutex);
+}
+
+void
+MultithreadedSimulatorImpl::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  while (!m_events->IsEmpty ())
+    {
+      Scheduler::Event next = m_events->RemoveNext ();
+      next.impl->Unref ();
+    }
+  m_events = 0;
+  m_removed.clear ();
+  for (uint32_t i = 0; i < m_partitions.size (); i++)
+    {
+      delete m_partitions[i];
+    }
+  m_partitions.clear ();
+  SimulatorImpl::DoDispose ();
+}
+
+void
+MultithreadedSimulatorImpl::Destroy ()
+{
+  NS_LOG_FUNCTION (this);
+  while (!m_destroyEvents.empty ())
+    {
+      Ptr<EventImpl> ev = m_destroyEvents.front ().PeekEventImpl ();
+      m_destroyEvents.pop_front ();
+      NS_LOG_LOGIC ("handle destroy " << ev);
+      if (!ev->IsCancelled ())
+        {
+          ev->Invoke ();
+        }
+    }
+}
+
+void
+MultithreadedSimulatorImpl::SetScheduler (ObjectFactory schedulerFactory)
+{
+  NS_LOG_FUNCTION (this << schedulerFactory);
+  NS_ASSERT_MSG (!m_running, "Can not change the scheduler during Simulator::Run");
+  Ptr<Scheduler> scheduler = schedulerFactory.Create<Scheduler> ();
+
+  if (m_events != 0)
+    {
+      while (!m_events->IsEmpty ())
+        {
+          Scheduler::Event next = m_events->RemoveNext ();
+          scheduler->Insert (next);
+        }
+    }
+  m_events = scheduler;
+  m_schedulerFactory = schedulerFactory;
+  // the partitions are empty between two runs
+  for (uint32_t i = 0; i < m_partitions.size (); i++)
+    {
+      m_partitions[i]->events = schedulerFactory.Create<Scheduler> ();
+    }
+}
+
+uint32_t
+MultithreadedSimulatorImpl::GetSystemId (void) const
+{
+  return 0;
+}
+
+void
+MultithreadedSimulatorImpl::SetPartition (uint32_t node, uint32_t partition)
+{
+  NS_LOG_FUNCTION (this << node << partition);
+  m_partitionOfNode[node] = partition;
+}
+
+uint32_t
+MultithreadedSimulatorImpl::GetNPartitions (void) const
+{
+  if (!m_partitions.empty ())
+    {
+      return m_partitions.size ();
+    }
+  if (m_nPartitions != 0)
+    {
+      return m_nPartitions;
+    }
+  long n = sysconf (_SC_NPROCESSORS_ONLN);
+  return n > 0 ? n : 1;
+}
+
+bool
+MultithreadedSimulatorImpl::IsRemote (uint32_t context)
+{
+  Partition *partition = m_current;
+  return partition != 0 && partition->impl->PartitionOf (context) != partition->id;
+}
+
+uint32_t
+MultithreadedSimulatorImpl::PartitionOf (uint32_t context) const
+{
+  return context < m_partitionOf.size () ? m_partitionOf[context] : 0;
+}
+
+void
+MultithreadedSimulatorImpl::CreatePartitions (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_partitions.empty ())
+    {
+      uint32_t n = GetNPartitions ();
+      for (uint32_t i = 0; i < n; i++)
+        {
+          Partition *partition = new Partition ();
+          partition->impl = this;
+          partition->id = i;
+          partition->events = m_schedulerFactory.Create<Scheduler> ();
+          partition->outgoing.resize (n);
+          partition->incoming.resize (n);
+          m_partitions.push_back (partition);
+        }
+    }
+  uint32_t n = m_partitions.size ();
+
+  // the node list may be created here, and DefaultSimulatorImpl would not
+  // give a uid to the destroy event it schedules
+  uint32_t uid = m_uid;
+  m_partitionOf.resize (NodeList::GetNNodes ());
+  m_uid = uid;
+  for (uint32_t i = 0; i < m_partitionOf.size (); i++)
+    {
+      m_partitionOf[i] = i % n;
+    }
+  for (std::map<uint32_t, uint32_t>::const_iterator i = m_partitionOfNode.begin (); i != m_partitionOfNode.end (); i++)
+    {
+      if (i->second >= n)
+        {
+          NS_FATAL_ERROR ("Node " << i->first << " is set to partition " << i->second << " of " << n);
+        }
+      if (i->first >= m_partitionOf.size ())
+        {
+          m_partitionOf.resize (i->first + 1, 0);
+        }
+      m_partitionOf[i->first] = i->second;
+    }
+
+  m_serial = n == 1;
+  while (!m_events->IsEmpty ())
+    {
+      Scheduler::Event next = m_events->RemoveNext ();
+      if (m_removed.erase (next.impl) == 1)
+        {
+          next.impl->Unref ();
+          continue;
+        }
+      m_partitions[PartitionOf (next.key.m_context)]->events->Insert (next);
+    }
+  NS_ASSERT (m_removed.empty ());
+  for (uint32_t i = 0; i < n; i++)
+    {
+      Partition *partition = m_partitions[i];
+      partition->currentTs = m_currentTs;
+      partition->currentUid = 0;
+      partition->currentContext = 0xffffffff;
+      partition->currentEvent = 0;
+      partition->currentRecord = NO_RECORD;
+      partition->records.clear ();
+      partition->base = m_uid;
+      partition->locals.clear ();
+      partition->end = 0;
+      partition->stop = Key (NO_TS, 0);
+      partition->stopRequests.clear ();
+      partition->stopNow = false;
+    }
+  m_end = 0;
+  m_stopped = false;
+}
+
+void
+MultithreadedSimulatorImpl::CalculateLookAhead (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_lookAhead = NO_TS;
+  for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); node++)
+    {
+      uint32_t partition = PartitionOf ((*node)->GetId ());
+      for (uint32_t i = 0; i < (*node)->GetNDevices (); i++)
+        {
+          Ptr<NetDevice> device = (*node)->GetDevice (i);
+          Ptr<Channel> channel = device->GetChannel ();
+          if (channel == 0)
+            {
+              continue;
+            }
+          for (uint32_t j = 0; j < channel->GetNDevices (); j++)
+            {
+              Ptr<Node> remote = channel->GetDevice (j)->GetNode ();
+              if (remote == 0 || PartitionOf (remote->GetId ()) == partition)
+                {
+                  continue;
+                }
+              if (!device->IsPointToPoint ())
+                {
+                  NS_FATAL_ERROR ("The channel of device " << i << " of node " << (*node)->GetId ()
+                                  << " connects partitions " << partition << " and "
+                                  << PartitionOf (remote->GetId ())
+                                  << ", only point to point channels may do so");
+                }
+              TimeValue delay;
+              channel->GetAttribute ("Delay", delay);
+              m_lookAhead = std::min (m_lookAhead, (uint64_t)delay.Get ().GetTimeStep ());
+            }
+        }
+    }
+  if (!m_lookAheadAttribute.IsZero ())
+    {
+      m_lookAhead = std::min (m_lookAhead, (uint64_t)m_lookAheadAttribute.GetTimeStep ());
+    }
+  if (m_lookAhead == 0)
+    {
+      NS_FATAL_ERROR ("A channel without delay connects two partitions");
+    }
+  NS_LOG_LOGIC ("lookahead " << m_lookAhead << " over " << m_partitions.size () << " partitions");
+}
+
+void
+MultithreadedSimulatorImpl::Barrier (void)
+{
+  pthread_mutex_lock (&m_barrierMutex);
+  uint32_t generation = m_barrierGeneration;
+  m_barrierCount++;
+  if (m_barrierCount == m_partitions.size ())
+    {
+      m_barrierCount = 0;
+      m_barrierGeneration++;
+      pthread_cond_broadcast (&m_barrierCondition);
+    }
+  else
+    {
+      while (generation == m_barrierGeneration)
+        {
+          pthread_cond_wait (&m_barrierCondition, &m_barrierMutex);
+        }
+    }
+  pthread_mutex_unlock (&m_barrierMutex);
+}
+
+void
+MultithreadedSimulatorImpl::Merge (void)
+{
+  // the uid of an event of the window is its own if it was scheduled
+  // before the window, otherwise it follows from the first uid of the
+  // events its parent scheduled, and the parent is merged before it
+  typedef std::pair<Key, uint32_t> Head;
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head> > heads;
+  std::vector<uint32_t> next (m_partitions.size (), 0);
+  for (uint32_t i = 0; i < m_partitions.size (); i++)
+    {
+      const std::vector<Partition::Record> &records = m_partitions[i]->records;
+      if (!records.empty ())
+        {
+          heads.push (Head (Key (records[0].ts, records[0].uid), i));
+        }
+    }
+  while (!heads.empty ())
+    {
+      uint32_t i = heads.top ().second;
+      heads.pop ();
+      std::vector<Partition::Record> &records = m_partitions[i]->records;
+      records[next[i]].base = m_uid;
+      m_uid += records[next[i]].count;
+      next[i]++;
+      if (next[i] < records.size ())
+        {
+          Partition::Record &record = records[next[i]];
+          uint32_t uid = record.parent == NO_RECORD ? record.uid : records[record.parent].base + record.seq;
+          heads.push (Head (Key (record.ts, uid), i));
+        }
+    }
+}
+
+void
+MultithreadedSimulatorImpl::EndWindow (void)
+{
+  if (!m_serial)
+    {
+      Merge ();
+    }
+  uint64_t stopNowTs = NO_TS;
+  Key next (NO_TS, 0);
+  for (uint32_t i = 0; i < m_partitions.size (); i++)
+    {
+      Partition *partition = m_partitions[i];
+      for (uint32_t j = 0; j < partition->outgoing.size (); j++)
+        {
+          std::vector<Partition::Held> &held = partition->outgoing[j];
+          for (std::vector<Partition::Held>::iterator k = held.begin (); k != held.end (); k++)
+            {
+              k->ev.key.m_uid = partition->records[k->parent].base + k->seq;
+              next = std::min (next, Key (k->ev.key.m_ts, k->ev.key.m_uid));
+            }
+          m_partitions[j]->incoming[i].swap (held);
+        }
+      for (std::vector<Partition::Held>::const_iterator k = partition->stopRequests.begin ();
+           k != partition->stopRequests.end (); k++)
+        {
+          uint32_t uid = k->parent == NO_RECORD ? k->ev.key.m_uid : partition->records[k->parent].base + k->seq;
+          m_stops.insert (Key (k->ev.key.m_ts, uid));
+        }
+      partition->stopRequests.clear ();
+      if (partition->stopNow)
+        {
+          stopNowTs = std::min (stopNowTs, partition->currentTs);
+        }
+      if (!partition->events->IsEmpty ())
+        {
+          Scheduler::EventKey key = partition->events->PeekNext ().key;
+          next = std::min (next, Key (key.m_ts, key.m_uid));
+        }
+    }
+  Key stop = m_stops.empty () ? Key (NO_TS, 0) : *m_stops.begin ();
+  // a stop within the last window was reached by the partition which
+  // requested it, whose first event may then have a temporary uid
+  bool stopReached = !m_stops.empty () && (stop.first < m_end || next >= stop);
+  if (stopReached && stop.first <= stopNowTs)
+    {
+      m_stops.erase (m_stops.begin ());
+      m_currentTs = stop.first;
+      m_stopped = true;
+    }
+  else if (stopNowTs != NO_TS)
+    {
+      m_currentTs = stopNowTs;
+      m_stopped = true;
+    }
+  else if (next.first == NO_TS)
+    {
+      // the time of the last event
+      for (uint32_t i = 0; i < m_partitions.size (); i++)
+        {
+          m_currentTs = std::max (m_currentTs, m_partitions[i]->currentTs);
+        }
+      m_stopped = true;
+    }
+  else
+    {
+      m_end = NO_TS - next.first > m_lookAhead ? next.first + m_lookAhead : NO_TS;
+      m_windowStop = stop;
+    }
+}
+
+void
+MultithreadedSimulatorImpl::ReceiveEvents (Partition *partition)
+{
+  uint32_t n = m_partitions.size ();
+  for (uint32_t i = 0; i < n; i++)
+    {
+      std::vector<Partition::Held> &incoming = partition->incoming[i];
+      for (std::vector<Partition::Held>::iterator j = incoming.begin (); j != incoming.end (); j++)
+        {
+          partition->events->Insert (j->ev);
+        }
+      incoming.clear ();
+    }
+}
+
+void
+MultithreadedSimulatorImpl::ProcessOneEvent (Partition *partition)
+{
+  Scheduler::Event next = partition->events->RemoveNext ();
+  if (!partition->removed.empty () && partition->removed.erase (next.impl) == 1)
+    {
+      next.impl->Unref ();
+      return;
+    }
+
+  NS_ASSERT (next.key.m_ts >= partition->currentTs);
+  partition->currentTs = next.key.m_ts;
+  partition->currentContext = next.key.m_context;
+  partition->currentUid = next.key.m_uid;
+  partition->currentEvent = next.impl;
+  partition->currentRecord = NO_RECORD;
+  next.impl->Invoke ();
+  // the uid of an event is not known for long, it is expired from now
+  // on, see IsExpired
+  next.impl->Cancel ();
+  partition->currentEvent = 0;
+  next.impl->Unref ();
+}
+
+uint32_t
+MultithreadedSimulatorImpl::AddChild (Partition *partition)
+{
+  if (partition->currentRecord == NO_RECORD)
+    {
+      Partition::Record record;
+      record.ts = partition->currentTs;
+      uint32_t local = partition->currentUid - partition->base;
+      if (local < partition->locals.size ())
+        {
+          record.uid = 0;
+          record.parent = partition->locals[local].parent;
+          record.seq = partition->locals[local].seq;
+        }
+      else
+        {
+          record.uid = partition->currentUid;
+          record.parent = NO_RECORD;
+          record.seq = 0;
+        }
+      record.count = 0;
+      record.base = 0;
+      partition->currentRecord = partition->records.size ();
+      partition->records.push_back (record);
+    }
+  return partition->records[partition->currentRecord].count++;
+}
+
+uint32_t
+MultithreadedSimulatorImpl::ScheduleInPartition (Partition *partition, Scheduler::Event &ev)
+{
+  if (m_serial)
+    {
+      ev.key.m_uid = m_uid;
+      m_uid++;
+      partition->events->Insert (ev);
+      return ev.key.m_uid;
+    }
+  uint32_t seq = AddChild (partition);
+  if (ev.key.m_ts < partition->end)
+    {
+      ev.key.m_uid = partition->base + partition->locals.size ();
+      Partition::Local local;
+      local.parent = partition->currentRecord;
+      local.seq = seq;
+      partition->locals.push_back (local);
+      partition->events->Insert (ev);
+      return ev.key.m_uid;
+    }
+  Partition::Held held;
+  held.ev = ev;
+  held.parent = partition->currentRecord;
+  held.seq = seq;
+  partition->outgoing[partition->id].push_back (held);
+  // the uid is given at the end of the window
+  return 0;
+}
+
+void
+MultithreadedSimulatorImpl::RunPartition (Partition *partition)
+{
+  m_current = partition;
+  while (true)
+    {
+      // partition 0 numbers the events of the window, hands them to their
+      // partitions and decides on the next window while the others wait
+      Barrier ();
+      if (partition->id == 0)
+        {
+          EndWindow ();
+        }
+      Barrier ();
+
+      ReceiveEvents (partition);
+      if (m_stopped)
+        {
+          break;
+        }
+      partition->records.clear ();
+      partition->base = m_uid;
+      partition->locals.clear ();
+      partition->end = m_end;
+      partition->stop = m_windowStop;
+      while (!partition->stopNow && !partition->events->IsEmpty ())
+        {
+          Scheduler::EventKey key = partition->events->PeekNext ().key;
+          if (key.m_ts >= partition->end || Key (key.m_ts, key.m_uid) >= partition->stop)
+            {
+              break;
+            }
+          ProcessOneEvent (partition);
+        }
+    }
+  m_current = 0;
+}
+
+void
+MultithreadedSimulatorImpl::RunPartitionThread (Partition *partition)
+{
+  partition->impl->RunPartition (partition);
+}
+
+bool
+MultithreadedSimulatorImpl::IsFinished (void) const
+{
+  if (!m_events->IsEmpty ())
+    {
+      return false;
+    }
+  for (uint32_t i = 0; i < m_partitions.size (); i++)
+    {
+      if (!m_partitions[i]->events->IsEmpty ())
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+void
+MultithreadedSimulatorImpl::Run (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (PoolAllocator::IsEnabled ())
+    {
+      NS_FATAL_ERROR ("The pool allocator can not be used with the multithreaded simulator");
+    }
+  CreatePartitions ();
+  CalculateLookAhead ();
+
+  m_running = true;
+  std::vector<Ptr<SystemThread> > threads;
+  for (uint32_t i = 1; i < m_partitions.size (); i++)
+    {
+      Ptr<SystemThread> thread = Create<SystemThread> (MakeBoundCallback (&MultithreadedSimulatorImpl::RunPartitionThread,
+                                                                          m_partitions[i]));
+      thread->Start ();
+      threads.push_back (thread);
+    }
+  RunPartition (m_partitions[0]);
+  for (uint32_t i = 0; i < threads.size (); i++)
+    {
+      threads[i]->Join ();
+    }
+  m_running = false;
+
+  // the events of the window left by a stop get their uid
+  for (uint32_t i = 0; i < m_partitions.size (); i++)
+    {
+      Partition *partition = m_partitions[i];
+      while (!partition->events->IsEmpty ())
+        {
+          Scheduler::Event next = partition->events->RemoveNext ();
+          if (partition->removed.erase (next.impl) == 1)
+            {
+              next.impl->Unref ();
+              continue;
+            }
+          uint32_t local = next.key.m_uid - partition->base;
+          if (!m_serial && local < partition->locals.size ())
+            {
+              const Partition::Local &parent = partition->locals[local];
+              next.key.m_uid = partition->records[parent.parent].base + parent.seq;
+            }
+          m_events->Insert (next);
+        }
+      NS_ASSERT (partition->removed.empty ());
+    }
+  m_currentContext = 0xffffffff;
+}
+
+void
+MultithreadedSimulatorImpl::Stop (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_current != 0)
+    {
+      m_current->stopNow = true;
+    }
+}
+
+void
+MultithreadedSimulatorImpl::Stop (Time const &time)
+{
+  NS_LOG_FUNCTION (this << time.GetTimeStep ());
+  // DefaultSimulatorImpl schedules a stop event, which takes a uid
+  Partition *partition = m_current;
+  if (partition == 0)
+    {
+      NS_ASSERT_MSG (!m_running, "Simulator::Stop called from a thread which runs no partition");
+      m_stops.insert (Key (m_currentTs + time.GetTimeStep (), m_uid));
+      m_uid++;
+      return;
+    }
+  Partition::Held request;
+  request.ev.impl = 0;
+  request.ev.key.m_ts = partition->currentTs + time.GetTimeStep ();
+  request.ev.key.m_context = partition->currentContext;
+  request.ev.key.m_uid = m_uid;
+  request.parent = NO_RECORD;
+  request.seq = 0;
+  if (m_serial)
+    {
+      m_uid++;
+    }
+  else
+    {
+      request.seq = AddChild (partition);
+      request.parent = partition->currentRecord;
+      // a temporary uid, to stop the partition in time
+      request.ev.key.m_uid = partition->base + partition->locals.size ();
+      Partition::Local local;
+      local.parent = request.parent;
+      local.seq = request.seq;
+      partition->locals.push_back (local);
+    }
+  Key stop (request.ev.key.m_ts, request.ev.key.m_uid);
+  if (stop.first < partition->end)
+    {
+      partition->stop = std::min (partition->stop, stop);
+    }
+  partition->stopRequests.push_back (request);
+}
+
+EventId
+MultithreadedSimulatorImpl::Schedule (Time const &time, EventImpl *event)
+{
+  NS_ASSERT (time.IsPositive ());
+  Scheduler::Event ev;
+  ev.impl = event;
+  Partition *partition = m_current;
+  if (partition != 0)
+    {
+      ev.key.m_ts = partition->currentTs + time.GetTimeStep ();
+      ev.key.m_context = partition->currentContext;
+      ev.key.m_uid = ScheduleInPartition (partition, ev);
+    }
+  else
+    {
+      NS_ASSERT_MSG (!m_running, "Simulator::Schedule called from a thread which runs no partition");
+      ev.key.m_ts = m_currentTs + time.GetTimeStep ();
+      ev.key.m_context = m_currentContext;
+      ev.key.m_uid = m_uid;
+      m_uid++;
+      m_events->Insert (ev);
+    }
+  return EventId (event, ev.key.m_ts, ev.key.m_context, ev.key.m_uid);
+}
+
+void
+MultithreadedSimulatorImpl::ScheduleWithContext (uint32_t context, Time const &time, EventImpl *event)
+{
+  NS_ASSERT (time.IsPositive ());
+  Scheduler::Event ev;
+  ev.impl = event;
+  ev.key.m_context = context;
+  Partition *partition = m_current;
+  if (partition == 0)
+    {
+      NS_ASSERT_MSG (!m_running, "Simulator::ScheduleWithContext called from a thread which runs no partition");
+      ev.key.m_ts = m_currentTs + time.GetTimeStep ();
+      ev.key.m_uid = m_uid;
+      m_uid++;
+      m_events->Insert (ev);
+      return;
+    }
+  ev.key.m_ts = partition->currentTs + time.GetTimeStep ();
+  uint32_t destination = PartitionOf (context);
+  if (destination == partition->id)
+    {
+      ScheduleInPartition (partition, ev);
+      return;
+    }
+  if (m_lookAhead == NO_TS)
+    {
+      NS_FATAL_ERROR ("An event is scheduled for node " << context << " in partition " << destination
+                      << " but no channel connects the partitions: set the LookAhead attribute");
+    }
+  if ((uint64_t)time.GetTimeStep () < m_lookAhead)
+    {
+      NS_FATAL_ERROR ("An event for node " << context << " in partition " << destination
+                      << " is scheduled " << time << " ahead, less than the lookahead "
+                      << TimeStep (m_lookAhead));
+    }
+  Partition::Held held;
+  held.ev = ev;
+  held.seq = AddChild (partition);
+  held.parent = partition->currentRecord;
+  partition->outgoing[destination].push_back (held);
+}
+
+EventId
+MultithreadedSimulatorImpl::ScheduleNow (EventImpl *event)
+{
+  return Schedule (TimeStep (0), event);
+}
+
+EventId
+MultithreadedSimulatorImpl::ScheduleDestroy (EventImpl *event)
+{
+  EventId id (Ptr<EventImpl> (event, false), Now ().GetTimeStep (), 0xffffffff, 2);
+  // DefaultSimulatorImpl takes a uid for it
+  Partition *partition = m_current;
+  if (partition != 0 && !m_serial)
+    {
+      AddChild (partition);
+    }
+  else
+    {
+      m_uid++;
+    }
+  CriticalSection cs (m_destroyMutex);
+  m_destroyEvents.push_back (id);
+  return id;
+}
+
+Time
+MultithreadedSimulatorImpl::Now (void) const
+{
+  // Do not add function logging here, to avoid stack overflow
+  Partition *partition = m_current;
+  return TimeStep (partition != 0 ? partition->currentTs : m_currentTs);
+}
+
+Time
+MultithreadedSimulatorImpl::GetDelayLeft (const EventId &id) const
+{
+  if (IsExpired (id))
+    {
+      return TimeStep (0);
+    }
+  else
+    {
+      return TimeStep (id.GetTs () - Now ().GetTimeStep ());
+    }
+}
+
+void
+MultithreadedSimulatorImpl::DropRemovedEvents (void)
+{
+  while (!m_events->IsEmpty () && m_removed.erase (m_events->PeekNext ().impl) == 1)
+    {
+      m_events->RemoveNext ().impl->Unref ();
+    }
+}
+
+void
+MultithreadedSimulatorImpl::Remove (const EventId &id)
+{
+  if (id.GetUid () == 2)
+    {
+      // destroy events.
+      CriticalSection cs (m_destroyMutex);
+      for (DestroyEvents::iterator i = m_destroyEvents.begin (); i != m_destroyEvents.end (); i++)
+        {
+          if (*i == id)
+            {
+              m_destroyEvents.erase (i);
+              break;
+            }
+        }
+      return;
+    }
+  if (IsExpired (id))
+    {
+      return;
+    }
+  // the event may have been given another uid since it was scheduled:
+  // it is dropped when it comes up
+  EventImpl *event = id.PeekEventImpl ();
+  event->Cancel ();
+  Partition *partition = m_current;
+  if (partition != 0)
+    {
+      NS_ASSERT_MSG (PartitionOf (id.GetContext ()) == partition->id,
+                     "Simulator::Remove of an event of another partition");
+      partition->removed.insert (event);
+    }
+  else
+    {
+      m_removed.insert (event);
+      DropRemovedEvents ();
+    }
+}
+
+void
+MultithreadedSimulatorImpl::Cancel (const EventId &id)
+{
+  if (!IsExpired (id))
+    {
+      id.PeekEventImpl ()->Cancel ();
+    }
+}
+
+bool
+MultithreadedSimulatorImpl::IsExpired (const EventId &ev) const
+{
+  if (ev.GetUid () == 2)
+    {
+      if (ev.PeekEventImpl () == 0 ||
+          ev.PeekEventImpl ()->IsCancelled ())
+        {
+          return true;
+        }
+      // destroy events.
+      CriticalSection cs (m_destroyMutex);
+      for (DestroyEvents::const_iterator i = m_destroyEvents.begin (); i != m_destroyEvents.end (); i++)
+        {
+          if (*i == ev)
+            {
+              return false;
+            }
+        }
+      return true;
+    }
+  // the events which ran are cancelled, see ProcessOneEvent
+  uint64_t currentTs = m_currentTs;
+  EventImpl *currentEvent = 0;
+  Partition *partition = m_current;
+  if (partition != 0)
+    {
+      currentTs = partition->currentTs;
+      currentEvent = partition->currentEvent;
+    }
+  if (ev.PeekEventImpl () == 0 ||
+      ev.GetTs () < currentTs ||
+      ev.PeekEventImpl () == currentEvent ||
+      ev.PeekEventImpl ()->IsCancelled ())
+    {
+      return true;
+    }
+  else
+    {
+      return false;
+    }
+}
+
+Time
+MultithreadedSimulatorImpl::GetMaximumSimulationTime (void) const
+{
+  return TimeStep (0x7fffffffffffffffLL);
+}
+
+uint32_t
+MultithreadedSimulatorImpl::GetContext (void) const
+{
+  Partition *partition = m_current;
+  return partition != 0 ? partition->currentContext : m_currentContext;
+}
+
+} // namespace ns3
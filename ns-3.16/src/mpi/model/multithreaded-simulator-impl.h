@@ -0,0 +1,205 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MULTITHREADED_SIMULATOR_IMPL_H
+#define MULTITHREADED_SIMULATOR_IMPL_H
+
+#include "ns3/simulator-impl.h"
+#include "ns3/scheduler.h"
+#include "ns3/event-impl.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/system-mutex.h"
+
+#include <pthread.h>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup mpi
+ *
+ * \brief conservative parallel simulator implementation running the
+ * partitions of the nodes on threads of a single process
+ *
+ * The nodes are split into partitions, each with its own event list,
+ * and every partition is run by its own thread: partition 0 by the
+ * thread calling Simulator::Run, the others by threads started for the
+ * duration of the run. As with DistributedSimulatorImpl, the partitions
+ * are synchronized with a lookahead: the smallest delay of the channels
+ * which connect two partitions. The run proceeds in windows
+ * [lbts, lbts + lookahead), where lbts is the smallest timestamp of all
+ * the pending events: no event of a window can cause another partition
+ * an event within the same window, so the partitions process their
+ * windows concurrently and meet at a barrier before the next one.
+ *
+ * The events a partition schedules for a node of another partition are
+ * appended to a queue dedicated to the pair of partitions, written only
+ * by the source during a window and handed to the destination between
+ * two windows, so they take no lock.
+ *
+ * The events are given the uid DefaultSimulatorImpl would give them, so
+ * that those with the same timestamp run in the same order and a run
+ * gives the same results as with DefaultSimulatorImpl. An event of the
+ * current window scheduled by another event of the window has a
+ * temporary uid, above those of the events scheduled before the window
+ * and in the order the partition scheduled it. Every partition logs
+ * the events of the window which scheduled others; between two windows
+ * the logs are merged in timestamp and uid order, as the events would
+ * have run in a single thread, which numbers the events scheduled in
+ * the window. Those for the next windows, including the local ones, are
+ * held back until then.
+ *
+ * The node of an event is its context. Node n is in partition
+ * n % Partitions unless SetPartition says otherwise, and the events
+ * without a node (context 0xffffffff), such as those scheduled with
+ * Simulator::Schedule before Run, are in partition 0: schedule those
+ * which touch a node with Simulator::ScheduleWithContext. Only the point
+ * to point channels may connect nodes of different partitions; the
+ * lookahead is computed from their "Delay" attribute when Run starts.
+ *
+ * Simulator::Stop (time) stops the run where DefaultSimulatorImpl
+ * would, unless it is called from an event for a time within the
+ * current window: the partition of the event then stops in time, but
+ * the other ones run to the end of the window. Likewise
+ * Simulator::Stop () stops the partition of the event right after it,
+ * and the other ones at the end of the window. Simulator::Now () is the
+ * time of the stop in both cases, and the events the other partitions
+ * ran past it are not run again by the next Run.
+ *
+ * The models must not share state between the nodes of different
+ * partitions other than through these channels: a trace sink, a log
+ * file or a global variable written by several nodes need a lock or a
+ * copy per partition. The packets crossing a channel between
+ * partitions are copied (Packet::DeepCopy) so that the two partitions
+ * do not share reference counted buffers. Packet metadata, byte tags
+ * and the pool allocator keep global free lists and are not supported;
+ * the uid of the packets is not unique across partitions.
+ */
+class MultithreadedSimulatorImpl : public SimulatorImpl
+{
+public:
+  static TypeId GetTypeId (void);
+
+  MultithreadedSimulatorImpl ();
+  ~MultithreadedSimulatorImpl ();
+
+  // virtual from SimulatorImpl
+  virtual void Destroy ();
+  virtual bool IsFinished (void) const;
+  virtual void Stop (void);
+  virtual void Stop (Time const &time);
+  virtual EventId Schedule (Time const &time, EventImpl *event);
+  virtual void ScheduleWithContext (uint32_t context, Time const &time, EventImpl *event);
+  virtual EventId ScheduleNow (EventImpl *event);
+  virtual EventId ScheduleDestroy (EventImpl *event);
+  virtual void Remove (const EventId &ev);
+  virtual void Cancel (const EventId &ev);
+  virtual bool IsExpired (const EventId &ev) const;
+  virtual void Run (void);
+  virtual Time Now (void) const;
+  virtual Time GetDelayLeft (const EventId &id) const;
+  virtual Time GetMaximumSimulationTime (void) const;
+  virtual void SetScheduler (ObjectFactory schedulerFactory);
+  virtual uint32_t GetSystemId (void) const;
+  virtual uint32_t GetContext (void) const;
+
+  /**
+   * \param node the id of a node
+   * \param partition the partition to run the events of the node in,
+   *        smaller than the "Partitions" attribute
+   *
+   * Takes effect at the next call to Run.
+   */
+  void SetPartition (uint32_t node, uint32_t partition);
+  /**
+   * \returns the number of partitions
+   */
+  uint32_t GetNPartitions (void) const;
+  /**
+   * \param context the context of an event
+   * \returns true if Run is in progress and the event would be
+   *          processed by another partition than the calling thread
+   */
+  static bool IsRemote (uint32_t context);
+
+private:
+  struct Partition;
+
+  virtual void DoDispose (void);
+  void CreatePartitions (void);
+  void CalculateLookAhead (void);
+  uint32_t PartitionOf (uint32_t context) const;
+  void RunPartition (Partition *partition);
+  static void RunPartitionThread (Partition *partition);
+  void EndWindow (void);
+  void Merge (void);
+  void ReceiveEvents (Partition *partition);
+  void ProcessOneEvent (Partition *partition);
+  uint32_t AddChild (Partition *partition);
+  uint32_t ScheduleInPartition (Partition *partition, Scheduler::Event &ev);
+  void DropRemovedEvents (void);
+  void Barrier (void);
+
+  typedef std::list<EventId> DestroyEvents;
+  typedef std::pair<uint64_t, uint32_t> Key;
+
+  // the state of the partitions; the events are kept in m_events while
+  // Run is not in progress
+  std::vector<Partition *> m_partitions;
+  Ptr<Scheduler> m_events;
+  ObjectFactory m_schedulerFactory;
+  // the uid of the next event, as given by DefaultSimulatorImpl
+  uint32_t m_uid;
+  uint64_t m_currentTs;
+  uint32_t m_currentContext;
+  // the pending Stop (time), as the timestamp and uid of the stop event
+  std::set<Key> m_stops;
+  // the events removed while Run is not in progress
+  std::set<EventImpl *> m_removed;
+  bool m_running;
+  // with a single partition, the events are numbered as they are scheduled
+  bool m_serial;
+
+  // written by partition 0 between two windows
+  uint64_t m_end;
+  Key m_windowStop;
+  bool m_stopped;
+
+  uint32_t m_nPartitions;
+  std::map<uint32_t, uint32_t> m_partitionOfNode;
+  std::vector<uint32_t> m_partitionOf;
+  Time m_lookAheadAttribute;
+  uint64_t m_lookAhead;
+
+  DestroyEvents m_destroyEvents;
+  mutable SystemMutex m_destroyMutex;
+
+  pthread_mutex_t m_barrierMutex;
+  pthread_cond_t m_barrierCondition;
+  uint32_t m_barrierCount;
+  uint32_t m_barrierGeneration;
+
+  // the partition run by the calling thread, if any
+  static __thread Partition *m_current;
+};
+
+} // namespace ns3
+
+#endif /* MULTITHREADED_SIMULATOR_IMPL_H */
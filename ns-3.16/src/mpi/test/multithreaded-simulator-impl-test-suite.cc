@@ -0,0 +1,302 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/nstime.h"
+#include "ns3/uinteger.h"
+#include "ns3/multithreaded-simulator-impl.h"
+
+using namespace ns3;
+
+/**
+ * Tokens hop between the contexts of a few fake nodes, each hop at
+ * least one lookahead long, and every arrival starts two local timers,
+ * one of which it cancels. The events seen by each context are compared
+ * with a run of the default simulator, in order.
+ */
+class MultithreadedSimulatorImplTestCase : public TestCase
+{
+public:
+  MultithreadedSimulatorImplTestCase (uint32_t partitions);
+  virtual void DoRun (void);
+
+protected:
+  MultithreadedSimulatorImplTestCase (std::string name, uint32_t partitions);
+
+  typedef std::vector<std::pair<uint64_t, uint32_t> > Events;
+
+  void Setup (void);
+  void Hop (uint32_t node, uint32_t token, uint32_t hops);
+  void Timer (uint32_t node, uint32_t token);
+  Ptr<MultithreadedSimulatorImpl> CreateImpl (void);
+
+  enum
+  {
+    N_NODES = 8,
+    N_TOKENS = 32
+  };
+  uint32_t m_partitions;
+  // written by the thread running the node only
+  std::vector<Events> m_events;
+  bool m_contextOk;
+  bool m_timersOk;
+};
+
+static std::string
+Name (uint32_t partitions)
+{
+  std::ostringstream oss;
+  oss << "Check the events of each node with " << partitions << " partitions";
+  return oss.str ();
+}
+
+MultithreadedSimulatorImplTestCase::MultithreadedSimulatorImplTestCase (uint32_t partitions)
+  : TestCase (Name (partitions)),
+    m_partitions (partitions)
+{
+}
+
+MultithreadedSimulatorImplTestCase::MultithreadedSimulatorImplTestCase (std::string name, uint32_t partitions)
+  : TestCase (name),
+    m_partitions (partitions)
+{
+}
+
+void
+MultithreadedSimulatorImplTestCase::Hop (uint32_t node, uint32_t token, uint32_t hops)
+{
+  m_contextOk = m_contextOk && Simulator::GetContext () == node;
+  m_events[node].push_back (std::make_pair (Simulator::Now ().GetTimeStep (), token));
+  EventId kept = Simulator::Schedule (MicroSeconds (1 + token % 300), &MultithreadedSimulatorImplTestCase::Timer,
+                                      this, node, 1000 + token);
+  EventId cancelled = Simulator::Schedule (MicroSeconds (2), &MultithreadedSimulatorImplTestCase::Timer,
+                                           this, node, 2000 + token);
+  m_timersOk = m_timersOk && !kept.IsExpired () && !cancelled.IsExpired ();
+  cancelled.Cancel ();
+  m_timersOk = m_timersOk && cancelled.IsExpired ();
+  if (hops > 0)
+    {
+      uint32_t next = (node * 3 + token) % N_NODES;
+      Time delay = MilliSeconds (1) + MicroSeconds ((token * 37 + hops * 11) % 500);
+      Simulator::ScheduleWithContext (next, delay, &MultithreadedSimulatorImplTestCase::Hop,
+                                      this, next, token, hops - 1);
+    }
+}
+
+void
+MultithreadedSimulatorImplTestCase::Timer (uint32_t node, uint32_t token)
+{
+  m_contextOk = m_contextOk && Simulator::GetContext () == node;
+  m_events[node].push_back (std::make_pair (Simulator::Now ().GetTimeStep (), token));
+}
+
+void
+MultithreadedSimulatorImplTestCase::Setup (void)
+{
+  m_events.assign (N_NODES, Events ());
+  m_contextOk = true;
+  m_timersOk = true;
+  for (uint32_t token = 0; token < N_TOKENS; token++)
+    {
+      // the tokens of the same node start together, and meet often
+      Simulator::ScheduleWithContext (token % N_NODES, MicroSeconds (token / N_NODES * 10),
+                                      &MultithreadedSimulatorImplTestCase::Hop,
+                                      this, token % N_NODES, token, 50);
+    }
+}
+
+Ptr<MultithreadedSimulatorImpl>
+MultithreadedSimulatorImplTestCase::CreateImpl (void)
+{
+  ObjectFactory factory;
+  factory.SetTypeId (MultithreadedSimulatorImpl::GetTypeId ());
+  factory.Set ("Partitions", UintegerValue (m_partitions));
+  factory.Set ("LookAhead", TimeValue (MilliSeconds (1)));
+  Ptr<MultithreadedSimulatorImpl> impl = factory.Create<MultithreadedSimulatorImpl> ();
+  for (uint32_t node = 0; node < N_NODES; node++)
+    {
+      impl->SetPartition (node, node % m_partitions);
+    }
+  return impl;
+}
+
+void
+MultithreadedSimulatorImplTestCase::DoRun (void)
+{
+  Simulator::Destroy ();
+  Setup ();
+  Simulator::Run ();
+  Simulator::Destroy ();
+  std::vector<Events> reference = m_events;
+
+  Simulator::SetImplementation (CreateImpl ());
+  Setup ();
+  Simulator::Run ();
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_contextOk, true, "an event ran with the context of another node");
+  NS_TEST_ASSERT_MSG_EQ (m_timersOk, true, "a timer expired too early or was not cancelled");
+  for (uint32_t node = 0; node < N_NODES; node++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_events[node].size (), reference[node].size (), "node " << node << " saw another number of events");
+      NS_TEST_ASSERT_MSG_EQ ((m_events[node] == reference[node]), true, "node " << node << " saw other events or another order");
+    }
+
+  // a run stopped at 20ms and resumed
+  Simulator::Stop (MilliSeconds (20));
+  Setup ();
+  Simulator::Stop (MilliSeconds (30));
+  Simulator::Run ();
+  std::vector<Events> stopped = m_events;
+  NS_TEST_ASSERT_MSG_EQ (Simulator::Now (), MilliSeconds (20), "the default simulator did not stop at the stop time");
+  Simulator::Run ();
+  Simulator::Run ();
+  Simulator::Destroy ();
+  reference = m_events;
+
+  Simulator::SetImplementation (CreateImpl ());
+  Simulator::Stop (MilliSeconds (20));
+  Setup ();
+  Simulator::Stop (MilliSeconds (30));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (Simulator::Now (), MilliSeconds (20), "the run did not stop at the stop time");
+  NS_TEST_ASSERT_MSG_EQ (Simulator::IsFinished (), false, "no event is left after the stop time");
+  for (uint32_t node = 0; node < N_NODES; node++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((m_events[node] == stopped[node]), true, "node " << node << " saw other events before the stop time");
+    }
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (Simulator::Now (), MilliSeconds (30), "the run did not stop at the second stop time");
+  Simulator::Run ();
+  Simulator::Destroy ();
+  for (uint32_t node = 0; node < N_NODES; node++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((m_events[node] == reference[node]), true, "node " << node << " saw other events after resuming");
+    }
+}
+
+/**
+ * An event of node 1 stops the run, either right away or after a
+ * delay. The partition of node 1 stops where the default simulator
+ * does, and the others by the end of the window; with a delay of more
+ * than a lookahead, all of them stop where the default simulator does.
+ */
+class MultithreadedSimulatorImplStopTestCase : public MultithreadedSimulatorImplTestCase
+{
+public:
+  MultithreadedSimulatorImplStopTestCase (uint32_t partitions, Time delay);
+  virtual void DoRun (void);
+
+private:
+  void StopEvent (void);
+
+  Time m_delay;
+};
+
+static std::string
+StopName (uint32_t partitions, Time delay)
+{
+  std::ostringstream oss;
+  oss << "Stop the run from an event, after " << delay.GetMicroSeconds () << "us with " << partitions << " partitions";
+  return oss.str ();
+}
+
+MultithreadedSimulatorImplStopTestCase::MultithreadedSimulatorImplStopTestCase (uint32_t partitions, Time delay)
+  : MultithreadedSimulatorImplTestCase (StopName (partitions, delay), partitions),
+    m_delay (delay)
+{
+}
+
+void
+MultithreadedSimulatorImplStopTestCase::StopEvent (void)
+{
+  if (m_delay.IsZero ())
+    {
+      Simulator::Stop ();
+    }
+  else
+    {
+      Simulator::Stop (m_delay);
+    }
+}
+
+void
+MultithreadedSimulatorImplStopTestCase::DoRun (void)
+{
+  // after a timer of node 1, and with the events at the stop time of
+  // other partitions
+  Time stop = MicroSeconds (10502) + m_delay;
+  Simulator::Destroy ();
+  Setup ();
+  Simulator::ScheduleWithContext (1, MicroSeconds (10502), &MultithreadedSimulatorImplStopTestCase::StopEvent, this);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (Simulator::Now (), stop, "the default simulator did not stop at the stop time");
+  std::vector<Events> stopped = m_events;
+  Simulator::Run ();
+  Simulator::Destroy ();
+  std::vector<Events> reference = m_events;
+
+  Simulator::SetImplementation (CreateImpl ());
+  Setup ();
+  Simulator::ScheduleWithContext (1, MicroSeconds (10502), &MultithreadedSimulatorImplStopTestCase::StopEvent, this);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (Simulator::Now (), stop, "the run did not stop at the stop time");
+  for (uint32_t node = 0; node < N_NODES; node++)
+    {
+      std::ostringstream oss;
+      oss << "node " << node << " saw other events before the stop";
+      if (node % m_partitions == 1 % m_partitions || m_delay >= MilliSeconds (1))
+        {
+          NS_TEST_ASSERT_MSG_EQ ((m_events[node] == stopped[node]), true, oss.str ());
+        }
+      else
+        {
+          // the events of the stop and some of those after it
+          NS_TEST_ASSERT_MSG_EQ ((m_events[node].size () >= stopped[node].size ()), true, oss.str ());
+          NS_TEST_ASSERT_MSG_EQ (std::equal (stopped[node].begin (), stopped[node].end (), m_events[node].begin ()), true, oss.str ());
+          for (Events::const_iterator i = m_events[node].begin (); i != m_events[node].end (); i++)
+            {
+              NS_TEST_ASSERT_MSG_EQ ((i->first < (uint64_t)(stop + MilliSeconds (1)).GetTimeStep ()), true, oss.str ());
+            }
+        }
+    }
+  Simulator::Run ();
+  Simulator::Destroy ();
+  for (uint32_t node = 0; node < N_NODES; node++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((m_events[node] == reference[node]), true, "node " << node << " saw other events after resuming");
+    }
+}
+
+static class MultithreadedSimulatorImplTestSuite : public TestSuite
+{
+public:
+  MultithreadedSimulatorImplTestSuite ()
+    : TestSuite ("multithreaded-simulator-impl", UNIT)
+  {
+    AddTestCase (new MultithreadedSimulatorImplTestCase (1));
+    AddTestCase (new MultithreadedSimulatorImplTestCase (2));
+    AddTestCase (new MultithreadedSimulatorImplTestCase (4));
+    AddTestCase (new MultithreadedSimulatorImplStopTestCase (1, Seconds (0)));
+    AddTestCase (new MultithreadedSimulatorImplStopTestCase (4, Seconds (0)));
+    AddTestCase (new MultithreadedSimulatorImplStopTestCase (4, MicroSeconds (300)));
+    AddTestCase (new MultithreadedSimulatorImplStopTestCase (4, MilliSeconds (3)));
+  }
+} g_multithreadedSimulatorImplTestSuite;
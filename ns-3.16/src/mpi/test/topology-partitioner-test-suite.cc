@@ -0,0 +1,129 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/test.h"
+#include "ns3/nstime.h"
+#include "ns3/topology-partitioner.h"
+
+using namespace ns3;
+
+/**
+ * Two chains of four nodes with 1ms links, joined by a 10ms link: the
+ * split keeps the chains whole and cuts the long link.
+ */
+class TopologyPartitionerClustersTestCase : public TestCase
+{
+public:
+  TopologyPartitionerClustersTestCase ();
+  virtual void DoRun (void);
+};
+
+TopologyPartitionerClustersTestCase::TopologyPartitionerClustersTestCase ()
+  : TestCase ("Check that the longest links are cut")
+{
+}
+
+void
+TopologyPartitionerClustersTestCase::DoRun (void)
+{
+  TopologyPartitioner partitioner;
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      partitioner.AddLink (i, i + 1, MilliSeconds (1));
+      partitioner.AddLink (i + 4, i + 5, MilliSeconds (1));
+    }
+  partitioner.AddLink (3, 4, MilliSeconds (10));
+  for (uint32_t i = 0; i < 8; i++)
+    {
+      partitioner.AddLoad (i, 100000);
+    }
+  partitioner.Partition (2);
+
+  NS_TEST_ASSERT_MSG_EQ (partitioner.GetNNodes (), 8, "wrong number of nodes");
+  NS_TEST_ASSERT_MSG_EQ (partitioner.GetNCutLinks (), 1, "more than the long link is cut");
+  NS_TEST_ASSERT_MSG_EQ (partitioner.GetLookAhead (), MilliSeconds (10), "the lookahead is not the long link");
+  for (uint32_t i = 1; i < 4; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (partitioner.GetPartition (i), partitioner.GetPartition (0), "node " << i << " left its chain");
+      NS_TEST_ASSERT_MSG_EQ (partitioner.GetPartition (i + 4), partitioner.GetPartition (4), "node " << i + 4 << " left its chain");
+    }
+  NS_TEST_ASSERT_MSG_NE (partitioner.GetPartition (0), partitioner.GetPartition (4), "the chains are not split");
+  NS_TEST_ASSERT_MSG_EQ_TOL (partitioner.GetImbalance (), 1, 1e-9, "the partitions are not balanced");
+  // 800000 events over 400000 events and 100 barriers of 100 events
+  NS_TEST_ASSERT_MSG_EQ_TOL (partitioner.GetPredictedSpeedup (), 800000.0 / 410000, 1e-9, "wrong predicted speedup");
+
+  // barriers too costly for the load: no split
+  partitioner.SetBarrierCost (1e6);
+  partitioner.Partition (2);
+  NS_TEST_ASSERT_MSG_EQ (partitioner.GetNCutLinks (), 0, "a link is cut");
+  NS_TEST_ASSERT_MSG_EQ (partitioner.GetLookAhead (), TimeStep (0x7fffffffffffffffLL), "the lookahead is bounded");
+  NS_TEST_ASSERT_MSG_EQ_TOL (partitioner.GetPredictedSpeedup (), 1, 1e-9, "wrong predicted speedup");
+}
+
+/**
+ * The load of a flow is spread over the nodes of its path, and groups of
+ * nodes are packed into the least loaded partition.
+ */
+class TopologyPartitionerFlowsTestCase : public TestCase
+{
+public:
+  TopologyPartitionerFlowsTestCase ();
+  virtual void DoRun (void);
+};
+
+TopologyPartitionerFlowsTestCase::TopologyPartitionerFlowsTestCase ()
+  : TestCase ("Check the load of flows and the balance of the partitions")
+{
+}
+
+void
+TopologyPartitionerFlowsTestCase::DoRun (void)
+{
+  // a chain 0-1-2-3 with a shortcut 0-2, and a separate link 4-5
+  TopologyPartitioner partitioner;
+  partitioner.AddLink (0, 1, MilliSeconds (10));
+  partitioner.AddLink (1, 2, MilliSeconds (10));
+  partitioner.AddLink (2, 3, MilliSeconds (10));
+  partitioner.AddLink (0, 2, MilliSeconds (10));
+  partitioner.AddLink (4, 5, MilliSeconds (10));
+  // 0, 2 and 3, but not 1
+  partitioner.AddFlow (0, 3, 1e6);
+  partitioner.AddFlow (4, 5, 1e6);
+  partitioner.AddLoad (1, 1e6);
+
+  // one node for each partition
+  partitioner.Partition (6);
+  NS_TEST_ASSERT_MSG_EQ (partitioner.GetNCutLinks (), 5, "a link is not cut");
+  NS_TEST_ASSERT_MSG_EQ_TOL (partitioner.GetImbalance (), 1, 1e-9, "the flow did not follow the shortest path");
+  NS_TEST_ASSERT_MSG_EQ_TOL (partitioner.GetPredictedSpeedup (), 6e6 / (1e6 + 1e4), 1e-9, "wrong predicted speedup");
+
+  // three nodes each, some split between the partitions
+  partitioner.Partition (2);
+  NS_TEST_ASSERT_MSG_EQ_TOL (partitioner.GetImbalance (), 1, 1e-9, "the partitions are not balanced");
+  NS_TEST_ASSERT_MSG_EQ (partitioner.GetLookAhead (), MilliSeconds (10), "wrong lookahead");
+  NS_TEST_ASSERT_MSG_EQ_TOL (partitioner.GetPredictedSpeedup (), 6e6 / (3e6 + 1e4), 1e-9, "wrong predicted speedup");
+}
+
+static class TopologyPartitionerTestSuite : public TestSuite
+{
+public:
+  TopologyPartitionerTestSuite ()
+    : TestSuite ("topology-partitioner", UNIT)
+  {
+    AddTestCase (new TopologyPartitionerClustersTestCase ());
+    AddTestCase (new TopologyPartitionerFlowsTestCase ());
+  }
+} g_topologyPartitionerTestSuite;
@@ -483,6 +483,13 @@ private:
 
   Buffer CreateFullCopy (void) const;
 
+  /**
+   * \return a copy of this buffer which does not share its data with
+   * this buffer nor with any other, so that it can be handed to another
+   * thread. The zero area is kept as is.
+   */
+  Buffer CreateDeepCopy (void) const;
+
   /**
    * \return the number of bytes required for serialization 
    */
@@ -129,6 +129,59 @@ PacketTagList::Remove (Tag &tag)
   return true;
 }
 
+bool
+PacketTagList::Replace (const Tag &tag)
+{
+  NS_LOG_FUNCTION (this << &tag);
+  TypeId tid = tag.GetInstanceTypeId ();
+  NS_ASSERT (tag.GetSerializedSize () <= PACKET_TAG_MAX_SIZE);
+  // the tag can be written in place if no other list shares the
+  // elements up to it
+  bool shared = false;
+  struct TagData *cur;
+  for (cur = m_next; cur != 0; cur = cur->next)
+    {
+      shared = shared || cur->count > 1;
+      if (cur->tid == tid)
+        {
+          break;
+        }
+    }
+  if (cur == 0)
+    {
+      return false;
+    }
+  if (shared)
+    {
+      // copy the elements up to the tag and share the ones after it
+      struct TagData *start = 0;
+      struct TagData **prevNext = &start;
+      for (cur = m_next; ; cur = cur->next)
+        {
+          struct TagData *copy = AllocData ();
+          copy->tid = cur->tid;
+          copy->count = 1;
+          std::memcpy (copy->data, cur->data, PACKET_TAG_MAX_SIZE);
+          *prevNext = copy;
+          prevNext = &copy->next;
+          if (cur->tid == tid)
+            {
+              copy->next = cur->next;
+              if (copy->next != 0)
+                {
+                  copy->next->count++;
+                }
+              cur = copy;
+              break;
+            }
+        }
+      RemoveAll ();
+      m_next = start;
+    }
+  tag.Serialize (TagBuffer (cur->data, cur->data + tag.GetSerializedSize ()));
+  return true;
+}
+
 void 
 PacketTagList::Add (const Tag &tag) const
 {
@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include <ostream>
 #include "ns3/type-id.h"
+#include "ns3/pool-allocator.h"
 
 namespace ns3 {
 
@@ -44,6 +45,15 @@ public:
     struct TagData *next;
     TypeId tid;
     uint32_t count;
+
+    static void *operator new (size_t size)
+    {
+      return PoolAllocator::Allocate (size);
+    }
+    static void operator delete (void *p, size_t size)
+    {
+      PoolAllocator::Deallocate (p, size);
+    }
   };
 
   inline PacketTagList ();
@@ -53,6 +63,7 @@ public:
 
   void Add (Tag const&tag) const;
   bool Remove (Tag &tag);
+  bool Replace (const Tag &tag);
   bool Peek (Tag &tag) const;
   inline void RemoveAll (void);
 
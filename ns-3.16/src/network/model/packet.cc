@@ -20,15 +20,19 @@
 #include "packet.h"
 #include "ns3/assert.h"
 #include "ns3/log.h"
+#include "ns3/fatal-error.h"
 #include "ns3/simulator.h"
 #include <string>
+#include <algorithm>
 #include <cstdarg>
+#include <vector>
 
 NS_LOG_COMPONENT_DEFINE ("Packet");
 
 namespace ns3 {
 
 uint32_t Packet::m_globalUid = 0;
+bool Packet::m_enableHeaderChecking = false;
 
 TypeId 
 ByteTagIterator::Item::GetTypeId (void) const
@@ -137,6 +141,41 @@ Packet::Copy (void) const
   return Ptr<Packet> (new Packet (*this), false);
 }
 
+Ptr<Packet>
+Packet::DeepCopy (void) const
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<Packet> p = Copy ();
+  p->m_buffer = m_buffer.CreateDeepCopy ();
+  p->m_byteTagList.RemoveAll ();
+  p->m_byteTagList.Add (m_byteTagList);
+  p->m_byteTagList.AddAtStart (p->m_buffer.GetCurrentStartOffset () - m_buffer.GetCurrentStartOffset (),
+                               p->m_buffer.GetCurrentStartOffset ());
+  // the tags are added to the front of the list: add them in reverse
+  // order to keep that of this packet
+  std::vector<Tag *> tags;
+  PacketTagIterator i = GetPacketTagIterator ();
+  while (i.HasNext ())
+    {
+      PacketTagIterator::Item item = i.Next ();
+      NS_ASSERT (item.GetTypeId ().HasConstructor ());
+      Callback<ObjectBase *> constructor = item.GetTypeId ().GetConstructor ();
+      NS_ASSERT (!constructor.IsNull ());
+      ObjectBase *instance = constructor ();
+      Tag *tag = dynamic_cast<Tag *> (instance);
+      NS_ASSERT (tag != 0);
+      item.GetTag (*tag);
+      tags.push_back (tag);
+    }
+  p->m_packetTagList.RemoveAll ();
+  for (std::vector<Tag *>::reverse_iterator j = tags.rbegin (); j != tags.rend (); j++)
+    {
+      p->m_packetTagList.Add (**j);
+      delete *j;
+    }
+  return p;
+}
+
 Packet::Packet ()
   : m_buffer (),
     m_byteTagList (),
@@ -148,7 +187,8 @@ Packet::Packet ()
      * global UID
      */
     m_metadata (static_cast<uint64_t> (Simulator::GetSystemId ()) << 32 | m_globalUid, 0),
-    m_nixVector (0)
+    m_nixVector (0),
+    m_nHeaders (0)
 {
   NS_LOG_FUNCTION (this);
   m_globalUid++;
@@ -158,10 +198,16 @@ Packet::Packet (const Packet &o)
   : m_buffer (o.m_buffer),
     m_byteTagList (o.m_byteTagList),
     m_packetTagList (o.m_packetTagList),
-    m_metadata (o.m_metadata)
+    m_metadata (o.m_metadata),
+    m_nHeaders (o.m_nHeaders)
 {
   o.m_nixVector ? m_nixVector = o.m_nixVector->Copy ()
     : m_nixVector = 0;
+  if (m_nHeaders != HEADERS_UNKNOWN)
+    {
+      std::copy (o.m_headerUids, o.m_headerUids + m_nHeaders, m_headerUids);
+      std::copy (o.m_headerSizes, o.m_headerSizes + m_nHeaders, m_headerSizes);
+    }
 }
 
 Packet &
@@ -177,6 +223,12 @@ Packet::operator = (const Packet &o)
   m_metadata = o.m_metadata;
   o.m_nixVector ? m_nixVector = o.m_nixVector->Copy () 
     : m_nixVector = 0;
+  m_nHeaders = o.m_nHeaders;
+  if (m_nHeaders != HEADERS_UNKNOWN)
+    {
+      std::copy (o.m_headerUids, o.m_headerUids + m_nHeaders, m_headerUids);
+      std::copy (o.m_headerSizes, o.m_headerSizes + m_nHeaders, m_headerSizes);
+    }
   return *this;
 }
 
@@ -191,7 +243,8 @@ Packet::Packet (uint32_t size)
      * global UID
      */
     m_metadata (static_cast<uint64_t> (Simulator::GetSystemId ()) << 32 | m_globalUid, size),
-    m_nixVector (0)
+    m_nixVector (0),
+    m_nHeaders (0)
 {
   NS_LOG_FUNCTION (this << size);
   m_globalUid++;
@@ -201,7 +254,8 @@ Packet::Packet (uint8_t const *buffer, uint32_t size, bool magic)
     m_byteTagList (),
     m_packetTagList (),
     m_metadata (0,0),
-    m_nixVector (0)
+    m_nixVector (0),
+    m_nHeaders (HEADERS_UNKNOWN)
 {
   NS_LOG_FUNCTION (this << &buffer << size << magic);
   NS_ASSERT (magic);
@@ -219,7 +273,8 @@ Packet::Packet (uint8_t const*buffer, uint32_t size)
      * global UID
      */
     m_metadata (static_cast<uint64_t> (Simulator::GetSystemId ()) << 32 | m_globalUid, size),
-    m_nixVector (0)
+    m_nixVector (0),
+    m_nHeaders (HEADERS_UNKNOWN)
 {
   NS_LOG_FUNCTION (this << &buffer << size);
   m_globalUid++;
@@ -234,7 +289,8 @@ Packet::Packet (const Buffer &buffer,  const ByteTagList &byteTagList,
     m_byteTagList (byteTagList),
     m_packetTagList (packetTagList),
     m_metadata (metadata),
-    m_nixVector (0)
+    m_nixVector (0),
+    m_nHeaders (HEADERS_UNKNOWN)
 {
   NS_LOG_FUNCTION (this << &buffer << &byteTagList << &packetTagList << &metadata);
 }
@@ -249,7 +305,13 @@ Packet::CreateFragment (uint32_t start, uint32_t length) const
   PacketMetadata metadata = m_metadata.CreateFragment (start, end);
   // again, call the constructor directly rather than
   // through Create because it is private.
-  return Ptr<Packet> (new Packet (buffer, m_byteTagList, m_packetTagList, metadata), false);
+  Ptr<Packet> fragment = Ptr<Packet> (new Packet (buffer, m_byteTagList, m_packetTagList, metadata), false);
+  if (m_nHeaders == 0)
+    {
+      // a fragment of a packet without headers has no headers either
+      fragment->m_nHeaders = 0;
+    }
+  return fragment;
 }
 
 void
@@ -280,6 +342,10 @@ Packet::AddHeader (const Header &header)
     }
   header.Serialize (m_buffer.Begin ());
   m_metadata.AddHeader (header, size);
+  if (m_enableHeaderChecking)
+    {
+      PushHeader (header, size);
+    }
 }
 uint32_t
 Packet::RemoveHeader (Header &header)
@@ -288,6 +354,10 @@ Packet::RemoveHeader (Header &header)
   NS_LOG_FUNCTION (this << &header);
   m_buffer.RemoveAtStart (deserialized);
   m_metadata.RemoveHeader (header, deserialized);
+  if (m_enableHeaderChecking)
+    {
+      PopHeader (header, deserialized);
+    }
   return deserialized;
 }
 uint32_t
@@ -345,6 +415,11 @@ Packet::AddAtEnd (Ptr<const Packet> packet)
                    appendPrependOffset);
   m_byteTagList.Add (copy);
   m_metadata.AddAtEnd (packet->m_metadata);
+  if (packet->m_nHeaders != 0)
+    {
+      // the headers of packet are not at the front
+      ForgetHeaders ();
+    }
 }
 void
 Packet::AddPaddingAtEnd (uint32_t size)
@@ -365,6 +440,10 @@ Packet::RemoveAtEnd (uint32_t size)
   NS_LOG_FUNCTION (this << size);
   m_buffer.RemoveAtEnd (size);
   m_metadata.RemoveAtEnd (size);
+  if (size != 0)
+    {
+      ForgetHeaders ();
+    }
 }
 void 
 Packet::RemoveAtStart (uint32_t size)
@@ -372,6 +451,10 @@ Packet::RemoveAtStart (uint32_t size)
   NS_LOG_FUNCTION (this << size);
   m_buffer.RemoveAtStart (size);
   m_metadata.RemoveAtStart (size);
+  if (size != 0)
+    {
+      ForgetHeaders ();
+    }
 }
 
 void 
@@ -585,6 +668,65 @@ Packet::EnableChecking (void)
   PacketMetadata::EnableChecking ();
 }
 
+void
+Packet::EnableHeaderChecking (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  m_enableHeaderChecking = true;
+}
+
+void
+Packet::PushHeader (const Header &header, uint32_t size)
+{
+  if (m_nHeaders == HEADERS_UNKNOWN)
+    {
+      return;
+    }
+  if (m_nHeaders == HEADER_STACK_SIZE)
+    {
+      // too deep to be tracked
+      m_nHeaders = HEADERS_UNKNOWN;
+      return;
+    }
+  m_headerUids[m_nHeaders] = header.GetInstanceTypeId ().GetUid ();
+  m_headerSizes[m_nHeaders] = size;
+  m_nHeaders++;
+}
+
+void
+Packet::PopHeader (const Header &header, uint32_t size)
+{
+  if (m_nHeaders == HEADERS_UNKNOWN)
+    {
+      return;
+    }
+  TypeId tid = header.GetInstanceTypeId ();
+  if (m_nHeaders == 0)
+    {
+      NS_FATAL_ERROR ("Removing header " << tid.GetName () << " from a packet without headers.");
+    }
+  m_nHeaders--;
+  if (m_headerUids[m_nHeaders] != tid.GetUid ())
+    {
+      NS_FATAL_ERROR ("Removing unexpected header " << tid.GetName () << ", the last header added is "
+                      << TypeId::GetRegistered (m_headerUids[m_nHeaders] - 1).GetName () << ".");
+    }
+  if (m_headerSizes[m_nHeaders] != size)
+    {
+      NS_FATAL_ERROR ("Removing header " << tid.GetName () << " of " << size
+                      << " bytes, " << m_headerSizes[m_nHeaders] << " bytes were added.");
+    }
+}
+
+void
+Packet::ForgetHeaders (void)
+{
+  if (m_nHeaders != 0)
+    {
+      m_nHeaders = HEADERS_UNKNOWN;
+    }
+}
+
 uint32_t Packet::GetSerializedSize (void) const
 {
   NS_LOG_FUNCTION (this);
@@ -878,6 +1020,13 @@ Packet::RemovePacketTag (Tag &tag)
   return found;
 }
 bool 
+Packet::ReplacePacketTag (const Tag &tag)
+{
+  NS_LOG_FUNCTION (this << &tag);
+  bool found = m_packetTagList.Replace (tag);
+  return found;
+}
+bool 
 Packet::PeekPacketTag (Tag &tag) const
 {
   NS_LOG_FUNCTION (this << &tag);
@@ -33,6 +33,7 @@
 #include "ns3/assert.h"
 #include "ns3/ptr.h"
 #include "ns3/deprecated.h"
+#include "ns3/pool-allocator.h"
 
 namespace ns3 {
 
@@ -374,6 +375,16 @@ public:
    */
   Ptr<Packet> Copy (void) const;
 
+  /**
+   * \returns a copy of the packet which shares neither its data
+   * nor its tags with this packet.
+   *
+   * Unlike the COW copy returned by Copy, it can be handed to
+   * another thread: the reference counts of the shared datasets
+   * are not atomic. The metadata, if enabled, is still shared.
+   */
+  Ptr<Packet> DeepCopy (void) const;
+
   /**
    * A packet is allocated a new uid when it is created
    * empty or with zero-filled payload.
@@ -430,6 +441,15 @@ public:
    * errors will be detected and will abort the program.
    */
   static void EnableChecking (void);
+  /**
+   * A cheaper alternative to EnableChecking, which does not record any
+   * metadata: every packet remembers the type and size of the last
+   * headers added to it (up to HEADER_STACK_SIZE of them), and removing
+   * a header of another type or size aborts the program. The packets
+   * whose headers cannot be tracked, e.g. fragments of packets with
+   * headers, or packets with deeper header stacks, are not checked.
+   */
+  static void EnableHeaderChecking (void);
 
   /**
    * For packet serializtion, the total size is checked 
@@ -515,6 +535,18 @@ public:
    * Tag::Deserialize if the tag is found.
    */
   bool RemovePacketTag (Tag &tag);
+  /**
+   * \param tag the new value of the tag
+   * \returns true if a tag of the same type is found, false
+   *          otherwise.
+   *
+   * Overwrite a tag of this packet with tag, without changing
+   * its position among the other tags. This is cheaper than
+   * RemovePacketTag followed by AddPacketTag, which copies the
+   * list of tags. This method calls Tag::Serialize if the tag is
+   * found.
+   */
+  bool ReplacePacketTag (const Tag &tag);
   /**
    * \param tag the tag to search in this packet
    * \returns true if the requested tag is found, false
@@ -553,12 +585,29 @@ public:
   void SetNixVector (Ptr<NixVector>);
   Ptr<NixVector> GetNixVector (void) const; 
 
+  /**
+   * Packets are taken from the PoolAllocator: every data segment and
+   * every ACK creates one.
+   */
+  static void *operator new (size_t size);
+  static void operator delete (void *p, size_t size);
+
 private:
   Packet (const Buffer &buffer, const ByteTagList &byteTagList, 
           const PacketTagList &packetTagList, const PacketMetadata &metadata);
 
   uint32_t Deserialize (uint8_t const*buffer, uint32_t size);
 
+  void PushHeader (const Header &header, uint32_t size);
+  void PopHeader (const Header &header, uint32_t size);
+  void ForgetHeaders (void);
+
+  enum
+  {
+    HEADER_STACK_SIZE = 4,
+    HEADERS_UNKNOWN = 0xff
+  };
+
   Buffer m_buffer;
   ByteTagList m_byteTagList;
   PacketTagList m_packetTagList;
@@ -567,7 +616,13 @@ private:
   /* Please see comments above about nix-vector */
   Ptr<NixVector> m_nixVector;
 
+  /* The headers checked by EnableHeaderChecking, the last added on top */
+  uint16_t m_headerUids[HEADER_STACK_SIZE];
+  uint16_t m_headerSizes[HEADER_STACK_SIZE];
+  uint8_t m_nHeaders;  //< HEADERS_UNKNOWN if the headers are not tracked
+
   static uint32_t m_globalUid;
+  static bool m_enableHeaderChecking;
 };
 
 std::ostream& operator<< (std::ostream& os, const Packet &packet);
@@ -622,6 +677,18 @@ Packet::GetSize (void) const
   return m_buffer.GetSize ();
 }
 
+inline void *
+Packet::operator new (size_t size)
+{
+  return PoolAllocator::Allocate (size);
+}
+
+inline void
+Packet::operator delete (void *p, size_t size)
+{
+  PoolAllocator::Deallocate (p, size);
+}
+
 } // namespace ns3
 
 #endif /* PACKET_H */
@@ -79,6 +79,37 @@ public:
     : ATestTagBase () {}
 };
 
+class AValueTag : public Tag
+{
+public:
+  static TypeId GetTypeId (void) {
+    static TypeId tid = TypeId ("anon::AValueTag")
+      .SetParent<Tag> ()
+      .AddConstructor<AValueTag> ()
+      .HideFromDocumentation ()
+    ;
+    return tid;
+  }
+  virtual TypeId GetInstanceTypeId (void) const {
+    return GetTypeId ();
+  }
+  virtual uint32_t GetSerializedSize (void) const {
+    return 4;
+  }
+  virtual void Serialize (TagBuffer buf) const {
+    buf.WriteU32 (m_value);
+  }
+  virtual void Deserialize (TagBuffer buf) {
+    m_value = buf.ReadU32 ();
+  }
+  virtual void Print (std::ostream &os) const {
+    os << m_value;
+  }
+  AValueTag (uint32_t value = 0)
+    : m_value (value) {}
+  uint32_t m_value;
+};
+
 class ATestHeaderBase : public Header
 {
 public:
@@ -420,6 +451,35 @@ PacketTest::DoRun (void)
     NS_TEST_EXPECT_MSG_EQ (p.PeekPacketTag (b), false, "trivial");
   }
 
+  {
+    // replacing a tag shared with a copy only changes this packet
+    Packet p;
+    p.AddPacketTag (ATestTag<10> ());
+    p.AddPacketTag (AValueTag (1));
+    p.AddPacketTag (ATestTag<11> ());
+    Packet copy = p;
+    NS_TEST_EXPECT_MSG_EQ (p.ReplacePacketTag (AValueTag (2)), true, "trivial");
+    AValueTag v;
+    p.PeekPacketTag (v);
+    NS_TEST_EXPECT_MSG_EQ (v.m_value, 2, "the tag was not replaced");
+    copy.PeekPacketTag (v);
+    NS_TEST_EXPECT_MSG_EQ (v.m_value, 1, "the copy of the tag was replaced");
+    // now the elements up to the tag belong to p alone
+    NS_TEST_EXPECT_MSG_EQ (p.ReplacePacketTag (AValueTag (3)), true, "trivial");
+    p.PeekPacketTag (v);
+    NS_TEST_EXPECT_MSG_EQ (v.m_value, 3, "the tag was not replaced");
+    copy.PeekPacketTag (v);
+    NS_TEST_EXPECT_MSG_EQ (v.m_value, 1, "the copy of the tag was replaced");
+    ATestTag<10> a;
+    ATestTag<11> b;
+    NS_TEST_EXPECT_MSG_EQ (p.PeekPacketTag (a), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (p.PeekPacketTag (b), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (copy.PeekPacketTag (a), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (copy.PeekPacketTag (b), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (a.m_error || b.m_error, false, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (p.ReplacePacketTag (ATestTag<12> ()), false, "trivial");
+  }
+
   {
     // bug 572
     Ptr<Packet> tmp = Create<Packet> (1000);
@@ -434,6 +494,108 @@ PacketTest::DoRun (void)
     CHECK (tmp, 1, E (20, 1, 1001));
 #endif
   }
+
+  {
+    // a deep copy keeps the data, the tags and their offsets
+    Ptr<Packet> tmp = Create<Packet> (1000);
+    tmp->AddByteTag (ATestTag<20> ());
+    tmp->AddHeader (ATestHeader<2> ());
+    tmp->AddPacketTag (ATestTag<10> ());
+    tmp->AddPacketTag (ATestTag<11> ());
+    Ptr<Packet> copy = tmp->DeepCopy ();
+    NS_TEST_EXPECT_MSG_EQ (copy->GetSize (), 1002, "trivial");
+    CHECK (copy, 1, E (20, 2, 1002));
+    ATestTag<10> a;
+    ATestTag<11> b;
+    NS_TEST_EXPECT_MSG_EQ (copy->PeekPacketTag (a), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (copy->PeekPacketTag (b), true, "trivial");
+    ATestHeader<2> header;
+    copy->RemoveHeader (header);
+    NS_TEST_EXPECT_MSG_EQ (header.m_error, false, "trivial");
+    CHECK (copy, 1, E (20, 0, 1000));
+    copy->RemovePacketTag (a);
+    NS_TEST_EXPECT_MSG_EQ (tmp->PeekPacketTag (a), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (tmp->GetSize (), 1002, "trivial");
+    CHECK (tmp, 1, E (20, 2, 1002));
+  }
+}
+//-----------------------------------------------------------------------------
+class PacketHeaderCheckingTest : public TestCase
+{
+public:
+  PacketHeaderCheckingTest ();
+  virtual void DoRun (void);
+};
+
+PacketHeaderCheckingTest::PacketHeaderCheckingTest ()
+  : TestCase ("Packet header checking") {
+}
+
+void
+PacketHeaderCheckingTest::DoRun (void)
+{
+  // the checks abort the program on error: these are the operations
+  // which must go through without any
+  Packet::EnableHeaderChecking ();
+  {
+    Ptr<Packet> p = Create<Packet> (1000);
+    p->AddHeader (ATestHeader<10> ());
+    p->AddHeader (ATestHeader<3> ());
+    Ptr<Packet> copy = p->Copy ();
+    ATestHeader<3> h3;
+    ATestHeader<10> h10;
+    NS_TEST_EXPECT_MSG_EQ (copy->RemoveHeader (h3), 3, "wrong header size");
+    NS_TEST_EXPECT_MSG_EQ (copy->RemoveHeader (h10), 10, "wrong header size");
+    NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (h3), 3, "wrong header size");
+    p->AddHeader (ATestHeader<4> ());
+    ATestHeader<4> h4;
+    NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (h4), 4, "wrong header size");
+    NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (h10), 10, "wrong header size");
+  }
+  {
+    // fragments and concatenations of payloads, as built by TcpTxBuffer
+    Ptr<Packet> p = Create<Packet> (1000)->CreateFragment (100, 500);
+    p->AddAtEnd (Create<Packet> (200));
+    p->AddHeader (ATestHeader<5> ());
+    p->AddAtEnd (Create<Packet> (10));
+    ATestHeader<5> h5;
+    NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (h5), 5, "wrong header size");
+    NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 710, "wrong packet size");
+  }
+  {
+    // fragments of packets with headers, and too many headers, are not tracked
+    Ptr<Packet> p = Create<Packet> (1000);
+    p->AddHeader (ATestHeader<2> ());
+    p->AddHeader (ATestHeader<3> ());
+    Ptr<Packet> fragment = p->CreateFragment (2, 500);
+    ATestHeader<2> h2;
+    fragment->RemoveHeader (h2);
+    for (uint32_t i = 0; i < 5; i++)
+      {
+        p->AddHeader (ATestHeader<1> ());
+      }
+    ATestHeader<1> h1;
+    for (uint32_t i = 0; i < 5; i++)
+      {
+        p->RemoveHeader (h1);
+      }
+    ATestHeader<3> h3;
+    NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (h3), 3, "wrong header size");
+    NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (h2), 2, "wrong header size");
+  }
+  {
+    // packets built from bytes, as received by the emu or fd devices,
+    // hold the serialized headers, which are not tracked
+    Ptr<Packet> p = Create<Packet> (100);
+    p->AddHeader (ATestHeader<20> ());
+    uint8_t bytes[120];
+    p->CopyData (bytes, sizeof (bytes));
+    Ptr<Packet> wire = Create<Packet> (bytes, sizeof (bytes));
+    ATestHeader<20> h20;
+    NS_TEST_EXPECT_MSG_EQ (wire->RemoveHeader (h20), 20, "wrong header size");
+    NS_TEST_EXPECT_MSG_EQ (h20.m_error, false, "the header was not deserialized");
+    NS_TEST_EXPECT_MSG_EQ (wire->GetSize (), 100, "wrong packet size");
+  }
 }
 //-----------------------------------------------------------------------------
 class PacketTestSuite : public TestSuite
@@ -446,6 +608,7 @@ PacketTestSuite::PacketTestSuite ()
   : TestSuite ("packet", UNIT)
 {
   AddTestCase (new PacketTest);
+  AddTestCase (new PacketHeaderCheckingTest);
 }
 
 static PacketTestSuite g_packetTestSuite;
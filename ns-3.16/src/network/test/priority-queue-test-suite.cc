@@ -0,0 +1,455 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/priority-queue.h"
+#include "ns3/my-priority-tag.h"
+#include "ns3/uinteger.h"
+#include "ns3/callback.h"
+
+using namespace ns3;
+
+static Ptr<Packet>
+CreateTaggedPacket (uint32_t size, uint32_t flowId, uint8_t priority)
+{
+  Ptr<Packet> p = Create<Packet> (size);
+  MyPriorityTag tag;
+  tag.SetId (flowId);
+  tag.SetPriority (priority);
+  p->AddPacketTag (tag);
+  return p;
+}
+
+class PriorityQueueOrderTestCase : public TestCase
+{
+public:
+  PriorityQueueOrderTestCase ();
+  virtual void DoRun (void);
+};
+
+PriorityQueueOrderTestCase::PriorityQueueOrderTestCase ()
+  : TestCase ("Dequeue order and push-out of the priority queue")
+{
+}
+
+void
+PriorityQueueOrderTestCase::DoRun (void)
+{
+  Ptr<PriorityQueue> queue = CreateObject<PriorityQueue> ();
+  queue->SetAttribute ("MaxBytes", UintegerValue (501));
+
+  Ptr<Packet> low1 = CreateTaggedPacket (100, 1, 2);
+  Ptr<Packet> low2 = CreateTaggedPacket (100, 2, 1);
+  Ptr<Packet> high1 = CreateTaggedPacket (100, 3, 0);
+  Ptr<Packet> high2 = CreateTaggedPacket (100, 4, 0);
+  Ptr<Packet> high3 = CreateTaggedPacket (100, 5, 0);
+  Ptr<Packet> high4 = CreateTaggedPacket (100, 6, 0);
+
+  queue->Enqueue (low1);
+  queue->Enqueue (low2);
+  queue->Enqueue (high1);
+  queue->Enqueue (high2);
+  queue->Enqueue (high3);
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 5, "All five packets fit");
+
+  // the queue is full, a high priority arrival pushes out the lowest priority packet
+  queue->Enqueue (high4);
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 5, "One packet should have been pushed out");
+
+  Ptr<Packet> p;
+  p = queue->Dequeue ();
+  NS_TEST_EXPECT_MSG_EQ (p->GetUid (), high1->GetUid (), "Priority 0 packets come out first");
+  p = queue->Dequeue ();
+  NS_TEST_EXPECT_MSG_EQ (p->GetUid (), high2->GetUid (), "Priority 0 is FIFO");
+  p = queue->Dequeue ();
+  NS_TEST_EXPECT_MSG_EQ (p->GetUid (), high3->GetUid (), "Priority 0 is FIFO");
+  p = queue->Dequeue ();
+  NS_TEST_EXPECT_MSG_EQ (p->GetUid (), high4->GetUid (), "Priority 0 is FIFO");
+  p = queue->Dequeue ();
+  NS_TEST_EXPECT_MSG_EQ (p->GetUid (), low2->GetUid (), "Priority 2 packet was the one pushed out");
+  p = queue->Dequeue ();
+  NS_TEST_EXPECT_MSG_EQ ((p == 0), true, "The queue should be empty");
+
+  Simulator::Destroy ();
+}
+
+class PriorityQueueFlushTestCase : public TestCase
+{
+public:
+  PriorityQueueFlushTestCase ();
+  virtual void DoRun (void);
+};
+
+PriorityQueueFlushTestCase::PriorityQueueFlushTestCase ()
+  : TestCase ("Flushing the low priority packets of a flow")
+{
+}
+
+void
+PriorityQueueFlushTestCase::DoRun (void)
+{
+  Ptr<PriorityQueue> queue = CreateObject<PriorityQueue> ();
+  queue->SetAttribute ("MaxBytes", UintegerValue (1000000));
+
+  std::vector<Ptr<Packet> > kept;
+  for (uint32_t i = 0; i < 40; i++)
+    {
+      uint32_t flowId = i % 4;
+      uint8_t priority = i % 5;
+      Ptr<Packet> p = CreateTaggedPacket (100 + i, flowId, priority);
+      queue->Enqueue (p);
+      if (flowId != 1 || priority == 0)
+        {
+          kept.push_back (p);
+        }
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 40, "All packets fit");
+
+  queue->FlushOutFlowPackets (1);
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), kept.size (), "Low priority packets of flow 1 are gone");
+  queue->FlushOutFlowPackets (1);
+  queue->FlushOutFlowPackets (17);
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), kept.size (), "Flushing twice or an unknown flow is harmless");
+
+  uint32_t bytes = 0;
+  for (uint32_t i = 0; i < kept.size (); i++)
+    {
+      bytes += kept[i]->GetSize ();
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNBytes (), bytes, "Byte count matches the remaining packets");
+
+  // remaining packets leave in priority order, FIFO within a priority
+  for (uint8_t priority = 0; priority < 5; priority++)
+    {
+      for (uint32_t i = 0; i < kept.size (); i++)
+        {
+          MyPriorityTag tag;
+          kept[i]->PeekPacketTag (tag);
+          if (tag.GetPriority () != priority)
+            {
+              continue;
+            }
+          Ptr<Packet> p = queue->Dequeue ();
+          NS_TEST_EXPECT_MSG_EQ (p->GetUid (), kept[i]->GetUid (), "Unexpected dequeue order after flush");
+        }
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue->IsEmpty (), true, "The queue should be empty");
+
+  // slots released by the flush are reused
+  queue->Enqueue (CreateTaggedPacket (100, 1, 3));
+  queue->FlushOutFlowPackets (1);
+  NS_TEST_EXPECT_MSG_EQ (queue->IsEmpty (), true, "The queue should be empty again");
+
+  Simulator::Destroy ();
+}
+
+class PriorityQueueUntaggedTestCase : public TestCase
+{
+public:
+  PriorityQueueUntaggedTestCase ();
+  virtual void DoRun (void);
+};
+
+PriorityQueueUntaggedTestCase::PriorityQueueUntaggedTestCase ()
+  : TestCase ("Packets without a priority tag go to the high priority sub-queue")
+{
+}
+
+void
+PriorityQueueUntaggedTestCase::DoRun (void)
+{
+  Ptr<PriorityQueue> queue = CreateObject<PriorityQueue> ();
+  queue->SetAttribute ("MaxBytes", UintegerValue (1000000));
+
+  Ptr<Packet> low = CreateTaggedPacket (100, 0, 3);
+  Ptr<Packet> untagged = Create<Packet> (200);
+  queue->Enqueue (low);
+  queue->Enqueue (untagged);
+
+  // flow 0 is also the id assumed for untagged packets, they must survive a flush
+  queue->FlushOutFlowPackets (0);
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 1, "Only the tagged low priority packet is flushed");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNBytes (), 200, "Byte count of the untagged packet");
+  Ptr<Packet> p = queue->Dequeue ();
+  NS_TEST_EXPECT_MSG_EQ (p->GetUid (), untagged->GetUid (), "Untagged packet is kept");
+
+  Simulator::Destroy ();
+}
+
+// runs the events scheduled for now, the queue logs its length forever
+static void
+RunPendingEvents (void)
+{
+  Simulator::Stop (Seconds (0));
+  Simulator::Run ();
+}
+
+// builds the deferred packets of a PriorityQueue the way a socket would
+class DeferredSender
+{
+public:
+  DeferredSender (Ptr<PriorityQueue> queue, uint32_t flowId)
+    : m_queue (queue),
+      m_flowId (flowId)
+  {
+  }
+  void Send (uint32_t seq, uint8_t priority)
+  {
+    m_built.push_back (seq);
+    m_queue->Enqueue (CreateTaggedPacket (100, m_flowId, priority));
+  }
+  Ptr<PriorityQueue> m_queue;
+  uint32_t m_flowId;
+  std::vector<uint32_t> m_built;
+};
+
+class PriorityQueueDeferTestCase : public TestCase
+{
+public:
+  PriorityQueueDeferTestCase ();
+  virtual void DoRun (void);
+  void CountDrop (Ptr<const Packet> p);
+  uint32_t m_drops;
+};
+
+PriorityQueueDeferTestCase::PriorityQueueDeferTestCase ()
+  : TestCase ("Deferred low priority packets are built as the queue drains"),
+    m_drops (0)
+{
+}
+
+void
+PriorityQueueDeferTestCase::CountDrop (Ptr<const Packet> p)
+{
+  m_drops++;
+}
+
+void
+PriorityQueueDeferTestCase::DoRun (void)
+{
+  Ptr<PriorityQueue> queue = CreateObject<PriorityQueue> ();
+  queue->SetAttribute ("MaxBytes", UintegerValue (1000));
+  queue->TraceConnectWithoutContext ("Drop", MakeCallback (&PriorityQueueDeferTestCase::CountDrop, this));
+  DeferredSender sender (queue, 7);
+  PriorityQueue::MaterializeCallback cb = MakeCallback (&DeferredSender::Send, &sender);
+
+  // nothing to join yet
+  NS_TEST_EXPECT_MSG_EQ (queue->DeferPacket (7, 2, 10, cb), false, "An empty sub-queue has no run");
+  queue->Enqueue (CreateTaggedPacket (100, 7, 2));
+  queue->AdoptLastPacket (7, 2, 10, cb);
+  // a burst sent tail first
+  for (uint32_t seq = 9; seq > 2; seq--)
+    {
+      NS_TEST_EXPECT_MSG_EQ (queue->DeferPacket (7, 2, seq, cb), true, "Consecutive packet joins the run");
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue->DeferPacket (8, 2, 2, cb), false, "Another flow cannot join the run");
+  NS_TEST_EXPECT_MSG_EQ (queue->DeferPacket (7, 3, 2, cb), false, "Another priority cannot join the run");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 8, "Deferred packets are counted");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNBytes (), 800, "Deferred bytes are counted");
+  NS_TEST_EXPECT_MSG_EQ (sender.m_built.size (), 0, "Nothing was built yet");
+
+  // the second high priority packet pushes out the last deferred packet
+  queue->Enqueue (CreateTaggedPacket (100, 1, 0));
+  queue->Enqueue (CreateTaggedPacket (100, 2, 0));
+  NS_TEST_EXPECT_MSG_EQ (m_drops, 1, "Queue full, one deferred packet pushed out");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 9, "Seven low and two high priority packets");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNBytes (), 900, "Byte count after push-out");
+
+  Ptr<Packet> p = queue->Dequeue ();
+  MyPriorityTag tag;
+  p->PeekPacketTag (tag);
+  NS_TEST_EXPECT_MSG_EQ ((uint32_t)tag.GetPriority (), 0, "High priority first");
+  queue->Dequeue ();
+
+  // the pushed out packet leaves a gap, the next packet starts a new run
+  NS_TEST_EXPECT_MSG_EQ (queue->DeferPacket (7, 2, 2, cb), true, "Packet after the gap is deferred");
+  NS_TEST_EXPECT_MSG_EQ (m_drops, 1, "and fits in the queue");
+
+  p = queue->Dequeue ();
+  p->PeekPacketTag (tag);
+  NS_TEST_EXPECT_MSG_EQ (tag.GetId (), 7, "Then the first packet of the run");
+  NS_TEST_EXPECT_MSG_EQ (sender.m_built.size (), 0, "The next one is built in a later event");
+  RunPendingEvents ();
+  NS_TEST_EXPECT_MSG_EQ (sender.m_built.size (), 1, "The next one is built once the head is free");
+  NS_TEST_EXPECT_MSG_EQ (sender.m_built[0], 9, "In the order the burst was deferred");
+
+  // dequeueing twice in the same event builds the packet right away
+  queue->Dequeue ();
+  queue->Dequeue ();
+  NS_TEST_EXPECT_MSG_EQ (sender.m_built.size (), 2, "Built on demand");
+  NS_TEST_EXPECT_MSG_EQ (sender.m_built[1], 8, "Next sequence number of the run");
+  RunPendingEvents ();
+  NS_TEST_EXPECT_MSG_EQ (sender.m_built.size (), 3, "Refilled after the second dequeue");
+  NS_TEST_EXPECT_MSG_EQ (sender.m_built[2], 7, "Next sequence number of the run");
+
+  uint32_t expected[] = { 6, 5, 4, 2 };
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      queue->Dequeue ();
+      RunPendingEvents ();
+      NS_TEST_EXPECT_MSG_EQ (sender.m_built.back (), expected[i], "Run order across the gap");
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNPackets (), 1, "Only the last built packet is left");
+  queue->Dequeue ();
+  NS_TEST_EXPECT_MSG_EQ (queue->IsEmpty (), true, "The queue should be empty");
+
+  // a flush removes deferred packets without building them
+  queue->Enqueue (CreateTaggedPacket (100, 7, 3));
+  queue->AdoptLastPacket (7, 3, 20, cb);
+  queue->DeferPacket (7, 3, 19, cb);
+  queue->DeferPacket (7, 3, 18, cb);
+  uint32_t built = sender.m_built.size ();
+  queue->FlushOutFlowPackets (7);
+  RunPendingEvents ();
+  NS_TEST_EXPECT_MSG_EQ (queue->IsEmpty (), true, "Flushed runs are gone");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNBytes (), 0, "No bytes left after the flush");
+  NS_TEST_EXPECT_MSG_EQ (sender.m_built.size (), built, "Flushed packets are never built");
+
+  Simulator::Destroy ();
+}
+
+class PriorityQueueClassStatsTestCase : public TestCase
+{
+public:
+  PriorityQueueClassStatsTestCase ();
+  virtual void DoRun (void);
+  void Dequeue (Ptr<PriorityQueue> queue);
+  void Refused (Ptr<const Packet> p, uint8_t priority, uint32_t flowId);
+  void PushedOut (Ptr<const Packet> p, uint8_t priority, uint32_t flowId);
+  std::vector<uint32_t> m_refused;    // priority and flow id of each refused packet
+  std::vector<uint32_t> m_pushedOut;  // priority and flow id of each pushed out packet
+};
+
+PriorityQueueClassStatsTestCase::PriorityQueueClassStatsTestCase ()
+  : TestCase ("Per priority counters, sojourn times and traces")
+{
+}
+
+void
+PriorityQueueClassStatsTestCase::Dequeue (Ptr<PriorityQueue> queue)
+{
+  queue->Dequeue ();
+}
+
+void
+PriorityQueueClassStatsTestCase::Refused (Ptr<const Packet> p, uint8_t priority, uint32_t flowId)
+{
+  m_refused.push_back (priority);
+  m_refused.push_back (flowId);
+}
+
+void
+PriorityQueueClassStatsTestCase::PushedOut (Ptr<const Packet> p, uint8_t priority, uint32_t flowId)
+{
+  m_pushedOut.push_back (priority);
+  m_pushedOut.push_back (flowId);
+}
+
+void
+PriorityQueueClassStatsTestCase::DoRun (void)
+{
+  Ptr<PriorityQueue> queue = CreateObject<PriorityQueue> ();
+  queue->SetAttribute ("MaxBytes", UintegerValue (501));
+  queue->TraceConnectWithoutContext ("ClassDrop", MakeCallback (&PriorityQueueClassStatsTestCase::Refused, this));
+  queue->TraceConnectWithoutContext ("ClassPushOut", MakeCallback (&PriorityQueueClassStatsTestCase::PushedOut, this));
+
+  queue->Enqueue (CreateTaggedPacket (100, 1, 2));
+  queue->Enqueue (CreateTaggedPacket (100, 2, 1));
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      queue->Enqueue (CreateTaggedPacket (100, 3 + i, 0));
+    }
+  // nothing below priority 3 to push out
+  queue->Enqueue (CreateTaggedPacket (100, 8, 3));
+  // the traces carry the priority of the tag, the last class counts it
+  queue->Enqueue (CreateTaggedPacket (100, 9, 7));
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      Simulator::Schedule (MicroSeconds (250 + 100 * i), &PriorityQueueClassStatsTestCase::Dequeue, this, queue);
+    }
+  Simulator::Stop (MicroSeconds (1000));
+  Simulator::Run ();
+
+  uint32_t pushedOut[] = { 2, 1 };
+  uint32_t refused[] = { 3, 8, 7, 9 };
+  NS_TEST_EXPECT_MSG_EQ ((m_pushedOut == std::vector<uint32_t> (pushedOut, pushedOut + 2)), true, "Push-out trace");
+  NS_TEST_EXPECT_MSG_EQ ((m_refused == std::vector<uint32_t> (refused, refused + 4)), true, "Drop trace");
+
+  const PriorityQueue::ClassStats &high = queue->GetClassStats (0);
+  NS_TEST_EXPECT_MSG_EQ (high.enqueuedPackets, 4, "Four high priority packets accepted");
+  NS_TEST_EXPECT_MSG_EQ (high.enqueuedBytes, 400, "Four high priority packets accepted");
+  NS_TEST_EXPECT_MSG_EQ (high.dequeuedPackets, 4, "and dequeued");
+  NS_TEST_EXPECT_MSG_EQ (high.sojournSum, MicroSeconds (250 + 350 + 450 + 550), "Sum of the high priority sojourn times");
+  NS_TEST_EXPECT_MSG_EQ (high.maxSojourn, MicroSeconds (550), "Longest high priority sojourn time");
+  NS_TEST_EXPECT_MSG_EQ (high.sojournHistogram.size (), 100, "Default number of bins");
+  NS_TEST_EXPECT_MSG_EQ (high.sojournHistogram[2] + high.sojournHistogram[3], 2, "100us bins");
+  NS_TEST_EXPECT_MSG_EQ (high.sojournHistogram[4] + high.sojournHistogram[5], 2, "100us bins");
+  const PriorityQueue::ClassStats &one = queue->GetClassStats (1);
+  NS_TEST_EXPECT_MSG_EQ (one.dequeuedBytes, 100, "The priority 1 packet left last");
+  NS_TEST_EXPECT_MSG_EQ (one.sojournSum, MicroSeconds (650), "after waiting for the high priority ones");
+  const PriorityQueue::ClassStats &two = queue->GetClassStats (2);
+  NS_TEST_EXPECT_MSG_EQ (two.enqueuedPackets, 1, "The priority 2 packet was accepted");
+  NS_TEST_EXPECT_MSG_EQ (two.pushedOutBytes, 100, "then pushed out");
+  NS_TEST_EXPECT_MSG_EQ (two.dequeuedPackets, 0, "and never dequeued");
+  const PriorityQueue::ClassStats &three = queue->GetClassStats (3);
+  NS_TEST_EXPECT_MSG_EQ (three.enqueuedPackets, 0, "The priority 3 packet was refused");
+  NS_TEST_EXPECT_MSG_EQ (three.droppedBytes, 100, "The priority 3 packet was refused");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetClassStats (NUM_PRIORITY_QUEUES - 1).droppedPackets, 1, "The priority 7 packet was refused");
+
+  // deferred packets are timed from DeferPacket, flushed ones are counted
+  queue->ResetClassStats ();
+  NS_TEST_EXPECT_MSG_EQ (queue->GetClassStats (0).sojournHistogram[2], 0, "Reset clears the histograms");
+  queue->SetAttribute ("MaxBytes", UintegerValue (1000000));
+  queue->SetAttribute ("SojournBins", UintegerValue (4));
+  DeferredSender sender (queue, 7);
+  PriorityQueue::MaterializeCallback cb = MakeCallback (&DeferredSender::Send, &sender);
+  queue->Enqueue (CreateTaggedPacket (100, 7, 2));
+  queue->AdoptLastPacket (7, 2, 10, cb);
+  Simulator::Schedule (MicroSeconds (100), &PriorityQueue::DeferPacket, queue, 7, 2, 9, cb);
+  Simulator::Schedule (MicroSeconds (150), &PriorityQueue::DeferPacket, queue, 7, 2, 8, cb);
+  Simulator::Schedule (MicroSeconds (300), &PriorityQueueClassStatsTestCase::Dequeue, this, queue);
+  Simulator::Schedule (MicroSeconds (700), &PriorityQueueClassStatsTestCase::Dequeue, this, queue);
+  Simulator::Schedule (MicroSeconds (800), &PriorityQueue::FlushOutFlowPackets, queue, 7);
+  Simulator::Stop (MicroSeconds (1000));
+  Simulator::Run ();
+
+  const PriorityQueue::ClassStats &deferred = queue->GetClassStats (2);
+  NS_TEST_EXPECT_MSG_EQ (sender.m_built.size (), 2, "Two deferred packets were built");
+  NS_TEST_EXPECT_MSG_EQ (deferred.enqueuedPackets, 3, "Deferred packets are counted when deferred");
+  NS_TEST_EXPECT_MSG_EQ (deferred.dequeuedPackets, 2, "Two packets left");
+  NS_TEST_EXPECT_MSG_EQ (deferred.sojournSum, MicroSeconds (300 + 600), "The second one waited from its DeferPacket");
+  NS_TEST_EXPECT_MSG_EQ (deferred.sojournHistogram[3], 2, "Long sojourns go to the last bin");
+  NS_TEST_EXPECT_MSG_EQ (deferred.flushedPackets, 1, "The last one was flushed");
+  NS_TEST_EXPECT_MSG_EQ (queue->IsEmpty (), true, "The queue should be empty");
+
+  Simulator::Destroy ();
+}
+
+static class PriorityQueueTestSuite : public TestSuite
+{
+public:
+  PriorityQueueTestSuite ()
+    : TestSuite ("priority-queue", UNIT)
+  {
+    AddTestCase (new PriorityQueueOrderTestCase ());
+    AddTestCase (new PriorityQueueFlushTestCase ());
+    AddTestCase (new PriorityQueueUntaggedTestCase ());
+    AddTestCase (new PriorityQueueDeferTestCase ());
+    AddTestCase (new PriorityQueueClassStatsTestCase ());
+  }
+} g_priorityQueueTestSuite;
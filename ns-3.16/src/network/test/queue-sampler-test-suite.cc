@@ -0,0 +1,159 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/config.h"
+#include "ns3/string.h"
+#include "ns3/queue-sampler.h"
+
+using namespace ns3;
+
+// A queue whose occupancy is set by the test and whose records are
+// counted instead of written
+class FakeSampledQueue : public SampledQueue
+{
+public:
+  FakeSampledQueue ()
+    : m_bytes (0), m_logged (0)
+  {
+    QueueSampler::Register (this);
+  }
+  virtual ~FakeSampledQueue ()
+  {
+    QueueSampler::Unregister (this);
+  }
+  virtual uint32_t GetSampleId (void) const
+  {
+    return 0;
+  }
+  virtual uint32_t GetNSubQueues (void) const
+  {
+    return 1;
+  }
+  virtual uint32_t GetSubQueuePackets (uint32_t subQueue) const
+  {
+    return m_bytes / 1000;
+  }
+  virtual uint32_t GetSubQueueBytes (uint32_t subQueue) const
+  {
+    return m_bytes;
+  }
+  virtual void LogQueueLength (void)
+  {
+    m_logged++;
+    m_times.push_back (Simulator::Now ());
+  }
+  void SetBytes (uint32_t bytes)
+  {
+    m_bytes = bytes;
+  }
+
+  uint32_t m_bytes;
+  uint32_t m_logged;
+  std::vector<Time> m_times;
+};
+
+class QueueSamplerModeTestCase : public TestCase
+{
+public:
+  QueueSamplerModeTestCase (std::string mode, uint32_t expected);
+  virtual void DoRun (void);
+private:
+  std::string m_mode;
+  uint32_t m_expected;
+};
+
+QueueSamplerModeTestCase::QueueSamplerModeTestCase (std::string mode, uint32_t expected)
+  : TestCase ("QueueSampler in " + mode + " mode"),
+    m_mode (mode),
+    m_expected (expected)
+{
+}
+
+void
+QueueSamplerModeTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::QueueSampler::Mode", StringValue (m_mode));
+  FakeSampledQueue a;
+  FakeSampledQueue b;
+  // the occupancy of a changes once, at 0.25 s; b stays empty
+  Simulator::Schedule (Seconds (0.25), &FakeSampledQueue::SetBytes, &a, 3000);
+  Simulator::Stop (Seconds (0.55));
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_EQ (a.m_logged, m_expected, "unexpected number of records of a changing queue");
+  if (m_mode == "Periodic")
+    {
+      // samples at 0, 0.1, ..., 0.5 s
+      NS_TEST_EXPECT_MSG_EQ (b.m_logged, 6, "every queue is sampled");
+      NS_TEST_EXPECT_MSG_EQ (a.m_times[3], MilliSeconds (300), "bad sample time");
+    }
+  else if (m_mode == "OnChange")
+    {
+      NS_TEST_EXPECT_MSG_EQ (b.m_logged, 1, "an idle queue is only recorded once");
+      NS_TEST_EXPECT_MSG_EQ (a.m_times[1], MilliSeconds (300), "the change is recorded at the next sample");
+    }
+  else
+    {
+      NS_TEST_EXPECT_MSG_EQ (b.m_logged, 0, "no records");
+    }
+  Simulator::Destroy ();
+  Config::SetDefault ("ns3::QueueSampler::Mode", StringValue ("Periodic"));
+}
+
+static void
+DeleteQueue (FakeSampledQueue *queue)
+{
+  delete queue;
+}
+
+class QueueSamplerLifetimeTestCase : public TestCase
+{
+public:
+  QueueSamplerLifetimeTestCase ();
+  virtual void DoRun (void);
+};
+
+QueueSamplerLifetimeTestCase::QueueSamplerLifetimeTestCase ()
+  : TestCase ("QueueSampler event ends with the last queue")
+{
+}
+
+void
+QueueSamplerLifetimeTestCase::DoRun (void)
+{
+  FakeSampledQueue *a = new FakeSampledQueue ();
+  Simulator::Schedule (Seconds (0.35), &DeleteQueue, a);
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (Simulator::Now (), Seconds (0.35), "the sampler kept the simulation running");
+  Simulator::Destroy ();
+}
+
+static class QueueSamplerTestSuite : public TestSuite
+{
+public:
+  QueueSamplerTestSuite ()
+    : TestSuite ("queue-sampler", UNIT)
+  {
+    AddTestCase (new QueueSamplerModeTestCase ("Periodic", 6));
+    AddTestCase (new QueueSamplerModeTestCase ("OnChange", 2));
+    AddTestCase (new QueueSamplerModeTestCase ("Histogram", 0));
+    AddTestCase (new QueueSamplerModeTestCase ("Disabled", 0));
+    AddTestCase (new QueueSamplerLifetimeTestCase ());
+  }
+} g_queueSamplerTestSuite;
@@ -0,0 +1,129 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/rcp-queue.h"
+#include "ns3/rcp-tag.h"
+#include "ns3/double.h"
+
+using namespace ns3;
+
+static Ptr<Packet>
+CreateRcpPacket (uint32_t size, double bottleneckRate)
+{
+  Ptr<Packet> p = Create<Packet> (size);
+  RCPTag tag;
+  tag.SetId (1);
+  tag.SetBottleneckRate (bottleneckRate);
+  tag.SetReverseBottleneckRate (-1);
+  tag.SetRTT (0.1);
+  tag.SetTs (2.5);
+  p->AddPacketTag (tag);
+  return p;
+}
+
+class RCPTagEncodingTestCase : public TestCase
+{
+public:
+  RCPTagEncodingTestCase ();
+  virtual void DoRun (void);
+};
+
+RCPTagEncodingTestCase::RCPTagEncodingTestCase ()
+  : TestCase ("Fixed point encoding of the RCP tag fields")
+{
+}
+
+void
+RCPTagEncodingTestCase::DoRun (void)
+{
+  Ptr<Packet> p = Create<Packet> (100);
+  RCPTag tag;
+  tag.SetId (7);
+  tag.SetBottleneckRate (1234567.4);
+  tag.SetReverseBottleneckRate (-1);
+  tag.SetRTT (0.123456789);
+  tag.SetTs (Seconds (12.000000001).GetSeconds ());
+  tag.SetReverseTs (1e6);
+  p->AddPacketTag (tag);
+
+  RCPTag peeked;
+  p->PeekPacketTag (peeked);
+  NS_TEST_EXPECT_MSG_EQ (peeked.GetId (), 7, "The id is kept");
+  NS_TEST_EXPECT_MSG_EQ (peeked.GetBottleneckRate (), 1234567, "Rates are whole bytes per second");
+  NS_TEST_EXPECT_MSG_EQ (peeked.GetBottleneckRateFixed (), 1234567, "Rates are whole bytes per second");
+  NS_TEST_EXPECT_MSG_EQ (peeked.GetReverseBottleneckRate (), -1, "Negative rates mean no rate");
+  NS_TEST_EXPECT_MSG_EQ (peeked.GetRTTNanoSeconds (), 123456789, "Times are nanoseconds");
+  Time ts = Seconds (peeked.GetTs ());
+  NS_TEST_EXPECT_MSG_EQ (ts, NanoSeconds (12000000001LL), "Times are nanoseconds");
+  NS_TEST_EXPECT_MSG_EQ (peeked.GetReverseTs (), 1e6, "Timestamps do not saturate");
+
+  tag.SetBottleneckRate (1e12);
+  tag.SetRTT (10);
+  p->ReplacePacketTag (tag);
+  p->PeekPacketTag (peeked);
+  NS_TEST_EXPECT_MSG_EQ (peeked.GetBottleneckRateFixed (), RCPTag::NO_RATE - 1, "Rates saturate");
+  NS_TEST_EXPECT_MSG_EQ (peeked.GetRTTNanoSeconds (), 0xffffffff, "RTTs saturate");
+}
+
+class RCPQueueStampTestCase : public TestCase
+{
+public:
+  RCPQueueStampTestCase ();
+  virtual void DoRun (void);
+};
+
+RCPQueueStampTestCase::RCPQueueStampTestCase ()
+  : TestCase ("The RCP queue stamps its rate on the packets with a higher one")
+{
+}
+
+void
+RCPQueueStampTestCase::DoRun (void)
+{
+  Ptr<RCPQueue> queue = CreateObject<RCPQueue> ();
+  queue->SetAttribute ("Capacity", DoubleValue (125000000));
+
+  // the initial rate of the queue is 5% of 1Gbps
+  double rates[] = { -1, 1000000, 10000000 };
+  double expected[] = { 6250000, 1000000, 6250000 };
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      queue->Enqueue (CreateRcpPacket (1000, rates[i]));
+    }
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      Ptr<Packet> p = queue->Dequeue ();
+      RCPTag tag;
+      NS_TEST_EXPECT_MSG_EQ (p->PeekPacketTag (tag), true, "The tag is still there");
+      NS_TEST_EXPECT_MSG_EQ (tag.GetBottleneckRate (), expected[i], "Unexpected bottleneck rate of packet " << i);
+      NS_TEST_EXPECT_MSG_EQ (tag.GetRTTNanoSeconds (), 100000000, "The other fields are unchanged");
+    }
+
+  Simulator::Destroy ();
+}
+
+static class RCPQueueTestSuite : public TestSuite
+{
+public:
+  RCPQueueTestSuite ()
+    : TestSuite ("rcp-queue", UNIT)
+  {
+    AddTestCase (new RCPTagEncodingTestCase ());
+    AddTestCase (new RCPQueueStampTestCase ());
+  }
+} g_rcpQueueTestSuite;
@@ -0,0 +1,129 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/record-sink.h"
+
+using namespace ns3;
+
+static std::string
+ReadFile (std::string filename)
+{
+  std::ifstream in (filename.c_str (), std::ios::binary);
+  std::ostringstream content;
+  content << in.rdbuf ();
+  return content.str ();
+}
+
+class RecordSinkTextTestCase : public TestCase
+{
+public:
+  RecordSinkTextTestCase ();
+  virtual void DoRun (void);
+};
+
+RecordSinkTextTestCase::RecordSinkTextTestCase ()
+  : TestCase ("Text records are buffered and formatted like std::ostream")
+{
+}
+
+void
+RecordSinkTextTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("record-sink-text.txt");
+  remove (filename.c_str ());
+  RecordStream *stream = RecordSink::GetStream (filename, "dIsHi");
+  NS_TEST_ASSERT_MSG_EQ (stream->GetFilename (), filename, "text logs keep their name");
+  NS_TEST_ASSERT_MSG_EQ (RecordSink::GetStream (filename, "dIsHi"), stream, "log points of a file share a stream");
+
+  double values[] = { 0.1, 1.5, 1234567.0, 0.30000000000000004, 1e-7, 12.0 };
+  std::ostringstream expected;
+  for (uint32_t i = 0; i < sizeof (values) / sizeof (values[0]); i++)
+    {
+      stream->Add (values[i]).Add (4294967295u).Add (std::string ("12")).Add ((uint16_t)i).Add ((int32_t)-3).End ();
+      expected << values[i] << "\t" << 4294967295u << "\t" << "12" << "\t" << i << "\t" << -3 << "\n";
+    }
+  NS_TEST_EXPECT_MSG_EQ (ReadFile (filename), "", "records are written before a flush");
+  RecordSink::Flush ();
+  NS_TEST_EXPECT_MSG_EQ (ReadFile (filename), expected.str (), "text records differ from std::ostream");
+
+  // a record buffered during a simulation is written when it is destroyed
+  stream->Add (2.0).Add (1u).Add (std::string ("")).Add ((uint16_t)0).Add ((int32_t)0).End ();
+  expected << 2.0 << "\t1\t\t0\t0\n";
+  Simulator::Destroy ();
+  NS_TEST_EXPECT_MSG_EQ (ReadFile (filename), expected.str (), "records are not flushed by Simulator::Destroy");
+}
+
+class RecordSinkBinaryTestCase : public TestCase
+{
+public:
+  RecordSinkBinaryTestCase ();
+  virtual void DoRun (void);
+};
+
+RecordSinkBinaryTestCase::RecordSinkBinaryTestCase ()
+  : TestCase ("Binary records")
+{
+}
+
+void
+RecordSinkBinaryTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("record-sink-binary");
+  remove ((filename + ".bin").c_str ());
+  RecordSink::SetBinary (true);
+  RecordStream *stream = RecordSink::GetStream (filename + ".txt", "dsI");
+  RecordSink::SetBinary (false);
+  NS_TEST_ASSERT_MSG_EQ (stream->GetFilename (), filename + ".bin", "binary logs are .bin files");
+
+  stream->Add (0.5).Add (std::string ("ab")).Add (7u).End ();
+  stream->Add (1.5).Add (std::string ("")).Add (8u).End ();
+  RecordSink::Flush ();
+
+  std::string content = ReadFile (filename + ".bin");
+  // header: magic, version, byte order, format length and format
+  NS_TEST_ASSERT_MSG_EQ (content.size (), 8 + 3 + (8 + 2 + 2 + 4) + (8 + 2 + 0 + 4), "unexpected file size");
+  NS_TEST_EXPECT_MSG_EQ (content.substr (0, 4), "RECS", "bad magic");
+  NS_TEST_EXPECT_MSG_EQ (content.substr (8, 3), "dsI", "bad format");
+  const char *record = content.data () + 11;
+  double time;
+  uint16_t length;
+  uint32_t value;
+  memcpy (&time, record, 8);
+  memcpy (&length, record + 8, 2);
+  memcpy (&value, record + 12, 4);
+  NS_TEST_EXPECT_MSG_EQ (time, 0.5, "bad double field");
+  NS_TEST_EXPECT_MSG_EQ (length, 2, "bad string length");
+  NS_TEST_EXPECT_MSG_EQ (std::string (record + 10, 2), "ab", "bad string field");
+  NS_TEST_EXPECT_MSG_EQ (value, 7, "bad integer field");
+  memcpy (&value, record + 16 + 10, 4);
+  NS_TEST_EXPECT_MSG_EQ (value, 8, "bad integer field of the second record");
+}
+
+static class RecordSinkTestSuite : public TestSuite
+{
+public:
+  RecordSinkTestSuite ()
+    : TestSuite ("record-sink", UNIT)
+  {
+    AddTestCase (new RecordSinkTextTestCase ());
+    AddTestCase (new RecordSinkBinaryTestCase ());
+  }
+} g_recordSinkTestSuite;
@@ -17,7 +17,7 @@
  */
 
 #include <iostream>
-#include <fstream>
+#include <algorithm>
 #include "ns3/simulator.h"
 #include "ns3/ptr.h"
 #include "ns3/log.h"
@@ -25,13 +25,18 @@
 #include "ns3/boolean.h"
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
+#include "ns3/string.h"
+#include "ns3/nstime.h"
+#include "ns3/trace-source-accessor.h"
 #include "ns3/my-priority-tag.h"
 #include "ns3/random-variable-stream.h"
 #include "priority-queue.h"
+#include "record-sink.h"
 
 
 #define MAXPACKETS 1000
 #define MAXBYTES 225000
+#define NO_SLOT 0xffffffff
 
 
 NS_LOG_COMPONENT_DEFINE ("PriorityQueue");
@@ -71,6 +76,30 @@ TypeId PriorityQueue::GetTypeId (void)
                     DoubleValue(0.0),
                     MakeDoubleAccessor(&PriorityQueue::m_backgrounddrop),
                     MakeDoubleChecker<double> ())  
+    .AddAttribute ("QueueLengthFile", "The file the queue length samples are written to.",
+                   StringValue ("queuelength.txt"),
+                   MakeStringAccessor (&PriorityQueue::m_queueLengthFile),
+                   MakeStringChecker ())
+    .AddAttribute ("SojournBinWidth", "The width of the bins of the sojourn time histograms.",
+                   TimeValue (MicroSeconds (100)),
+                   MakeTimeAccessor (&PriorityQueue::m_sojournBinWidth),
+                   MakeTimeChecker ())
+    .AddAttribute ("SojournBins", "The number of bins of the sojourn time histograms, the last one holds the longer sojourns.",
+                   UintegerValue (100),
+                   MakeUintegerAccessor (&PriorityQueue::m_sojournBins),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddTraceSource ("ClassEnqueue",
+                     "A packet of a priority class was accepted: packet, priority, flow id.",
+                     MakeTraceSourceAccessor (&PriorityQueue::m_traceClassEnqueue))
+    .AddTraceSource ("ClassDequeue",
+                     "A packet of a priority class was dequeued: packet, priority, sojourn time.",
+                     MakeTraceSourceAccessor (&PriorityQueue::m_traceClassDequeue))
+    .AddTraceSource ("ClassDrop",
+                     "A packet of a priority class was refused on arrival: packet, priority, flow id.",
+                     MakeTraceSourceAccessor (&PriorityQueue::m_traceClassDrop))
+    .AddTraceSource ("ClassPushOut",
+                     "A queued packet of a priority class was pushed out by a higher priority arrival: packet, priority, flow id.",
+                     MakeTraceSourceAccessor (&PriorityQueue::m_traceClassPushOut))
     ;
   return tid;
 }
@@ -78,19 +107,97 @@ TypeId PriorityQueue::GetTypeId (void)
 void
 PriorityQueue::LogQueueLength()
 {
-  std::ofstream ofs("queuelength.txt", std::ios::app);
-  ofs<<Simulator::Now().GetSeconds()<<"\t"<<m_id<<"\t"<<m_packets[0].size()<<"\t"<<m_totalpackets<<"\t"<<m_bytesInSubQueue[0]<<"\t"<<m_bytesInQueue<<"\n";
-  ofs.close();
-  m_sendEvent = Simulator::Schedule(Seconds(0.1), &PriorityQueue::LogQueueLength, this);
+  if(m_queueLengthStream == 0)
+  {
+    m_queueLengthStream = RecordSink::GetStream (m_queueLengthFile, "dIIIII");
+  }
+  m_queueLengthStream->Add (Simulator::Now ().GetSeconds ()).Add (m_id).Add (m_packetsInSubQueue[0]).Add (m_totalpackets).Add (m_bytesInSubQueue[0]).Add (m_bytesInQueue).End ();
+}
+
+uint32_t
+PriorityQueue::GetSampleId (void) const
+{
+  return m_id;
+}
+
+uint32_t
+PriorityQueue::GetNSubQueues (void) const
+{
+  return NUM_PRIORITY_QUEUES;
+}
+
+uint32_t
+PriorityQueue::GetSubQueuePackets (uint32_t subQueue) const
+{
+  return m_packetsInSubQueue[subQueue];
+}
+
+uint32_t
+PriorityQueue::GetSubQueueBytes (uint32_t subQueue) const
+{
+  return m_bytesInSubQueue[subQueue];
+}
+
+const PriorityQueue::ClassStats &
+PriorityQueue::GetClassStats (uint8_t priority) const
+{
+  NS_ASSERT (priority < NUM_PRIORITY_QUEUES);
+  return m_classStats[priority];
+}
+
+void
+PriorityQueue::ResetClassStats (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (int i=0; i< NUM_PRIORITY_QUEUES; i++)
+  {
+    ClassStats &stats = m_classStats[i];
+    stats.enqueuedPackets = 0;
+    stats.enqueuedBytes = 0;
+    stats.dequeuedPackets = 0;
+    stats.dequeuedBytes = 0;
+    stats.droppedPackets = 0;
+    stats.droppedBytes = 0;
+    stats.pushedOutPackets = 0;
+    stats.pushedOutBytes = 0;
+    stats.flushedPackets = 0;
+    stats.flushedBytes = 0;
+    stats.sojournSum = Seconds (0);
+    stats.maxSojourn = Seconds (0);
+    std::fill (stats.sojournHistogram.begin (), stats.sojournHistogram.end (), 0);
+  }
+}
+
+//counts a dequeued packet, the histograms are sized by the first one
+Time
+PriorityQueue::RecordSojourn (uint16_t subQueue, int64_t enqueueTime, uint32_t size)
+{
+  ClassStats &stats = m_classStats[subQueue];
+  Time sojourn = TimeStep (Simulator::Now ().GetTimeStep () - enqueueTime);
+  stats.dequeuedPackets++;
+  stats.dequeuedBytes += size;
+  stats.sojournSum += sojourn;
+  if (sojourn > stats.maxSojourn)
+    stats.maxSojourn = sojourn;
+  if (stats.sojournHistogram.size () != m_sojournBins)
+    stats.sojournHistogram.resize (m_sojournBins, 0);
+  int64_t bin = sojourn.GetTimeStep () / std::max<int64_t> (m_sojournBinWidth.GetTimeStep (), 1);
+  stats.sojournHistogram[std::min<int64_t> (bin, m_sojournBins - 1)]++;
+  return sojourn;
 }
 
 PriorityQueue::PriorityQueue () :
   Queue (),
+  m_sojournBinWidth (MicroSeconds (100)),
+  m_sojournBins (100),
+  m_freeSlot (NO_SLOT),
+  m_lastEnqueued (NO_SLOT),
+  m_materializing (NO_SLOT),
   m_totalpackets (0),
   m_bytesInQueue (0),
   m_id(0),
   m_backgrounddrop(0),
-  m_sendEvent()
+  m_queueLengthStream(0)
   //m_time (0),
   //m_interval(1.0)
   //m_packetInfocount(0),
@@ -99,14 +206,18 @@ PriorityQueue::PriorityQueue () :
   NS_LOG_FUNCTION_NOARGS ();
   for (int i=0; i< NUM_PRIORITY_QUEUES; i++){
     m_bytesInSubQueue[i] = 0;
-    counts[i] = 0;
+    m_packetsInSubQueue[i] = 0;
+    m_head[i] = NO_SLOT;
+    m_tail[i] = NO_SLOT;
   }
-  LogQueueLength();
+  ResetClassStats ();
+  QueueSampler::Register (this);
 }
 
 PriorityQueue::~PriorityQueue ()
 {
   NS_LOG_FUNCTION_NOARGS ();
+  QueueSampler::Unregister (this);
 }
 
 void
@@ -124,59 +235,186 @@ PriorityQueue::GetMode (void)
 }
 
 
-uint16_t 
-PriorityQueue::GetPriorityFromPacket(Ptr <const Packet> p)
+//reads the MyPriorityTag once; the result is cached in the slot of the packet
+void
+PriorityQueue::ClassifyPacket(Ptr<const Packet> p, uint16_t &priority, uint32_t &flowId)
 {
     MyPriorityTag tag;
-    Packet::EnablePrinting();
-    bool peeked = p->PeekPacketTag(tag);
-    if(!peeked)
+    if(!p->PeekPacketTag(tag))
     {
       //some rare flagged packets sent directly from l4 might not contain the tag...in that case, just assume 0 priority
-      return 0;
+      priority = 0;
+      flowId = 0;
+      return;
     }
-    NS_ASSERT(tag.GetTypeId().GetName() == "ns3::MyPriorityTag");
-    return tag.GetPriority();
+    priority = tag.GetPriority();
+    flowId = tag.GetId();
 }
 
-uint32_t 
-PriorityQueue::GetIdFromPacket(Ptr <const Packet> p)
+//links a new slot at the tail of its sub-queue and, for low priority
+//sub-queues, at the head of the list of packets of its flow
+uint32_t
+PriorityQueue::AllocateSlot(Ptr<Packet> p, uint32_t flowId, uint32_t size, uint8_t priority, uint16_t subQueue)
 {
-    MyPriorityTag tag;
-    Packet::EnablePrinting();
-    bool peeked = p->PeekPacketTag(tag);
-    if(!peeked)
+  uint32_t slot;
+  if(m_freeSlot != NO_SLOT)
+  {
+    slot = m_freeSlot;
+    m_freeSlot = m_slots[slot].next;
+  }
+  else
+  {
+    slot = m_slots.size();
+    m_slots.push_back(Slot());
+  }
+
+  Slot &s = m_slots[slot];
+  s.packet = p;
+  s.flowId = flowId;
+  s.size = size;
+  s.run = NO_SLOT;
+  s.subQueue = subQueue;
+  s.priority = priority;
+  s.enqueueTime = Simulator::Now ().GetTimeStep ();
+  s.next = NO_SLOT;
+  s.prev = m_tail[subQueue];
+  if(m_tail[subQueue] != NO_SLOT)
+    m_slots[m_tail[subQueue]].next = slot;
+  else
+    m_head[subQueue] = slot;
+  m_tail[subQueue] = slot;
+
+  s.flowPrev = NO_SLOT;
+  s.flowNext = NO_SLOT;
+  if(subQueue > 0)
+  {
+    std::pair<FlowIndex::iterator, bool> ret = m_flows.insert(std::make_pair(flowId, slot));
+    if(!ret.second)
     {
-      //some rare flagged packets sent directly from l4 might not contain the tag...in that case, just assume 0 priority
-      return 0;
+      s.flowNext = ret.first->second;
+      m_slots[s.flowNext].flowPrev = slot;
+      ret.first->second = slot;
     }
-    NS_ASSERT(tag.GetTypeId().GetName() == "ns3::MyPriorityTag");
-    return tag.GetId();
+  }
+  return slot;
 }
 
+//unlinks a slot from its sub-queue and flow lists and returns it to the pool;
+//packets and bytes are what the slot held, including deferred packets
+Ptr<Packet>
+PriorityQueue::RemoveSlot(uint32_t slot, uint32_t &packets, uint32_t &bytes)
+{
+  Slot &s = m_slots[slot];
+  Ptr<Packet> p = s.packet;
+  uint16_t i = s.subQueue;
+  bool wasHead = (m_head[i] == slot);
+
+  if(s.prev != NO_SLOT)
+    m_slots[s.prev].next = s.next;
+  else
+    m_head[i] = s.next;
+  if(s.next != NO_SLOT)
+    m_slots[s.next].prev = s.prev;
+  else
+    m_tail[i] = s.prev;
+
+  if(i > 0)
+  {
+    if(s.flowPrev != NO_SLOT)
+      m_slots[s.flowPrev].flowNext = s.flowNext;
+    else if(s.flowNext != NO_SLOT)
+      m_flows[s.flowId] = s.flowNext;
+    else
+      m_flows.erase(s.flowId);
+    if(s.flowNext != NO_SLOT)
+      m_slots[s.flowNext].flowPrev = s.flowPrev;
+  }
+
+  packets = (p != 0) ? 1 : 0;
+  if(s.run != NO_SLOT)
+  {
+    Run &r = m_runs[s.run];
+    packets += r.pending;
+    r.refill.Cancel();
+    r.materialize = MaterializeCallback();
+    r.lastPacket = 0;
+    r.times.clear();
+    r.timesHead = 0;
+    m_freeRuns.push_back(s.run);
+    s.run = NO_SLOT;
+  }
+  bytes = packets * s.size;
+
+  s.packet = 0;
+  s.next = m_freeSlot;
+  m_freeSlot = slot;
+  if(m_lastEnqueued == slot)
+    m_lastEnqueued = NO_SLOT;
+
+  RemovePackets(i, packets, bytes);
+  if(wasHead && m_head[i] != NO_SLOT)
+    ScheduleRefill(m_head[i]);
+  return p;
+}
+
+void
+PriorityQueue::AddPackets(uint16_t subQueue, uint32_t packets, uint32_t bytes)
+{
+  m_bytesInSubQueue[subQueue] += bytes;
+  m_bytesInQueue += bytes;
+  m_packetsInSubQueue[subQueue] += packets;
+  m_totalpackets += packets;
+}
+
+void
+PriorityQueue::RemovePackets(uint16_t subQueue, uint32_t packets, uint32_t bytes)
+{
+  m_bytesInSubQueue[subQueue] -= bytes;
+  m_bytesInQueue -= bytes;
+  m_packetsInSubQueue[subQueue] -= packets;
+  m_totalpackets -= packets;
+}
 
 
 bool
 PriorityQueue::DropPacket(uint16_t pr)
 {
   uint32_t i;
+  uint32_t packets, bytes;
   Ptr<Packet> p;
   for(i=NUM_PRIORITY_QUEUES-1;i>pr;i--)
   {
-    if(m_packets[i].empty())
+    if(m_tail[i] == NO_SLOT)
     {
       continue;
     }
- 
-    p = m_packets[i].back();
-    m_packets[i].pop_back();
-    
-    
+
+    uint32_t tail = m_tail[i];
+    Slot &s = m_slots[tail];
+    uint32_t flowId = s.flowId;
+    uint8_t priority = s.priority;
+    if(s.run != NO_SLOT && m_runs[s.run].pending > 0)
+    {
+      //the last packet of the run was never built, trace a copy of its predecessor
+      Run &r = m_runs[s.run];
+      p = r.lastPacket->Copy();
+      bytes = s.size;
+      r.pending--;
+      r.lastSeq -= r.step;
+      r.times.pop_back();
+      RemovePackets(i, 1, bytes);
+      if(s.packet == 0 && r.pending == 0)
+        RemoveSlot(tail, packets, bytes);
+    }
+    else
+    {
+      p = RemoveSlot(tail, packets, bytes);
+    }
     
+    m_classStats[i].pushedOutPackets++;
+    m_classStats[i].pushedOutBytes += p->GetSize ();
+    m_traceClassPushOut (p, priority, flowId);
     Drop (p);
-    m_totalpackets--;
-    m_bytesInQueue -= p->GetSize ();
-    m_bytesInSubQueue[i] -= p->GetSize ();
     m_nPackets--;
     m_nBytes -= p->GetSize ();
     
@@ -195,42 +433,33 @@ void PriorityQueue::FlushOutFlowPackets(uint32_t flowId)
   //flushing out packets with priority flowId
   NS_LOG_FUNCTION (this<<m_id);
 
-   for(int i=NUM_PRIORITY_QUEUES-1;i>=1;i--)
-   {
-      int j = 0;
-      while((m_packets[i].begin() + j) != m_packets[i].end())
-      {
-        std::deque< Ptr<Packet> >::iterator it = m_packets[i].begin() + j;
-        if(GetIdFromPacket(*it) == flowId)
-        {
-          NS_LOG_INFO("Erasing packet from queue "<<i);
-          m_totalpackets--;
-          m_bytesInQueue -= (*it)->GetSize ();
-          m_bytesInSubQueue[i] -= (*it)->GetSize ();
-          m_nPackets--;
-          m_nBytes -= (*it)->GetSize ();
-          m_packets[i].erase(m_packets[i].begin() + j);
-        }
-        else
-            j++;
-      }
-   }
+  FlowIndex::iterator it = m_flows.find(flowId);
+  if(it == m_flows.end())
+    return;
 
+  uint32_t slot = it->second;
+  while(slot != NO_SLOT)
+  {
+    uint32_t next = m_slots[slot].flowNext;
+    uint16_t subQueue = m_slots[slot].subQueue;
+    NS_LOG_INFO("Erasing packet from queue "<<subQueue);
+    uint32_t packets, bytes;
+    RemoveSlot(slot, packets, bytes);
+    m_classStats[subQueue].flushedPackets += packets;
+    m_classStats[subQueue].flushedBytes += bytes;
+    m_nPackets -= packets;
+    m_nBytes -= bytes;
+    slot = next;
+  }
+  NS_ASSERT(m_flows.find(flowId) == m_flows.end());
 }
 
-
-bool 
-PriorityQueue::DoEnqueue (Ptr<Packet> p)
+//admission control shared by real and deferred packets: push out lower
+//priority packets on overflow and apply the background drop rate
+bool
+PriorityQueue::Admit(uint16_t pr, uint32_t size)
 {
-  NS_LOG_FUNCTION (this << p << m_id);
   bool dropped = true;
-  uint16_t pr;
-
-  pr = GetPriorityFromPacket(p);
-
-  NS_LOG_LOGIC("Enqueueing in priority queue");
-  //p->Print(std::cout);
-  //std::cout<<std::endl;
 
   if (m_mode == QUEUE_MODE_PACKETS && (m_totalpackets >= m_maxPackets))
   {
@@ -238,22 +467,18 @@ PriorityQueue::DoEnqueue (Ptr<Packet> p)
       dropped = DropPacket(pr);
       if(!dropped)
       {
-        Drop (p);
-        
         NS_LOG_LOGIC("Dropped the packet from queue 0");
         return false;
       }
   }
 
-  if (m_mode == QUEUE_MODE_BYTES && (m_bytesInQueue + p->GetSize () >= m_maxBytes))
+  if (m_mode == QUEUE_MODE_BYTES && (m_bytesInQueue + size >= m_maxBytes))
   {
       NS_LOG_LOGIC ("Queue full (packet would exceed max bytes) -- droppping pkt");
-      while((m_bytesInQueue + p->GetSize() >= m_maxBytes)&&(dropped))
+      while((m_bytesInQueue + size >= m_maxBytes)&&(dropped))
         dropped = DropPacket(pr);
-      if((m_bytesInQueue + p->GetSize() >= m_maxBytes)&&(!dropped))
+      if((m_bytesInQueue + size >= m_maxBytes)&&(!dropped))
       {
-        Drop (p);
-        
         NS_LOG_LOGIC("Dropped the packet from queue 0");
         return false;
       }
@@ -268,30 +493,71 @@ PriorityQueue::DoEnqueue (Ptr<Packet> p)
       if (prob < m_backgrounddrop)
       {
           NS_LOG_LOGIC ("background drop");
-          //dropped = DropPacket(pr);
-          //if(!dropped)
-          //{
-              Drop (p);
-        
-              NS_LOG_LOGIC("Dropped the packet from queue 0");
-              return false;
-         //}
+          return false;
       }
   } 
+  return true;
+}
 
-  
+
+bool 
+PriorityQueue::DoEnqueue (Ptr<Packet> p)
+{
+  NS_LOG_FUNCTION (this << p << m_id);
+
+  if(m_materializing != NO_SLOT)
+  {
+    //a deferred packet being built, it was accounted for by DeferPacket
+    Slot &s = m_slots[m_materializing];
+    Run &r = m_runs[s.run];
+    NS_ASSERT(s.packet == 0 && r.pending > 0);
+    NS_ASSERT_MSG(p->GetSize () == s.size, "Packets of a run must all have the same size");
+    s.packet = p;
+    s.enqueueTime = r.times[r.timesHead++];
+    if(r.timesHead == r.times.size())
+    {
+      r.times.clear();
+      r.timesHead = 0;
+    }
+    r.lastPacket = p;
+    r.pending--;
+    r.seq += r.step;
+    m_materializing = NO_SLOT;
+    //Queue::Enqueue counts it again
+    m_nPackets--;
+    m_nBytes -= s.size;
+    return true;
+  }
+
+  uint16_t pr;
+  uint32_t flowId;
+  uint32_t size = p->GetSize ();
+
+  ClassifyPacket(p, pr, flowId);
+
+  NS_LOG_LOGIC("Enqueueing in priority queue");
+  //p->Print(std::cout);
+  //std::cout<<std::endl;
 
   //enqueue on basis of priority...also take priority 0 into consideration 
-  if(pr>=NUM_PRIORITY_QUEUES)
-      pr = NUM_PRIORITY_QUEUES-1;
+  uint16_t subQueue = std::min<uint16_t> (pr, NUM_PRIORITY_QUEUES - 1);
 
-  m_packets[pr].push_back(p);
+  if(!Admit(pr, size))
+  {
+    m_classStats[subQueue].droppedPackets++;
+    m_classStats[subQueue].droppedBytes += size;
+    m_traceClassDrop (p, pr, flowId);
+    Drop (p);
+    return false;
+  }
 
-  m_bytesInSubQueue[pr] += p->GetSize ();
-  m_bytesInQueue += p->GetSize ();
-  m_totalpackets++; 
+  m_lastEnqueued = AllocateSlot(p, flowId, size, pr, subQueue);
+  AddPackets(subQueue, 1, size);
+  m_classStats[subQueue].enqueuedPackets++;
+  m_classStats[subQueue].enqueuedBytes += size;
+  m_traceClassEnqueue (p, pr, flowId);
   
-  NS_LOG_INFO(Simulator::Now().GetSeconds()<<": "<<m_id<<"\t Enqueueing in queue "<<pr<<" Total bytes in subqueue = "<<m_bytesInSubQueue[pr]);
+  NS_LOG_INFO(Simulator::Now().GetSeconds()<<": "<<m_id<<"\t Enqueueing in queue "<<subQueue<<" Total bytes in subqueue = "<<m_bytesInSubQueue[subQueue]);
   
   NS_LOG_LOGIC ("Number packets " << m_totalpackets);
   NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
@@ -299,6 +565,154 @@ PriorityQueue::DoEnqueue (Ptr<Packet> p)
   return true;
 }
 
+void
+PriorityQueue::AdoptLastPacket (uint32_t flowId, uint8_t priority, uint32_t seq, MaterializeCallback materialize)
+{
+  NS_LOG_FUNCTION (this << flowId << (uint16_t)priority << seq);
+  uint16_t pr = std::min<uint16_t> (priority, NUM_PRIORITY_QUEUES - 1);
+  uint32_t slot = m_lastEnqueued;
+  if(pr == 0 || slot == NO_SLOT || m_tail[pr] != slot)
+    return;
+  Slot &s = m_slots[slot];
+  if(s.run != NO_SLOT || s.flowId != flowId)
+    return;
+
+  if(m_freeRuns.empty())
+  {
+    m_freeRuns.push_back(m_runs.size());
+    m_runs.push_back(Run());
+  }
+  s.run = m_freeRuns.back();
+  m_freeRuns.pop_back();
+  Run &r = m_runs[s.run];
+  r.materialize = materialize;
+  r.lastPacket = s.packet;
+  r.pending = 0;
+  r.seq = seq;
+  r.lastSeq = seq;
+  r.step = 0;
+  r.priority = priority;
+  r.times.clear();
+  r.timesHead = 0;
+}
+
+bool
+PriorityQueue::DeferPacket (uint32_t flowId, uint8_t priority, uint32_t seq, MaterializeCallback materialize)
+{
+  NS_LOG_FUNCTION (this << flowId << (uint16_t)priority << seq);
+  uint16_t pr = std::min<uint16_t> (priority, NUM_PRIORITY_QUEUES - 1);
+  uint32_t tail = m_tail[pr];
+  if(pr == 0 || tail == NO_SLOT)
+    return false;
+  if(m_slots[tail].run == NO_SLOT || m_slots[tail].flowId != flowId)
+    return false;
+  Run &tailRun = m_runs[m_slots[tail].run];
+  if(tailRun.priority != priority || !tailRun.materialize.IsEqual(materialize))
+    return false;
+  int32_t step = (int32_t)(seq - tailRun.lastSeq);
+  if(tailRun.step == 0 && step == 0)
+    return false;
+
+  uint32_t size = m_slots[tail].size;
+  if(!Admit(priority, size))
+  {
+    //Admit never pushes out packets of this sub-queue, tail is still valid
+    Ptr<Packet> copy = m_runs[m_slots[tail].run].lastPacket->Copy ();
+    m_classStats[pr].droppedPackets++;
+    m_classStats[pr].droppedBytes += size;
+    m_traceClassDrop (copy, priority, flowId);
+    Drop (copy);
+    return true;
+  }
+
+  Run &r = m_runs[m_slots[tail].run];
+  if(r.step == 0)
+    r.step = step;
+  if(step == r.step)
+  {
+    //the successor of the last packet of the run
+    if(r.pending == 0)
+      r.seq = seq;
+    r.pending++;
+    r.lastSeq = seq;
+    r.times.push_back(Simulator::Now ().GetTimeStep ());
+    m_traceClassEnqueue (r.lastPacket, priority, flowId);
+  }
+  else
+  {
+    //a gap (e.g. a background drop) or a new burst, start a run whose
+    //packets are all unbuilt, its first one is built when it reaches the head
+    Ptr<Packet> lastPacket = r.lastPacket;
+    int32_t runStep = r.step;
+    uint32_t slot = AllocateSlot(0, flowId, size, priority, pr);
+    if(m_freeRuns.empty())
+    {
+      m_freeRuns.push_back(m_runs.size());
+      m_runs.push_back(Run());
+    }
+    m_slots[slot].run = m_freeRuns.back();
+    m_freeRuns.pop_back();
+    Run &next = m_runs[m_slots[slot].run];
+    next.materialize = materialize;
+    next.lastPacket = lastPacket;
+    next.pending = 1;
+    next.seq = seq;
+    next.lastSeq = seq;
+    next.step = runStep;
+    next.priority = priority;
+    next.times.clear();
+    next.times.push_back(Simulator::Now ().GetTimeStep ());
+    next.timesHead = 0;
+    m_traceClassEnqueue (lastPacket, priority, flowId);
+  }
+  AddPackets(pr, 1, size);
+  m_classStats[pr].enqueuedPackets++;
+  m_classStats[pr].enqueuedBytes += size;
+  m_nPackets++;
+  m_nBytes += size;
+  return true;
+}
+
+//builds the first packet of a slot at the head of its sub-queue once the
+//device is done with the current event
+void
+PriorityQueue::ScheduleRefill (uint32_t slot)
+{
+  Slot &s = m_slots[slot];
+  if(s.packet != 0 || s.run == NO_SLOT)
+    return;
+  Run &r = m_runs[s.run];
+  if(!r.refill.IsRunning())
+    r.refill = Simulator::ScheduleNow(&PriorityQueue::MaterializeRun, this, slot);
+}
+
+void
+PriorityQueue::MaterializeRun (uint32_t slot)
+{
+  NS_LOG_FUNCTION (this << slot);
+  Run &r = m_runs[m_slots[slot].run];
+  NS_ASSERT(m_slots[slot].packet == 0 && r.pending > 0);
+  MaterializeCallback materialize = r.materialize;
+  uint32_t seq = r.seq;
+  uint8_t priority = r.priority;
+
+  m_materializing = slot;
+  materialize(seq, priority);
+  if(m_materializing != NO_SLOT)
+  {
+    //the sender could not build it (e.g. its socket is gone), give up the run
+    NS_LOG_WARN("Deferred packet " << seq << " was not built, dropping its run");
+    m_materializing = NO_SLOT;
+    uint16_t subQueue = m_slots[slot].subQueue;
+    uint32_t packets, bytes;
+    RemoveSlot(slot, packets, bytes);
+    m_classStats[subQueue].flushedPackets += packets;
+    m_classStats[subQueue].flushedBytes += bytes;
+    m_nPackets -= packets;
+    m_nBytes -= bytes;
+  }
+}
+
 Ptr<Packet>
 PriorityQueue::DoDequeue (void)
 {
@@ -310,21 +724,40 @@ PriorityQueue::DoDequeue (void)
   for(i=0;i<NUM_PRIORITY_QUEUES;i++)
   //for(i=NUM_PRIORITY_QUEUES-1; i>=0; i--)
   {
-      while (!m_packets[i].empty ())
+      //refills run as soon as a slot reaches the head and a device dequeues
+      //once per transmission, so this only builds packets for callers that
+      //dequeue twice within the same event
+      while (m_head[i] != NO_SLOT && m_slots[m_head[i]].packet == 0)
+      {
+          m_runs[m_slots[m_head[i]].run].refill.Cancel ();
+          MaterializeRun (m_head[i]);
+      }
+
+      if (m_head[i] != NO_SLOT)
       {
           NS_LOG_LOGIC(Simulator::Now().GetSeconds()<<":Dequeuing from queue"<<i);
-          Ptr<Packet> p = m_packets[i].front ();
-          m_packets[i].pop_front ();
-          m_bytesInQueue -= p->GetSize ();
-          m_bytesInSubQueue[i] -= p->GetSize ();
-          m_totalpackets--;
+          uint32_t head = m_head[i];
+          Slot &s = m_slots[head];
+          m_traceClassDequeue (s.packet, s.priority, RecordSojourn (i, s.enqueueTime, s.size));
+          Ptr<Packet> p;
+          if (s.run != NO_SLOT && m_runs[s.run].pending > 0)
+          {
+              p = s.packet;
+              s.packet = 0;
+              RemovePackets (i, 1, s.size);
+              ScheduleRefill (head);
+          }
+          else
+          {
+              uint32_t packets, bytes;
+              p = RemoveSlot (head, packets, bytes);
+          }
 
           NS_LOG_LOGIC ("Popped " << p);
           //p->Print(std::cout);
           //std::cout<<std::endl;     
           NS_LOG_LOGIC ("Number packets " << m_totalpackets);
           NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
-          counts[i]++;
           NS_LOG_INFO(Simulator::Now().GetSeconds()<<": "<<m_id<<"\t Dequeueing in queue "<<i<<" Total bytes in subqueue = "<<m_bytesInSubQueue[i]);
           return p;
       }
@@ -342,13 +775,19 @@ PriorityQueue::DoPeek (void) const
 
   for(i=0;i<NUM_PRIORITY_QUEUES;i++)
   {
-    if (m_packets[i].empty ())
+    if (m_head[i] == NO_SLOT)
     {
          NS_LOG_LOGIC ("Queue empty");
          continue;
     }
 
-    Ptr<Packet> p = m_packets[i].front ();
+    const Slot &s = m_slots[m_head[i]];
+    Ptr<Packet> p = s.packet;
+    if (p == 0)
+    {
+      //not built yet, its predecessor has the same size and tags
+      p = m_runs[s.run].lastPacket;
+    }
 
     NS_LOG_LOGIC ("Number packets " << m_totalpackets);
     NS_LOG_LOGIC ("Number bytes " << m_bytesInQueue);
@@ -365,4 +804,3 @@ PriorityQueue::DoPeek (void) const
 
 
 } // namespace ns3
-
@@ -16,12 +16,18 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
-#ifndef DROPTAIL_H
-#define DROPTAIL_H
+#ifndef PRIORITY_QUEUE_H
+#define PRIORITY_QUEUE_H
 
-#include <queue>
+#include <vector>
 #include "ns3/packet.h"
 #include "ns3/queue.h"
+#include "ns3/callback.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/traced-callback.h"
+#include "ns3/sgi-hashmap.h"
+#include "queue-sampler.h"
 
 #define NUM_PRIORITY_QUEUES 5    
 //#define BUFSZ 1000000
@@ -29,11 +35,39 @@
 namespace ns3 {
 
 class TraceContainer;
+class RecordStream;
 
 //defining priority queue
-class PriorityQueue : public Queue {
+class PriorityQueue : public Queue, public SampledQueue {
 public:
   static TypeId GetTypeId (void);
+
+  /**
+   * What happened to the packets of one priority class since the queue was
+   * created or since the last ResetClassStats.
+   *
+   * Deferred packets count when they are accounted for by DeferPacket, not
+   * when they are built. Sojourn times are measured from that accounting,
+   * or from Enqueue, to Dequeue.
+   */
+  struct ClassStats
+  {
+    uint64_t enqueuedPackets;
+    uint64_t enqueuedBytes;
+    uint64_t dequeuedPackets;
+    uint64_t dequeuedBytes;
+    uint64_t droppedPackets;      // refused on arrival, full queue or background drop
+    uint64_t droppedBytes;
+    uint64_t pushedOutPackets;    // removed from the tail by a higher priority arrival
+    uint64_t pushedOutBytes;
+    uint64_t flushedPackets;      // removed by FlushOutFlowPackets or with a run that could not be built
+    uint64_t flushedBytes;
+    Time sojournSum;              // of the dequeued packets
+    Time maxSojourn;
+    /// dequeued packets per SojournBinWidth, the last bin holds the longer sojourns
+    std::vector<uint64_t> sojournHistogram;
+  };
+
   /**
    * \brief PriorityQueue Constructor
    *
@@ -58,19 +92,140 @@ public:
    */
   PriorityQueue::QueueMode GetMode (void);
 
+  /**
+   * Remove every packet of the given flow from the low priority
+   * sub-queues (1 to NUM_PRIORITY_QUEUES-1).
+   *
+   * Packets are threaded on a per-flow list at enqueue time, so the cost
+   * is proportional to the number of packets of that flow in the queue.
+   *
+   * \param flowId the flow id carried in the MyPriorityTag of the packets
+   */
   void FlushOutFlowPackets(uint32_t flowId);
 
+  /**
+   * Sends the low priority packet of the given sequence number and priority
+   * through the protocol stack, so that it is enqueued in this queue.
+   */
+  typedef Callback<void, uint32_t, uint8_t> MaterializeCallback;
+
+  /**
+   * Register a low priority packet without building it.
+   *
+   * If the tail of the sub-queue of this priority is a run of packets of the
+   * same flow and sender whose sequence numbers advance by a constant step,
+   * the packet is accounted for (admission, push-out and background drop
+   * exactly as DoEnqueue would do) and appended to the run. The packet is
+   * only built, through the callback, once the packet before it has been
+   * dequeued, so the queue holds at most one real packet per run.
+   *
+   * \returns false if the packet cannot join a run; the caller should send
+   * it normally and then call AdoptLastPacket.
+   */
+  bool DeferPacket (uint32_t flowId, uint8_t priority, uint32_t seq, MaterializeCallback materialize);
+
+  /**
+   * Make the packet enqueued by the last call to Enqueue the first packet of
+   * a run that later DeferPacket calls can extend. Does nothing if that
+   * packet is no longer at the tail of its sub-queue.
+   */
+  void AdoptLastPacket (uint32_t flowId, uint8_t priority, uint32_t seq, MaterializeCallback materialize);
+
+  /**
+   * \param priority a priority class, below NUM_PRIORITY_QUEUES
+   * \returns the counters and sojourn times of the class; the last class
+   * also counts the packets of the higher priorities
+   */
+  const ClassStats &GetClassStats (uint8_t priority) const;
+
+  /**
+   * Zero the counters and sojourn times of every class, e.g. at the end of
+   * each sampling period.
+   */
+  void ResetClassStats (void);
+
+  // SampledQueue, one sub-queue per priority
+  virtual uint32_t GetSampleId (void) const;
+  virtual uint32_t GetNSubQueues (void) const;
+  virtual uint32_t GetSubQueuePackets (uint32_t subQueue) const;
+  virtual uint32_t GetSubQueueBytes (uint32_t subQueue) const;
+  virtual void LogQueueLength (void);
+
 private:
+  /**
+   * A queued packet. Slots live in a pool and are linked both in the FIFO
+   * of their sub-queue and in the list of packets of their flow. The
+   * priority, flow id and size are read once at enqueue so that drops,
+   * flushes and the byte accounting never go back to the packet or its tag
+   * list.
+   */
+  struct Slot
+  {
+    Ptr<Packet> packet;
+    uint32_t flowId;
+    uint32_t size;
+    uint32_t run;            // index in m_runs, or none for a single packet
+    uint32_t prev;
+    uint32_t next;
+    uint32_t flowPrev;
+    uint32_t flowNext;
+    uint16_t subQueue;
+    uint8_t priority;        // of the MyPriorityTag, the sub-queue of the higher ones is the last
+    int64_t enqueueTime;     // time step at which the slot packet was accounted for
+  };
+  /**
+   * Deferred packets of a slot. All packets of a run have the size of the
+   * slot. The slot packet, when not 0, is the first packet of the run; it
+   * is built when the slot reaches the head of its sub-queue.
+   */
+  struct Run
+  {
+    MaterializeCallback materialize;
+    Ptr<Packet> lastPacket;  // last packet built, copied to trace drops of deferred packets
+    EventId refill;
+    uint32_t pending;        // deferred packets not built yet
+    uint32_t seq;            // sequence number of the next packet to build
+    uint32_t lastSeq;        // sequence number of the last packet of the run
+    int32_t step;
+    uint8_t priority;
+    // time steps at which the pending packets were accounted for, from timesHead on
+    std::vector<int64_t> times;
+    uint32_t timesHead;
+  };
+  typedef sgi::hash_map<uint32_t, uint32_t> FlowIndex;
+
+
   virtual bool DoEnqueue (Ptr<Packet> p);
   virtual Ptr<Packet> DoDequeue (void);
   virtual Ptr<const Packet> DoPeek (void) const;
   bool DropPacket(uint16_t);
-  uint16_t GetPriorityFromPacket(Ptr<const Packet>);
-  uint32_t GetIdFromPacket(Ptr<const Packet>);
-  void LogQueueLength();
-
-  uint32_t counts[NUM_PRIORITY_QUEUES];
-  std::deque<Ptr<Packet> > m_packets[NUM_PRIORITY_QUEUES];
+  bool Admit(uint16_t pr, uint32_t size);
+  void ClassifyPacket(Ptr<const Packet> p, uint16_t &priority, uint32_t &flowId);
+  uint32_t AllocateSlot (Ptr<Packet> p, uint32_t flowId, uint32_t size, uint8_t priority, uint16_t subQueue);
+  Ptr<Packet> RemoveSlot (uint32_t slot, uint32_t &packets, uint32_t &bytes);
+  void AddPackets (uint16_t subQueue, uint32_t packets, uint32_t bytes);
+  void RemovePackets (uint16_t subQueue, uint32_t packets, uint32_t bytes);
+  void ScheduleRefill (uint32_t slot);
+  void MaterializeRun (uint32_t slot);
+  Time RecordSojourn (uint16_t subQueue, int64_t enqueueTime, uint32_t size);
+
+  ClassStats m_classStats[NUM_PRIORITY_QUEUES];
+  Time m_sojournBinWidth;
+  uint32_t m_sojournBins;
+  TracedCallback<Ptr<const Packet>, uint8_t, uint32_t> m_traceClassEnqueue;
+  TracedCallback<Ptr<const Packet>, uint8_t, Time> m_traceClassDequeue;
+  TracedCallback<Ptr<const Packet>, uint8_t, uint32_t> m_traceClassDrop;
+  TracedCallback<Ptr<const Packet>, uint8_t, uint32_t> m_traceClassPushOut;
+  std::vector<Slot> m_slots;
+  uint32_t m_freeSlot;
+  uint32_t m_head[NUM_PRIORITY_QUEUES];
+  uint32_t m_tail[NUM_PRIORITY_QUEUES];
+  uint32_t m_packetsInSubQueue[NUM_PRIORITY_QUEUES];
+  FlowIndex m_flows;                 // flow id -> first slot of that flow in sub-queues 1..N-1
+  std::vector<Run> m_runs;
+  std::vector<uint32_t> m_freeRuns;
+  uint32_t m_lastEnqueued;           // slot of the last packet accepted by DoEnqueue
+  uint32_t m_materializing;          // slot whose next packet is being built
   uint32_t m_bytesInSubQueue[NUM_PRIORITY_QUEUES];
   uint32_t m_totalpackets;
   uint32_t m_maxPackets;
@@ -78,8 +233,9 @@ private:
   uint32_t m_bytesInQueue;
   uint32_t m_id;
   double m_backgrounddrop;
+  std::string m_queueLengthFile;
+  RecordStream *m_queueLengthStream; // opened by the first sample
   QueueMode m_mode;
-  EventId m_sendEvent;
 };
 
 
@@ -87,4 +243,4 @@ private:
 
 } // namespace ns3
 
-#endif /* PRIORITY_H */
+#endif /* PRIORITY_QUEUE_H */
@@ -0,0 +1,272 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "queue-sampler.h"
+#include "record-sink.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/enum.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
+
+NS_LOG_COMPONENT_DEFINE ("QueueSampler");
+
+namespace ns3 {
+
+SampledQueue::~SampledQueue ()
+{
+}
+
+NS_OBJECT_ENSURE_REGISTERED (QueueSampler);
+
+TypeId
+QueueSampler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::QueueSampler")
+    .SetParent<Object> ()
+    .AddConstructor<QueueSampler> ()
+    .AddAttribute ("Mode", "What is recorded at each sample.",
+                   EnumValue (PERIODIC),
+                   MakeEnumAccessor (&QueueSampler::m_mode),
+                   MakeEnumChecker (PERIODIC, "Periodic",
+                                    ON_CHANGE, "OnChange",
+                                    HISTOGRAM, "Histogram",
+                                    DISABLED, "Disabled"))
+    .AddAttribute ("Interval", "The time between two samples.",
+                   TimeValue (Seconds (0.1)),
+                   MakeTimeAccessor (&QueueSampler::m_interval),
+                   MakeTimeChecker ())
+    .AddAttribute ("SubQueues", "Also record the occupancy of each sub-queue.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&QueueSampler::m_subQueues),
+                   MakeBooleanChecker ())
+    .AddAttribute ("BinWidth", "The width in bytes of a histogram bin.",
+                   UintegerValue (1500),
+                   MakeUintegerAccessor (&QueueSampler::m_binWidth),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("SubQueueFile", "The file the sub-queue samples are written to.",
+                   StringValue ("subqueuelength.txt"),
+                   MakeStringAccessor (&QueueSampler::m_subQueueFile),
+                   MakeStringChecker ())
+    .AddAttribute ("HistogramFile", "The file the histograms are written to.",
+                   StringValue ("queuehistogram.txt"),
+                   MakeStringAccessor (&QueueSampler::m_histogramFile),
+                   MakeStringChecker ())
+  ;
+  return tid;
+}
+
+QueueSampler::QueueSampler ()
+  : m_subQueueStream (0),
+    m_histogramStream (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+QueueSampler::~QueueSampler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+QueueSampler::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_event.Cancel ();
+  for (std::vector<Entry>::iterator i = m_entries.begin (); i != m_entries.end (); i++)
+    {
+      LogHistogram (*i);
+    }
+  m_entries.clear ();
+  Object::DoDispose ();
+}
+
+Ptr<QueueSampler> &
+QueueSampler::GetInstance (void)
+{
+  static Ptr<QueueSampler> instance;
+  return instance;
+}
+
+void
+QueueSampler::DestroyInstance (void)
+{
+  Ptr<QueueSampler> &instance = GetInstance ();
+  if (instance != 0)
+    {
+      instance->Dispose ();
+      instance = 0;
+    }
+}
+
+void
+QueueSampler::Register (SampledQueue *queue)
+{
+  Ptr<QueueSampler> &instance = GetInstance ();
+  if (instance == 0)
+    {
+      instance = CreateObject<QueueSampler> ();
+      Simulator::ScheduleDestroy (&QueueSampler::DestroyInstance);
+    }
+  instance->Add (queue);
+}
+
+void
+QueueSampler::Unregister (SampledQueue *queue)
+{
+  Ptr<QueueSampler> &instance = GetInstance ();
+  if (instance != 0)
+    {
+      instance->Remove (queue);
+    }
+}
+
+void
+QueueSampler::Add (SampledQueue *queue)
+{
+  NS_LOG_FUNCTION (this << queue);
+  if (m_mode == DISABLED)
+    {
+      return;
+    }
+  Entry entry;
+  entry.queue = queue;
+  m_entries.push_back (entry);
+  if (!m_event.IsRunning ())
+    {
+      m_event = Simulator::ScheduleNow (&QueueSampler::Sample, this);
+    }
+}
+
+void
+QueueSampler::Remove (SampledQueue *queue)
+{
+  NS_LOG_FUNCTION (this << queue);
+  for (std::vector<Entry>::iterator i = m_entries.begin (); i != m_entries.end (); i++)
+    {
+      if (i->queue == queue)
+        {
+          LogHistogram (*i);
+          m_entries.erase (i);
+          break;
+        }
+    }
+  if (m_entries.empty () && m_event.IsRunning ())
+    {
+      Simulator::Remove (m_event);
+    }
+}
+
+void
+QueueSampler::Sample (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::vector<Entry>::iterator i = m_entries.begin (); i != m_entries.end (); i++)
+    {
+      SampleEntry (*i, m_mode == ON_CHANGE);
+    }
+  m_event = Simulator::Schedule (m_interval, &QueueSampler::Sample, this);
+}
+
+void
+QueueSampler::SampleEntry (Entry &entry, bool changedOnly)
+{
+  uint32_t n = entry.queue->GetNSubQueues ();
+  if (entry.bytes.size () != n)
+    {
+      // never equal to a real sample, so the first one is always recorded
+      entry.packets.assign (n, 0xffffffff);
+      entry.bytes.assign (n, 0xffffffff);
+      entry.histogram.resize (n);
+    }
+
+  if (m_mode == HISTOGRAM)
+    {
+      for (uint32_t s = 0; s < n; s++)
+        {
+          uint32_t bin = entry.queue->GetSubQueueBytes (s) / m_binWidth;
+          if (entry.histogram[s].size () <= bin)
+            {
+              entry.histogram[s].resize (bin + 1, 0);
+            }
+          entry.histogram[s][bin]++;
+        }
+      return;
+    }
+
+  bool changed = false;
+  for (uint32_t s = 0; s < n; s++)
+    {
+      changed |= entry.queue->GetSubQueuePackets (s) != entry.packets[s] ||
+        entry.queue->GetSubQueueBytes (s) != entry.bytes[s];
+    }
+  if (changedOnly && !changed)
+    {
+      return;
+    }
+  entry.queue->LogQueueLength ();
+  if (!m_subQueues)
+    {
+      for (uint32_t s = 0; s < n; s++)
+        {
+          entry.packets[s] = entry.queue->GetSubQueuePackets (s);
+          entry.bytes[s] = entry.queue->GetSubQueueBytes (s);
+        }
+      return;
+    }
+  if (m_subQueueStream == 0)
+    {
+      m_subQueueStream = RecordSink::GetStream (m_subQueueFile, "dIHII");
+    }
+  double now = Simulator::Now ().GetSeconds ();
+  for (uint32_t s = 0; s < n; s++)
+    {
+      uint32_t packets = entry.queue->GetSubQueuePackets (s);
+      uint32_t bytes = entry.queue->GetSubQueueBytes (s);
+      if (!changedOnly || packets != entry.packets[s] || bytes != entry.bytes[s])
+        {
+          m_subQueueStream->Add (now).Add (entry.queue->GetSampleId ()).Add ((uint16_t)s).Add (packets).Add (bytes).End ();
+        }
+      entry.packets[s] = packets;
+      entry.bytes[s] = bytes;
+    }
+}
+
+void
+QueueSampler::LogHistogram (Entry &entry)
+{
+  if (m_mode != HISTOGRAM)
+    {
+      return;
+    }
+  if (m_histogramStream == 0)
+    {
+      m_histogramStream = RecordSink::GetStream (m_histogramFile, "IHIQ");
+    }
+  for (uint32_t s = 0; s < entry.histogram.size (); s++)
+    {
+      for (uint32_t bin = 0; bin < entry.histogram[s].size (); bin++)
+        {
+          if (entry.histogram[s][bin] != 0)
+            {
+              m_histogramStream->Add (entry.queue->GetSampleId ()).Add ((uint16_t)s).Add (bin * m_binWidth).Add (entry.histogram[s][bin]).End ();
+            }
+        }
+    }
+}
+
+} // namespace ns3
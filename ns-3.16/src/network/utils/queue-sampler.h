@@ -0,0 +1,145 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef QUEUE_SAMPLER_H
+#define QUEUE_SAMPLER_H
+
+#include <vector>
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+
+namespace ns3 {
+
+class RecordStream;
+
+/**
+ * \ingroup queue
+ *
+ * \brief A queue whose occupancy is sampled by the QueueSampler.
+ */
+class SampledQueue
+{
+public:
+  virtual ~SampledQueue ();
+  /**
+   * \returns the id of the queue in the logs
+   */
+  virtual uint32_t GetSampleId (void) const = 0;
+  /**
+   * \returns the number of sub-queues, e.g. one per priority
+   */
+  virtual uint32_t GetNSubQueues (void) const = 0;
+  /**
+   * \param subQueue a sub-queue index
+   * \returns the number of packets in the sub-queue
+   */
+  virtual uint32_t GetSubQueuePackets (uint32_t subQueue) const = 0;
+  /**
+   * \param subQueue a sub-queue index
+   * \returns the number of bytes in the sub-queue
+   */
+  virtual uint32_t GetSubQueueBytes (uint32_t subQueue) const = 0;
+  /**
+   * \brief Write the queuelength.txt record of the queue.
+   */
+  virtual void LogQueueLength (void) = 0;
+};
+
+/**
+ * \ingroup queue
+ *
+ * \brief Samples the occupancy of every registered queue from a single
+ * periodic event.
+ *
+ * Queues register themselves when they are built. Depending on the Mode
+ * attribute, every Interval the sampler:
+ *
+ *  - Periodic: writes the queuelength.txt record of every queue,
+ *  - OnChange: writes it only for the queues whose occupancy changed
+ *    since their last record,
+ *  - Histogram: counts the samples of each sub-queue per occupancy bin,
+ *    written to queuehistogram.txt when the simulation is destroyed,
+ *  - Disabled: does not schedule any event.
+ *
+ * With SubQueues set, the Periodic and OnChange modes also write the
+ * packets and bytes of each (changed) sub-queue to subqueuelength.txt.
+ *
+ * The sampler is created with the first registered queue, so its
+ * attributes are set with Config::SetDefault or from the command line,
+ * e.g. --ns3::QueueSampler::Mode=Disabled.
+ */
+class QueueSampler : public Object
+{
+public:
+  enum Mode
+  {
+    PERIODIC,
+    ON_CHANGE,
+    HISTOGRAM,
+    DISABLED
+  };
+
+  static TypeId GetTypeId (void);
+
+  QueueSampler ();
+  virtual ~QueueSampler ();
+
+  /**
+   * \brief Start sampling a queue.
+   * \param queue the queue
+   */
+  static void Register (SampledQueue *queue);
+  /**
+   * \brief Stop sampling a queue, typically from its destructor.
+   * \param queue the queue
+   */
+  static void Unregister (SampledQueue *queue);
+
+private:
+  struct Entry
+  {
+    SampledQueue *queue;
+    std::vector<uint32_t> packets;                // at the last record
+    std::vector<uint32_t> bytes;                  // at the last record
+    std::vector<std::vector<uint64_t> > histogram; // samples per sub-queue and bin
+  };
+
+  static Ptr<QueueSampler> &GetInstance (void);
+  static void DestroyInstance (void);
+
+  virtual void DoDispose (void);
+  void Add (SampledQueue *queue);
+  void Remove (SampledQueue *queue);
+  void Sample (void);
+  void SampleEntry (Entry &entry, bool changedOnly);
+  void LogHistogram (Entry &entry);
+
+  Time m_interval;
+  Mode m_mode;
+  bool m_subQueues;
+  uint32_t m_binWidth;
+  std::string m_subQueueFile;
+  std::string m_histogramFile;
+  RecordStream *m_subQueueStream;
+  RecordStream *m_histogramStream;
+  std::vector<Entry> m_entries;
+  EventId m_event;
+};
+
+} // namespace ns3
+
+#endif /* QUEUE_SAMPLER_H */
@@ -17,13 +17,14 @@
  */
 
 #include <iostream>
-#include <fstream>
 #include "ns3/log.h"
 #include "ns3/enum.h"
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
+#include "ns3/string.h"
 #include "ns3/simulator.h"
 #include "rcp-queue.h"
+#include "record-sink.h"
 #include "rcp-tag.h"
 #include "ns3/random-variable-stream.h"
 #define RTT 0.2
@@ -63,8 +64,13 @@ TypeId RCPQueue::GetTypeId (void)
                    MakeUintegerChecker<uint32_t> ())   
     .AddAttribute ("Capacity", "Capacity of queue in bytes/sec",
                    DoubleValue (0),
-                   MakeDoubleAccessor (&RCPQueue::m_capacity),
+                   MakeDoubleAccessor (&RCPQueue::SetCapacity,
+                                       &RCPQueue::GetCapacity),
                    MakeDoubleChecker<double> ())  
+    .AddAttribute ("QueueLengthFile", "The file the queue length samples are written to.",
+                   StringValue ("queuelength.txt"),
+                   MakeStringAccessor (&RCPQueue::m_queueLengthFile),
+                   MakeStringChecker ())
   ;
 
   return tid;
@@ -73,22 +79,51 @@ TypeId RCPQueue::GetTypeId (void)
 void
 RCPQueue::LogQueueLength()
 {
-  std::ofstream ofs("queuelength.txt", std::ios::app);
-  ofs<<Simulator::Now().GetSeconds()<<"\t"<<m_id<<"\t"<<m_bytesInQueue<<"\n";
-  ofs.close();
-  m_sendEvent = Simulator::Schedule(Seconds(0.1), &RCPQueue::LogQueueLength, this);
+  if (m_queueLengthStream == 0)
+    {
+      m_queueLengthStream = RecordSink::GetStream (m_queueLengthFile, "dII");
+    }
+  m_queueLengthStream->Add (Simulator::Now ().GetSeconds ()).Add (m_id).Add (m_bytesInQueue).End ();
+}
+
+uint32_t
+RCPQueue::GetSampleId (void) const
+{
+  return m_id;
+}
+
+uint32_t
+RCPQueue::GetNSubQueues (void) const
+{
+  return 1;
+}
+
+uint32_t
+RCPQueue::GetSubQueuePackets (uint32_t subQueue) const
+{
+  return m_packets.size ();
+}
+
+uint32_t
+RCPQueue::GetSubQueueBytes (uint32_t subQueue) const
+{
+  return m_bytesInQueue;
 }
 
 RCPQueue::RCPQueue () :
   Queue (),
   m_packets (),
   m_bytesInQueue (0),
+  m_queueLengthStream (0),
   m_capacity(0),
+  m_invCapacity(0),
   m_virtualCapacity(0),
   m_alpha(0.4),
   m_beta(0.4),
   m_gamma(1),
-  m_rate(0.05*125000000),
+  m_rate(0),
+  m_rateFixed(0),
+  m_rateGain(0),
   m_inputTraffic(0),
   m_activeInputTraffic(0),
   m_trafficSpill(0),
@@ -103,8 +138,9 @@ RCPQueue::RCPQueue () :
   m_numFlows(FLOWSNUM)
 {
   NS_LOG_FUNCTION (this);
+  SetRate(0.05*125000000);
   m_Tq = min(RTT, m_updateSlot);
-  LogQueueLength();
+  QueueSampler::Register (this);
 
   Ptr<NormalRandomVariable> n = CreateObject<NormalRandomVariable> ();
   double T = n->GetValue(m_Tq, 0.2*m_Tq);
@@ -119,6 +155,7 @@ RCPQueue::RCPQueue () :
 RCPQueue::~RCPQueue ()
 {
   NS_LOG_FUNCTION (this);
+  QueueSampler::Unregister (this);
 }
 
 void
@@ -137,34 +174,56 @@ RCPQueue::GetMode (void)
 
 
 
+void
+RCPQueue::SetCapacity (double capacity)
+{
+  NS_LOG_FUNCTION (this << capacity);
+  m_capacity = capacity;
+  m_invCapacity = 1 / capacity;
+  m_rateGain = m_rate * m_invCapacity;
+}
+
+double
+RCPQueue::GetCapacity (void) const
+{
+  return m_capacity;
+}
+
+void
+RCPQueue::SetRate (double rate)
+{
+  m_rate = rate;
+  m_rateFixed = RCPTag::EncodeRate (rate);
+  m_rateGain = m_rate * m_invCapacity;
+}
+
 void
 RCPQueue::OnArrival (Ptr<Packet> p)
 {
   uint32_t size = p->GetSize();
-  double pkt_time = double(size)/m_capacity;
+  double pkt_time = size * m_invCapacity;
   double end_time = Simulator::Now().GetSeconds() + pkt_time;
   double part1, part2;
 
   RCPTag tag; 
   p->PeekPacketTag(tag);
-  NS_ASSERT(tag.GetTypeId().GetName() == "ns3::RCPTag");  
-  
 
   // update avg_rtt_ here
-  double this_rtt = tag.GetRTT();
+  uint32_t this_rtt = tag.GetRTTNanoSeconds();
 
   if (this_rtt > 0)
   {
-       m_Tq_rtt_sum += (this_rtt * size);
+       m_Tq_rtt_sum += (uint64_t)this_rtt * size;
        m_input_traffic_rtt += size;
-       m_Tq_rtt = running_avg(this_rtt, m_Tq_rtt, m_rate/m_capacity);
+       m_Tq_rtt = running_avg(this_rtt * 1e-9, m_Tq_rtt, m_rateGain);
   }
 
   if (end_time <= m_endSlot)
     m_activeInputTraffic += size;
   else 
   {
-    part2 = size * (end_time - m_endSlot)/pkt_time;
+    // the bytes sent after the end of the slot, size * (end_time - m_endSlot) / pkt_time
+    part2 = (end_time - m_endSlot) * m_capacity;
     part1 = size - part2;
     m_activeInputTraffic += part1;
     m_trafficSpill += part2;
@@ -205,14 +264,17 @@ void
 RCPQueue::OnDeparture (Ptr<Packet> p)
 {
   RCPTag tag; 
-  p->RemovePacketTag(tag);
-  NS_ASSERT(tag.GetTypeId().GetName() == "ns3::RCPTag");  
-  
-  
-  if((tag.GetBottleneckRate()==-1) || (tag.GetBottleneckRate() > m_rate))
-      tag.SetBottleneckRate(m_rate);
-  p->AddPacketTag(tag);
+  if (!p->PeekPacketTag(tag))
+    return;
 
+  // the rates are compared in the fixed point encoding of the tag, and
+  // the tag is only written back when this link is the new bottleneck
+  uint32_t rate = tag.GetBottleneckRateFixed();
+  if((rate==RCPTag::NO_RATE) || (rate > m_rateFixed))
+  {
+      tag.SetBottleneckRateFixed(m_rateFixed);
+      p->ReplacePacketTag(tag);
+  }
 }
 
 
@@ -277,7 +339,7 @@ RCPQueue::QueueTimeout()
   //Q_pkts = m_packets.size();
 
   if (m_input_traffic_rtt > 0)
-    m_Tq_rtt_numPkts = m_Tq_rtt_sum/m_input_traffic_rtt;
+    m_Tq_rtt_numPkts = (double)m_Tq_rtt_sum/m_input_traffic_rtt * 1e-9;
 
    if (m_Tq_rtt_numPkts >= m_avg_rtt)
         m_rtt_moving_gain = (m_Tq/m_avg_rtt);
@@ -293,17 +355,17 @@ RCPQueue::QueueTimeout()
   
   if (temp < 16000.0 )
   {    // Masayoshi 16 KB/sec = 128 Kbps
-      m_rate = 16000.0;
+      SetRate(16000.0);
       NS_LOG_INFO("Low");
   } 
   else if (temp > m_capacity)
   {
-      m_rate = m_capacity;
+      SetRate(m_capacity);
       NS_LOG_INFO("High");
   } 
   else 
   {
-    m_rate = temp;
+    SetRate(temp);
   }
 
   NS_LOG_INFO(Simulator::Now().GetSeconds()<<"\t"<<m_id<<": Rate Changed to: "<<m_rate);
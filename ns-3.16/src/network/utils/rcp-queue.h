@@ -22,17 +22,19 @@
 #include <queue>
 #include "ns3/packet.h"
 #include "ns3/queue.h"
+#include "queue-sampler.h"
 
 namespace ns3 {
 
 class TraceContainer;
+class RecordStream;
 
 /**
  * \ingroup queue
  *
  * \brief A FIFO packet queue that drops tail-end packets on overflow
  */
-class RCPQueue : public Queue {
+class RCPQueue : public Queue, public SampledQueue {
 public:
   static TypeId GetTypeId (void);
   /**
@@ -59,14 +61,23 @@ public:
    */
   RCPQueue::QueueMode GetMode (void);
 
+  // SampledQueue, a single sub-queue
+  virtual uint32_t GetSampleId (void) const;
+  virtual uint32_t GetNSubQueues (void) const;
+  virtual uint32_t GetSubQueuePackets (uint32_t subQueue) const;
+  virtual uint32_t GetSubQueueBytes (uint32_t subQueue) const;
+  virtual void LogQueueLength (void);
+
 private:
   virtual bool DoEnqueue (Ptr<Packet> p);
   virtual Ptr<Packet> DoDequeue (void);
   virtual Ptr<const Packet> DoPeek (void) const;
-  void LogQueueLength();
   void OnArrival(Ptr<Packet> p);
   void OnDeparture(Ptr<Packet> p);
   void QueueTimeout();
+  void SetCapacity(double capacity);
+  double GetCapacity() const;
+  void SetRate(double rate);
 
   //RCP helper functions
   double running_avg(double var_sample, double var_last_avg, double gain);
@@ -79,12 +90,14 @@ private:
   uint32_t m_bytesInQueue;
   uint32_t m_id;
   QueueMode m_mode;
-  EventId m_sendEvent;
+  std::string m_queueLengthFile;
+  RecordStream *m_queueLengthStream; // opened by the first sample
 
   EventId m_queueTimeout;
   
   //parameters
   double m_capacity;
+  double m_invCapacity; // 1 / m_capacity, for the per packet updates
   double m_virtualCapacity;
 
   double m_alpha;
@@ -92,6 +105,8 @@ private:
   double m_gamma;
 
   double m_rate;
+  uint32_t m_rateFixed; // m_rate in the RCPTag encoding
+  double m_rateGain; // m_rate / m_capacity
 
   double m_inputTraffic;
   double m_activeInputTraffic;
@@ -101,7 +116,7 @@ private:
   double m_endSlot;
   double m_Tq;
   
-  double m_Tq_rtt_sum;
+  uint64_t m_Tq_rtt_sum; // nanoseconds times bytes
   double m_Tq_rtt;
   double m_Tq_rtt_numPkts;
   uint32_t m_input_traffic_rtt;
@@ -5,6 +5,8 @@ namespace ns3
 
 NS_OBJECT_ENSURE_REGISTERED (RCPTag);
 
+const uint32_t RCPTag::NO_RATE;
+
 TypeId
 RCPTag::GetTypeId (void)
 {
@@ -40,85 +42,132 @@ uint32_t RCPTag::GetId() const
   return m_flowid;
 }
 
+uint32_t RCPTag::EncodeRate(double rate)
+{
+  if (rate < 0)
+    {
+      return NO_RATE;
+    }
+  if (rate >= NO_RATE - 1)
+    {
+      return NO_RATE - 1;
+    }
+  return static_cast<uint32_t> (rate + 0.5);
+}
+
+uint64_t RCPTag::EncodeTime(double seconds)
+{
+  if (seconds <= 0)
+    {
+      return 0;
+    }
+  if (seconds >= 1.8e10)
+    {
+      return 0xffffffffffffffffULL;
+    }
+  return static_cast<uint64_t> (seconds * 1e9 + 0.5);
+}
+
 void RCPTag::SetBottleneckRate(double bottleneckRate)
 {
-  m_bottleneckRate = bottleneckRate;
+  m_bottleneckRate = EncodeRate (bottleneckRate);
 }
 double RCPTag::GetBottleneckRate() const
+{
+  if (m_bottleneckRate == NO_RATE)
+    {
+      return -1;
+    }
+  return m_bottleneckRate;
+}
+void RCPTag::SetBottleneckRateFixed(uint32_t bottleneckRate)
+{
+  m_bottleneckRate = bottleneckRate;
+}
+uint32_t RCPTag::GetBottleneckRateFixed() const
 {
   return m_bottleneckRate;
 }
 
 void RCPTag::SetReverseBottleneckRate(double reverseBottleneckRate)
 {
-  m_reverseBottleneckRate = reverseBottleneckRate;
+  m_reverseBottleneckRate = EncodeRate (reverseBottleneckRate);
 }
 double RCPTag::GetReverseBottleneckRate() const
 {
+  if (m_reverseBottleneckRate == NO_RATE)
+    {
+      return -1;
+    }
   return m_reverseBottleneckRate;
 }
 
 void RCPTag::SetRTT(double rtt)
 {
-  m_rtt = rtt;
+  uint64_t ns = EncodeTime (rtt);
+  m_rtt = ns > 0xffffffff ? 0xffffffff : ns;
 }
 double RCPTag::GetRTT() const
+{
+  return m_rtt / 1e9;
+}
+uint32_t RCPTag::GetRTTNanoSeconds() const
 {
   return m_rtt;
 }
 
 void RCPTag::SetTs(double ts)
 {
-  m_ts = ts;
+  m_ts = EncodeTime (ts);
 }
 double RCPTag::GetTs() const
 {
-  return m_ts;
+  return m_ts / 1e9;
 }
 
 void RCPTag::SetReverseTs(double reverseTs)
 {
-  m_reverseTs = reverseTs;
+  m_reverseTs = EncodeTime (reverseTs);
 }
 double RCPTag::GetReverseTs() const
 {
-  return m_reverseTs;
+  return m_reverseTs / 1e9;
 }
 
 uint32_t RCPTag::GetSerializedSize (void) const
 {
-  uint32_t size = sizeof(uint32_t) + 5*sizeof(double);
+  uint32_t size = 4*sizeof(uint32_t) + 2*sizeof(uint64_t);
   return size;
 }
 
 void RCPTag::Serialize (TagBuffer i) const
 {
   i.WriteU32(m_flowid);
-  i.WriteDouble(m_bottleneckRate);
-  i.WriteDouble(m_reverseBottleneckRate);
-  i.WriteDouble(m_rtt);
-  i.WriteDouble(m_ts);
-  i.WriteDouble(m_reverseTs);
+  i.WriteU32(m_bottleneckRate);
+  i.WriteU32(m_reverseBottleneckRate);
+  i.WriteU32(m_rtt);
+  i.WriteU64(m_ts);
+  i.WriteU64(m_reverseTs);
 }
 
 void RCPTag::Deserialize (TagBuffer i)
 {
   m_flowid = i.ReadU32();
-  m_bottleneckRate = i.ReadDouble();
-  m_reverseBottleneckRate = i.ReadDouble();
-  m_rtt = i.ReadDouble();
-  m_ts = i.ReadDouble();
-  m_reverseTs = i.ReadDouble();
+  m_bottleneckRate = i.ReadU32();
+  m_reverseBottleneckRate = i.ReadU32();
+  m_rtt = i.ReadU32();
+  m_ts = i.ReadU64();
+  m_reverseTs = i.ReadU64();
 }
 
 void RCPTag::Print(std::ostream &os) const
 {
   os << "Id: " << (uint32_t)m_flowid;
-  os << ", Bottleneck Rate: " << m_bottleneckRate;
-  os << ", Reverse Bottleneck Rate: " << m_reverseBottleneckRate;
-  os << ", RTT: " << m_rtt;
-  os << ", TimeStamp: " << m_ts;
-  os << ", Reverse TimeStamp: " << m_reverseTs;
+  os << ", Bottleneck Rate: " << GetBottleneckRate ();
+  os << ", Reverse Bottleneck Rate: " << GetReverseBottleneckRate ();
+  os << ", RTT: " << GetRTT ();
+  os << ", TimeStamp: " << GetTs ();
+  os << ", Reverse TimeStamp: " << GetReverseTs ();
   os << "\n";
 }
 
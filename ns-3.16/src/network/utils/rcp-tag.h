@@ -1,5 +1,5 @@
-#ifndef ECN_PRIORITY_TAG_H
-#define ECN_PRIORITY_TAG_H
+#ifndef RCP_TAG_H
+#define RCP_TAG_H
 
 #include "ns3/tag.h"
 #include "ns3/nstime.h"
@@ -7,23 +7,42 @@
 namespace ns3
 {
 
+/**
+ * The RCP fields are kept in fixed point: the rates in whole bytes per
+ * second, saturating at NO_RATE - 1, and the times in nanoseconds, the
+ * resolution of the simulator.  The RTT saturates after about 4.3
+ * seconds.  The double accessors convert; the fixed point ones let the
+ * queues compare and stamp rates without converting.
+ */
 class RCPTag : public Tag
 {
 
 public:
+  /// The fixed point rate of a negative rate, which means no rate.
+  static const uint32_t NO_RATE = 0xffffffff;
+
   RCPTag();
 
+  /**
+   * \param rate a rate in bytes per second, negative for none
+   * \returns the fixed point encoding of the rate
+   */
+  static uint32_t EncodeRate (double rate);
+
   void SetId(uint32_t id);
   uint32_t GetId() const;
 
   void SetBottleneckRate(double bottleneckRate);
   double GetBottleneckRate() const;
+  void SetBottleneckRateFixed(uint32_t bottleneckRate);
+  uint32_t GetBottleneckRateFixed() const;
 
   void SetReverseBottleneckRate(double reverseBottleneckRate);
   double GetReverseBottleneckRate() const;
   
   void SetRTT(double rtt);
   double GetRTT() const;
+  uint32_t GetRTTNanoSeconds() const;
   
   void SetTs(double ts);
   double GetTs() const;
@@ -39,14 +58,16 @@ public:
   virtual void Print (std::ostream &os) const;
 
 private:
+  static uint64_t EncodeTime (double seconds);
+
   uint32_t m_flowid;
-  double m_bottleneckRate;
-  double m_reverseBottleneckRate;
-  double m_rtt;
-  double m_ts;
-  double m_reverseTs;
+  uint32_t m_bottleneckRate;
+  uint32_t m_reverseBottleneckRate;
+  uint32_t m_rtt;
+  uint64_t m_ts;
+  uint64_t m_reverseTs;
 };
 
 } //namespace ns3
 
-#endif /* MY_PRIORITY_TAG_H */
+#endif /* RCP_TAG_H */
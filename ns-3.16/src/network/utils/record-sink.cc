@@ -0,0 +1,354 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "record-sink.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+#include <map>
+#include <stdio.h>
+
+NS_LOG_COMPONENT_DEFINE ("RecordSink");
+
+namespace ns3 {
+
+namespace {
+
+// header of a binary record file, followed by the 16 bit length of the
+// format and the format itself
+const char RECORD_MAGIC[4] = { 'R', 'E', 'C', 'S' };
+const uint8_t RECORD_VERSION = 1;
+
+bool
+IsLittleEndian (void)
+{
+  uint16_t one = 1;
+  return *reinterpret_cast<uint8_t *> (&one) == 1;
+}
+
+struct Registry
+{
+  Registry ()
+    : binary (false),
+      bufferSize (1 << 20),
+      flushScheduled (false)
+  {
+  }
+  // the streams are flushed and their files closed as the program exits
+  ~Registry ()
+  {
+    for (std::map<std::string, RecordStream *>::iterator i = streams.begin (); i != streams.end (); i++)
+      {
+        delete i->second;
+      }
+  }
+  // owned, see ~Registry
+  std::map<std::string, RecordStream *> streams;
+  bool binary;
+  uint32_t bufferSize;
+  bool flushScheduled;
+};
+
+Registry &
+GetRegistry (void)
+{
+  static Registry registry;
+  return registry;
+}
+
+void
+FlushAtDestroy (void)
+{
+  GetRegistry ().flushScheduled = false;
+  RecordSink::Flush ();
+}
+
+// a record was buffered: make sure the simulation flushes it when it
+// is destroyed
+void
+ScheduleFlush (void)
+{
+  Registry &registry = GetRegistry ();
+  if (!registry.flushScheduled)
+    {
+      registry.flushScheduled = true;
+      Simulator::ScheduleDestroy (&FlushAtDestroy);
+    }
+}
+
+} // anonymous namespace
+
+RecordStream::RecordStream (std::string filename, std::string format, bool binary, uint32_t bufferSize)
+  : m_filename (filename),
+    m_format (format),
+    m_binary (binary),
+    m_bufferSize (bufferSize),
+    m_recordStart (0),
+    m_field (0)
+{
+  NS_LOG_FUNCTION (this << filename << format << binary);
+  m_buffer.reserve (bufferSize + 256);
+  m_file.open (m_filename.c_str (), std::ios::out | std::ios::app | std::ios::binary);
+  NS_ABORT_MSG_UNLESS (m_file.is_open (), "RecordStream::RecordStream(): Unable to open " << m_filename);
+  if (m_binary && m_file.tellp () == std::streampos (0))
+    {
+      char endianness = IsLittleEndian () ? '<' : '>';
+      uint16_t length = m_format.size ();
+      m_file.write (RECORD_MAGIC, sizeof (RECORD_MAGIC));
+      m_file.write (reinterpret_cast<const char *> (&RECORD_VERSION), 1);
+      m_file.write (&endianness, 1);
+      m_file.write (reinterpret_cast<const char *> (&length), sizeof (length));
+      m_file.write (m_format.data (), m_format.size ());
+      m_file.flush ();
+    }
+}
+
+RecordStream::~RecordStream ()
+{
+  Flush ();
+}
+
+std::string
+RecordStream::GetFilename (void) const
+{
+  return m_filename;
+}
+
+std::string
+RecordStream::GetFormat (void) const
+{
+  return m_format;
+}
+
+void
+RecordStream::BeginField (char type)
+{
+  NS_ASSERT_MSG (m_field < m_format.size () && m_format[m_field] == type,
+                 m_filename << ": field " << m_field << " of type " << type
+                            << " does not follow the format " << m_format);
+  if (m_field == 0)
+    {
+      if (m_buffer.empty ())
+        {
+          ScheduleFlush ();
+        }
+      m_recordStart = m_buffer.size ();
+    }
+  if (!m_binary && m_field != 0)
+    {
+      m_buffer.push_back ('\t');
+    }
+  m_field++;
+}
+
+void
+RecordStream::AppendText (const char *text, int length)
+{
+  m_buffer.append (text, length);
+}
+
+void
+RecordStream::AppendBinary (const void *data, uint32_t size)
+{
+  m_buffer.append (static_cast<const char *> (data), size);
+}
+
+RecordStream &
+RecordStream::Add (double value)
+{
+  BeginField ('d');
+  if (m_binary)
+    {
+      AppendBinary (&value, sizeof (value));
+    }
+  else
+    {
+      // the default precision of std::ostream
+      char text[32];
+      AppendText (text, snprintf (text, sizeof (text), "%g", value));
+    }
+  return *this;
+}
+
+RecordStream &
+RecordStream::Add (uint64_t value)
+{
+  BeginField ('Q');
+  if (m_binary)
+    {
+      AppendBinary (&value, sizeof (value));
+    }
+  else
+    {
+      char text[32];
+      AppendText (text, snprintf (text, sizeof (text), "%llu", static_cast<unsigned long long> (value)));
+    }
+  return *this;
+}
+
+RecordStream &
+RecordStream::Add (uint32_t value)
+{
+  BeginField ('I');
+  if (m_binary)
+    {
+      AppendBinary (&value, sizeof (value));
+    }
+  else
+    {
+      char text[16];
+      AppendText (text, snprintf (text, sizeof (text), "%u", value));
+    }
+  return *this;
+}
+
+RecordStream &
+RecordStream::Add (uint16_t value)
+{
+  BeginField ('H');
+  if (m_binary)
+    {
+      AppendBinary (&value, sizeof (value));
+    }
+  else
+    {
+      char text[8];
+      AppendText (text, snprintf (text, sizeof (text), "%u", value));
+    }
+  return *this;
+}
+
+RecordStream &
+RecordStream::Add (int32_t value)
+{
+  BeginField ('i');
+  if (m_binary)
+    {
+      AppendBinary (&value, sizeof (value));
+    }
+  else
+    {
+      char text[16];
+      AppendText (text, snprintf (text, sizeof (text), "%d", value));
+    }
+  return *this;
+}
+
+RecordStream &
+RecordStream::Add (const std::string &value)
+{
+  BeginField ('s');
+  if (m_binary)
+    {
+      NS_ASSERT (value.size () <= 0xffff);
+      uint16_t length = value.size ();
+      AppendBinary (&length, sizeof (length));
+    }
+  m_buffer.append (value);
+  return *this;
+}
+
+void
+RecordStream::End (void)
+{
+  NS_ASSERT_MSG (m_field == m_format.size (), m_filename << ": record has " << m_field
+                                                         << " fields, the format is " << m_format);
+  m_field = 0;
+  if (!m_binary)
+    {
+      m_buffer.push_back ('\n');
+    }
+  if (m_buffer.size () >= m_bufferSize)
+    {
+      Flush ();
+    }
+}
+
+void
+RecordStream::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_buffer.empty ())
+    {
+      return;
+    }
+  // a partial record stays in the buffer
+  std::string::size_type size = (m_field == 0) ? m_buffer.size () : m_recordStart;
+  m_file.write (m_buffer.data (), size);
+  m_file.flush ();
+  m_buffer.erase (0, size);
+  m_recordStart = 0;
+}
+
+void
+RecordSink::SetBinary (bool binary)
+{
+  GetRegistry ().binary = binary;
+}
+
+bool
+RecordSink::IsBinary (void)
+{
+  return GetRegistry ().binary;
+}
+
+void
+RecordSink::SetBufferSize (uint32_t bytes)
+{
+  GetRegistry ().bufferSize = bytes;
+}
+
+RecordStream *
+RecordSink::GetStream (std::string filename, std::string format)
+{
+  NS_LOG_FUNCTION (filename << format);
+  Registry &registry = GetRegistry ();
+  std::map<std::string, RecordStream *>::iterator i = registry.streams.find (filename);
+  if (i != registry.streams.end ())
+    {
+      NS_ABORT_MSG_UNLESS (i->second->GetFormat () == format,
+                           "RecordSink::GetStream(): " << filename << " is written with the format "
+                                                       << i->second->GetFormat () << ", not " << format);
+      return i->second;
+    }
+  std::string path = filename;
+  if (registry.binary)
+    {
+      std::string::size_type dot = path.rfind (".txt");
+      if (dot != std::string::npos && dot + 4 == path.size ())
+        {
+          path.erase (dot);
+        }
+      path += ".bin";
+    }
+  RecordStream *stream = new RecordStream (path, format, registry.binary, registry.bufferSize);
+  registry.streams[filename] = stream;
+  return stream;
+}
+
+void
+RecordSink::Flush (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  Registry &registry = GetRegistry ();
+  for (std::map<std::string, RecordStream *>::iterator i = registry.streams.begin (); i != registry.streams.end (); i++)
+    {
+      i->second->Flush ();
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,155 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RECORD_SINK_H
+#define RECORD_SINK_H
+
+#include <stdint.h>
+#include <string>
+#include <fstream>
+
+namespace ns3 {
+
+/**
+ * \ingroup network
+ * \brief One buffered log file of a RecordSink, such as rto.txt or
+ * queuelength.txt.
+ *
+ * A record is written as a sequence of Add calls, one per field, closed
+ * by End.  The fields must follow the format the stream was created
+ * with, one character per field:
+ *
+ *  - 'd' double
+ *  - 'Q' uint64_t
+ *  - 'I' uint32_t
+ *  - 'H' uint16_t
+ *  - 'i' int32_t
+ *  - 's' std::string
+ *
+ * As text, the fields are separated by tabs and formatted like the
+ * default std::ostream output, so the files do not change.  As binary,
+ * the file starts with a header holding the format and each record is
+ * the packed fields in host byte order, a string being a 16 bit length
+ * followed by its bytes.  baseline-result/records.py reads both.
+ *
+ * Records are only kept in memory until the buffer of the stream is
+ * full, the simulation is destroyed or RecordSink::Flush is called.
+ */
+class RecordStream
+{
+public:
+  RecordStream &Add (double value);
+  RecordStream &Add (uint64_t value);
+  RecordStream &Add (uint32_t value);
+  RecordStream &Add (uint16_t value);
+  RecordStream &Add (int32_t value);
+  RecordStream &Add (const std::string &value);
+  /**
+   * \brief Close the current record.
+   */
+  void End (void);
+  /**
+   * \brief Write the buffered records to the file.
+   */
+  void Flush (void);
+
+  /**
+   * \returns the name of the file written
+   */
+  std::string GetFilename (void) const;
+  /**
+   * \returns the field format of the records
+   */
+  std::string GetFormat (void) const;
+
+  /**
+   * \brief Flush the buffered records and close the file. The streams of
+   * RecordSink::GetStream belong to the RecordSink.
+   */
+  ~RecordStream ();
+
+private:
+  friend class RecordSink;
+
+  RecordStream (std::string filename, std::string format, bool binary, uint32_t bufferSize);
+  RecordStream (const RecordStream &o);
+  RecordStream &operator= (const RecordStream &o);
+
+  void BeginField (char type);
+  void AppendText (const char *text, int length);
+  void AppendBinary (const void *data, uint32_t size);
+
+  std::string m_filename;
+  std::string m_format;
+  bool m_binary;
+  uint32_t m_bufferSize;
+  std::string m_buffer;
+  std::ofstream m_file;
+  std::string::size_type m_recordStart;  // where the current record starts in m_buffer
+  uint32_t m_field;            // index of the next field of the record
+};
+
+/**
+ * \ingroup network
+ * \brief Shared, buffered sink of the result logs of a simulation.
+ *
+ * Every log point of the same file shares one RecordStream, so a record
+ * costs an append to a memory buffer instead of opening and closing the
+ * file.  Files are opened in append mode when their stream is created
+ * and stay open until the program exits, when the streams are flushed and
+ * deleted, so callers may keep the pointer returned by GetStream, typically
+ * in a static.
+ */
+class RecordSink
+{
+public:
+  /**
+   * \brief Write the streams created from now on as binary records.
+   *
+   * The binary file of filename.txt is filename.bin.
+   *
+   * \param binary true for binary records, false for text
+   */
+  static void SetBinary (bool binary);
+  /**
+   * \returns true if new streams write binary records
+   */
+  static bool IsBinary (void);
+  /**
+   * \brief Set the size a stream buffers before writing to its file.
+   * \param bytes buffer size of the streams created from now on
+   */
+  static void SetBufferSize (uint32_t bytes);
+  /**
+   * \brief Get the stream of a log file, creating it if needed.
+   *
+   * \param filename the name of the text log
+   * \param format the type of the fields of a record, see RecordStream
+   * \returns the stream shared by every log point of the file
+   */
+  static RecordStream *GetStream (std::string filename, std::string format);
+  /**
+   * \brief Write the buffered records of every stream to their files.
+   *
+   * This is called when the simulation is destroyed and when the
+   * program exits.
+   */
+  static void Flush (void);
+};
+
+} // namespace ns3
+
+#endif /* RECORD_SINK_H */
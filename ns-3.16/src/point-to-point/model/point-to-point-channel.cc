@@ -22,6 +22,10 @@
 #include "ns3/packet.h"
 #include "ns3/simulator.h"
 #include "ns3/log.h"
+#include "ns3/core-config.h"
+#ifdef HAVE_PTHREAD_H
+#include "ns3/multithreaded-simulator-impl.h"
+#endif
 
 NS_LOG_COMPONENT_DEFINE ("PointToPointChannel");
 
@@ -76,6 +80,15 @@ PointToPointChannel::Attach (Ptr<PointToPointNetDevice> device)
       m_link[1].m_dst = m_link[0].m_src;
       m_link[0].m_state = IDLE;
       m_link[1].m_state = IDLE;
+      // the node ids of the destinations, unless the devices are not
+      // added to their nodes yet
+      for (uint32_t i = 0; i < N_DEVICES; i++)
+        {
+          if (m_link[i].m_dst->GetNode () != 0)
+            {
+              m_link[i].m_dstNode = m_link[i].m_dst->GetNode ()->GetId ();
+            }
+        }
     }
 }
 
@@ -92,13 +105,30 @@ PointToPointChannel::TransmitStart (
   NS_ASSERT (m_link[1].m_state != INITIALIZING);
 
   uint32_t wire = src == m_link[0].m_src ? 0 : 1;
+  Link &link = m_link[wire];
+  if (link.m_dstNode == 0xffffffff)
+    {
+      link.m_dstNode = link.m_dst->GetNode ()->GetId ();
+    }
 
-  Simulator::ScheduleWithContext (m_link[wire].m_dst->GetNode ()->GetId (),
-                                  txTime + m_delay, &PointToPointNetDevice::Receive,
-                                  m_link[wire].m_dst, p);
+  // The event holds a plain pointer to the destination device, which the
+  // channel keeps alive, so that its reference count is only touched by
+  // the thread running the destination node.
+#ifdef HAVE_PTHREAD_H
+  if (MultithreadedSimulatorImpl::IsRemote (link.m_dstNode))
+    {
+      Simulator::ScheduleWithContext (link.m_dstNode, txTime + m_delay,
+                                      &PointToPointNetDevice::Receive,
+                                      PeekPointer (link.m_dst), p->DeepCopy ());
+      return true;
+    }
+#endif
+  Simulator::ScheduleWithContext (link.m_dstNode, txTime + m_delay,
+                                  &PointToPointNetDevice::Receive,
+                                  PeekPointer (link.m_dst), p);
 
   // Call the tx anim callback on the net device
-  m_txrxPointToPoint (p, src, m_link[wire].m_dst, txTime, txTime + m_delay);
+  m_txrxPointToPoint (p, src, link.m_dst, txTime, txTime + m_delay);
   return true;
 }
 
@@ -43,6 +43,10 @@ class Packet;
  * There are two "wires" in the channel.  The first device connected gets the
  * [0] wire to transmit on.  The second device gets the [1] wire.  There is a
  * state (IDLE, TRANSMITTING) associated with each wire.
+ *
+ * With MultithreadedSimulatorImpl, the two devices may be run by two
+ * threads: the packets are then handed over as a Packet::DeepCopy and
+ * the TxRxPointToPoint trace is not fired.
  */
 class PointToPointChannel : public Channel 
 {
@@ -154,10 +158,11 @@ private:
   class Link
   {
 public:
-    Link() : m_state (INITIALIZING), m_src (0), m_dst (0) {}
+    Link() : m_state (INITIALIZING), m_src (0), m_dst (0), m_dstNode (0xffffffff) {}
     WireState                  m_state;
     Ptr<PointToPointNetDevice> m_src;
     Ptr<PointToPointNetDevice> m_dst;
+    uint32_t                   m_dstNode;
   };
 
   Link    m_link[N_DEVICES];
@@ -155,7 +155,8 @@ PointToPointNetDevice::PointToPointNetDevice ()
     m_lastUpdate(0),
     m_sinceLastUpdate(0),
     m_promised(0),
-    m_newpromised(0)
+    m_newpromised(0),
+    m_counters ()
 {
   NS_LOG_FUNCTION (this);
   for(int i = 0; i < QS_INTERVALS; i ++) m_arrivalRate[i] = 0;
@@ -257,6 +258,8 @@ PointToPointNetDevice::TransmitComplete (void)
   NS_ASSERT_MSG (m_currentPkt != 0, "PointToPointNetDevice::TransmitComplete(): m_currentPkt zero");
 
   m_phyTxEndTrace (m_currentPkt);
+  m_counters.phyTxEndPackets++;
+  m_counters.phyTxEndBytes += m_currentPkt->GetSize ();
   m_currentPkt = 0;
 
   Ptr<Packet> p = m_queue->Dequeue ();
@@ -321,6 +324,8 @@ PointToPointNetDevice::Receive (Ptr<Packet> packet)
       // corrupted packet, don't forward this packet up, let it go.
       //
       m_phyRxDropTrace (packet);
+      m_counters.phyRxDropPackets++;
+      m_counters.phyRxDropBytes += packet->GetSize ();
     }
   else 
     {
@@ -348,6 +353,8 @@ PointToPointNetDevice::Receive (Ptr<Packet> packet)
         }
 
       m_macRxTrace (packet);
+      m_counters.macRxPackets++;
+      m_counters.macRxBytes += packet->GetSize ();
       m_rxCallback (this, packet, protocol, GetRemote ());
     }
 }
@@ -359,6 +366,12 @@ PointToPointNetDevice::GetQueue (void) const
   return m_queue;
 }
 
+const PointToPointNetDevice::Counters &
+PointToPointNetDevice::GetCounters (void) const
+{
+  return m_counters;
+}
+
 void
 PointToPointNetDevice::NotifyLinkUp (void)
 {
@@ -484,6 +497,8 @@ PointToPointNetDevice::Send (
   if (IsLinkUp () == false)
     {
       m_macTxDropTrace (packet);
+      m_counters.macTxDropPackets++;
+      m_counters.macTxDropBytes += packet->GetSize ();
       return false;
     }
 
@@ -494,6 +509,8 @@ PointToPointNetDevice::Send (
   AddHeader (packet, protocolNumber);
 
   m_macTxTrace (packet);
+  m_counters.macTxPackets++;
+  m_counters.macTxBytes += packet->GetSize ();
 
   //
   // If there's a transmission in progress, we enque the packet for later
@@ -516,6 +533,8 @@ PointToPointNetDevice::Send (
         {
           // Enqueue may fail (overflow)
           m_macTxDropTrace (packet);
+          m_counters.macTxDropPackets++;
+          m_counters.macTxDropBytes += packet->GetSize ();
           return false;
         }
     }
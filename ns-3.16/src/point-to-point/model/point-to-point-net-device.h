@@ -120,6 +120,31 @@ public:
    */
   Ptr<Queue> GetQueue (void) const;
 
+  /**
+   * Packet and byte counts of the device since it was created, updated at
+   * the points where the trace sources of the same names fire.  Sampling
+   * them periodically gives the utilization of the link without connecting
+   * a callback to every packet.  Bytes include the PPP header.
+   */
+  struct Counters
+  {
+    uint64_t macTxPackets;      // MacTx: handed to the device, before queueing
+    uint64_t macTxBytes;
+    uint64_t macTxDropPackets;  // MacTxDrop: link down or queue overflow
+    uint64_t macTxDropBytes;
+    uint64_t phyTxEndPackets;   // PhyTxEnd: completely transmitted
+    uint64_t phyTxEndBytes;
+    uint64_t macRxPackets;      // MacRx: forwarded up, without the PPP header
+    uint64_t macRxBytes;
+    uint64_t phyRxDropPackets;  // PhyRxDrop: lost to the receive error model
+    uint64_t phyRxDropBytes;
+  };
+
+  /**
+   * @returns the counters of the device
+   */
+  const Counters &GetCounters (void) const;
+
   /**
    * Attach a receive ErrorModel to the PointToPointNetDevice.
    *
@@ -478,6 +503,8 @@ private:
   uint32_t      m_promised;
   uint32_t      m_newpromised;
 
+  Counters m_counters;
+
 
 };
 
@@ -3,6 +3,14 @@
 #include "ns3/simulator.h"
 #include "ns3/point-to-point-net-device.h"
 #include "ns3/point-to-point-channel.h"
+#include "ns3/node.h"
+#include "ns3/uinteger.h"
+#include "ns3/core-config.h"
+#ifdef HAVE_PTHREAD_H
+#include "ns3/multithreaded-simulator-impl.h"
+#endif
+#include <utility>
+#include <vector>
 
 using namespace ns3;
 
@@ -55,6 +63,190 @@ PointToPointTest::DoRun (void)
 
   Simulator::Destroy ();
 }
+
+class PointToPointCountersTest : public TestCase
+{
+public:
+  PointToPointCountersTest ();
+
+  virtual void DoRun (void);
+
+private:
+  void Send (Ptr<PointToPointNetDevice> device, uint32_t size);
+};
+
+PointToPointCountersTest::PointToPointCountersTest ()
+  : TestCase ("PointToPoint packet and byte counters")
+{
+}
+
+void
+PointToPointCountersTest::Send (Ptr<PointToPointNetDevice> device, uint32_t size)
+{
+  device->Send (Create<Packet> (size), device->GetBroadcast (), 0x800);
+}
+
+void
+PointToPointCountersTest::DoRun (void)
+{
+  Ptr<Node> a = CreateObject<Node> ();
+  Ptr<Node> b = CreateObject<Node> ();
+  Ptr<PointToPointNetDevice> devA = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointNetDevice> devB = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointChannel> channel = CreateObject<PointToPointChannel> ();
+
+  Ptr<Queue> queue = CreateObject<DropTailQueue> ();
+  queue->SetAttribute ("MaxBytes", UintegerValue (600));
+  devA->Attach (channel);
+  devA->SetAddress (Mac48Address::Allocate ());
+  devA->SetQueue (queue);
+  devB->Attach (channel);
+  devB->SetAddress (Mac48Address::Allocate ());
+  devB->SetQueue (CreateObject<DropTailQueue> ());
+
+  a->AddDevice (devA);
+  b->AddDevice (devB);
+
+  // the first packet is sent right away, the next two fill the queue, the
+  // last overflows
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      Simulator::Schedule (Seconds (1.0), &PointToPointCountersTest::Send, this, devA, 100 * (i + 1));
+    }
+  Simulator::Run ();
+
+  // each packet carries a 2 byte PPP header
+  const PointToPointNetDevice::Counters &sent = devA->GetCounters ();
+  NS_TEST_ASSERT_MSG_EQ (sent.macTxPackets, 4, "every packet hits MacTx");
+  NS_TEST_ASSERT_MSG_EQ (sent.macTxBytes, 1008, "every packet hits MacTx");
+  NS_TEST_ASSERT_MSG_EQ (sent.phyTxEndPackets, 3, "the last packet did not fit in the queue");
+  NS_TEST_ASSERT_MSG_EQ (sent.phyTxEndBytes, 606, "the last packet did not fit in the queue");
+  // MacTxDrop only covers overflows while the transmitter is ready
+  NS_TEST_ASSERT_MSG_EQ (sent.macTxDropPackets, 0, "the queue dropped the last packet");
+  NS_TEST_ASSERT_MSG_EQ (queue->GetTotalDroppedBytes (), 402, "the queue dropped the last packet");
+  NS_TEST_ASSERT_MSG_EQ (sent.macRxPackets, 0, "nothing was sent to a");
+  const PointToPointNetDevice::Counters &received = devB->GetCounters ();
+  NS_TEST_ASSERT_MSG_EQ (received.macRxPackets, 3, "b received the transmitted packets");
+  NS_TEST_ASSERT_MSG_EQ (received.macRxBytes, 600, "without their PPP header");
+  NS_TEST_ASSERT_MSG_EQ (received.macTxPackets, 0, "b did not send anything");
+
+  Simulator::Destroy ();
+}
+
+#ifdef HAVE_PTHREAD_H
+/**
+ * Two nodes send packets to each other over a channel between two
+ * partitions of MultithreadedSimulatorImpl: they must receive the same
+ * packets at the same times as with the default simulator.
+ */
+class PointToPointMultithreadedTest : public TestCase
+{
+public:
+  PointToPointMultithreadedTest ();
+
+  virtual void DoRun (void);
+
+private:
+  typedef std::vector<std::pair<uint64_t, uint32_t> > Received;
+
+  void RunOnce (bool multithreaded);
+  void Send (Ptr<PointToPointNetDevice> device, uint32_t size);
+  bool Receive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol, const Address &from);
+
+  uint32_t m_nodeA;
+  // written by the thread running the node only
+  Received m_received[2];
+};
+
+PointToPointMultithreadedTest::PointToPointMultithreadedTest ()
+  : TestCase ("PointToPoint between two partitions of the multithreaded simulator")
+{
+}
+
+void
+PointToPointMultithreadedTest::Send (Ptr<PointToPointNetDevice> device, uint32_t size)
+{
+  device->Send (Create<Packet> (size), device->GetBroadcast (), 0x800);
+}
+
+bool
+PointToPointMultithreadedTest::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol, const Address &from)
+{
+  uint32_t i = device->GetNode ()->GetId () == m_nodeA ? 0 : 1;
+  m_received[i].push_back (std::make_pair (Simulator::Now ().GetTimeStep (), packet->GetSize ()));
+  return true;
+}
+
+void
+PointToPointMultithreadedTest::RunOnce (bool multithreaded)
+{
+  Ptr<MultithreadedSimulatorImpl> impl;
+  if (multithreaded)
+    {
+      ObjectFactory factory;
+      factory.SetTypeId (MultithreadedSimulatorImpl::GetTypeId ());
+      factory.Set ("Partitions", UintegerValue (2));
+      impl = factory.Create<MultithreadedSimulatorImpl> ();
+      Simulator::SetImplementation (impl);
+    }
+
+  Ptr<Node> a = CreateObject<Node> ();
+  Ptr<Node> b = CreateObject<Node> ();
+  Ptr<PointToPointNetDevice> devA = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointNetDevice> devB = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointChannel> channel = CreateObject<PointToPointChannel> ();
+  channel->SetAttribute ("Delay", TimeValue (MilliSeconds (2)));
+
+  a->AddDevice (devA);
+  b->AddDevice (devB);
+  devA->Attach (channel);
+  devA->SetAddress (Mac48Address::Allocate ());
+  devA->SetQueue (CreateObject<DropTailQueue> ());
+  devA->SetAttribute ("DataRate", DataRateValue (DataRate ("10Mbps")));
+  devA->SetReceiveCallback (MakeCallback (&PointToPointMultithreadedTest::Receive, this));
+  devB->Attach (channel);
+  devB->SetAddress (Mac48Address::Allocate ());
+  devB->SetQueue (CreateObject<DropTailQueue> ());
+  devB->SetAttribute ("DataRate", DataRateValue (DataRate ("10Mbps")));
+  devB->SetReceiveCallback (MakeCallback (&PointToPointMultithreadedTest::Receive, this));
+  m_nodeA = a->GetId ();
+  if (impl != 0)
+    {
+      impl->SetPartition (a->GetId (), 0);
+      impl->SetPartition (b->GetId (), 1);
+    }
+
+  m_received[0].clear ();
+  m_received[1].clear ();
+  for (uint32_t i = 0; i < 50; i++)
+    {
+      Simulator::ScheduleWithContext (a->GetId (), MicroSeconds (300 * i),
+                                      &PointToPointMultithreadedTest::Send, this, devA, 100 + i);
+      Simulator::ScheduleWithContext (b->GetId (), MicroSeconds (300 * i + 150),
+                                      &PointToPointMultithreadedTest::Send, this, devB, 1000 + i);
+    }
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+PointToPointMultithreadedTest::DoRun (void)
+{
+  Simulator::Destroy ();
+  RunOnce (false);
+  Received reference[2] = { m_received[0], m_received[1] };
+  NS_TEST_ASSERT_MSG_EQ (reference[0].size (), 50, "node a did not receive all the packets");
+  NS_TEST_ASSERT_MSG_EQ (reference[1].size (), 50, "node b did not receive all the packets");
+
+  RunOnce (true);
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_received[i].size (), reference[i].size (), "node " << i << " received another number of packets");
+      NS_TEST_ASSERT_MSG_EQ ((m_received[i] == reference[i]), true, "node " << i << " received other packets");
+    }
+}
+#endif /* HAVE_PTHREAD_H */
+
 //-----------------------------------------------------------------------------
 class PointToPointTestSuite : public TestSuite
 {
@@ -66,6 +258,10 @@ PointToPointTestSuite::PointToPointTestSuite ()
   : TestSuite ("devices-point-to-point", UNIT)
 {
   AddTestCase (new PointToPointTest);
+  AddTestCase (new PointToPointCountersTest);
+#ifdef HAVE_PTHREAD_H
+  AddTestCase (new PointToPointMultithreadedTest);
+#endif
 }
 
 static PointToPointTestSuite g_pointToPointTestSuite;
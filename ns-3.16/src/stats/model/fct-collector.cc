@@ -0,0 +1,354 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "fct-collector.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/record-sink.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+NS_LOG_COMPONENT_DEFINE ("FctCollector");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (FctCollector);
+
+TypeId
+FctCollector::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FctCollector")
+    .SetParent<Object> ()
+    .AddConstructor<FctCollector> ()
+    .AddAttribute ("FlowFile", "The file the completed flows are written to, with the format IIdddII: "
+                   "flow id, size, start, first byte, last byte, retransmits and timeouts. "
+                   "Empty to only summarize the flows.",
+                   StringValue (""),
+                   MakeStringAccessor (&FctCollector::m_flowFile),
+                   MakeStringChecker ())
+    .AddAttribute ("BufferRecords", "The number of completed flows kept before they are written to the FlowFile.",
+                   UintegerValue (4096),
+                   MakeUintegerAccessor (&FctCollector::m_bufferRecords),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("SummaryStart", "Only the flows starting at or after this time are summarized.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&FctCollector::m_summaryStart),
+                   MakeTimeChecker ())
+    .AddAttribute ("SummaryStop", "Only the flows completing at or before this time are summarized.",
+                   TimeValue (Time (std::numeric_limits<int64_t>::max ())),
+                   MakeTimeAccessor (&FctCollector::m_summaryStop),
+                   MakeTimeChecker ())
+    .AddTraceSource ("FlowCompleted", "A flow received all its data.",
+                     MakeTraceSourceAccessor (&FctCollector::m_completedTrace))
+  ;
+  return tid;
+}
+
+FctCollector::FctCollector ()
+  : m_flowStream (0),
+    m_completed (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+FctCollector::~FctCollector ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+FctCollector::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Flush ();
+  m_active.clear ();
+  Object::DoDispose ();
+}
+
+void
+FctCollector::SetSizeBuckets (const std::vector<uint32_t> &bounds)
+{
+  NS_LOG_FUNCTION (this);
+  m_bounds = bounds;
+  m_buckets.clear ();
+}
+
+void
+FctCollector::FlowStarted (uint32_t flowId, uint32_t size, Time start)
+{
+  NS_LOG_FUNCTION (this << flowId << size << start);
+  FlowRecord &record = m_active[flowId];
+  record.flowId = flowId;
+  record.size = size;
+  record.start = start;
+  record.firstByte = Time ();
+  record.lastByte = Time ();
+  record.retransmits = 0;
+  record.timeouts = 0;
+}
+
+void
+FctCollector::FirstByte (uint32_t flowId)
+{
+  NS_LOG_FUNCTION (this << flowId);
+  std::map<uint32_t, FlowRecord>::iterator it = m_active.find (flowId);
+  if (it != m_active.end () && it->second.firstByte.IsZero ())
+    {
+      it->second.firstByte = Simulator::Now ();
+    }
+}
+
+void
+FctCollector::Retransmit (uint32_t flowId)
+{
+  NS_LOG_FUNCTION (this << flowId);
+  std::map<uint32_t, FlowRecord>::iterator it = m_active.find (flowId);
+  if (it != m_active.end ())
+    {
+      it->second.retransmits++;
+    }
+}
+
+void
+FctCollector::Timeout (uint32_t flowId)
+{
+  NS_LOG_FUNCTION (this << flowId);
+  std::map<uint32_t, FlowRecord>::iterator it = m_active.find (flowId);
+  if (it != m_active.end ())
+    {
+      it->second.timeouts++;
+    }
+}
+
+void
+FctCollector::FlowCompleted (uint32_t flowId)
+{
+  NS_LOG_FUNCTION (this << flowId);
+  std::map<uint32_t, FlowRecord>::iterator it = m_active.find (flowId);
+  if (it == m_active.end ())
+    {
+      return;
+    }
+  FlowRecord record = it->second;
+  m_active.erase (it);
+  record.lastByte = Simulator::Now ();
+  if (record.firstByte.IsZero ())
+    {
+      record.firstByte = record.lastByte;
+    }
+  m_completed++;
+  Summarize (record);
+  m_completedTrace (record);
+
+  if (!m_flowFile.empty ())
+    {
+      m_buffer.push_back (record);
+      if (m_buffer.size () >= m_bufferRecords)
+        {
+          Flush ();
+        }
+    }
+}
+
+void
+FctCollector::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_buffer.empty ())
+    {
+      return;
+    }
+  if (m_flowStream == 0)
+    {
+      m_flowStream = RecordSink::GetStream (m_flowFile, "IIdddII");
+    }
+  for (std::vector<FlowRecord>::const_iterator i = m_buffer.begin (); i != m_buffer.end (); i++)
+    {
+      m_flowStream->Add (i->flowId).Add (i->size)
+        .Add (i->start.GetSeconds ()).Add (i->firstByte.GetSeconds ()).Add (i->lastByte.GetSeconds ())
+        .Add (i->retransmits).Add (i->timeouts).End ();
+    }
+  m_buffer.clear ();
+}
+
+uint32_t
+FctCollector::GetActiveFlows (void) const
+{
+  return m_active.size ();
+}
+
+uint64_t
+FctCollector::GetCompletedFlows (void) const
+{
+  return m_completed;
+}
+
+uint32_t
+FctCollector::GetBucketKey (uint32_t size) const
+{
+  if (m_bounds.empty ())
+    {
+      return size;
+    }
+  std::vector<uint32_t>::const_iterator it = std::upper_bound (m_bounds.begin (), m_bounds.end (), size);
+  if (it == m_bounds.begin ())
+    {
+      return m_bounds.front ();
+    }
+  return *(it - 1);
+}
+
+const FctCollector::Bucket *
+FctCollector::GetBucket (uint32_t size) const
+{
+  std::map<uint32_t, Bucket>::const_iterator it = m_buckets.find (GetBucketKey (size));
+  return it == m_buckets.end () ? 0 : &it->second;
+}
+
+void
+FctCollector::Summarize (const FlowRecord &record)
+{
+  if (record.start < m_summaryStart || record.lastByte > m_summaryStop)
+    {
+      return;
+    }
+  m_buckets[GetBucketKey (record.size)].Add ((record.lastByte - record.start).GetSeconds ());
+}
+
+uint64_t
+FctCollector::GetCount (uint32_t size) const
+{
+  const Bucket *bucket = GetBucket (size);
+  return bucket == 0 ? 0 : bucket->count;
+}
+
+double
+FctCollector::GetMean (uint32_t size) const
+{
+  const Bucket *bucket = GetBucket (size);
+  return bucket == 0 ? 0 : bucket->sum / bucket->count;
+}
+
+double
+FctCollector::GetPercentile (uint32_t size, double percent) const
+{
+  const Bucket *bucket = GetBucket (size);
+  return bucket == 0 ? 0 : bucket->GetPercentile (percent);
+}
+
+void
+FctCollector::WriteSummary (RecordStream *stream) const
+{
+  NS_LOG_FUNCTION (this << stream);
+  for (std::map<uint32_t, Bucket>::const_iterator i = m_buckets.begin (); i != m_buckets.end (); i++)
+    {
+      const Bucket &bucket = i->second;
+      stream->Add (i->first).Add (bucket.sum / bucket.count)
+        .Add (bucket.GetPercentile (50)).Add (bucket.GetPercentile (99))
+        .Add (bucket.GetPercentile (1)).Add (bucket.GetPercentile (10))
+        .Add (bucket.count).End ();
+    }
+}
+
+FctCollector::Bucket::Bucket ()
+  : count (0),
+    sum (0),
+    min (0),
+    max (0)
+{
+}
+
+void
+FctCollector::Bucket::Add (double seconds)
+{
+  if (count == 0)
+    {
+      min = seconds;
+      max = seconds;
+    }
+  else
+    {
+      min = std::min (min, seconds);
+      max = std::max (max, seconds);
+    }
+  count++;
+  sum += seconds;
+
+  // seconds = m * 2^e with m in [0.5, 1), the bin is the slice of m
+  int32_t key = std::numeric_limits<int32_t>::min ();
+  if (seconds > 0)
+    {
+      int e;
+      double m = std::frexp (seconds, &e);
+      key = e * SUB_BINS + static_cast<int32_t> ((m - 0.5) * 2 * SUB_BINS);
+    }
+  bins[key]++;
+}
+
+double
+FctCollector::Bucket::GetSample (uint64_t rank) const
+{
+  if (rank == 0)
+    {
+      return min;
+    }
+  if (rank + 1 >= count)
+    {
+      return max;
+    }
+  uint64_t seen = 0;
+  std::map<int32_t, uint64_t>::const_iterator it = bins.begin ();
+  for (; it != bins.end (); it++)
+    {
+      seen += it->second;
+      if (seen > rank)
+        {
+          break;
+        }
+    }
+  if (it->first == std::numeric_limits<int32_t>::min ())
+    {
+      return min;
+    }
+  // the middle of the bin
+  int32_t e = it->first >= 0 ? it->first / SUB_BINS : -((-it->first + SUB_BINS - 1) / SUB_BINS);
+  int32_t sub = it->first - e * SUB_BINS;
+  double value = std::ldexp (0.5 + (sub + 0.5) / (2 * SUB_BINS), e);
+  return std::max (min, std::min (max, value));
+}
+
+double
+FctCollector::Bucket::GetPercentile (double percent) const
+{
+  if (count == 0)
+    {
+      return 0;
+    }
+  double rank = percent / 100 * (count - 1);
+  uint64_t below = static_cast<uint64_t> (std::floor (rank));
+  double low = GetSample (below);
+  if (rank == below)
+    {
+      return low;
+    }
+  return low + (rank - below) * (GetSample (below + 1) - low);
+}
+
+} // namespace ns3
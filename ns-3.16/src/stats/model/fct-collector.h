@@ -0,0 +1,205 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FCT_COLLECTOR_H
+#define FCT_COLLECTOR_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/traced-callback.h"
+
+namespace ns3 {
+
+class RecordStream;
+
+/**
+ * \ingroup stats
+ *
+ * \brief Collects the completion time of flows, by flow id.
+ *
+ * The workload tells the collector when a flow starts, and the ends of
+ * the flow when its first and last bytes are received and when it
+ * retransmits or times out.  Only the flows in progress are kept by id;
+ * a completed flow is appended to a buffer of FlowRecord which is
+ * written to the FlowFile every BufferRecords records, so the memory
+ * does not grow with the number of flows of the workload.
+ *
+ * The completion times are also summarized online, per flow size
+ * bucket: the mean is exact, the percentiles come from a log-linear
+ * histogram whose bins are less than 1% wide.  Only the flows which
+ * start after SummaryStart and complete before SummaryStop are
+ * summarized, e.g. to leave out the warm up of the network.
+ *
+ * All the methods are called from simulation events, so a collector is
+ * used by a single thread.  With MultithreadedSimulatorImpl, the events
+ * of the two ends of a flow may run in different partitions: use one
+ * collector per partition.
+ */
+class FctCollector : public Object
+{
+public:
+  /**
+   * \brief What is known of a flow.
+   */
+  struct FlowRecord
+  {
+    uint32_t flowId;
+    uint32_t size;        // bytes
+    Time start;
+    Time firstByte;       // when the receiver got the first data
+    Time lastByte;        // when the receiver got all the data
+    uint32_t retransmits; // fast retransmits and timeouts
+    uint32_t timeouts;
+  };
+
+  static TypeId GetTypeId (void);
+
+  FctCollector ();
+  virtual ~FctCollector ();
+
+  /**
+   * \brief Group the flows of the summary by size range.
+   *
+   * A flow belongs to the bucket of the largest bound not above its
+   * size, or to the first bucket.  Without bounds, the default, each
+   * flow size has its own bucket.
+   *
+   * \param bounds the lower bound of each bucket, in increasing order
+   */
+  void SetSizeBuckets (const std::vector<uint32_t> &bounds);
+
+  /**
+   * \param flowId the id of the flow
+   * \param size the bytes of the flow
+   * \param start when the flow started, usually now
+   */
+  void FlowStarted (uint32_t flowId, uint32_t size, Time start);
+  /**
+   * \brief The receiver got the first data of a flow, now.
+   * \param flowId the id of the flow
+   */
+  void FirstByte (uint32_t flowId);
+  /**
+   * \brief The sender retransmitted a segment of a flow.
+   * \param flowId the id of the flow
+   */
+  void Retransmit (uint32_t flowId);
+  /**
+   * \brief The retransmission timer of a flow expired.
+   * \param flowId the id of the flow
+   */
+  void Timeout (uint32_t flowId);
+  /**
+   * \brief The receiver got all the data of a flow, now.
+   *
+   * Events of the flow after this one are ignored.
+   *
+   * \param flowId the id of the flow
+   */
+  void FlowCompleted (uint32_t flowId);
+
+  /**
+   * \brief Write the buffered records to the FlowFile.
+   */
+  void Flush (void);
+
+  /**
+   * \returns the number of flows started and not completed
+   */
+  uint32_t GetActiveFlows (void) const;
+  /**
+   * \returns the number of flows completed
+   */
+  uint64_t GetCompletedFlows (void) const;
+
+  /**
+   * \param size a flow size
+   * \returns the number of summarized flows in the bucket of the size
+   */
+  uint64_t GetCount (uint32_t size) const;
+  /**
+   * \param size a flow size
+   * \returns the mean completion time in the bucket of the size, in seconds
+   */
+  double GetMean (uint32_t size) const;
+  /**
+   * \param size a flow size
+   * \param percent the percentile, between 0 and 100
+   * \returns the completion time percentile in the bucket of the size,
+   * in seconds, interpolated between samples like numpy.percentile
+   */
+  double GetPercentile (uint32_t size, double percent) const;
+
+  /**
+   * \brief Write one record per size bucket: the bucket, the mean, the
+   * 50th, 99th, 1st and 10th percentiles and the number of flows.
+   *
+   * These are the columns of the per size files of
+   * baseline-result/findavg_fair.py.
+   *
+   * \param stream a stream created with the format "IdddddQ"
+   */
+  void WriteSummary (RecordStream *stream) const;
+
+private:
+  /**
+   * The completion times of a size bucket.  A bin covers 1/SUB_BINS of
+   * the powers of two it falls in.
+   */
+  struct Bucket
+  {
+    Bucket ();
+    void Add (double seconds);
+    // the value of the sample of the given rank, from 0
+    double GetSample (uint64_t rank) const;
+    double GetPercentile (double percent) const;
+
+    uint64_t count;
+    double sum;
+    double min;
+    double max;
+    std::map<int32_t, uint64_t> bins;
+  };
+
+  enum
+  {
+    SUB_BINS = 128
+  };
+
+  virtual void DoDispose (void);
+  uint32_t GetBucketKey (uint32_t size) const;
+  const Bucket *GetBucket (uint32_t size) const;
+  void Summarize (const FlowRecord &record);
+
+  std::string m_flowFile;
+  uint32_t m_bufferRecords;
+  Time m_summaryStart;
+  Time m_summaryStop;
+  RecordStream *m_flowStream;
+  std::vector<uint32_t> m_bounds;
+  std::map<uint32_t, FlowRecord> m_active;
+  std::vector<FlowRecord> m_buffer;
+  uint64_t m_completed;
+  std::map<uint32_t, Bucket> m_buckets;
+  TracedCallback<const FlowRecord &> m_completedTrace;
+};
+
+} // namespace ns3
+
+#endif /* FCT_COLLECTOR_H */
@@ -0,0 +1,204 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/nstime.h"
+#include "ns3/record-sink.h"
+#include "ns3/fct-collector.h"
+
+using namespace ns3;
+
+class FctCollectorRecordTestCase : public TestCase
+{
+public:
+  FctCollectorRecordTestCase ();
+  virtual void DoRun (void);
+
+private:
+  void Completed (const FctCollector::FlowRecord &record);
+
+  std::vector<FctCollector::FlowRecord> m_completed;
+};
+
+FctCollectorRecordTestCase::FctCollectorRecordTestCase ()
+  : TestCase ("The events of a flow make up its record, which is spilled to the flow file")
+{
+}
+
+void
+FctCollectorRecordTestCase::Completed (const FctCollector::FlowRecord &record)
+{
+  m_completed.push_back (record);
+}
+
+void
+FctCollectorRecordTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("fct-collector.txt");
+  remove (filename.c_str ());
+  Ptr<FctCollector> collector = CreateObject<FctCollector> ();
+  collector->SetAttribute ("FlowFile", StringValue (filename));
+  collector->SetAttribute ("BufferRecords", UintegerValue (2));
+  collector->TraceConnectWithoutContext ("FlowCompleted", MakeCallback (&FctCollectorRecordTestCase::Completed, this));
+
+  // flow i starts at i seconds and completes 3s later
+  for (uint32_t id = 1; id <= 3; id++)
+    {
+      Simulator::Schedule (Seconds (id), &FctCollector::FlowStarted, collector, id, 1000 * id, Seconds (id));
+      Simulator::Schedule (Seconds (id + 1), &FctCollector::FirstByte, collector, id);
+      Simulator::Schedule (Seconds (id + 1.5), &FctCollector::FirstByte, collector, id);
+      Simulator::Schedule (Seconds (id + 2), &FctCollector::Retransmit, collector, id);
+      Simulator::Schedule (Seconds (id + 2), &FctCollector::Timeout, collector, id);
+      Simulator::Schedule (Seconds (id + 2), &FctCollector::Retransmit, collector, id);
+      Simulator::Schedule (Seconds (id + 3), &FctCollector::FlowCompleted, collector, id);
+      // ignored, the flow is done
+      Simulator::Schedule (Seconds (id + 4), &FctCollector::Retransmit, collector, id);
+      Simulator::Schedule (Seconds (id + 4), &FctCollector::FlowCompleted, collector, id);
+    }
+  // never started
+  Simulator::Schedule (Seconds (1), &FctCollector::FlowCompleted, collector, 7);
+  Simulator::Schedule (Seconds (1), &FctCollector::Retransmit, collector, 7);
+  // never completed
+  Simulator::Schedule (Seconds (1), &FctCollector::FlowStarted, collector, 8, 1, Seconds (1));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_completed.size (), 3, "one record per completed flow");
+  NS_TEST_EXPECT_MSG_EQ (collector->GetCompletedFlows (), 3, "one record per completed flow");
+  NS_TEST_EXPECT_MSG_EQ (collector->GetActiveFlows (), 1, "flow 8 is still active");
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      const FctCollector::FlowRecord &record = m_completed[i];
+      uint32_t id = i + 1;
+      NS_TEST_EXPECT_MSG_EQ (record.flowId, id, "flows complete in order");
+      NS_TEST_EXPECT_MSG_EQ (record.size, 1000 * id, "the size is kept");
+      NS_TEST_EXPECT_MSG_EQ (record.start, Seconds (id), "the start is kept");
+      NS_TEST_EXPECT_MSG_EQ (record.firstByte, Seconds (id + 1), "only the first byte counts");
+      NS_TEST_EXPECT_MSG_EQ (record.lastByte, Seconds (id + 3), "the last byte is the completion");
+      NS_TEST_EXPECT_MSG_EQ (record.retransmits, 2, "the retransmissions of the flow are counted");
+      NS_TEST_EXPECT_MSG_EQ (record.timeouts, 1, "the timeouts of the flow are counted");
+    }
+
+  // the first two records were spilled, the last one is written by Dispose
+  RecordSink::Flush ();
+  std::ifstream in (filename.c_str ());
+  std::string line;
+  uint32_t lines = 0;
+  while (std::getline (in, line))
+    {
+      lines++;
+    }
+  NS_TEST_EXPECT_MSG_EQ (lines, 2, "the buffer is spilled when full");
+  collector->Dispose ();
+  RecordSink::Flush ();
+  std::ifstream all (filename.c_str ());
+  std::getline (all, line);
+  NS_TEST_EXPECT_MSG_EQ (line, "1\t1000\t1\t2\t4\t2\t1", "flow id, size, start, first byte, last byte, retransmits and timeouts");
+  lines = 1;
+  while (std::getline (all, line))
+    {
+      lines++;
+    }
+  NS_TEST_EXPECT_MSG_EQ (lines, 3, "the buffer is written when the collector is disposed");
+
+  Simulator::Destroy ();
+}
+
+class FctCollectorSummaryTestCase : public TestCase
+{
+public:
+  FctCollectorSummaryTestCase ();
+  virtual void DoRun (void);
+};
+
+FctCollectorSummaryTestCase::FctCollectorSummaryTestCase ()
+  : TestCase ("The online summary matches the exact mean and percentiles")
+{
+}
+
+void
+FctCollectorSummaryTestCase::DoRun (void)
+{
+  Ptr<FctCollector> collector = CreateObject<FctCollector> ();
+  collector->SetAttribute ("SummaryStart", TimeValue (Seconds (1)));
+  collector->SetAttribute ("SummaryStop", TimeValue (Seconds (100)));
+
+  // flows of 1000 bytes take 1ms to 1s, of 2000 bytes 10ms; the flows
+  // starting before 1s or completing after 100s are not summarized
+  for (uint32_t i = 1; i <= 1000; i++)
+    {
+      Simulator::Schedule (Seconds (1), &FctCollector::FlowStarted, collector, i, 1000, Seconds (1));
+      Simulator::Schedule (Seconds (1) + MilliSeconds (i), &FctCollector::FlowCompleted, collector, i);
+    }
+  Simulator::Schedule (Seconds (1), &FctCollector::FlowStarted, collector, 1001, 2000, Seconds (1));
+  Simulator::Schedule (Seconds (1.01), &FctCollector::FlowCompleted, collector, 1001);
+  Simulator::Schedule (Seconds (0.5), &FctCollector::FlowStarted, collector, 1002, 1000, Seconds (0.5));
+  Simulator::Schedule (Seconds (60), &FctCollector::FlowCompleted, collector, 1002);
+  Simulator::Schedule (Seconds (2), &FctCollector::FlowStarted, collector, 1003, 1000, Seconds (2));
+  Simulator::Schedule (Seconds (101), &FctCollector::FlowCompleted, collector, 1003);
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_EQ (collector->GetCompletedFlows (), 1003, "every flow completed");
+  NS_TEST_EXPECT_MSG_EQ (collector->GetCount (1000), 1000, "the flows out of the window are left out");
+  NS_TEST_EXPECT_MSG_EQ (collector->GetCount (2000), 1, "each size has its bucket");
+  NS_TEST_EXPECT_MSG_EQ (collector->GetCount (1500), 0, "each size has its bucket");
+  NS_TEST_EXPECT_MSG_EQ_TOL (collector->GetMean (1000), 0.5005, 1e-9, "the mean is exact");
+  // numpy.percentile (range (1, 1001), p) / 1000
+  double percents[] = { 1, 10, 50, 99 };
+  double expected[] = { 0.01099, 0.1009, 0.5005, 0.99001 };
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      double p = collector->GetPercentile (1000, percents[i]);
+      NS_TEST_EXPECT_MSG_EQ_TOL (p, expected[i], expected[i] * 0.01, "percentile " << percents[i]);
+    }
+  NS_TEST_EXPECT_MSG_EQ_TOL (collector->GetPercentile (1000, 0), 0.001, 1e-12, "the extremes are exact");
+  NS_TEST_EXPECT_MSG_EQ_TOL (collector->GetPercentile (1000, 100), 1, 1e-12, "the extremes are exact");
+  NS_TEST_EXPECT_MSG_EQ_TOL (collector->GetPercentile (2000, 50), 0.01, 1e-12, "a single sample is exact");
+
+  // the same flows in two buckets
+  std::vector<uint32_t> bounds;
+  bounds.push_back (0);
+  bounds.push_back (1500);
+  collector->SetSizeBuckets (bounds);
+  collector->SetAttribute ("SummaryStop", TimeValue (Seconds (1000)));
+  for (uint32_t i = 1; i <= 1001; i++)
+    {
+      Simulator::Schedule (Seconds (1), &FctCollector::FlowStarted, collector, i, i < 1001 ? 1000 : 2000, Seconds (1));
+      Simulator::Schedule (Seconds (1) + MilliSeconds (i), &FctCollector::FlowCompleted, collector, i);
+    }
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (collector->GetCount (1), 1000, "sizes below 1500 share a bucket");
+  NS_TEST_EXPECT_MSG_EQ (collector->GetCount (1500), 1, "sizes from 1500 share a bucket");
+  NS_TEST_EXPECT_MSG_EQ (collector->GetCount (100000), 1, "sizes from 1500 share a bucket");
+
+  Simulator::Destroy ();
+}
+
+static class FctCollectorTestSuite : public TestSuite
+{
+public:
+  FctCollectorTestSuite ()
+    : TestSuite ("fct-collector", UNIT)
+  {
+    AddTestCase (new FctCollectorRecordTestCase ());
+    AddTestCase (new FctCollectorSummaryTestCase ());
+  }
+} g_fctCollectorTestSuite;
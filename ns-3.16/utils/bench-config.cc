@@ -0,0 +1,140 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Times the setup of the Id of every transmit queue, as the scenarios in
+// scratch/ do it, for increasing numbers of nodes:
+//
+//  - range:   Config::Set on /NodeList/[i-i]/DeviceList/[j-j]/TxQueue/Id,
+//             which still copies the whole NodeList and DeviceList
+//             containers for each path, as every path used to;
+//  - index:   Config::Set on /NodeList/i/DeviceList/j/TxQueue/Id, which
+//             only fetches the indexed elements;
+//  - SetMany: one Config::SetMany on /NodeList/*/DeviceList/*/TxQueue/Id.
+
+#include "ns3/system-wall-clock-ms.h"
+#include "ns3/simulator.h"
+#include "ns3/config.h"
+#include "ns3/uinteger.h"
+#include "ns3/node.h"
+#include "ns3/drop-tail-queue.h"
+#include "ns3/point-to-point-net-device.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace ns3;
+
+static uint32_t g_devices = 10;
+static uint32_t g_minNodes = 100;
+static uint32_t g_maxNodes = 1600;
+
+static void
+CreateTopology (uint32_t nodes)
+{
+  for (uint32_t i = 0; i < nodes; i++)
+    {
+      Ptr<Node> node = CreateObject<Node> ();
+      for (uint32_t j = 0; j < g_devices; j++)
+        {
+          Ptr<PointToPointNetDevice> device = CreateObject<PointToPointNetDevice> ();
+          device->SetQueue (CreateObject<DropTailQueue> ());
+          node->AddDevice (device);
+        }
+    }
+}
+
+static uint64_t
+RunSet (uint32_t nodes, bool range)
+{
+  SystemWallClockMs time;
+  time.Start ();
+  uint32_t id = 0;
+  for (uint32_t i = 0; i < nodes; i++)
+    {
+      for (uint32_t j = 0; j < g_devices; j++)
+        {
+          std::ostringstream oss;
+          if (range)
+            {
+              oss << "/NodeList/[" << i << "-" << i << "]/DeviceList/[" << j << "-" << j << "]/TxQueue/Id";
+            }
+          else
+            {
+              oss << "/NodeList/" << i << "/DeviceList/" << j << "/TxQueue/Id";
+            }
+          Config::Set (oss.str (), UintegerValue (id++));
+        }
+    }
+  return time.End ();
+}
+
+static uint64_t
+RunSetMany (uint32_t nodes)
+{
+  SystemWallClockMs time;
+  time.Start ();
+  std::vector<Ptr<const AttributeValue> > ids;
+  for (uint32_t id = 0; id < nodes * g_devices; id++)
+    {
+      ids.push_back (Create<UintegerValue> (id));
+    }
+  Config::SetMany ("/NodeList/*/DeviceList/*/TxQueue/Id", ids);
+  return time.End ();
+}
+
+int main (int argc, char *argv[])
+{
+  argc--;
+  argv++;
+  while (argc > 0)
+    {
+      if (strncmp ("--devices=", argv[0], strlen ("--devices=")) == 0)
+        {
+          g_devices = atoi (argv[0] + strlen ("--devices="));
+        }
+      else if (strncmp ("--min-nodes=", argv[0], strlen ("--min-nodes=")) == 0)
+        {
+          g_minNodes = atoi (argv[0] + strlen ("--min-nodes="));
+        }
+      else if (strncmp ("--max-nodes=", argv[0], strlen ("--max-nodes=")) == 0)
+        {
+          g_maxNodes = atoi (argv[0] + strlen ("--max-nodes="));
+        }
+      else
+        {
+          std::cout << "bench-config [--devices=N] [--min-nodes=N] [--max-nodes=N]" << std::endl;
+          return 1;
+        }
+      argc--;
+      argv++;
+    }
+
+  std::cout << "devices/node=" << g_devices << std::endl;
+  std::cout << "nodes\trange ms\tindex ms\tSetMany ms" << std::endl;
+  for (uint32_t nodes = g_minNodes; nodes > 0 && nodes <= g_maxNodes; nodes *= 2)
+    {
+      CreateTopology (nodes);
+      uint64_t rangeMs = RunSet (nodes, true);
+      uint64_t indexMs = RunSet (nodes, false);
+      uint64_t setManyMs = RunSetMany (nodes);
+      std::cout << nodes << "\t" << rangeMs << "\t\t" << indexMs << "\t\t" << setManyMs << std::endl;
+      // empties the NodeList
+      Simulator::Destroy ();
+    }
+  return 0;
+}
@@ -0,0 +1,232 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Compares Ipv4EndPointDemux::Lookup against the original implementation,
+// which scanned the list of every end point of the host for each packet.
+//
+// The host is a server: one listener on port 80 and a growing number of
+// connections accepted on it, as in the fan-in of wan-internet2-sack.
+// Every lookup is for the packet of a random connection.
+
+#include "ns3/system-wall-clock-ms.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/loopback-net-device.h"
+#include "ns3/ipv4-interface.h"
+#include "ns3/ipv4-end-point.h"
+#include "ns3/ipv4-end-point-demux.h"
+#include <list>
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace ns3;
+
+// the end point list and lookup loop of the original Ipv4EndPointDemux
+class ListScanDemux
+{
+public:
+  typedef std::list<Ipv4EndPoint *> EndPoints;
+
+  ~ListScanDemux ()
+  {
+    for (EndPoints::iterator i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+      {
+        delete *i;
+      }
+  }
+  Ipv4EndPoint *Allocate (Ipv4Address address, uint16_t port)
+  {
+    Ipv4EndPoint *endPoint = new Ipv4EndPoint (address, port);
+    m_endPoints.push_back (endPoint);
+    return endPoint;
+  }
+  Ipv4EndPoint *Allocate (Ipv4Address localAddress, uint16_t localPort,
+                          Ipv4Address peerAddress, uint16_t peerPort)
+  {
+    Ipv4EndPoint *endPoint = Allocate (localAddress, localPort);
+    endPoint->SetPeer (peerAddress, peerPort);
+    return endPoint;
+  }
+  EndPoints Lookup (Ipv4Address daddr, uint16_t dport, Ipv4Address saddr, uint16_t sport,
+                    Ptr<Ipv4Interface> incomingInterface)
+  {
+    EndPoints retval1, retval2, retval3, retval4;
+    for (EndPoints::iterator i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+      {
+        Ipv4EndPoint* endP = *i;
+        if (endP->GetLocalPort () != dport)
+          {
+            continue;
+          }
+        if (endP->GetBoundNetDevice () && endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
+          {
+            continue;
+          }
+        bool subnetDirected = false;
+        Ipv4Address incomingInterfaceAddr = daddr;
+        for (uint32_t j = 0; j < incomingInterface->GetNAddresses (); j++)
+          {
+            Ipv4InterfaceAddress addr = incomingInterface->GetAddress (j);
+            if (addr.GetLocal ().CombineMask (addr.GetMask ()) == daddr.CombineMask (addr.GetMask ()) &&
+                daddr.IsSubnetDirectedBroadcast (addr.GetMask ()))
+              {
+                subnetDirected = true;
+                incomingInterfaceAddr = addr.GetLocal ();
+              }
+          }
+        bool isBroadcast = (daddr.IsBroadcast () || subnetDirected == true);
+        bool localAddressMatchesWildCard = endP->GetLocalAddress () == Ipv4Address::GetAny ();
+        bool localAddressMatchesExact = endP->GetLocalAddress () == daddr;
+        if (isBroadcast && (endP->GetLocalAddress () != Ipv4Address::GetAny ()))
+          {
+            localAddressMatchesExact = (endP->GetLocalAddress () == incomingInterfaceAddr);
+          }
+        if (!(localAddressMatchesExact || localAddressMatchesWildCard))
+          continue;
+        bool remotePeerMatchesExact = endP->GetPeerPort () == sport;
+        bool remotePeerMatchesWildCard = endP->GetPeerPort () == 0;
+        bool remoteAddressMatchesExact = endP->GetPeerAddress () == saddr;
+        bool remoteAddressMatchesWildCard = endP->GetPeerAddress () == Ipv4Address::GetAny ();
+        if (!(remotePeerMatchesExact || remotePeerMatchesWildCard))
+          continue;
+        if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
+          continue;
+        if (localAddressMatchesWildCard && remotePeerMatchesWildCard && remoteAddressMatchesWildCard)
+          {
+            retval1.push_back (endP);
+          }
+        if ((localAddressMatchesExact || (isBroadcast && localAddressMatchesWildCard)) &&
+            remotePeerMatchesWildCard && remoteAddressMatchesWildCard)
+          {
+            retval2.push_back (endP);
+          }
+        if (localAddressMatchesWildCard && remotePeerMatchesExact && remoteAddressMatchesExact)
+          {
+            retval3.push_back (endP);
+          }
+        if (localAddressMatchesExact && remotePeerMatchesExact && remoteAddressMatchesExact)
+          {
+            retval4.push_back (endP);
+          }
+      }
+    if (!retval4.empty ()) return retval4;
+    if (!retval3.empty ()) return retval3;
+    if (!retval2.empty ()) return retval2;
+    return retval1;
+  }
+private:
+  EndPoints m_endPoints;
+};
+
+static uint32_t g_lookups = 2000;
+static Ipv4Address g_local ("10.0.0.1");
+
+static Ipv4Address
+PeerAddress (uint32_t connection)
+{
+  return Ipv4Address (Ipv4Address ("10.1.0.0").Get () + connection / 1000);
+}
+
+static uint16_t
+PeerPort (uint32_t connection)
+{
+  return 49152 + connection % 1000;
+}
+
+template <typename D>
+static void
+Populate (D &demux, uint32_t connections)
+{
+  demux.Allocate (Ipv4Address::GetAny (), 80);
+  for (uint32_t c = 0; c < connections; c++)
+    {
+      // what TcpSocketBase does when it forks on a SYN
+      demux.Allocate (g_local, 80, PeerAddress (c), PeerPort (c));
+    }
+}
+
+template <typename D>
+static uint64_t
+RunBench (D &demux, uint32_t connections, Ptr<Ipv4Interface> interface)
+{
+  uint32_t found = 0;
+  SystemWallClockMs time;
+  time.Start ();
+  for (uint32_t i = 0; i < g_lookups; i++)
+    {
+      uint32_t c = (i * 7919) % connections;
+      found += demux.Lookup (g_local, 80, PeerAddress (c), PeerPort (c), interface).size ();
+    }
+  uint64_t ms = time.End ();
+  if (found != g_lookups)
+    {
+      std::cout << "lookup missed " << g_lookups - found << " connections" << std::endl;
+    }
+  return ms;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t maxConnections = 100000;
+  argc--;
+  argv++;
+  while (argc > 0)
+    {
+      if (strncmp ("--lookups=", argv[0], strlen ("--lookups=")) == 0)
+        {
+          g_lookups = atoi (argv[0] + strlen ("--lookups="));
+        }
+      else if (strncmp ("--max-connections=", argv[0], strlen ("--max-connections=")) == 0)
+        {
+          maxConnections = atoi (argv[0] + strlen ("--max-connections="));
+        }
+      else
+        {
+          std::cout << "bench-end-point-demux [--lookups=N] [--max-connections=N]" << std::endl;
+          return 1;
+        }
+      argc--;
+      argv++;
+    }
+
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<LoopbackNetDevice> device = CreateObject<LoopbackNetDevice> ();
+  node->AddDevice (device);
+  Ptr<Ipv4Interface> interface = CreateObject<Ipv4Interface> ();
+  interface->SetNode (node);
+  interface->SetDevice (device);
+  interface->AddAddress (Ipv4InterfaceAddress (g_local, "255.255.255.0"));
+
+  std::cout << "lookups=" << g_lookups << std::endl;
+  for (uint32_t connections = 10; connections <= maxConnections; connections *= 10)
+    {
+      ListScanDemux scan;
+      Populate (scan, connections);
+      uint64_t scanMs = RunBench (scan, connections, interface);
+
+      Ipv4EndPointDemux hashed;
+      Populate (hashed, connections);
+      uint64_t hashedMs = RunBench (hashed, connections, interface);
+
+      std::cout << "end points=" << connections + 1
+                << " list scan: " << scanMs << " ms"
+                << " hashed: " << hashedMs << " ms" << std::endl;
+    }
+
+  Simulator::Destroy ();
+  return 0;
+}
@@ -0,0 +1,137 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Times the reports a FlowProbe makes to the FlowMonitor, with many
+// packets in flight.
+//
+// Every millisecond, each flow sends a new packet, which is reported
+// once per hop, and the packet sent a window earlier is received,
+// unless it was dropped silently.  The monitor tracks flows * window
+// packets, and looks for the lost ones every second.
+
+#include "ns3/system-wall-clock-ms.h"
+#include "ns3/simulator.h"
+#include "ns3/nstime.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/flow-probe.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace ns3;
+
+static uint32_t g_flows = 10000;
+static uint32_t g_window = 32;
+static uint32_t g_hops = 4;
+static uint32_t g_rounds = 3000;
+
+class BenchFlowProbe : public FlowProbe
+{
+public:
+  BenchFlowProbe (Ptr<FlowMonitor> monitor)
+    : FlowProbe (monitor)
+  {
+  }
+};
+
+static void
+Round (Ptr<FlowMonitor> monitor, Ptr<FlowProbe> probe, uint32_t round)
+{
+  for (FlowId flow = 1; flow <= g_flows; flow++)
+    {
+      monitor->ReportFirstTx (probe, flow, round, 1000);
+      for (uint32_t h = 0; h < g_hops; h++)
+        {
+          // the packets in flight are at different hops
+          uint32_t seq = round - std::min (round, h * g_window / g_hops);
+          monitor->ReportForwarding (probe, flow, seq, 1000);
+        }
+      // one packet in a hundred is never received
+      if (round >= g_window && (round + flow) % 100 != 0)
+        {
+          monitor->ReportLastRx (probe, flow, round - g_window, 1000);
+        }
+    }
+  if (round + 1 < g_rounds)
+    {
+      Simulator::Schedule (MilliSeconds (1), &Round, monitor, probe, round + 1);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+  argc--;
+  argv++;
+  while (argc > 0)
+    {
+      if (strncmp ("--flows=", argv[0], strlen ("--flows=")) == 0)
+        {
+          g_flows = atoi (argv[0] + strlen ("--flows="));
+        }
+      else if (strncmp ("--window=", argv[0], strlen ("--window=")) == 0)
+        {
+          g_window = atoi (argv[0] + strlen ("--window="));
+        }
+      else if (strncmp ("--hops=", argv[0], strlen ("--hops=")) == 0)
+        {
+          g_hops = atoi (argv[0] + strlen ("--hops="));
+        }
+      else if (strncmp ("--rounds=", argv[0], strlen ("--rounds=")) == 0)
+        {
+          g_rounds = atoi (argv[0] + strlen ("--rounds="));
+        }
+      else
+        {
+          std::cout << "bench-flow-monitor [--flows=N] [--window=N] [--hops=N] [--rounds=N]" << std::endl;
+          return 1;
+        }
+      argc--;
+      argv++;
+    }
+
+  std::cout << "flows=" << g_flows << " window=" << g_window
+            << " hops=" << g_hops << " rounds=" << g_rounds << std::endl;
+
+  Ptr<FlowMonitor> monitor = CreateObject<FlowMonitor> ();
+  monitor->SetAttribute ("MaxPerHopDelay", TimeValue (MilliSeconds (500)));
+  Ptr<FlowProbe> probe = Create<BenchFlowProbe> (monitor);
+  Simulator::Schedule (MilliSeconds (1), &Round, monitor, probe, 0);
+  Simulator::Stop (MilliSeconds (g_rounds + 1));
+
+  SystemWallClockMs time;
+  time.Start ();
+  Simulator::Run ();
+  uint64_t ms = time.End ();
+
+  std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
+  uint64_t rx = 0;
+  uint64_t lost = 0;
+  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); i++)
+    {
+      rx += i->second.rxPackets;
+      lost += i->second.lostPackets;
+    }
+  uint64_t reports = (uint64_t)g_flows * g_rounds * (g_hops + 2);
+  std::cout << ms << " ms, " << (ms * 1e6 / reports) << " ns per report" << std::endl;
+  std::cout << "received " << rx << ", lost " << lost << std::endl;
+
+  probe = 0;
+  monitor = 0;
+  Simulator::Destroy ();
+  return 0;
+}
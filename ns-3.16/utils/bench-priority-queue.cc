@@ -0,0 +1,182 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Compares PriorityQueue::FlushOutFlowPackets against the original
+// implementation, which scanned the std::deque of every low priority
+// sub-queue and peeked the MyPriorityTag of each packet.
+//
+// Each round enqueues the low priority tail of every flow (priorities 1
+// to 4, interleaved across flows as on a busy host uplink), then flushes
+// the flows one after the other while draining a few packets in between.
+
+#include "ns3/system-wall-clock-ms.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/priority-queue.h"
+#include "ns3/my-priority-tag.h"
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace ns3;
+
+// the sub-queue layout and flush loop of the original PriorityQueue
+class DequeScanQueue
+{
+public:
+  void Enqueue (Ptr<Packet> p)
+  {
+    uint16_t pr = GetTag (p).GetPriority ();
+    if (pr >= NUM_PRIORITY_QUEUES)
+      {
+        pr = NUM_PRIORITY_QUEUES - 1;
+      }
+    m_packets[pr].push_back (p);
+  }
+  Ptr<Packet> Dequeue (void)
+  {
+    for (int i = 0; i < NUM_PRIORITY_QUEUES; i++)
+      {
+        if (!m_packets[i].empty ())
+          {
+            Ptr<Packet> p = m_packets[i].front ();
+            m_packets[i].pop_front ();
+            return p;
+          }
+      }
+    return 0;
+  }
+  void FlushOutFlowPackets (uint32_t flowId)
+  {
+    for (int i = NUM_PRIORITY_QUEUES - 1; i >= 1; i--)
+      {
+        int j = 0;
+        while ((m_packets[i].begin () + j) != m_packets[i].end ())
+          {
+            std::deque<Ptr<Packet> >::iterator it = m_packets[i].begin () + j;
+            if (GetTag (*it).GetId () == flowId)
+              {
+                m_packets[i].erase (m_packets[i].begin () + j);
+              }
+            else
+              {
+                j++;
+              }
+          }
+      }
+  }
+private:
+  static MyPriorityTag GetTag (Ptr<const Packet> p)
+  {
+    MyPriorityTag tag;
+    Packet::EnablePrinting ();
+    p->PeekPacketTag (tag);
+    return tag;
+  }
+  std::deque<Ptr<Packet> > m_packets[NUM_PRIORITY_QUEUES];
+};
+
+static uint32_t g_flows = 100;
+static uint32_t g_packets = 200;
+static uint32_t g_rounds = 5;
+static uint32_t g_drain = 4;
+
+static Ptr<Packet>
+MakePacket (uint32_t flowId, uint32_t index)
+{
+  Ptr<Packet> p = Create<Packet> (1500);
+  MyPriorityTag tag;
+  tag.SetId (flowId);
+  tag.SetPriority (1 + (index * 4) / g_packets);
+  p->AddPacketTag (tag);
+  return p;
+}
+
+template <typename Q>
+static uint64_t
+RunBench (Q &queue)
+{
+  SystemWallClockMs time;
+  time.Start ();
+  for (uint32_t round = 0; round < g_rounds; round++)
+    {
+      for (uint32_t i = 0; i < g_packets; i++)
+        {
+          for (uint32_t f = 0; f < g_flows; f++)
+            {
+              queue.Enqueue (MakePacket (f, i));
+            }
+        }
+      for (uint32_t f = 0; f < g_flows; f++)
+        {
+          queue.FlushOutFlowPackets (f);
+          for (uint32_t d = 0; d < g_drain; d++)
+            {
+              queue.Dequeue ();
+            }
+        }
+    }
+  return time.End ();
+}
+
+int main (int argc, char *argv[])
+{
+  argc--;
+  argv++;
+  while (argc > 0)
+    {
+      if (strncmp ("--flows=", argv[0], strlen ("--flows=")) == 0)
+        {
+          g_flows = atoi (argv[0] + strlen ("--flows="));
+        }
+      else if (strncmp ("--packets=", argv[0], strlen ("--packets=")) == 0)
+        {
+          g_packets = atoi (argv[0] + strlen ("--packets="));
+        }
+      else if (strncmp ("--rounds=", argv[0], strlen ("--rounds=")) == 0)
+        {
+          g_rounds = atoi (argv[0] + strlen ("--rounds="));
+        }
+      else if (strncmp ("--drain=", argv[0], strlen ("--drain=")) == 0)
+        {
+          g_drain = atoi (argv[0] + strlen ("--drain="));
+        }
+      else
+        {
+          std::cout << "bench-priority-queue [--flows=N] [--packets=N] [--rounds=N] [--drain=N]" << std::endl;
+          return 1;
+        }
+      argc--;
+      argv++;
+    }
+
+  std::cout << "flows=" << g_flows << " packets/flow=" << g_packets
+            << " rounds=" << g_rounds << std::endl;
+
+  DequeScanQueue scan;
+  uint64_t scanMs = RunBench (scan);
+  std::cout << "deque scan:     " << scanMs << " ms" << std::endl;
+
+  Ptr<PriorityQueue> indexed = CreateObject<PriorityQueue> ();
+  indexed->SetAttribute ("MaxBytes", UintegerValue (0xffffffff));
+  uint64_t indexedMs = RunBench (*indexed);
+  std::cout << "per-flow index: " << indexedMs << " ms" << std::endl;
+
+  Simulator::Destroy ();
+  return 0;
+}
@@ -0,0 +1,338 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Compares the per packet path of RCPQueue against the original
+// implementation, which carried the RCP fields as six doubles and
+// stamped the bottleneck rate with RemovePacketTag and AddPacketTag at
+// every hop, and divided by the capacity for every arrival.
+//
+// Each round pushes a batch of packets, carrying an RCP tag and a
+// priority tag, through a chain of queues.  The stamped rates of the two
+// implementations are compared at the end.
+
+#include "ns3/system-wall-clock-ms.h"
+#include "ns3/simulator.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/rcp-queue.h"
+#include "ns3/rcp-tag.h"
+#include "ns3/my-priority-tag.h"
+#include <cmath>
+#include <iostream>
+#include <queue>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace ns3;
+
+// the tag of the original implementation
+class LegacyRCPTag : public Tag
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::LegacyRCPTag")
+      .SetParent<Tag> ()
+      .AddConstructor<LegacyRCPTag> ()
+    ;
+    return tid;
+  }
+  virtual TypeId GetInstanceTypeId (void) const
+  {
+    return GetTypeId ();
+  }
+  virtual uint32_t GetSerializedSize (void) const
+  {
+    return sizeof (uint32_t) + 5 * sizeof (double);
+  }
+  virtual void Serialize (TagBuffer i) const
+  {
+    i.WriteU32 (m_flowid);
+    i.WriteDouble (m_bottleneckRate);
+    i.WriteDouble (m_reverseBottleneckRate);
+    i.WriteDouble (m_rtt);
+    i.WriteDouble (m_ts);
+    i.WriteDouble (m_reverseTs);
+  }
+  virtual void Deserialize (TagBuffer i)
+  {
+    m_flowid = i.ReadU32 ();
+    m_bottleneckRate = i.ReadDouble ();
+    m_reverseBottleneckRate = i.ReadDouble ();
+    m_rtt = i.ReadDouble ();
+    m_ts = i.ReadDouble ();
+    m_reverseTs = i.ReadDouble ();
+  }
+  virtual void Print (std::ostream &os) const
+  {
+    os << m_flowid;
+  }
+  uint32_t m_flowid;
+  double m_bottleneckRate;
+  double m_reverseBottleneckRate;
+  double m_rtt;
+  double m_ts;
+  double m_reverseTs;
+};
+
+// the packet path of the original RCPQueue, in bytes mode
+class LegacyRCPQueue : public Queue
+{
+public:
+  LegacyRCPQueue (double capacity)
+    : m_maxBytes (0xffffffff),
+      m_bytesInQueue (0),
+      m_capacity (capacity),
+      m_rate (0.05 * 125000000),
+      m_activeInputTraffic (0),
+      m_trafficSpill (0),
+      m_endSlot (0.01),
+      m_Tq_rtt_sum (0),
+      m_Tq_rtt (0),
+      m_input_traffic_rtt (0)
+  {
+  }
+private:
+  virtual bool DoEnqueue (Ptr<Packet> p)
+  {
+    if (m_bytesInQueue + p->GetSize () >= m_maxBytes)
+      {
+        Drop (p);
+        return false;
+      }
+    m_bytesInQueue += p->GetSize ();
+    m_packets.push (p);
+    OnArrival (p);
+    return true;
+  }
+  virtual Ptr<Packet> DoDequeue (void)
+  {
+    if (m_packets.empty ())
+      {
+        return 0;
+      }
+    Ptr<Packet> p = m_packets.front ();
+    m_packets.pop ();
+    m_bytesInQueue -= p->GetSize ();
+    OnDeparture (p);
+    return p;
+  }
+  virtual Ptr<const Packet> DoPeek (void) const
+  {
+    return m_packets.empty () ? 0 : m_packets.front ();
+  }
+  void OnArrival (Ptr<Packet> p)
+  {
+    uint32_t size = p->GetSize ();
+    double pkt_time = double (size) / m_capacity;
+    double end_time = Simulator::Now ().GetSeconds () + pkt_time;
+    double part1, part2;
+    LegacyRCPTag tag;
+    p->PeekPacketTag (tag);
+    double this_rtt = tag.m_rtt;
+    if (this_rtt > 0)
+      {
+        m_Tq_rtt_sum += (this_rtt * size);
+        m_input_traffic_rtt += size;
+        double gain = m_rate / m_capacity;
+        m_Tq_rtt = gain * this_rtt + (1 - gain) * m_Tq_rtt;
+      }
+    if (end_time <= m_endSlot)
+      {
+        m_activeInputTraffic += size;
+      }
+    else
+      {
+        part2 = size * (end_time - m_endSlot) / pkt_time;
+        part1 = size - part2;
+        m_activeInputTraffic += part1;
+        m_trafficSpill += part2;
+      }
+  }
+  void OnDeparture (Ptr<Packet> p)
+  {
+    LegacyRCPTag tag;
+    p->RemovePacketTag (tag);
+    if ((tag.m_bottleneckRate == -1) || (tag.m_bottleneckRate > m_rate))
+      {
+        tag.m_bottleneckRate = m_rate;
+      }
+    p->AddPacketTag (tag);
+  }
+
+  std::queue<Ptr<Packet> > m_packets;
+  uint32_t m_maxBytes;
+  uint32_t m_bytesInQueue;
+  double m_capacity;
+  double m_rate;
+  double m_activeInputTraffic;
+  double m_trafficSpill;
+  double m_endSlot;
+  double m_Tq_rtt_sum;
+  double m_Tq_rtt;
+  uint32_t m_input_traffic_rtt;
+};
+
+static uint32_t g_hops = 5;
+static uint32_t g_batch = 100;
+static uint32_t g_rounds = 2000;
+
+static double
+GetSenderRate (uint32_t i)
+{
+  // a third of the packets carry no rate yet
+  return i % 3 == 0 ? -1 : 1000000.0 + 37 * i;
+}
+
+static void
+AddPriorityTag (Ptr<Packet> p, uint32_t i)
+{
+  MyPriorityTag priority;
+  priority.SetId (i);
+  priority.SetPriority (0);
+  p->AddPacketTag (priority);
+}
+
+static Ptr<Packet>
+MakeLegacyPacket (uint32_t i)
+{
+  Ptr<Packet> p = Create<Packet> (1460);
+  LegacyRCPTag tag;
+  tag.m_flowid = i;
+  tag.m_bottleneckRate = GetSenderRate (i);
+  tag.m_reverseBottleneckRate = 2000000;
+  tag.m_rtt = 0.1;
+  tag.m_ts = 1.5;
+  tag.m_reverseTs = 1.4;
+  p->AddPacketTag (tag);
+  AddPriorityTag (p, i);
+  return p;
+}
+
+static Ptr<Packet>
+MakePacket (uint32_t i)
+{
+  Ptr<Packet> p = Create<Packet> (1460);
+  RCPTag tag;
+  tag.SetId (i);
+  tag.SetBottleneckRate (GetSenderRate (i));
+  tag.SetReverseBottleneckRate (2000000);
+  tag.SetRTT (0.1);
+  tag.SetTs (1.5);
+  tag.SetReverseTs (1.4);
+  p->AddPacketTag (tag);
+  AddPriorityTag (p, i);
+  return p;
+}
+
+static uint64_t
+RunBench (std::vector<Ptr<Queue> > &queues, Ptr<Packet> (*make)(uint32_t),
+          std::vector<Ptr<Packet> > &last)
+{
+  uint64_t ms = 0;
+  std::vector<Ptr<Packet> > batch (g_batch);
+  for (uint32_t round = 0; round < g_rounds; round++)
+    {
+      for (uint32_t i = 0; i < g_batch; i++)
+        {
+          batch[i] = make (i);
+        }
+      SystemWallClockMs time;
+      time.Start ();
+      for (uint32_t h = 0; h < queues.size (); h++)
+        {
+          for (uint32_t i = 0; i < g_batch; i++)
+            {
+              queues[h]->Enqueue (batch[i]);
+            }
+          for (uint32_t i = 0; i < g_batch; i++)
+            {
+              batch[i] = queues[h]->Dequeue ();
+            }
+        }
+      ms += time.End ();
+    }
+  last = batch;
+  return ms;
+}
+
+int main (int argc, char *argv[])
+{
+  argc--;
+  argv++;
+  while (argc > 0)
+    {
+      if (strncmp ("--hops=", argv[0], strlen ("--hops=")) == 0)
+        {
+          g_hops = atoi (argv[0] + strlen ("--hops="));
+        }
+      else if (strncmp ("--batch=", argv[0], strlen ("--batch=")) == 0)
+        {
+          g_batch = atoi (argv[0] + strlen ("--batch="));
+        }
+      else if (strncmp ("--rounds=", argv[0], strlen ("--rounds=")) == 0)
+        {
+          g_rounds = atoi (argv[0] + strlen ("--rounds="));
+        }
+      else
+        {
+          std::cout << "bench-rcp-queue [--hops=N] [--batch=N] [--rounds=N]" << std::endl;
+          return 1;
+        }
+      argc--;
+      argv++;
+    }
+
+  std::cout << "hops=" << g_hops << " packets/round=" << g_batch
+            << " rounds=" << g_rounds << std::endl;
+
+  std::vector<Ptr<Queue> > legacy;
+  std::vector<Ptr<Queue> > lean;
+  for (uint32_t h = 0; h < g_hops; h++)
+    {
+      legacy.push_back (CreateObject<LegacyRCPQueue> (125000000.0));
+      Ptr<RCPQueue> queue = CreateObject<RCPQueue> ();
+      queue->SetAttribute ("Capacity", DoubleValue (125000000));
+      queue->SetAttribute ("MaxBytes", UintegerValue (0xffffffff));
+      lean.push_back (queue);
+    }
+
+  std::vector<Ptr<Packet> > legacyLast;
+  std::vector<Ptr<Packet> > leanLast;
+  uint64_t legacyMs = RunBench (legacy, &MakeLegacyPacket, legacyLast);
+  std::cout << "doubles, remove/add: " << legacyMs << " ms" << std::endl;
+  uint64_t leanMs = RunBench (lean, &MakePacket, leanLast);
+  std::cout << "fixed point, replace: " << leanMs << " ms" << std::endl;
+
+  // both encode the same rates, up to the rounding to whole bytes per second
+  uint32_t mismatches = 0;
+  for (uint32_t i = 0; i < g_batch; i++)
+    {
+      LegacyRCPTag a;
+      RCPTag b;
+      legacyLast[i]->PeekPacketTag (a);
+      leanLast[i]->PeekPacketTag (b);
+      if (std::fabs (a.m_bottleneckRate - b.GetBottleneckRate ()) > 0.5)
+        {
+          mismatches++;
+        }
+    }
+  std::cout << "stamped rates which differ: " << mismatches << std::endl;
+
+  Simulator::Destroy ();
+  return 0;
+}
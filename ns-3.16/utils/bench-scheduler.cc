@@ -0,0 +1,190 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Replays the operations on the event list recorded by a simulation
+// (see the eventTrace option of scratch/wan-internet2-sack) against
+// every scheduler, without running the events themselves.
+
+#include "ns3/core-module.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace ns3;
+
+// the trace is a sequence of 64 bit words: the timestamp of an
+// insertion, TRACE_NEXT for the removal of the next event, or
+// TRACE_REMOVE with the number of the insertion of a removed event
+static const uint64_t TRACE_NEXT = 1ULL << 63;
+static const uint64_t TRACE_REMOVE = 1ULL << 62;
+
+class Bench
+{
+public:
+  Bench ();
+  bool ReadTrace (const char *filename);
+  void RunBench (std::string scheduler);
+private:
+  std::vector<uint64_t> m_trace;
+  uint32_t m_nInserts;
+  uint32_t m_nRemoves;
+  uint32_t m_maxPending;
+};
+
+Bench::Bench ()
+  : m_nInserts (0),
+    m_nRemoves (0),
+    m_maxPending (0)
+{
+}
+
+bool
+Bench::ReadTrace (const char *filename)
+{
+  std::ifstream input (filename, std::ios::binary);
+  if (!input)
+    {
+      return false;
+    }
+  uint64_t word;
+  uint32_t pending = 0;
+  while (input.read ((char *)&word, sizeof (word)))
+    {
+      m_trace.push_back (word);
+      if (word == TRACE_NEXT || (word & TRACE_REMOVE) != 0)
+        {
+          pending--;
+          m_nRemoves += word != TRACE_NEXT;
+        }
+      else
+        {
+          pending++;
+          m_nInserts++;
+          m_maxPending = std::max (m_maxPending, pending);
+        }
+    }
+  std::cout << "trace: " << m_trace.size () << " operations, " << m_nInserts << " insertions, "
+            << m_nRemoves << " removals, at most " << m_maxPending << " pending events" << std::endl;
+  return true;
+}
+
+void
+Bench::RunBench (std::string scheduler)
+{
+  ObjectFactory factory (scheduler);
+  Ptr<Scheduler> events = factory.Create<Scheduler> ();
+  // the timestamps by uid, for the removals
+  std::vector<uint64_t> timestamps;
+  timestamps.reserve (m_nInserts);
+  uint64_t check = 0;
+
+  SystemWallClockMs time;
+  time.Start ();
+  for (std::vector<uint64_t>::const_iterator i = m_trace.begin (); i != m_trace.end (); i++)
+    {
+      Scheduler::Event ev;
+      ev.impl = 0;
+      ev.key.m_context = 0;
+      if (*i == TRACE_NEXT)
+        {
+          ev = events->RemoveNext ();
+          check += ev.key.m_uid;
+        }
+      else if ((*i & TRACE_REMOVE) != 0)
+        {
+          ev.key.m_uid = *i & ~TRACE_REMOVE;
+          ev.key.m_ts = timestamps[ev.key.m_uid];
+          events->Remove (ev);
+        }
+      else
+        {
+          ev.key.m_ts = *i;
+          ev.key.m_uid = timestamps.size ();
+          timestamps.push_back (*i);
+          events->Insert (ev);
+        }
+    }
+  double elapsed = time.End () / 1000.0;
+
+  std::cout << scheduler << ": " << elapsed << "s, "
+            << (elapsed > 0 ? m_trace.size () / elapsed : 0) << " operations/s, check " << check << std::endl;
+}
+
+void
+PrintHelp (void)
+{
+  std::cout << "bench-scheduler filename [options]" << std::endl;
+  std::cout << "  filename: an event list trace, as written by wan-internet2-sack --eventTrace=filename" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "      --scheduler=TypeId: replay with this scheduler only, may be repeated" << std::endl;
+  std::cout << "                          (default: map, heap, calendar and quad heap schedulers)" << std::endl;
+  std::cout << "      --n=N: replay N times with each scheduler" << std::endl;
+}
+
+int main (int argc, char *argv[])
+{
+  if (argc == 1)
+    {
+      PrintHelp ();
+      return 0;
+    }
+  char const *filename = argv[1];
+  std::vector<std::string> schedulers;
+  uint32_t n = 1;
+  argc -= 2;
+  argv += 2;
+  while (argc > 0)
+    {
+      if (strncmp ("--scheduler=", argv[0], strlen ("--scheduler=")) == 0)
+        {
+          schedulers.push_back (argv[0] + strlen ("--scheduler="));
+        }
+      else if (strncmp ("--n=", argv[0], strlen ("--n=")) == 0)
+        {
+          n = atoi (argv[0] + strlen ("--n="));
+        }
+      argc--;
+      argv++;
+    }
+  if (schedulers.empty ())
+    {
+      // the list scheduler is left out: it is quadratic
+      schedulers.push_back ("ns3::MapScheduler");
+      schedulers.push_back ("ns3::HeapScheduler");
+      schedulers.push_back ("ns3::CalendarScheduler");
+      schedulers.push_back ("ns3::QuadHeapScheduler");
+    }
+
+  Bench bench;
+  if (!bench.ReadTrace (filename))
+    {
+      std::cerr << "can not read " << filename << std::endl;
+      return 1;
+    }
+  for (uint32_t i = 0; i < n; i++)
+    {
+      for (std::vector<std::string>::const_iterator j = schedulers.begin (); j != schedulers.end (); j++)
+        {
+          bench.RunBench (*j);
+        }
+    }
+
+  return 0;
+}